@@ -0,0 +1,550 @@
+/*
+ * BRIDGE Capture Log Seek
+ * Prints the part of a sniff log (or a LAST capture log) around a given time,
+ * using the name.idx time index next to it instead of reading the whole file.
+ * The index layout is in ../src/sniff_protocol.h.
+ *
+ * Usage:
+ *   ./log_seek FILE FROM [TO]          - Print the capture from FROM until TO
+ *   ./log_seek --rebuild FILE [DATE]   - Recreate FILE.idx from the capture
+ *
+ * Times are "YYYY-mm-dd HH:MM:SS", "HH:MM:SS" on the day the capture starts, or
+ * seconds since the epoch. Output starts at the last index point at or before
+ * FROM and ends at the first one after TO, so it covers a little more than asked.
+ *
+ * Framed sniff logs and LAST logs carry full timestamps. Hex and text sniff
+ * logs only carry the time of day: --rebuild takes the date from a rotated file
+ * name, or DATE (YYYY-mm-dd) if given. Raw logs have no timestamps to index.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <ctype.h>
+#include <zlib.h>
+#include "../src/sniff_protocol.h"
+
+#define CHUNK_SIZE (256 * 1024)
+// Longest line start a timestamp is looked for in, "[YYYY-mm-dd HH:MM:SS]" or "HH:MM:SS.uuuuuu "
+#define LINE_PREFIX_SIZE 24
+
+typedef struct {
+    int fd;
+    uint8_t flags;
+    uint64_t count;
+} Index;
+
+static int open_index(const char *path, Index *index) {
+    char index_path[4096];
+    unsigned char header[SNIFF_INDEX_HEADER_SIZE];
+
+    snprintf(index_path, sizeof(index_path), "%s%s", path, SNIFF_INDEX_SUFFIX);
+    index->fd = open(index_path, O_RDONLY);
+    if (index->fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s (try --rebuild)\n", index_path, strerror(errno));
+        return -1;
+    }
+
+    off_t size = lseek(index->fd, 0, SEEK_END);
+    if (size < SNIFF_INDEX_HEADER_SIZE ||
+        pread(index->fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        !sniff_index_decode_header(header, &index->flags)) {
+        fprintf(stderr, "%s is not a capture index\n", index_path);
+        close(index->fd);
+        return -1;
+    }
+    // A torn last entry from a writer that was killed is ignored
+    index->count = (uint64_t)(size - SNIFF_INDEX_HEADER_SIZE) / SNIFF_INDEX_ENTRY_SIZE;
+    return 0;
+}
+
+static int read_entry(const Index *index, uint64_t i, SniffIndexEntry *entry) {
+    unsigned char encoded[SNIFF_INDEX_ENTRY_SIZE];
+    off_t at = SNIFF_INDEX_HEADER_SIZE + (off_t)i * SNIFF_INDEX_ENTRY_SIZE;
+
+    if (pread(index->fd, encoded, sizeof(encoded), at) != (ssize_t)sizeof(encoded)) {
+        return -1;
+    }
+    sniff_index_decode_entry(encoded, entry);
+    return 0;
+}
+
+// Number of entries before timestamp_ns; entries are in time order, and
+// several may share a time (LAST's have whole seconds)
+static uint64_t entries_before(const Index *index, uint64_t timestamp_ns) {
+    uint64_t low = 0;
+    uint64_t high = index->count;
+    SniffIndexEntry entry;
+
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (read_entry(index, middle, &entry) != 0) {
+            high = middle;
+        } else if (entry.timestamp_ns < timestamp_ns) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static int parse_time(const char *text, const Index *index, uint64_t *timestamp_ns) {
+    struct tm tm_info;
+    const char *end;
+    char *number_end;
+
+    memset(&tm_info, 0, sizeof(tm_info));
+    tm_info.tm_isdst = -1;
+
+    if ((end = strptime(text, "%Y-%m-%d %H:%M:%S", &tm_info)) && *end == '\0') {
+        // Full local date and time
+    } else if ((end = strptime(text, "%H:%M:%S", &tm_info)) && *end == '\0') {
+        SniffIndexEntry first;
+        if (index->count == 0 || read_entry(index, 0, &first) != 0) return -1;
+        time_t start = (time_t)(first.timestamp_ns / 1000000000ULL);
+        struct tm day;
+        localtime_r(&start, &day);
+        tm_info.tm_year = day.tm_year;
+        tm_info.tm_mon = day.tm_mon;
+        tm_info.tm_mday = day.tm_mday;
+    } else {
+        unsigned long long seconds = strtoull(text, &number_end, 10);
+        if (number_end == text || *number_end != '\0') return -1;
+        *timestamp_ns = seconds * 1000000000ULL;
+        return 0;
+    }
+
+    time_t seconds = mktime(&tm_info);
+    if (seconds == (time_t)-1) return -1;
+    *timestamp_ns = (uint64_t)seconds * 1000000000ULL;
+    return 0;
+}
+
+static int write_out(const unsigned char *data, size_t len) {
+    return fwrite(data, 1, len, stdout) == len ? 0 : -1;
+}
+
+// Uncompressed bytes [start, end) of a plain file
+static int copy_plain(int fd, uint64_t start, uint64_t end) {
+    unsigned char *buffer = malloc(CHUNK_SIZE);
+    if (!buffer) return -1;
+
+    uint64_t position = start;
+    while (position < end) {
+        size_t want = end - position < CHUNK_SIZE ? (size_t)(end - position) : CHUNK_SIZE;
+        ssize_t got = pread(fd, buffer, want, (off_t)position);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0 || write_out(buffer, (size_t)got) != 0) break;
+        position += got;
+    }
+    free(buffer);
+    return position == end || end == UINT64_MAX ? 0 : -1;
+}
+
+// Raw inflate from a full flush point the writer left at offset
+static int copy_gzip_from(int fd, uint64_t offset, uint64_t data_offset, uint64_t end) {
+    unsigned char *in = malloc(CHUNK_SIZE);
+    unsigned char *out = malloc(CHUNK_SIZE);
+    z_stream stream;
+    int status = Z_OK;
+
+    memset(&stream, 0, sizeof(stream));
+    if (!in || !out || inflateInit2(&stream, -15) != Z_OK) {
+        free(in);
+        free(out);
+        return -1;
+    }
+
+    uint64_t position = data_offset;
+    off_t read_at = (off_t)offset;
+    while (position < end && status != Z_STREAM_END) {
+        ssize_t got = pread(fd, in, CHUNK_SIZE, read_at);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        read_at += got;
+
+        stream.next_in = in;
+        stream.avail_in = (uInt)got;
+        do {
+            stream.next_out = out;
+            stream.avail_out = CHUNK_SIZE;
+            status = inflate(&stream, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                fprintf(stderr, "Corrupt data at offset %llu: %s\n", (unsigned long long)offset,
+                        stream.msg ? stream.msg : "inflate failed");
+                goto done;
+            }
+            size_t produced = CHUNK_SIZE - stream.avail_out;
+            if (position + produced > end) produced = (size_t)(end - position);
+            if (write_out(out, produced) != 0) goto done;
+            position += produced;
+        } while (stream.avail_out == 0 && position < end && status != Z_STREAM_END);
+    }
+
+done:
+    inflateEnd(&stream);
+    free(in);
+    free(out);
+    return 0;
+}
+
+// A rebuilt index has no flush points: decompress from the start and skip
+static int copy_gzip_skipping(const char *path, uint64_t start, uint64_t end) {
+    gzFile file = gzopen(path, "rb");
+    unsigned char *buffer = malloc(CHUNK_SIZE);
+    if (!file || !buffer) {
+        if (file) gzclose(file);
+        free(buffer);
+        return -1;
+    }
+
+    gzbuffer(file, CHUNK_SIZE);
+    if (gzseek(file, (z_off_t)start, SEEK_SET) < 0) {
+        gzclose(file);
+        free(buffer);
+        return -1;
+    }
+
+    uint64_t position = start;
+    while (position < end) {
+        unsigned want = end - position < CHUNK_SIZE ? (unsigned)(end - position) : CHUNK_SIZE;
+        int got = gzread(file, buffer, want);
+        if (got <= 0 || write_out(buffer, (size_t)got) != 0) break;
+        position += got;
+    }
+    gzclose(file);
+    free(buffer);
+    return 0;
+}
+
+static int seek_and_print(const char *path, const char *from_text, const char *to_text) {
+    Index index;
+    uint64_t from_ns, to_ns = UINT64_MAX;
+    SniffIndexEntry start = { 0, 0, 0 };
+    SniffIndexEntry stop;
+    uint64_t end = UINT64_MAX;
+
+    if (open_index(path, &index) != 0) return 1;
+    if (parse_time(from_text, &index, &from_ns) != 0 ||
+        (to_text && parse_time(to_text, &index, &to_ns) != 0)) {
+        fprintf(stderr, "Cannot read the time; use \"YYYY-mm-dd HH:MM:SS\", \"HH:MM:SS\" or epoch seconds\n");
+        close(index.fd);
+        return 1;
+    }
+    // TO is a whole second; everything captured within it is wanted
+    if (to_text) to_ns += 999999999ULL;
+
+    // From the first entry at FROM, else the last one before it
+    uint64_t first = entries_before(&index, from_ns);
+    SniffIndexEntry entry;
+    if (!(first < index.count && read_entry(&index, first, &entry) == 0 && entry.timestamp_ns == from_ns)) {
+        first = first > 0 ? first - 1 : index.count;
+    }
+    if (first < index.count && read_entry(&index, first, &start) != 0) first = index.count;
+    uint64_t after = to_text ? entries_before(&index, to_ns + 1) : index.count;
+    if (after < index.count && read_entry(&index, after, &stop) == 0) end = stop.data_offset;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        close(index.fd);
+        return 1;
+    }
+
+    fprintf(stderr, "%llu index entries; reading from byte %llu", (unsigned long long)index.count,
+            (unsigned long long)start.data_offset);
+    if (end != UINT64_MAX) fprintf(stderr, " to %llu", (unsigned long long)end);
+    fprintf(stderr, "%s\n", (index.flags & SNIFF_INDEX_GZIP) ? " of the uncompressed capture" : "");
+
+    int result;
+    if (!(index.flags & SNIFF_INDEX_GZIP)) {
+        result = copy_plain(fd, start.data_offset, end);
+    } else if (first < index.count && start.offset != SNIFF_INDEX_NO_OFFSET) {
+        result = copy_gzip_from(fd, start.offset, start.data_offset, end);
+    } else {
+        result = copy_gzip_skipping(path, start.data_offset, end);
+    }
+
+    fflush(stdout);
+    close(fd);
+    close(index.fd);
+    return result == 0 ? 0 : 1;
+}
+
+// Rebuilding: find every record's start and time in the uncompressed capture,
+// and index them the way the writer does
+
+typedef enum {
+    CAPTURE_UNKNOWN,
+    CAPTURE_FRAMED,             // BSFR frames
+    CAPTURE_LAST,               // "[YYYY-mm-dd HH:MM:SS] RX: ..." lines
+    CAPTURE_TIME_OF_DAY         // "HH:MM:SS.uuuuuu D: ..." hex or text lines
+} CaptureKind;
+
+typedef struct {
+    CaptureKind kind;
+    FILE *out;
+    int gzip;
+    uint64_t position;          // Uncompressed offset of the next byte fed in
+
+    // Framed: header bytes gathered so far, then data bytes still to skip
+    unsigned char header[SNIFF_FRAME_HEADER_SIZE];
+    size_t header_length;
+    uint64_t skip;
+
+    // Lines: the start of the current one, gathered until it can be parsed
+    char line[LINE_PREFIX_SIZE + 1];
+    size_t line_length;
+    uint64_t line_start;
+    int gathering;
+
+    // Time of day lines: the capture's first day, and days since
+    struct tm day;
+    int days;
+    int last_seconds;
+
+    unsigned long records;      // Since the last index point
+    uint64_t last_index_ns;
+    uint64_t written_ns;
+    unsigned long entries;
+} Scanner;
+
+static void add_record(Scanner *scanner, uint64_t offset, uint64_t timestamp_ns) {
+    if (scanner->entries == 0 || scanner->records >= SNIFF_INDEX_RECORDS ||
+        timestamp_ns >= scanner->last_index_ns + SNIFF_INDEX_INTERVAL_MS * 1000000ULL) {
+        // Entries never go back in time; the reader's binary search relies on it
+        if (timestamp_ns >= scanner->written_ns) {
+            SniffIndexEntry entry = {
+                .timestamp_ns = timestamp_ns,
+                .offset = scanner->gzip ? SNIFF_INDEX_NO_OFFSET : offset,
+                .data_offset = offset
+            };
+            unsigned char encoded[SNIFF_INDEX_ENTRY_SIZE];
+            sniff_index_encode_entry(encoded, &entry);
+            fwrite(encoded, 1, sizeof(encoded), scanner->out);
+            scanner->written_ns = timestamp_ns;
+            scanner->entries++;
+        }
+        scanner->last_index_ns = timestamp_ns;
+        scanner->records = 0;
+    }
+    scanner->records++;
+}
+
+static void parse_line(Scanner *scanner) {
+    struct tm tm_info;
+    int year, month, mday, hour, minute, second, micros;
+
+    scanner->line[scanner->line_length] = '\0';
+    if (scanner->kind == CAPTURE_LAST) {
+        if (sscanf(scanner->line, "[%4d-%2d-%2d %2d:%2d:%2d]", &year, &month, &mday,
+                   &hour, &minute, &second) != 6) {
+            return;
+        }
+        memset(&tm_info, 0, sizeof(tm_info));
+        tm_info.tm_year = year - 1900;
+        tm_info.tm_mon = month - 1;
+        tm_info.tm_mday = mday;
+        micros = 0;
+    } else {
+        if (sscanf(scanner->line, "%2d:%2d:%2d.%6d ", &hour, &minute, &second, &micros) != 4) {
+            return;
+        }
+        // Half a day backwards can only be midnight
+        int seconds = hour * 3600 + minute * 60 + second;
+        if (seconds + 43200 < scanner->last_seconds) scanner->days++;
+        scanner->last_seconds = seconds;
+        tm_info = scanner->day;
+        tm_info.tm_mday += scanner->days;
+    }
+    tm_info.tm_hour = hour;
+    tm_info.tm_min = minute;
+    tm_info.tm_sec = second;
+    tm_info.tm_isdst = -1;
+
+    time_t seconds = mktime(&tm_info);
+    if (seconds == (time_t)-1) return;
+    add_record(scanner, scanner->line_start, (uint64_t)seconds * 1000000000ULL + micros * 1000ULL);
+}
+
+static void scan_lines(Scanner *scanner, const unsigned char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (scanner->gathering) {
+            if (data[i] == '\n' || scanner->line_length == LINE_PREFIX_SIZE) {
+                parse_line(scanner);
+                scanner->gathering = 0;
+            } else {
+                scanner->line[scanner->line_length++] = (char)data[i];
+            }
+        }
+        if (data[i] == '\n') {
+            scanner->gathering = 1;
+            scanner->line_length = 0;
+            scanner->line_start = scanner->position + i + 1;
+        }
+    }
+}
+
+static int scan_frames(Scanner *scanner, const unsigned char *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len) {
+        if (scanner->skip > 0) {
+            size_t chunk = len - i < scanner->skip ? len - i : (size_t)scanner->skip;
+            i += chunk;
+            scanner->skip -= chunk;
+            continue;
+        }
+
+        size_t want = SNIFF_FRAME_HEADER_SIZE - scanner->header_length;
+        size_t chunk = len - i < want ? len - i : want;
+        memcpy(scanner->header + scanner->header_length, data + i, chunk);
+        scanner->header_length += chunk;
+        i += chunk;
+        if (scanner->header_length < SNIFF_FRAME_HEADER_SIZE) break;
+
+        SniffFrameHeader header;
+        uint64_t start = scanner->position + i - SNIFF_FRAME_HEADER_SIZE;
+        if (!sniff_frame_decode(scanner->header, &header)) {
+            fprintf(stderr, "No frame header at byte %llu; the index stops there\n",
+                    (unsigned long long)start);
+            return -1;
+        }
+        add_record(scanner, start, header.timestamp_ns);
+        scanner->header_length = 0;
+        scanner->skip = header.length;
+    }
+    return 0;
+}
+
+static CaptureKind detect_kind(const unsigned char *data, size_t len) {
+    size_t i = 0;
+
+    if (len >= 4 && sniff_get_u32(data) == SNIFF_FRAME_MAGIC) return CAPTURE_FRAMED;
+    // LAST logs start with a blank line and "=== Log started at ... ==="
+    while (i < len && data[i] == '\n') i++;
+    if (i < len && (data[i] == '[' || data[i] == '=')) return CAPTURE_LAST;
+    if (len - i >= 3 && isdigit(data[i]) && isdigit(data[i + 1]) && data[i + 2] == ':') {
+        return CAPTURE_TIME_OF_DAY;
+    }
+    return CAPTURE_UNKNOWN;
+}
+
+// The date of a hex or text log: DATE, else the stamp in a rotated file's name
+// (base_00001_YYYYmmddHHMMSS.log)
+static int capture_day(const char *path, const char *date, struct tm *day) {
+    memset(day, 0, sizeof(*day));
+    if (date) {
+        const char *end = strptime(date, "%Y-%m-%d", day);
+        return end && *end == '\0' ? 0 : -1;
+    }
+
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    for (const char *p = strchr(name, '_'); p; p = strchr(p + 1, '_')) {
+        size_t digits = strspn(p + 1, "0123456789");
+        if (digits == 14) {
+            const char *end = strptime(p + 1, "%Y%m%d%H%M%S", day);
+            return end ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+static int rebuild(const char *path, const char *date) {
+    Scanner scanner;
+    char index_path[4096], temp_path[4096 + 8];
+    unsigned char header[SNIFF_INDEX_HEADER_SIZE];
+    int result = 0;
+
+    memset(&scanner, 0, sizeof(scanner));
+    snprintf(index_path, sizeof(index_path), "%s%s", path, SNIFF_INDEX_SUFFIX);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", index_path);
+
+    // gzread passes uncompressed files through as they are
+    gzFile file = gzopen(path, "rb");
+    unsigned char *buffer = malloc(CHUNK_SIZE);
+    if (!file || !buffer) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        if (file) gzclose(file);
+        free(buffer);
+        return 1;
+    }
+    gzbuffer(file, CHUNK_SIZE);
+
+    int got = gzread(file, buffer, CHUNK_SIZE);
+    scanner.gzip = !gzdirect(file);
+    scanner.kind = got > 0 ? detect_kind(buffer, (size_t)got) : CAPTURE_UNKNOWN;
+    if (scanner.kind == CAPTURE_UNKNOWN) {
+        fprintf(stderr, "%s has no timestamps to index (a raw log?)\n", path);
+        result = 1;
+    } else if (scanner.kind == CAPTURE_TIME_OF_DAY && capture_day(path, date, &scanner.day) != 0) {
+        fprintf(stderr, "%s only has times of day; give its date as YYYY-mm-dd\n", path);
+        result = 1;
+    } else if (!(scanner.out = fopen(temp_path, "wb"))) {
+        fprintf(stderr, "Cannot create %s: %s\n", temp_path, strerror(errno));
+        result = 1;
+    }
+    if (result != 0) {
+        gzclose(file);
+        free(buffer);
+        return result;
+    }
+
+    sniff_index_encode_header(header, scanner.gzip ? SNIFF_INDEX_GZIP : 0);
+    fwrite(header, 1, sizeof(header), scanner.out);
+    scanner.gathering = 1;          // The file starts a line
+
+    while (got > 0) {
+        if (scanner.kind == CAPTURE_FRAMED) {
+            if (scan_frames(&scanner, buffer, (size_t)got) != 0) break;
+        } else {
+            scan_lines(&scanner, buffer, (size_t)got);
+        }
+        scanner.position += got;
+        got = gzread(file, buffer, CHUNK_SIZE);
+    }
+    if (got < 0) {
+        int error;
+        fprintf(stderr, "Stopped at byte %llu: %s\n", (unsigned long long)scanner.position,
+                gzerror(file, &error));
+    }
+
+    gzclose(file);
+    free(buffer);
+    if (fclose(scanner.out) != 0 || rename(temp_path, index_path) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", index_path, strerror(errno));
+        unlink(temp_path);
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %lu entries over %llu bytes%s\n", index_path, scanner.entries,
+            (unsigned long long)scanner.position,
+            scanner.gzip ? " (gzip: seeking decompresses from the start)" : "");
+    return 0;
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "  %s FILE FROM [TO]          - Print the capture from FROM until TO\n", program);
+    fprintf(stderr, "  %s --rebuild FILE [DATE]   - Recreate FILE%s from the capture\n", program,
+            SNIFF_INDEX_SUFFIX);
+    fprintf(stderr, "\nTimes: \"YYYY-mm-dd HH:MM:SS\", \"HH:MM:SS\" or epoch seconds\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "--rebuild") == 0) {
+        return rebuild(argv[2], argc == 4 ? argv[3] : NULL);
+    }
+    if (argc < 3 || argc > 4 || argv[1][0] == '-') {
+        print_usage(argv[0]);
+        return 1;
+    }
+    return seek_and_print(argv[1], argv[2], argc == 4 ? argv[3] : NULL);
+}
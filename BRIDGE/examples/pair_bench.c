@@ -0,0 +1,205 @@
+/*
+ * BRIDGE Null Modem Pair Benchmark
+ * Drives serial-speed traffic through every pair of a running BRIDGE and
+ * reports the CPU the BRIDGE process spends relaying it
+ *
+ * Usage:
+ *   ./pair_bench [pairs] [seconds] [bytes_per_second] [bridge_pid]
+ *
+ * Start BRIDGE with the same number of pairs and the default device paths
+ * first. The default rate of 11520 bytes/s is a 115200 baud 8N1 line, sent in
+ * both directions on every pair. Without a pid, the first process named
+ * "bridge" is measured.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <termios.h>
+
+#define DEVICE1_BASE "/tmp/ttyV0"
+#define DEVICE2_BASE "/tmp/ttyV1"
+#define MAX_PAIRS 32
+#define TICK_US 10000
+
+typedef struct {
+    int fd;                     // Writes go out here and arrive on the other end
+    unsigned long long sent;
+    unsigned long long received; // By the other end
+    unsigned long long errors;
+} Direction;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Same naming as BRIDGE: pair 0 uses the base path, pair N appends "_N"
+static void pair_path(const char *base, int pair, char *buffer, size_t size) {
+    if (pair == 0) {
+        snprintf(buffer, size, "%s", base);
+    } else {
+        snprintf(buffer, size, "%s_%d", base, pair);
+    }
+}
+
+static int open_raw(const char *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static pid_t find_bridge(void) {
+    DIR *proc = opendir("/proc");
+    if (!proc) return -1;
+
+    pid_t found = -1;
+    struct dirent *entry;
+    while (found < 0 && (entry = readdir(proc)) != NULL) {
+        char path[300], comm[64];
+        snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+        FILE *file = fopen(path, "r");
+        if (!file) continue;
+        if (fgets(comm, sizeof(comm), file) && strcmp(comm, "bridge\n") == 0) {
+            found = (pid_t)atoi(entry->d_name);
+        }
+        fclose(file);
+    }
+    closedir(proc);
+    return found;
+}
+
+// User plus system time of a process in seconds, or -1
+static double process_cpu_seconds(pid_t pid) {
+    char path[64], line[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+    char *ok = fgets(line, sizeof(line), file);
+    fclose(file);
+    if (!ok) return -1;
+
+    // Fields 14 and 15, counted after the parenthesised command name
+    char *fields = strrchr(line, ')');
+    unsigned long utime, stime;
+    if (!fields || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                          &utime, &stime) != 2) {
+        return -1;
+    }
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// Writes what is due; the data is a running byte counter so the reader can check it
+static void send_due(Direction *direction, unsigned long long due) {
+    unsigned char buffer[4096];
+    while (direction->sent < due) {
+        size_t length = due - direction->sent < sizeof(buffer) ? due - direction->sent : sizeof(buffer);
+        for (size_t i = 0; i < length; i++) {
+            buffer[i] = (unsigned char)(direction->sent + i);
+        }
+        ssize_t written = write(direction->fd, buffer, length);
+        if (written <= 0) break;
+        direction->sent += written;
+    }
+}
+
+static void receive(Direction *direction, int fd) {
+    unsigned char buffer[4096];
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < bytes_read; i++) {
+            if (buffer[i] != (unsigned char)(direction->received + i)) {
+                direction->errors++;
+            }
+        }
+        direction->received += bytes_read;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int pairs = argc >= 2 ? atoi(argv[1]) : 8;
+    int seconds = argc >= 3 ? atoi(argv[2]) : 10;
+    double rate = argc >= 4 ? atof(argv[3]) : 11520.0;
+    pid_t pid = argc >= 5 ? (pid_t)atoi(argv[4]) : find_bridge();
+
+    if (pairs < 1 || pairs > MAX_PAIRS || seconds < 1 || rate <= 0) {
+        printf("BRIDGE Null Modem Pair Benchmark\n");
+        printf("Usage: %s [pairs 1-%d] [seconds] [bytes_per_second] [bridge_pid]\n", argv[0], MAX_PAIRS);
+        return 1;
+    }
+
+    // directions[2 * i] is device 1 -> device 2 of pair i, [2 * i + 1] the reverse
+    static Direction directions[2 * MAX_PAIRS];
+    for (int i = 0; i < pairs; i++) {
+        char path1[256], path2[256];
+        pair_path(DEVICE1_BASE, i, path1, sizeof(path1));
+        pair_path(DEVICE2_BASE, i, path2, sizeof(path2));
+        directions[2 * i].fd = open_raw(path1);
+        directions[2 * i + 1].fd = open_raw(path2);
+        if (directions[2 * i].fd < 0 || directions[2 * i + 1].fd < 0) {
+            return 1;
+        }
+    }
+
+    if (pid <= 0) {
+        printf("No BRIDGE process found; CPU use will not be measured\n");
+    }
+    printf("Sending %.0f bytes/s each way on %d pairs for %d s...\n", rate, pairs, seconds);
+
+    double cpu_start = pid > 0 ? process_cpu_seconds(pid) : -1;
+    double start = now_seconds();
+    double end = start + seconds;
+    double now;
+
+    while ((now = now_seconds()) < end) {
+        unsigned long long due = (unsigned long long)((now - start) * rate);
+        for (int i = 0; i < pairs; i++) {
+            send_due(&directions[2 * i], due);
+            send_due(&directions[2 * i + 1], due);
+            receive(&directions[2 * i], directions[2 * i + 1].fd);
+            receive(&directions[2 * i + 1], directions[2 * i].fd);
+        }
+        usleep(TICK_US);
+    }
+
+    // Let the relay catch up before counting what is missing
+    usleep(200000);
+    for (int i = 0; i < pairs; i++) {
+        receive(&directions[2 * i], directions[2 * i + 1].fd);
+        receive(&directions[2 * i + 1], directions[2 * i].fd);
+    }
+    double elapsed = now_seconds() - start;
+    double cpu = pid > 0 ? process_cpu_seconds(pid) - cpu_start : -1;
+
+    unsigned long long sent = 0, received = 0, errors = 0;
+    for (int i = 0; i < 2 * pairs; i++) {
+        sent += directions[i].sent;
+        received += directions[i].received;
+        errors += directions[i].errors;
+        close(directions[i].fd);
+    }
+
+    printf("Relayed %llu of %llu bytes in %.1f s, %llu corrupt\n", received, sent, elapsed, errors);
+    if (cpu >= 0 && cpu_start >= 0) {
+        printf("  BRIDGE CPU %.2f%% total, %.3f%% per pair, %.1f µs per KB\n",
+               cpu / elapsed * 100.0, cpu / elapsed * 100.0 / pairs,
+               received > 0 ? cpu * 1e6 / (received / 1024.0) : 0.0);
+    }
+
+    return received == sent && errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*
+ * BRIDGE Sniffing Throughput Benchmark
+ * Measures the framed-format decoder on its own, or a live BRIDGE output
+ *
+ * Usage:
+ *   ./sniff_bench decode [frame_size] [frames]   - Decode synthetic frames in memory
+ *   ./sniff_bench tcp [seconds]                  - Read Framed output from BRIDGE's TCP server
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "sniff_lib.h"
+
+// Bytes handed to the decoder per call, like a typical recv()
+#define CHUNK_SIZE 4096
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void count_frame(const SniffFrame *frame, void *user_data) {
+    unsigned long long *checksum = (unsigned long long *)user_data;
+    if (frame->header.length > 0) {
+        *checksum += frame->data[0];
+    }
+}
+
+static int bench_decode(size_t frame_size, unsigned long frames) {
+    size_t frame_bytes = SNIFF_FRAME_HEADER_SIZE + frame_size;
+    size_t total = frame_bytes * frames;
+    unsigned char *stream = malloc(total);
+    if (!stream) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (unsigned long i = 0; i < frames; i++) {
+        SniffFrameHeader header = {
+            .version = SNIFF_FRAME_VERSION,
+            .direction = (i & 1) ? 'R' : 'T',
+            .sequence = i,
+            .timestamp_ns = 1000000000ULL * i,
+            .length = (uint32_t)frame_size
+        };
+        unsigned char *frame = stream + i * frame_bytes;
+        sniff_frame_encode(frame, &header);
+        memset(frame + SNIFF_FRAME_HEADER_SIZE, (int)(i & 0xFF), frame_size);
+    }
+
+    unsigned long long checksum = 0;
+    SniffDecoder decoder;
+    if (sniff_decoder_init(&decoder, count_frame, &checksum) != 0) {
+        free(stream);
+        return 1;
+    }
+
+    double start = now_seconds();
+    for (size_t offset = 0; offset < total; offset += CHUNK_SIZE) {
+        size_t chunk = total - offset < CHUNK_SIZE ? total - offset : CHUNK_SIZE;
+        sniff_decoder_feed(&decoder, stream + offset, chunk);
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("Decoded %lu frames of %zu bytes in %.3f s\n", decoder.frames, frame_size, elapsed);
+    printf("  %.1f MB/s, %.2f M frames/s, %llu lost, %llu bytes skipped (checksum %llu)\n",
+           total / elapsed / 1e6, decoder.frames / elapsed / 1e6,
+           decoder.lost, decoder.skipped_bytes, checksum);
+
+    int ok = decoder.frames == frames && decoder.lost == 0 && decoder.skipped_bytes == 0;
+    sniff_decoder_free(&decoder);
+    free(stream);
+    return ok ? 0 : 1;
+}
+
+static int bench_tcp(int seconds) {
+    int sock = sniff_connect_tcp("localhost", SNIFF_DEFAULT_TCP_PORT);
+    if (sock < 0) {
+        perror("Failed to connect to TCP server");
+        return 1;
+    }
+
+    SniffDecoder decoder;
+    if (sniff_decoder_init(&decoder, NULL, NULL) != 0) {
+        close(sock);
+        return 1;
+    }
+
+    printf("Reading Framed output from localhost:%d for %d s...\n", SNIFF_DEFAULT_TCP_PORT, seconds);
+
+    static unsigned char buffer[65536];
+    unsigned long long received = 0;
+    double start = now_seconds();
+    double end = start + seconds;
+
+    while (now_seconds() < end) {
+        ssize_t bytes_read = recv(sock, buffer, sizeof(buffer), 0);
+        if (bytes_read == 0) break;
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            perror("TCP receive error");
+            break;
+        }
+        received += bytes_read;
+        sniff_decoder_feed(&decoder, buffer, bytes_read);
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("Received %llu bytes, %lu frames (%llu data bytes) in %.1f s\n",
+           received, decoder.frames, decoder.bytes, elapsed);
+    printf("  %.2f MB/s, %.0f frames/s, %llu frames dropped by BRIDGE, %llu bytes skipped\n",
+           received / elapsed / 1e6, decoder.frames / elapsed, decoder.lost, decoder.skipped_bytes);
+
+    sniff_decoder_free(&decoder);
+    close(sock);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "decode") == 0) {
+        size_t frame_size = argc >= 3 ? (size_t)atol(argv[2]) : 64;
+        unsigned long frames = argc >= 4 ? (unsigned long)atol(argv[3]) : 1000000;
+        if (frame_size > SNIFF_FRAME_MAX_LENGTH) frame_size = SNIFF_FRAME_MAX_LENGTH;
+        return bench_decode(frame_size, frames);
+    }
+    if (argc >= 2 && strcmp(argv[1], "tcp") == 0) {
+        return bench_tcp(argc >= 3 ? atoi(argv[2]) : 10);
+    }
+
+    printf("BRIDGE Sniffing Throughput Benchmark\n");
+    printf("Usage:\n");
+    printf("  %s decode [frame_size] [frames]  - Decode synthetic frames in memory\n", argv[0]);
+    printf("  %s tcp [seconds]                 - Read Framed output from BRIDGE's TCP server\n", argv[0]);
+    return 1;
+}
@@ -1,14 +1,18 @@
 /*
  * Example BRIDGE Sniffing Client
  * Demonstrates how to receive sniffed serial data from BRIDGE
- * 
+ *
  * This example shows three methods of receiving data:
  * 1. Named Pipe reader
  * 2. TCP client
  * 3. UDP listener
- * 
- * Compile: gcc -o sniff_client sniff_client.c
- * Usage: ./sniff_client [pipe|tcp|udp]
+ *
+ * With --framed, BRIDGE must use the Framed format; every packet is then
+ * printed with its sequence number, timestamp, direction and channel as hex.
+ * Otherwise the data is printed as it arrives (Hex and Text formats).
+ *
+ * Compile: make (needs sniff_lib.c and ../src/sniff_protocol.h)
+ * Usage: ./sniff_client [--framed] [pipe|tcp|udp]
  */
 
 #define _GNU_SOURCE
@@ -16,21 +20,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netinet/ip.h>
-#include <arpa/inet.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "sniff_lib.h"
 
-#define BUFFER_SIZE 4096
-#define DEFAULT_PIPE_PATH "/tmp/bridge_sniff_pipe"
-#define DEFAULT_TCP_PORT 8888
-#define DEFAULT_UDP_PORT 9999
-#define DEFAULT_UDP_ADDR "239.1.1.1"
+#define BUFFER_SIZE 65536
 
 volatile int running = 1;
+int framed = 0;
+SniffDecoder decoder;
 
 void signal_handler(int sig) {
     (void)sig;
@@ -38,43 +38,78 @@ void signal_handler(int sig) {
     printf("\nShutting down...\n");
 }
 
+void print_frame(const SniffFrame *frame, void *user_data) {
+    const char *source = (const char *)user_data;
+    time_t seconds = (time_t)(frame->header.timestamp_ns / 1000000000ULL);
+    struct tm tm_info;
+    char time_str[16];
+
+    localtime_r(&seconds, &tm_info);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
+    printf("%s #%llu %s.%09llu %c ch%u [%u]:", source, (unsigned long long)frame->header.sequence,
+           time_str, (unsigned long long)(frame->header.timestamp_ns % 1000000000ULL),
+           frame->header.direction, frame->header.channel, frame->header.length);
+    for (uint32_t i = 0; i < frame->header.length; i++) {
+        printf(" %02X", frame->data[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Hand received bytes to the decoder, or print them as they are
+void handle_data(const char *source, const char *data, size_t length) {
+    if (framed) {
+        unsigned long long lost = decoder.lost;
+        decoder.user_data = (void *)source;
+        if (sniff_decoder_feed(&decoder, data, length) != 0) {
+            fprintf(stderr, "Decoder overflow\n");
+        }
+        if (decoder.lost != lost) {
+            fprintf(stderr, "[BRIDGE dropped %llu packets for this output, %llu total]\n",
+                    decoder.lost - lost, decoder.lost);
+        }
+        return;
+    }
+
+    printf("%s: %.*s", source, (int)length, data);
+    fflush(stdout);
+}
+
 int read_from_pipe(const char *pipe_path) {
     printf("Opening named pipe: %s\n", pipe_path);
     printf("Make sure BRIDGE is running with pipe output enabled.\n");
     printf("Press Ctrl+C to exit.\n\n");
-    
-    int fd = open(pipe_path, O_RDONLY);
+
+    int fd = sniff_open_pipe(pipe_path);
     if (fd < 0) {
         perror("Failed to open pipe");
         return 1;
     }
-    
-    char buffer[BUFFER_SIZE];
+
+    static char buffer[BUFFER_SIZE];
     while (running) {
-        ssize_t bytes_read = read(fd, buffer, sizeof(buffer) - 1);
+        ssize_t bytes_read = read(fd, buffer, sizeof(buffer));
         if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            printf("PIPE: %s", buffer);
-            fflush(stdout);
+            handle_data("PIPE", buffer, bytes_read);
         } else if (bytes_read == 0) {
             // Pipe closed, try to reopen
             close(fd);
             usleep(100000); // 100ms
-            fd = open(pipe_path, O_RDONLY);
+            fd = sniff_open_pipe(pipe_path);
             if (fd < 0) {
                 perror("Failed to reopen pipe");
                 break;
             }
         } else {
-            if (errno != EAGAIN) {
+            if (errno != EAGAIN && errno != EINTR) {
                 perror("Pipe read error");
                 break;
             }
             usleep(10000); // 10ms
         }
     }
-    
-    close(fd);
+
+    if (fd >= 0) close(fd);
     return 0;
 }
 
@@ -82,43 +117,29 @@ int read_from_tcp(int port) {
     printf("Connecting to TCP server on localhost:%d\n", port);
     printf("Make sure BRIDGE is running with TCP output enabled.\n");
     printf("Press Ctrl+C to exit.\n\n");
-    
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    int sock = sniff_connect_tcp("localhost", port);
     if (sock < 0) {
-        perror("Failed to create TCP socket");
-        return 1;
-    }
-    
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    
-    if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         perror("Failed to connect to TCP server");
-        close(sock);
         return 1;
     }
-    
+
     printf("Connected to BRIDGE TCP server!\n\n");
-    
-    char buffer[BUFFER_SIZE];
+
+    static char buffer[BUFFER_SIZE];
     while (running) {
-        ssize_t bytes_read = recv(sock, buffer, sizeof(buffer) - 1, 0);
+        ssize_t bytes_read = recv(sock, buffer, sizeof(buffer), 0);
         if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            printf("TCP: %s", buffer);
-            fflush(stdout);
+            handle_data("TCP", buffer, bytes_read);
         } else if (bytes_read == 0) {
             printf("TCP connection closed by server\n");
             break;
-        } else {
+        } else if (errno != EINTR) {
             perror("TCP receive error");
             break;
         }
     }
-    
+
     close(sock);
     return 0;
 }
@@ -127,76 +148,55 @@ int read_from_udp(int port, const char *addr) {
     printf("Listening for UDP packets on %s:%d\n", addr, port);
     printf("Make sure BRIDGE is running with UDP output enabled.\n");
     printf("Press Ctrl+C to exit.\n\n");
-    
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    int sock = sniff_open_udp(addr, port);
     if (sock < 0) {
-        perror("Failed to create UDP socket");
+        perror("Failed to open UDP socket");
         return 1;
     }
-    
-    // Enable address reuse
-    int opt = 1;
-    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_port = htons(port);
-    local_addr.sin_addr.s_addr = INADDR_ANY;
-    
-    if (bind(sock, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
-        perror("Failed to bind UDP socket");
-        close(sock);
-        return 1;
-    }
-    
-    // Join multicast group if it's a multicast address
-    if (inet_addr(addr) >= inet_addr("224.0.0.0") && inet_addr(addr) <= inet_addr("239.255.255.255")) {
-        struct ip_mreq mreq;
-        mreq.imr_multiaddr.s_addr = inet_addr(addr);
-        mreq.imr_interface.s_addr = INADDR_ANY;
-        
-        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
-            perror("Failed to join multicast group");
-            close(sock);
-            return 1;
-        }
-        printf("Joined multicast group %s\n", addr);
-    }
-    
+
     printf("UDP listener ready!\n\n");
-    
-    char buffer[BUFFER_SIZE];
-    struct sockaddr_in sender_addr;
-    socklen_t sender_len = sizeof(sender_addr);
-    
+
+    static char buffer[BUFFER_SIZE];
+    SniffUdpTracker tracker;
+    memset(&tracker, 0, sizeof(tracker));
+
     while (running) {
-        ssize_t bytes_read = recvfrom(sock, buffer, sizeof(buffer) - 1, 0,
-                                    (struct sockaddr*)&sender_addr, &sender_len);
-        if (bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            printf("UDP: %s", buffer);
-            fflush(stdout);
-        } else if (bytes_read < 0) {
-            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        ssize_t bytes_read = recv(sock, buffer, sizeof(buffer), 0);
+        if (bytes_read < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
                 perror("UDP receive error");
                 break;
             }
-            usleep(10000); // 10ms
+            continue;
+        }
+
+        unsigned long long lost = tracker.lost;
+        size_t payload_length;
+        const unsigned char *payload = sniff_udp_payload(&tracker, buffer, bytes_read,
+                                                         &payload_length, NULL);
+        if (!payload) {
+            continue;
+        }
+        if (tracker.lost != lost) {
+            fprintf(stderr, "[lost %llu datagrams, %llu total]\n", tracker.lost - lost, tracker.lost);
         }
+        handle_data("UDP", (const char *)payload, payload_length);
     }
-    
+
     close(sock);
     return 0;
 }
 
 void print_usage(const char *program_name) {
     printf("BRIDGE Sniffing Client Example\n");
-    printf("Usage: %s [method]\n\n", program_name);
+    printf("Usage: %s [--framed] [method]\n\n", program_name);
     printf("Methods:\n");
-    printf("  pipe  - Read from named pipe (default: %s)\n", DEFAULT_PIPE_PATH);
-    printf("  tcp   - Connect to TCP server (default: localhost:%d)\n", DEFAULT_TCP_PORT);
-    printf("  udp   - Listen for UDP packets (default: %s:%d)\n", DEFAULT_UDP_ADDR, DEFAULT_UDP_PORT);
+    printf("  pipe  - Read from named pipe (default: %s)\n", SNIFF_DEFAULT_PIPE_PATH);
+    printf("  tcp   - Connect to TCP server (default: localhost:%d)\n", SNIFF_DEFAULT_TCP_PORT);
+    printf("  udp   - Listen for UDP packets (default: %s:%d)\n", SNIFF_DEFAULT_UDP_ADDR, SNIFF_DEFAULT_UDP_PORT);
+    printf("\nOptions:\n");
+    printf("  --framed  Decode BRIDGE's Framed format\n");
     printf("\nThis client demonstrates how to receive sniffed serial data from BRIDGE.\n");
     printf("Make sure BRIDGE is running with the corresponding output method enabled.\n");
 }
@@ -204,23 +204,39 @@ void print_usage(const char *program_name) {
 int main(int argc, char *argv[]) {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
-    
-    if (argc != 2) {
+
+    int arg = 1;
+    if (argc > 1 && strcmp(argv[1], "--framed") == 0) {
+        framed = 1;
+        arg++;
+    }
+    if (argc != arg + 1) {
         print_usage(argv[0]);
         return 1;
     }
-    
-    const char *method = argv[1];
-    
+
+    if (framed && sniff_decoder_init(&decoder, print_frame, NULL) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    const char *method = argv[arg];
+    int result;
+
     if (strcmp(method, "pipe") == 0) {
-        return read_from_pipe(DEFAULT_PIPE_PATH);
+        result = read_from_pipe(SNIFF_DEFAULT_PIPE_PATH);
     } else if (strcmp(method, "tcp") == 0) {
-        return read_from_tcp(DEFAULT_TCP_PORT);
+        result = read_from_tcp(SNIFF_DEFAULT_TCP_PORT);
     } else if (strcmp(method, "udp") == 0) {
-        return read_from_udp(DEFAULT_UDP_PORT, DEFAULT_UDP_ADDR);
+        result = read_from_udp(SNIFF_DEFAULT_UDP_PORT, SNIFF_DEFAULT_UDP_ADDR);
     } else {
         printf("Unknown method: %s\n\n", method);
         print_usage(argv[0]);
-        return 1;
+        result = 1;
+    }
+
+    if (framed) {
+        sniff_decoder_free(&decoder);
     }
+    return result;
 }
@@ -0,0 +1,193 @@
+/*
+ * BRIDGE Sniffing Client Library
+ * Opens the BRIDGE sniff outputs and decodes the framed format
+ */
+
+#define _GNU_SOURCE
+#include "sniff_lib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+int sniff_open_pipe(const char *path) {
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+int sniff_connect_tcp(const char *host, int port) {
+    struct addrinfo hints, *result, *entry;
+    char port_str[16];
+    int sock = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    if (getaddrinfo(host, port_str, &hints, &result) != 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+
+    for (entry = result; entry; entry = entry->ai_next) {
+        sock = socket(entry->ai_family, entry->ai_socktype | SOCK_CLOEXEC, entry->ai_protocol);
+        if (sock < 0) continue;
+        if (connect(sock, entry->ai_addr, entry->ai_addrlen) == 0) break;
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+int sniff_open_udp(const char *group, int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return -1;
+
+    int opt = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_port = htons(port);
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(sock, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    struct in_addr group_addr;
+    if (inet_pton(AF_INET, group, &group_addr) == 1 && IN_MULTICAST(ntohl(group_addr.s_addr))) {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = group_addr;
+        mreq.imr_interface.s_addr = INADDR_ANY;
+        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            int error = errno;
+            close(sock);
+            errno = error;
+            return -1;
+        }
+    }
+
+    return sock;
+}
+
+int sniff_decoder_init(SniffDecoder *decoder, SniffFrameCallback callback, void *user_data) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->capacity = SNIFF_FRAME_HEADER_SIZE + SNIFF_FRAME_MAX_LENGTH;
+    decoder->buffer = malloc(decoder->capacity);
+    decoder->callback = callback;
+    decoder->user_data = user_data;
+    return decoder->buffer ? 0 : -1;
+}
+
+void sniff_decoder_free(SniffDecoder *decoder) {
+    free(decoder->buffer);
+    decoder->buffer = NULL;
+}
+
+static void deliver(SniffDecoder *decoder, const SniffFrameHeader *header, const unsigned char *data) {
+    if (decoder->have_sequence && header->sequence > decoder->next_sequence) {
+        decoder->lost += header->sequence - decoder->next_sequence;
+    }
+    decoder->have_sequence = 1;
+    decoder->next_sequence = header->sequence + 1;
+    decoder->frames++;
+    decoder->bytes += header->length;
+
+    if (decoder->callback) {
+        SniffFrame frame = { *header, data };
+        decoder->callback(&frame, decoder->user_data);
+    }
+}
+
+// Decode whole frames from data; returns how many bytes were used. Whatever
+// is left is the start of a frame that has not fully arrived yet.
+static size_t decode(SniffDecoder *decoder, const unsigned char *data, size_t length) {
+    size_t pos = 0;
+
+    while (length - pos >= SNIFF_FRAME_HEADER_SIZE) {
+        SniffFrameHeader header;
+        if (!sniff_frame_decode(data + pos, &header)) {
+            // Lost sync: look for the next magic
+            pos++;
+            decoder->skipped_bytes++;
+            continue;
+        }
+        if (length - pos < SNIFF_FRAME_HEADER_SIZE + header.length) {
+            break;
+        }
+        deliver(decoder, &header, data + pos + SNIFF_FRAME_HEADER_SIZE);
+        pos += SNIFF_FRAME_HEADER_SIZE + header.length;
+    }
+    return pos;
+}
+
+int sniff_decoder_feed(SniffDecoder *decoder, const void *data, size_t length) {
+    const unsigned char *input = data;
+
+    // Complete a frame left over from earlier calls
+    while (decoder->length > 0 && length > 0) {
+        size_t want = SNIFF_FRAME_HEADER_SIZE;
+        SniffFrameHeader header;
+        if (decoder->length >= SNIFF_FRAME_HEADER_SIZE &&
+            sniff_frame_decode(decoder->buffer, &header)) {
+            want += header.length;
+        }
+
+        size_t take = want > decoder->length ? want - decoder->length : 0;
+        if (take > length) take = length;
+        memcpy(decoder->buffer + decoder->length, input, take);
+        decoder->length += take;
+        input += take;
+        length -= take;
+
+        size_t used = decode(decoder, decoder->buffer, decoder->length);
+        memmove(decoder->buffer, decoder->buffer + used, decoder->length - used);
+        decoder->length -= used;
+        if (take == 0 && used == 0) break;
+    }
+
+    // Fast path: decode straight from the caller's data, keep only the tail
+    if (decoder->length == 0) {
+        size_t used = decode(decoder, input, length);
+        input += used;
+        length -= used;
+    }
+
+    if (decoder->length + length > decoder->capacity) {
+        return -1;
+    }
+    memcpy(decoder->buffer + decoder->length, input, length);
+    decoder->length += length;
+    return 0;
+}
+
+const unsigned char* sniff_udp_payload(SniffUdpTracker *tracker, const void *datagram,
+                                       size_t length, size_t *payload_length,
+                                       SniffUdpHeader *header) {
+    SniffUdpHeader parsed;
+    if (!sniff_udp_decode(datagram, length, &parsed)) {
+        return NULL;
+    }
+
+    if (tracker->have_sequence && parsed.sequence != tracker->next_sequence) {
+        tracker->lost += (uint32_t)(parsed.sequence - tracker->next_sequence);
+    }
+    tracker->have_sequence = 1;
+    tracker->next_sequence = parsed.sequence + 1;
+    tracker->datagrams++;
+
+    if (header) *header = parsed;
+    *payload_length = length - SNIFF_UDP_HEADER_SIZE;
+    return (const unsigned char *)datagram + SNIFF_UDP_HEADER_SIZE;
+}
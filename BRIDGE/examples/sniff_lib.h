@@ -0,0 +1,69 @@
+/*
+ * BRIDGE Sniffing Client Library
+ * Opens the BRIDGE sniff outputs and decodes the framed format
+ *
+ * Link sniff_lib.c into your program and add BRIDGE/src to the include
+ * path for sniff_protocol.h, which defines the wire layout.
+ */
+
+#ifndef SNIFF_LIB_H
+#define SNIFF_LIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sniff_protocol.h"
+
+#define SNIFF_DEFAULT_PIPE_PATH "/tmp/bridge_sniff_pipe"
+#define SNIFF_DEFAULT_TCP_PORT 8888
+#define SNIFF_DEFAULT_UDP_PORT 9999
+#define SNIFF_DEFAULT_UDP_ADDR "239.1.1.1"
+
+// Opening the outputs; each returns a descriptor or -1 with errno set
+int sniff_open_pipe(const char *path);
+int sniff_connect_tcp(const char *host, int port);
+int sniff_open_udp(const char *group, int port);   // Joins the group if it is multicast
+
+// One decoded frame; data is only valid during the callback
+typedef struct {
+    SniffFrameHeader header;
+    const unsigned char *data;
+} SniffFrame;
+
+typedef void (*SniffFrameCallback)(const SniffFrame *frame, void *user_data);
+
+// Turns a byte stream from any output into frames. Bytes may arrive in any
+// split; garbage and cut frames are skipped up to the next valid header.
+typedef struct {
+    unsigned char *buffer;
+    size_t length;
+    size_t capacity;
+    SniffFrameCallback callback;
+    void *user_data;
+
+    int have_sequence;
+    uint64_t next_sequence;
+    unsigned long frames;
+    unsigned long long bytes;
+    unsigned long long lost;            // Frames missing from the sequence (dropped by BRIDGE)
+    unsigned long long skipped_bytes;   // Bytes thrown away while resynchronising
+} SniffDecoder;
+
+int sniff_decoder_init(SniffDecoder *decoder, SniffFrameCallback callback, void *user_data);
+void sniff_decoder_free(SniffDecoder *decoder);
+// Returns 0, or -1 if out of memory
+int sniff_decoder_feed(SniffDecoder *decoder, const void *data, size_t length);
+
+// Tracks the sequence of UDP datagrams; returns the payload after the
+// datagram header, or NULL if the datagram is not from BRIDGE
+typedef struct {
+    int have_sequence;
+    uint32_t next_sequence;
+    unsigned long datagrams;
+    unsigned long long lost;
+} SniffUdpTracker;
+
+const unsigned char* sniff_udp_payload(SniffUdpTracker *tracker, const void *datagram,
+                                       size_t length, size_t *payload_length,
+                                       SniffUdpHeader *header);
+
+#endif // SNIFF_LIB_H
@@ -9,6 +9,7 @@
 #include "ui.h"
 #include "settings.h"
 #include "utils.h"
+#include "impair.h"
 
 void connect_signals(BridgeApp *app) {
     // Window signals
@@ -23,6 +24,41 @@ void connect_signals(BridgeApp *app) {
     // Entry signals
     g_signal_connect(app->device1_entry, "changed", G_CALLBACK(on_device_entry_changed), app);
     g_signal_connect(app->device2_entry, "changed", G_CALLBACK(on_device_entry_changed), app);
+    g_signal_connect(app->pair_count_spin, "value-changed", G_CALLBACK(on_pair_count_changed), app);
+    g_signal_connect(app->pair_sniff_renderer, "toggled", G_CALLBACK(on_pair_sniff_toggled), app);
+
+    // Multiplexer signals
+    g_signal_connect(app->mode_combo, "changed", G_CALLBACK(on_mode_changed), app);
+    g_signal_connect(app->mux_port_entry, "changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_baud_combo, "changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_data_bits_combo, "changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_parity_combo, "changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_stop_bits_combo, "changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_flow_combo, "changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_clients_spin, "value-changed", G_CALLBACK(on_mux_settings_changed), app);
+    g_signal_connect(app->mux_policy_combo, "changed", G_CALLBACK(on_mux_settings_changed), app);
+
+    // Line emulation signals
+    g_signal_connect(app->line_pair_spin, "value-changed", G_CALLBACK(on_line_pair_changed), app);
+    g_signal_connect(app->line_baud_combo, "changed", G_CALLBACK(on_line_settings_changed), app);
+    g_signal_connect(app->line_format_combo, "changed", G_CALLBACK(on_line_settings_changed), app);
+    g_signal_connect(app->line_gap_entry, "changed", G_CALLBACK(on_line_settings_changed), app);
+    g_signal_connect(app->line_buffer_entry, "changed", G_CALLBACK(on_line_settings_changed), app);
+    g_signal_connect(app->line_apply_all_button, "clicked", G_CALLBACK(on_line_apply_all_clicked), app);
+
+    // Impairment signals
+    g_signal_connect(app->impair_pair_spin, "value-changed", G_CALLBACK(on_impair_selection_changed), app);
+    g_signal_connect(app->impair_direction_combo, "changed", G_CALLBACK(on_impair_selection_changed), app);
+    g_signal_connect(app->impair_latency_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_jitter_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_jitter_combo, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_drop_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_ber_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_outage_interval_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_outage_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_rate_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_seed_entry, "changed", G_CALLBACK(on_impair_settings_changed), app);
+    g_signal_connect(app->impair_apply_all_button, "clicked", G_CALLBACK(on_impair_apply_all_clicked), app);
     
     // Settings signals
     g_signal_connect(app->auto_start_check, "toggled", G_CALLBACK(on_settings_changed), app);
@@ -37,8 +73,10 @@ void connect_signals(BridgeApp *app) {
     g_signal_connect(app->sniff_tcp_check, "toggled", G_CALLBACK(on_sniff_output_toggled), app);
     g_signal_connect(app->sniff_udp_check, "toggled", G_CALLBACK(on_sniff_output_toggled), app);
     g_signal_connect(app->sniff_file_check, "toggled", G_CALLBACK(on_sniff_output_toggled), app);
+    g_signal_connect(app->sniff_pcap_check, "toggled", G_CALLBACK(on_sniff_output_toggled), app);
     g_signal_connect(app->sniff_direction_combo, "changed", G_CALLBACK(on_sniff_settings_changed), app);
     g_signal_connect(app->sniff_format_combo, "changed", G_CALLBACK(on_sniff_settings_changed), app);
+    g_signal_connect(app->sniff_policy_combo, "changed", G_CALLBACK(on_sniff_settings_changed), app);
 }
 
 void on_start_button_clicked(GtkButton *button, gpointer user_data) {
@@ -61,30 +99,42 @@ void on_start_button_clicked(GtkButton *button, gpointer user_data) {
     
     strncpy(app->device1_path, device1, MAX_PATH_LENGTH - 1);
     strncpy(app->device2_path, device2, MAX_PATH_LENGTH - 1);
+    app->pair_count = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->pair_count_spin));
+    update_mux_settings_from_ui(app);
+
+    if (app->mode == BRIDGE_MODE_MULTIPLEXER && strlen(app->mux_port_path) == 0) {
+        log_message(app, "ERROR: Please enter the serial port to multiplex");
+        return;
+    }
     
-    // Start null modem in a separate thread to avoid blocking UI
-    GThread *start_thread = g_thread_new("start_nullmodem", 
-                                        (GThreadFunc)start_nullmodem_thread, app);
-    g_thread_unref(start_thread);
+    // Start on the main loop, like a supervised restart, so the two never
+    // overlap; the idle lets the buttons redraw first
+    gtk_widget_set_sensitive(app->start_button, FALSE);
+    g_idle_add(start_nullmodem_idle, app);
 }
 
 void on_stop_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; // Suppress unused parameter warning
     BridgeApp *app = (BridgeApp *)user_data;
     
-    // Stop null modem in a separate thread
-    GThread *stop_thread = g_thread_new("stop_nullmodem", 
-                                       (GThreadFunc)stop_nullmodem_thread, app);
-    g_thread_unref(stop_thread);
+    // On the main loop too; stopping also cancels a pending restart
+    gtk_widget_set_sensitive(app->stop_button, FALSE);
+    g_idle_add(stop_nullmodem_idle, app);
 }
 
 void on_test_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; // Suppress unused parameter warning
     BridgeApp *app = (BridgeApp *)user_data;
     
-    // Test communication in a separate thread
+    // The checks and the copy of the device paths happen here; only the
+    // waiting for the test data runs in a separate thread
+    CommunicationTest *test = communication_test_new(app);
+    if (!test) {
+        show_error_dialog("✗ Communication test failed!");
+        return;
+    }
     GThread *test_thread = g_thread_new("test_communication", 
-                                       (GThreadFunc)test_communication_thread, app);
+                                       (GThreadFunc)test_communication_thread, test);
     g_thread_unref(test_thread);
 }
 
@@ -108,10 +158,14 @@ void on_window_destroy(GtkWidget *widget, gpointer user_data) {
         stop_null_modem(app);
     }
     
-    // Stop status timer
+    // Stop status and log timers
     if (app->status_timer_id > 0) {
         g_source_remove(app->status_timer_id);
     }
+    if (app->log_drain_id > 0) {
+        g_source_remove(app->log_drain_id);
+        app->log_drain_id = 0;
+    }
     
     gtk_main_quit();
 }
@@ -131,6 +185,174 @@ void on_device_entry_changed(GtkEntry *entry, gpointer user_data) {
     save_settings(app);
 }
 
+void on_pair_count_changed(GtkSpinButton *spin, gpointer user_data) {
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    // The running pairs stay as they are until the next start
+    if (app->state == BRIDGE_STATE_RUNNING || app->state == BRIDGE_STATE_STARTING) {
+        return;
+    }
+
+    app->pair_count = gtk_spin_button_get_value_as_int(spin);
+    update_pairs_view(app);
+    save_settings(app);
+}
+
+void on_pair_sniff_toggled(GtkCellRendererToggle *renderer, gchar *path, gpointer user_data) {
+    (void)renderer; // Suppress unused parameter warning
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    // Read by the relay tap on every chunk, so this takes effect immediately
+    int pair = atoi(path);
+    if (pair >= 0 && pair < MAX_BRIDGE_PAIRS) {
+        app->pair_sniff[pair] = !app->pair_sniff[pair];
+        log_message(app, "Sniffing %s for pair %d", app->pair_sniff[pair] ? "enabled" : "disabled", pair);
+        update_pairs_view(app);
+    }
+}
+
+void on_mode_changed(GtkComboBox *combo, gpointer user_data) {
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    // Only selectable while stopped, see update_ui_state
+    app->mode = gtk_combo_box_get_active(combo) == 1 ? BRIDGE_MODE_MULTIPLEXER : BRIDGE_MODE_NULL_MODEM;
+    update_ui_state(app);
+    update_pairs_view(app);
+    save_settings(app);
+}
+
+void on_mux_settings_changed(GtkWidget *widget, gpointer user_data) {
+    (void)widget; // Suppress unused parameter warning
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    update_mux_settings_from_ui(app);
+    update_pairs_view(app);
+    save_settings(app);
+}
+
+void update_mux_settings_from_ui(BridgeApp *app) {
+    // The frame is insensitive while running, so these never change under a live mux
+    const char *port = gtk_entry_get_text(GTK_ENTRY(app->mux_port_entry));
+    strncpy(app->mux_port_path, port, MAX_PATH_LENGTH - 1);
+
+    const char *baud = gtk_combo_box_get_active_id(GTK_COMBO_BOX(app->mux_baud_combo));
+    const char *data_bits = gtk_combo_box_get_active_id(GTK_COMBO_BOX(app->mux_data_bits_combo));
+    const char *parity = gtk_combo_box_get_active_id(GTK_COMBO_BOX(app->mux_parity_combo));
+    const char *stop_bits = gtk_combo_box_get_active_id(GTK_COMBO_BOX(app->mux_stop_bits_combo));
+    if (baud) app->mux_baud = atoi(baud);
+    if (data_bits) app->mux_data_bits = atoi(data_bits);
+    if (parity) app->mux_parity = parity[0];
+    if (stop_bits) app->mux_stop_bits = atoi(stop_bits);
+
+    app->mux_flow = (MuxFlowControl)MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(app->mux_flow_combo)), 0);
+    app->mux_policy = (MuxPolicy)MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(app->mux_policy_combo)), 0);
+    app->mux_clients = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->mux_clients_spin));
+}
+
+void on_line_pair_changed(GtkSpinButton *spin, gpointer user_data) {
+    (void)spin; // Suppress unused parameter warning
+    show_line_settings((BridgeApp *)user_data);
+}
+
+void on_line_settings_changed(GtkWidget *widget, gpointer user_data) {
+    (void)widget; // Suppress unused parameter warning
+    BridgeApp *app = (BridgeApp *)user_data;
+    if (app->line_loading) return;
+
+    // The frame is insensitive while running; the pairs pick this up on the next start
+    int pair = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->line_pair_spin));
+    LineEmulation *line = &app->pair_line[pair];
+
+    const char *baud = gtk_combo_box_get_active_id(GTK_COMBO_BOX(app->line_baud_combo));
+    const char *format = gtk_combo_box_get_active_id(GTK_COMBO_BOX(app->line_format_combo));
+    if (baud) line->baud = atoi(baud);
+    if (format && strlen(format) == 3) {
+        line->data_bits = format[0] - '0';
+        line->parity = format[1];
+        line->stop_bits = format[2] - '0';
+    }
+    line->gap_us = (unsigned int)strtoul(gtk_entry_get_text(GTK_ENTRY(app->line_gap_entry)), NULL, 10);
+    line->device_buffer = (unsigned int)strtoul(gtk_entry_get_text(GTK_ENTRY(app->line_buffer_entry)),
+                                                NULL, 10);
+
+    update_pairs_view(app);
+    save_settings(app);
+}
+
+void on_line_apply_all_clicked(GtkButton *button, gpointer user_data) {
+    (void)button; // Suppress unused parameter warning
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    int pair = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->line_pair_spin));
+    for (int i = 0; i < MAX_BRIDGE_PAIRS; i++) {
+        app->pair_line[i] = app->pair_line[pair];
+    }
+
+    char description[128];
+    format_line_emulation(&app->pair_line[pair], description, sizeof(description));
+    log_message(app, "Line emulation for all pairs: %s", description[0] ? description : "off");
+    update_pairs_view(app);
+    save_settings(app);
+}
+
+void on_impair_selection_changed(GtkWidget *widget, gpointer user_data) {
+    (void)widget; // Suppress unused parameter warning
+    show_impairment_settings((BridgeApp *)user_data);
+}
+
+static unsigned int entry_uint(GtkWidget *entry) {
+    return (unsigned int)strtoul(gtk_entry_get_text(GTK_ENTRY(entry)), NULL, 10);
+}
+
+// A probability; anything unparsable or out of range counts as 0 or 1
+static double entry_rate(GtkWidget *entry) {
+    double rate = strtod(gtk_entry_get_text(GTK_ENTRY(entry)), NULL);
+    return rate > 0.0 ? MIN(rate, 1.0) : 0.0;
+}
+
+void on_impair_settings_changed(GtkWidget *widget, gpointer user_data) {
+    (void)widget; // Suppress unused parameter warning
+    BridgeApp *app = (BridgeApp *)user_data;
+    if (app->impair_loading) return;
+
+    // The frame is insensitive while running; the pairs pick this up on the next start
+    int pair = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->impair_pair_spin));
+    int direction = MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(app->impair_direction_combo)), 0);
+    LinkImpairment *config = &app->pair_impair[pair][direction];
+
+    config->latency_ms = entry_uint(app->impair_latency_entry);
+    config->jitter_ms = entry_uint(app->impair_jitter_entry);
+    config->jitter_dist = (ImpairJitter)MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(app->impair_jitter_combo)), 0);
+    config->drop_rate = entry_rate(app->impair_drop_entry);
+    config->bit_error_rate = entry_rate(app->impair_ber_entry);
+    config->outage_interval_ms = entry_uint(app->impair_outage_interval_entry);
+    config->outage_ms = entry_uint(app->impair_outage_entry);
+    config->rate_limit = entry_uint(app->impair_rate_entry);
+    app->impair_seed = entry_uint(app->impair_seed_entry);
+
+    save_settings(app);
+}
+
+void on_impair_apply_all_clicked(GtkButton *button, gpointer user_data) {
+    (void)button; // Suppress unused parameter warning
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    // Both directions of every pair
+    int pair = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->impair_pair_spin));
+    int direction = MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(app->impair_direction_combo)), 0);
+    LinkImpairment config = app->pair_impair[pair][direction];
+    for (int i = 0; i < MAX_BRIDGE_PAIRS; i++) {
+        app->pair_impair[i][0] = config;
+        app->pair_impair[i][1] = config;
+    }
+
+    char description[160];
+    format_impairment(&config, description, sizeof(description));
+    log_message(app, "Impairments for all pairs, both directions: %s",
+               description[0] ? description : "none");
+    save_settings(app);
+}
+
 void on_settings_changed(GtkWidget *widget, gpointer user_data) {
     BridgeApp *app = (BridgeApp *)user_data;
     
@@ -155,45 +377,48 @@ void on_settings_changed(GtkWidget *widget, gpointer user_data) {
     save_settings(app);
 }
 
-// Thread functions for non-blocking operations
-gpointer start_nullmodem_thread(gpointer data) {
+// Start and stop run on the main loop: the restart timer recreates the relay
+// there as well, and the lifecycle state is only touched from that thread
+gboolean start_nullmodem_idle(gpointer data) {
     BridgeApp *app = (BridgeApp *)data;
-    
-    gboolean success = create_null_modem(app);
-    
-    // Update UI from main thread
-    g_idle_add((GSourceFunc)update_ui_state, app);
-    
-    if (!success) {
+
+    // A second click queued behind the first finds it already running
+    if (app->state == BRIDGE_STATE_RUNNING) return G_SOURCE_REMOVE;
+
+    if (!create_null_modem(app)) {
         g_idle_add((GSourceFunc)show_error_dialog, "Failed to start null modem. Check log for details.");
     }
-    
-    return NULL;
+    update_ui_state(app);
+    return G_SOURCE_REMOVE;
 }
 
-gpointer stop_nullmodem_thread(gpointer data) {
+gboolean stop_nullmodem_idle(gpointer data) {
     BridgeApp *app = (BridgeApp *)data;
-    
+
     stop_null_modem(app);
-    
-    // Update UI from main thread
-    g_idle_add((GSourceFunc)update_ui_state, app);
-    
-    return NULL;
+    update_ui_state(app);
+    return G_SOURCE_REMOVE;
 }
 
-gpointer test_communication_thread(gpointer data) {
-    BridgeApp *app = (BridgeApp *)data;
-    
-    gboolean success = test_null_modem_communication(app);
-    
-    // Show result dialog from main thread
-    if (success) {
-        g_idle_add((GSourceFunc)show_info_dialog, "✓ Communication test passed!");
+// Records the result and shows it, back on the main thread
+static gboolean finish_communication_test(gpointer data) {
+    CommunicationTest *test = (CommunicationTest *)data;
+    gboolean passed = test->passed;
+
+    communication_test_free(test);
+    if (passed) {
+        show_info_dialog("✓ Communication test passed!");
     } else {
-        g_idle_add((GSourceFunc)show_error_dialog, "✗ Communication test failed!");
+        show_error_dialog("✗ Communication test failed!");
     }
-    
+    return G_SOURCE_REMOVE;
+}
+
+gpointer test_communication_thread(gpointer data) {
+    CommunicationTest *test = (CommunicationTest *)data;
+
+    communication_test_run(test);
+    g_idle_add(finish_communication_test, test);
     return NULL;
 }
 
@@ -280,6 +505,9 @@ void on_sniff_output_toggled(GtkToggleButton *button, gpointer user_data) {
     if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->sniff_file_check))) {
         app->sniff_output_methods |= SNIFF_OUTPUT_FILE;
     }
+    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->sniff_pcap_check))) {
+        app->sniff_output_methods |= SNIFF_OUTPUT_PCAPNG;
+    }
 }
 
 void on_sniff_settings_changed(GtkWidget *widget, gpointer user_data) {
@@ -312,6 +540,11 @@ void update_sniff_settings_from_ui(BridgeApp *app) {
         const char *udp_port = gtk_entry_get_text(GTK_ENTRY(app->sniff_udp_port_entry));
         strncpy(app->sniff_udp_addr, udp_addr, 63);
         app->sniff_udp_port = atoi(udp_port);
+
+        const char *udp_iface = gtk_entry_get_text(GTK_ENTRY(app->sniff_udp_iface_entry));
+        const char *udp_ttl = gtk_entry_get_text(GTK_ENTRY(app->sniff_udp_ttl_entry));
+        strncpy(app->sniff_udp_iface, udp_iface, 63);
+        app->sniff_udp_ttl = atoi(udp_ttl) > 0 ? atoi(udp_ttl) : DEFAULT_SNIFF_UDP_TTL;
     }
 
     if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->sniff_file_check))) {
@@ -320,6 +553,18 @@ void update_sniff_settings_from_ui(BridgeApp *app) {
         strncpy(app->sniff_log_file, log_file, MAX_PATH_LENGTH - 1);
     }
 
+    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->sniff_pcap_check))) {
+        app->sniff_output_methods |= SNIFF_OUTPUT_PCAPNG;
+        const char *pcap_path = gtk_entry_get_text(GTK_ENTRY(app->sniff_pcap_entry));
+        strncpy(app->sniff_pcap_path, pcap_path, MAX_PATH_LENGTH - 1);
+        app->sniff_pcap_live = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(app->sniff_pcap_live_check));
+
+        int rotate_mb = atoi(gtk_entry_get_text(GTK_ENTRY(app->sniff_pcap_size_entry)));
+        int rotate_seconds = atoi(gtk_entry_get_text(GTK_ENTRY(app->sniff_pcap_time_entry)));
+        app->sniff_pcap_rotate_mb = rotate_mb > 0 ? rotate_mb : 0;
+        app->sniff_pcap_rotate_seconds = rotate_seconds > 0 ? rotate_seconds : 0;
+    }
+
     // Update direction setting
     int direction_index = gtk_combo_box_get_active(GTK_COMBO_BOX(app->sniff_direction_combo));
     switch (direction_index) {
@@ -335,6 +580,16 @@ void update_sniff_settings_from_ui(BridgeApp *app) {
         case 0: app->sniff_format = SNIFF_FORMAT_RAW; break;
         case 1: app->sniff_format = SNIFF_FORMAT_HEX; break;
         case 2: app->sniff_format = SNIFF_FORMAT_TEXT; break;
+        case 3: app->sniff_format = SNIFF_FORMAT_FRAMED; break;
         default: app->sniff_format = SNIFF_FORMAT_HEX; break;
     }
+
+    // Update slow reader policy (applies to outputs started from now on)
+    int policy_index = gtk_combo_box_get_active(GTK_COMBO_BOX(app->sniff_policy_combo));
+    switch (policy_index) {
+        case 0: app->sniff_slow_policy = SNIFF_POLICY_DROP_OLDEST; break;
+        case 1: app->sniff_slow_policy = SNIFF_POLICY_DISCONNECT; break;
+        case 2: app->sniff_slow_policy = SNIFF_POLICY_BLOCK; break;
+        default: app->sniff_slow_policy = SNIFF_POLICY_DROP_OLDEST; break;
+    }
 }
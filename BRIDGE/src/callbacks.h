@@ -16,8 +16,25 @@ void on_test_button_clicked(GtkButton *button, gpointer user_data);
 void on_clear_log_clicked(GtkButton *button, gpointer user_data);
 void on_window_destroy(GtkWidget *widget, gpointer user_data);
 void on_device_entry_changed(GtkEntry *entry, gpointer user_data);
+void on_pair_count_changed(GtkSpinButton *spin, gpointer user_data);
+void on_pair_sniff_toggled(GtkCellRendererToggle *renderer, gchar *path, gpointer user_data);
 void on_settings_changed(GtkWidget *widget, gpointer user_data);
 
+// Multiplexer callbacks
+void on_mode_changed(GtkComboBox *combo, gpointer user_data);
+void on_mux_settings_changed(GtkWidget *widget, gpointer user_data);
+void update_mux_settings_from_ui(BridgeApp *app);
+
+// Line emulation callbacks
+void on_line_pair_changed(GtkSpinButton *spin, gpointer user_data);
+void on_line_settings_changed(GtkWidget *widget, gpointer user_data);
+void on_line_apply_all_clicked(GtkButton *button, gpointer user_data);
+
+// Impairment callbacks
+void on_impair_selection_changed(GtkWidget *widget, gpointer user_data);
+void on_impair_settings_changed(GtkWidget *widget, gpointer user_data);
+void on_impair_apply_all_clicked(GtkButton *button, gpointer user_data);
+
 // Sniffing callbacks
 void on_sniffing_enable_toggled(GtkToggleButton *button, gpointer user_data);
 void on_sniff_start_clicked(GtkButton *button, gpointer user_data);
@@ -26,9 +43,11 @@ void on_sniff_output_toggled(GtkToggleButton *button, gpointer user_data);
 void on_sniff_settings_changed(GtkWidget *widget, gpointer user_data);
 void update_sniff_settings_from_ui(BridgeApp *app);
 
+// Null modem lifecycle, run from the main loop
+gboolean start_nullmodem_idle(gpointer data);
+gboolean stop_nullmodem_idle(gpointer data);
+
 // Thread functions
-gpointer start_nullmodem_thread(gpointer data);
-gpointer stop_nullmodem_thread(gpointer data);
 gpointer test_communication_thread(gpointer data);
 
 // Dialog functions
@@ -6,6 +6,9 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+// Feature test macros for POSIX functions; must precede every system header
+#define _GNU_SOURCE
+
 // Standard includes
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,9 +23,6 @@
 #include <time.h>
 #include <pthread.h>
 
-// Feature test macros for POSIX functions
-#define _GNU_SOURCE
-
 // GTK includes
 #include <gtk/gtk.h>
 
@@ -31,16 +31,36 @@
 #define MAX_LOG_LENGTH 1024
 #define DEFAULT_DEVICE1 "/tmp/ttyV0"
 #define DEFAULT_DEVICE2 "/tmp/ttyV1"
-#define SOCAT_CHECK_INTERVAL 1000  // milliseconds
-#define DEVICE_CREATION_TIMEOUT 5000  // milliseconds
+// Null modem pairs run by one instance, all on the same relay thread
+#define MAX_BRIDGE_PAIRS 32
+#define DEFAULT_MUX_PORT "/dev/ttyUSB0"
+#define DEFAULT_MUX_BAUD 4800
+// Relay metrics query; "none" in the settings turns it off
+#define DEFAULT_STATS_SOCKET "/tmp/bridge_stats.sock"
+// A failed relay is recreated after 100 ms, doubling per failed attempt up to
+// 30 s, at most restart_budget times per 10 minutes
+#define RESTART_BACKOFF_MIN_MS 100
+#define RESTART_BACKOFF_MAX_MS 30000
+#define RESTART_WINDOW_SECONDS 600
+#define DEFAULT_RESTART_BUDGET 5
+#define MAX_RESTART_INCIDENTS 16
 
 // Sniffing constants
-#define MAX_SNIFF_BUFFER_SIZE 4096
 #define DEFAULT_SNIFF_PIPE "/tmp/bridge_sniff_pipe"
 #define DEFAULT_SNIFF_TCP_PORT 8888
 #define DEFAULT_SNIFF_UDP_PORT 9999
 #define DEFAULT_SNIFF_UDP_ADDR "239.1.1.1"
-#define MAX_SNIFF_CLIENTS 10
+#define DEFAULT_SNIFF_UDP_TTL 1
+#define DEFAULT_SNIFF_PCAP_FIFO "/tmp/bridge_sniff.pcapng"
+
+// One outage of a running bridge, from failure to recovery or stop
+typedef struct {
+    time_t failed_at;
+    guint64 downtime_ns;                // 0 while still down
+    int restarts;                       // Restarts attempted
+    gboolean recovered;
+    char reason[128];
+} RestartIncident;
 
 // Application states
 typedef enum {
@@ -51,13 +71,71 @@ typedef enum {
     BRIDGE_STATE_ERROR
 } BridgeState;
 
+// What Start creates
+typedef enum {
+    BRIDGE_MODE_NULL_MODEM,     // Pairs of PTYs connected back to back
+    BRIDGE_MODE_MULTIPLEXER     // One real serial port shared by several PTYs
+} BridgeMode;
+
+// Which client's data goes to a multiplexed port next
+typedef enum {
+    MUX_POLICY_FIFO,            // Whole chunks in arrival order
+    MUX_POLICY_PRIORITY,        // Lowest client number first
+    MUX_POLICY_EXCLUSIVE        // One client at a time; the others are discarded
+} MuxPolicy;
+
+typedef enum {
+    MUX_FLOW_NONE,
+    MUX_FLOW_HARDWARE,
+    MUX_FLOW_SOFTWARE
+} MuxFlowControl;
+
+// Serial line emulated on a null modem pair; baud 0 passes data unpaced
+typedef struct {
+    int baud;
+    int data_bits;
+    char parity;                // 'N', 'E' or 'O'
+    int stop_bits;
+    unsigned int gap_us;        // Extra idle time after every character
+    unsigned int device_buffer; // Receive buffer of the far device in bytes; 0 for unbounded
+} LineEmulation;
+
+// Shape of the random part of an impaired link's delay
+typedef enum {
+    IMPAIR_JITTER_UNIFORM,      // Evenly spread over latency ± jitter
+    IMPAIR_JITTER_NORMAL,       // Normal around latency, jitter is the standard deviation
+    IMPAIR_JITTER_EXPONENTIAL   // Latency plus an exponential tail with mean jitter
+} ImpairJitter;
+
+// Faults injected into one direction of a null modem pair; all zero for a clean link
+typedef struct {
+    unsigned int latency_ms;
+    unsigned int jitter_ms;
+    ImpairJitter jitter_dist;
+    double drop_rate;               // Probability of losing each byte
+    double bit_error_rate;          // Probability of flipping each bit
+    unsigned int outage_interval_ms; // Mean time between burst outages; 0 for none
+    unsigned int outage_ms;         // Length of each outage, in which everything is lost
+    unsigned int rate_limit;        // Bytes per second; 0 for no cap
+} LinkImpairment;
+
+// What the impairments did to the data
+typedef struct {
+    unsigned long delayed_chunks;
+    unsigned long dropped_bytes;
+    unsigned long flipped_bits;
+    unsigned long outages;
+    unsigned long outage_bytes;     // Lost in outages, not counted in dropped_bytes
+} ImpairStats;
+
 // Sniffing output methods
 typedef enum {
     SNIFF_OUTPUT_NONE = 0,
     SNIFF_OUTPUT_PIPE = 1,
     SNIFF_OUTPUT_TCP = 2,
     SNIFF_OUTPUT_UDP = 4,
-    SNIFF_OUTPUT_FILE = 8
+    SNIFF_OUTPUT_FILE = 8,
+    SNIFF_OUTPUT_PCAPNG = 16
 } SniffOutputMethod;
 
 // Sniffing data direction
@@ -71,9 +149,17 @@ typedef enum {
 typedef enum {
     SNIFF_FORMAT_RAW,
     SNIFF_FORMAT_HEX,
-    SNIFF_FORMAT_TEXT
+    SNIFF_FORMAT_TEXT,
+    SNIFF_FORMAT_FRAMED         // Binary header + data, see sniff_protocol.h
 } SniffFormat;
 
+// What a sniff output does when it falls too far behind
+typedef enum {
+    SNIFF_POLICY_DROP_OLDEST,
+    SNIFF_POLICY_DISCONNECT,
+    SNIFF_POLICY_BLOCK
+} SniffSlowPolicy;
+
 // Main application data structure
 typedef struct {
     // Main window and layout
@@ -84,6 +170,42 @@ typedef struct {
     // Configuration widgets
     GtkWidget *device1_entry;
     GtkWidget *device2_entry;
+    GtkWidget *pair_count_spin;
+    GtkWidget *mode_combo;
+    GtkWidget *mux_frame;
+    GtkWidget *mux_port_entry;
+    GtkWidget *mux_baud_combo;
+    GtkWidget *mux_data_bits_combo;
+    GtkWidget *mux_parity_combo;
+    GtkWidget *mux_stop_bits_combo;
+    GtkWidget *mux_flow_combo;
+    GtkWidget *mux_clients_spin;
+    GtkWidget *mux_policy_combo;
+    GtkWidget *line_frame;
+    GtkWidget *line_pair_spin;          // Pair whose line the widgets below show
+    GtkWidget *line_baud_combo;
+    GtkWidget *line_format_combo;
+    GtkWidget *line_gap_entry;
+    GtkWidget *line_buffer_entry;
+    GtkWidget *line_apply_all_button;
+    gboolean line_loading;              // Widgets are being filled from pair_line
+
+    // Impairment widgets; they show one direction of one pair
+    GtkWidget *impair_frame;
+    GtkWidget *impair_pair_spin;
+    GtkWidget *impair_direction_combo;
+    GtkWidget *impair_latency_entry;
+    GtkWidget *impair_jitter_entry;
+    GtkWidget *impair_jitter_combo;
+    GtkWidget *impair_drop_entry;
+    GtkWidget *impair_ber_entry;
+    GtkWidget *impair_outage_interval_entry;
+    GtkWidget *impair_outage_entry;
+    GtkWidget *impair_rate_entry;
+    GtkWidget *impair_seed_entry;
+    GtkWidget *impair_apply_all_button;
+    GtkWidget *impair_stats_label;
+    gboolean impair_loading;            // Widgets are being filled from pair_impair
     GtkWidget *start_button;
     GtkWidget *stop_button;
     GtkWidget *test_button;
@@ -93,10 +215,18 @@ typedef struct {
     GtkWidget *status_label;
     GtkWidget *devices_label;
     GtkWidget *connection_time_label;
+    GtkWidget *relay_stats_label;
+    GtkWidget *metrics_label;
+    GtkWidget *pairs_view;
+    GtkListStore *pairs_store;          // One status row per configured pair
+    GtkCellRenderer *pair_sniff_renderer;
 
-    // Log display
+    // Log display, fed from log_queue by the main loop
     GtkWidget *log_text;
     GtkTextBuffer *log_buffer;
+    struct LogQueue *log_queue;
+    guint log_drain_id;
+    int log_lines;
 
     // Settings widgets
     GtkWidget *auto_start_check;
@@ -113,35 +243,79 @@ typedef struct {
     GtkWidget *sniff_tcp_port_entry;
     GtkWidget *sniff_udp_port_entry;
     GtkWidget *sniff_udp_addr_entry;
+    GtkWidget *sniff_udp_iface_entry;
+    GtkWidget *sniff_udp_ttl_entry;
     GtkWidget *sniff_file_entry;
+    GtkWidget *sniff_pcap_check;
+    GtkWidget *sniff_pcap_entry;
+    GtkWidget *sniff_pcap_live_check;
+    GtkWidget *sniff_pcap_size_entry;
+    GtkWidget *sniff_pcap_time_entry;
     GtkWidget *sniff_direction_combo;
     GtkWidget *sniff_format_combo;
+    GtkWidget *sniff_policy_combo;
     GtkWidget *sniff_start_button;
     GtkWidget *sniff_stop_button;
     GtkWidget *sniff_stats_label;
 
     // Null modem state
     BridgeState state;
-    pid_t socat_pid;
+    BridgeMode mode;
+    struct RelayLoop *relay;            // Epoll thread shuttling bytes between the PTYs
+    struct SerialMux *mux;              // Multiplexer mode only
+    struct RelayPair *relay_pairs[MAX_BRIDGE_PAIRS];
+    int pair_count;                     // Pair N > 0 uses the device paths with "_N" appended
+    gboolean pair_sniff[MAX_BRIDGE_PAIRS]; // Pair is captured while sniffing
+    LineEmulation pair_line[MAX_BRIDGE_PAIRS]; // Applied when the pairs are created
+    LinkImpairment pair_impair[MAX_BRIDGE_PAIRS][2]; // [0] device 1 -> 2, [1] device 2 -> 1
+    unsigned int impair_seed;           // Same seed, same data: same faults
     char device1_path[MAX_PATH_LENGTH];
     char device2_path[MAX_PATH_LENGTH];
     time_t start_time;
+    guint64 startup_ns;                 // How long the last start took, links watched and all
+    char stats_socket_path[MAX_PATH_LENGTH]; // Empty when the stats query is off
+    struct StatsServer *stats_server;
+
+    // Multiplexer settings; client N uses device1_path with "_N" appended
+    char mux_port_path[MAX_PATH_LENGTH];
+    int mux_baud;
+    int mux_data_bits;
+    char mux_parity;                    // 'N', 'E' or 'O'
+    int mux_stop_bits;
+    MuxFlowControl mux_flow;
+    int mux_clients;
+    MuxPolicy mux_policy;
     gboolean running;
     
     // Monitoring
     guint status_timer_id;
-    pthread_t monitor_thread;
-    gboolean monitor_running;
+    int metrics_port;                   // Loopback Prometheus endpoint; 0 when off
+    struct MetricsHttpServer *metrics_http;
+
+    // Supervision: a relay that fails is recreated on the same device paths.
+    // Main thread only, like create_null_modem and stop_null_modem
+    guint restart_timer_id;             // Restart pending
+    int restart_attempts;               // Failed restarts in the current incident
+    time_t restart_window_start;
+    int restart_window_used;            // Restarts since restart_window_start
+    guint64 down_since_ns;              // 0 while up
+    unsigned long restarts;
+    guint64 downtime_ns;                // Over all incidents
+    RestartIncident incidents[MAX_RESTART_INCIDENTS]; // The latest, by incident_count
+    unsigned long incident_count;
 
     // Statistics
     unsigned long test_count;
     unsigned long successful_tests;
     time_t last_test_time;
+    ImpairStats impair_stats;           // Totals over all pairs, refreshed with the status
 
     // Settings
     gboolean auto_start;
     gboolean verbose_logging;
+    int restart_budget;        // Automatic restarts per RESTART_WINDOW_SECONDS; 0 is off
     char *device_permissions;  // "666", "644", etc.
+    gboolean headless;         // No window: logs go to stderr, see daemon.c
     
     // Appearance settings (following LAST pattern)
     char *font_family;
@@ -155,21 +329,33 @@ typedef struct {
     SniffOutputMethod sniff_output_methods;
     SniffDirection sniff_direction;
     SniffFormat sniff_format;
+    SniffSlowPolicy sniff_slow_policy;
     char sniff_pipe_path[MAX_PATH_LENGTH];
     int sniff_tcp_port;
     int sniff_udp_port;
     char sniff_udp_addr[64];
+    int sniff_udp_ttl;              // Multicast only
+    char sniff_udp_iface[64];       // Multicast interface address or name; empty for the default
     char sniff_log_file[MAX_PATH_LENGTH];
+    char sniff_pcap_path[MAX_PATH_LENGTH];
+    gboolean sniff_pcap_live;       // Path is a FIFO for "wireshark -k -i"
+    unsigned int sniff_pcap_rotate_mb;      // 0 for no size limit
+    unsigned int sniff_pcap_rotate_seconds; // 0 for no time limit
+    gboolean sniff_file_gzip;       // Log file is written gzip compressed
+    unsigned int sniff_file_rotate_mb;      // 0 for no size limit
+    unsigned int sniff_file_rotate_seconds; // 0 for no time limit
+    unsigned int sniff_file_keep;   // Rotated log files kept; 0 keeps all
 
     // Sniffing runtime state
     pthread_t sniff_thread;
     gboolean sniff_thread_running;
     int sniff_pipe_fd;
-    int sniff_tcp_server_fd;
-    int sniff_tcp_client_fds[MAX_SNIFF_CLIENTS];
-    int sniff_udp_fd;
-    FILE *sniff_log_fp;
-    char capture_file_path[MAX_PATH_LENGTH];
+    struct SniffTcpServer *sniff_tcp;
+    struct SniffUdpSender *sniff_udp;
+    struct SniffFileWriter *sniff_file;
+    struct SniffPcapWriter *sniff_pcap;
+    struct SniffRing *sniff_ring;   // Relay tap -> per-output consumer threads
+    pthread_mutex_t sniff_mutex;    // Keeps the ring alive while the relay tap uses it
 
     // Sniffing statistics
     unsigned long sniff_bytes_captured;
@@ -186,13 +372,12 @@ extern BridgeApp *g_bridge_app;
 gboolean create_null_modem(BridgeApp *app);
 void stop_null_modem(BridgeApp *app);
 gboolean is_null_modem_running(BridgeApp *app);
-gboolean test_null_modem_communication(BridgeApp *app);
 void cleanup_devices(BridgeApp *app);
 
 // ui.h
 void create_main_window(BridgeApp *app);
 gboolean update_ui_state(gpointer data);
-void append_log_message(BridgeApp *app, const char *message, gboolean timestamp);
+gboolean drain_log_queue(gpointer data);
 
 // utils.h
 char* get_current_timestamp(void);
@@ -219,6 +404,6 @@ void cleanup_sniffing(BridgeApp *app);
 gboolean start_sniffing(BridgeApp *app);
 void stop_sniffing(BridgeApp *app);
 gboolean is_sniffing_active(BridgeApp *app);
-void process_sniff_data(BridgeApp *app, const char *data, size_t len, char direction);
+void process_sniff_data(BridgeApp *app, int channel, const char *data, size_t len, char direction);
 
 #endif // COMMON_H
@@ -0,0 +1,320 @@
+/*
+ * Headless daemon for BRIDGE - Virtual Null Modem Bridge
+ * Starts the configured pairs and sniff outputs without a window, tells the
+ * service manager when the devices exist, and reloads on SIGHUP
+ */
+
+#include "daemon.h"
+#include "nullmodem.h"
+#include "relay.h"
+#include "sniffing.h"
+#include "settings.h"
+#include "stats_socket.h"
+#include "metrics_http.h"
+#include "utils.h"
+#include <glib-unix.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef struct {
+    BridgeApp *app;
+    GMainLoop *loop;
+    int exit_status;
+} Daemon;
+
+// sd_notify(3) without libsystemd: one datagram to $NOTIFY_SOCKET, which is
+// a path or, with a leading '@', an abstract socket
+static void notify_service_manager(const char *state) {
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || (path[0] != '/' && path[0] != '@')) return;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    size_t length = strlen(path);
+    if (length >= sizeof(addr.sun_path)) return;
+    memcpy(addr.sun_path, path, length);
+    if (addr.sun_path[0] == '@') addr.sun_path[0] = '\0';
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    if (sendto(fd, state, strlen(state), MSG_NOSIGNAL, (struct sockaddr *)&addr,
+               offsetof(struct sockaddr_un, sun_path) + length) < 0) {
+        fprintf(stderr, "Could not notify %s: %s\n", path, strerror(errno));
+    }
+    close(fd);
+}
+
+static void format_service_status(BridgeApp *app, char *buffer, size_t buffer_size) {
+    char channel[2 * MAX_PATH_LENGTH + 8];
+    format_channel_description(app, 0, channel, sizeof(channel));
+    int count = device_channel_count(app);
+    snprintf(buffer, buffer_size, "%d %s, %s%s%s", count,
+             app->mode == BRIDGE_MODE_MULTIPLEXER ? (count == 1 ? "client" : "clients")
+                                                  : (count == 1 ? "pair" : "pairs"),
+             channel, count > 1 ? " ..." : "", is_sniffing_active(app) ? ", sniffing" : "");
+}
+
+// Optional servers that can come and go without touching the pairs
+static void start_metrics_endpoint(BridgeApp *app) {
+    if (app->metrics_port <= 0) return;
+    app->metrics_http = metrics_http_server_new(app->metrics_port);
+    if (app->metrics_http) {
+        publish_metrics(app);
+        log_message(app, "Metrics: http://127.0.0.1:%d/metrics", app->metrics_port);
+    } else {
+        log_message(app, "Failed to open metrics endpoint on 127.0.0.1:%d: %s", app->metrics_port,
+                   strerror(errno));
+    }
+}
+
+static void start_stats_socket(BridgeApp *app) {
+    if (!app->stats_socket_path[0]) return;
+    app->stats_server = stats_server_new(app, app->stats_socket_path);
+    if (app->stats_server) {
+        log_message(app, "Relay metrics: socat - UNIX-CONNECT:%s", app->stats_socket_path);
+    }
+}
+
+static gboolean same_line(const LineEmulation *a, const LineEmulation *b) {
+    return a->baud == b->baud && a->data_bits == b->data_bits && a->parity == b->parity &&
+           a->stop_bits == b->stop_bits && a->gap_us == b->gap_us &&
+           a->device_buffer == b->device_buffer;
+}
+
+static gboolean same_impairment(const LinkImpairment *a, const LinkImpairment *b) {
+    return a->latency_ms == b->latency_ms && a->jitter_ms == b->jitter_ms &&
+           a->jitter_dist == b->jitter_dist && a->drop_rate == b->drop_rate &&
+           a->bit_error_rate == b->bit_error_rate && a->outage_interval_ms == b->outage_interval_ms &&
+           a->outage_ms == b->outage_ms && a->rate_limit == b->rate_limit;
+}
+
+// Anything baked into the running PTYs; changing it means recreating them,
+// which hangs up every program that has one open
+static gboolean same_devices(const BridgeApp *a, const BridgeApp *b) {
+    if (a->mode != b->mode || strcmp(a->device1_path, b->device1_path) != 0) return FALSE;
+
+    if (a->mode == BRIDGE_MODE_MULTIPLEXER) {
+        return strcmp(a->mux_port_path, b->mux_port_path) == 0 && a->mux_baud == b->mux_baud &&
+               a->mux_data_bits == b->mux_data_bits && a->mux_parity == b->mux_parity &&
+               a->mux_stop_bits == b->mux_stop_bits && a->mux_flow == b->mux_flow &&
+               a->mux_clients == b->mux_clients && a->mux_policy == b->mux_policy;
+    }
+
+    if (strcmp(a->device2_path, b->device2_path) != 0 || a->pair_count != b->pair_count ||
+        a->impair_seed != b->impair_seed) {
+        return FALSE;
+    }
+    for (int i = 0; i < a->pair_count; i++) {
+        if (!same_line(&a->pair_line[i], &b->pair_line[i]) ||
+            !same_impairment(&a->pair_impair[i][0], &b->pair_impair[i][0]) ||
+            !same_impairment(&a->pair_impair[i][1], &b->pair_impair[i][1])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean same_sniffing(const BridgeApp *a, const BridgeApp *b) {
+    return a->sniffing_enabled == b->sniffing_enabled &&
+           a->sniff_output_methods == b->sniff_output_methods &&
+           a->sniff_direction == b->sniff_direction && a->sniff_format == b->sniff_format &&
+           a->sniff_slow_policy == b->sniff_slow_policy &&
+           strcmp(a->sniff_pipe_path, b->sniff_pipe_path) == 0 &&
+           a->sniff_tcp_port == b->sniff_tcp_port && a->sniff_udp_port == b->sniff_udp_port &&
+           strcmp(a->sniff_udp_addr, b->sniff_udp_addr) == 0 && a->sniff_udp_ttl == b->sniff_udp_ttl &&
+           strcmp(a->sniff_udp_iface, b->sniff_udp_iface) == 0 &&
+           strcmp(a->sniff_log_file, b->sniff_log_file) == 0 &&
+           a->sniff_file_gzip == b->sniff_file_gzip &&
+           a->sniff_file_rotate_mb == b->sniff_file_rotate_mb &&
+           a->sniff_file_rotate_seconds == b->sniff_file_rotate_seconds &&
+           a->sniff_file_keep == b->sniff_file_keep &&
+           strcmp(a->sniff_pcap_path, b->sniff_pcap_path) == 0 &&
+           a->sniff_pcap_live == b->sniff_pcap_live &&
+           a->sniff_pcap_rotate_mb == b->sniff_pcap_rotate_mb &&
+           a->sniff_pcap_rotate_seconds == b->sniff_pcap_rotate_seconds;
+}
+
+static void copy_sniffing(BridgeApp *to, const BridgeApp *from) {
+    to->sniffing_enabled = from->sniffing_enabled;
+    to->sniff_output_methods = from->sniff_output_methods;
+    to->sniff_direction = from->sniff_direction;
+    to->sniff_format = from->sniff_format;
+    to->sniff_slow_policy = from->sniff_slow_policy;
+    memcpy(to->sniff_pipe_path, from->sniff_pipe_path, sizeof(to->sniff_pipe_path));
+    to->sniff_tcp_port = from->sniff_tcp_port;
+    to->sniff_udp_port = from->sniff_udp_port;
+    memcpy(to->sniff_udp_addr, from->sniff_udp_addr, sizeof(to->sniff_udp_addr));
+    to->sniff_udp_ttl = from->sniff_udp_ttl;
+    memcpy(to->sniff_udp_iface, from->sniff_udp_iface, sizeof(to->sniff_udp_iface));
+    memcpy(to->sniff_log_file, from->sniff_log_file, sizeof(to->sniff_log_file));
+    to->sniff_file_gzip = from->sniff_file_gzip;
+    to->sniff_file_rotate_mb = from->sniff_file_rotate_mb;
+    to->sniff_file_rotate_seconds = from->sniff_file_rotate_seconds;
+    to->sniff_file_keep = from->sniff_file_keep;
+    memcpy(to->sniff_pcap_path, from->sniff_pcap_path, sizeof(to->sniff_pcap_path));
+    to->sniff_pcap_live = from->sniff_pcap_live;
+    to->sniff_pcap_rotate_mb = from->sniff_pcap_rotate_mb;
+    to->sniff_pcap_rotate_seconds = from->sniff_pcap_rotate_seconds;
+}
+
+static gboolean start_configured_sniffing(BridgeApp *app) {
+    if (!app->sniffing_enabled || app->sniff_output_methods == SNIFF_OUTPUT_NONE) return TRUE;
+    return start_sniffing(app);
+}
+
+// Re-read the settings file into a scratch copy, so keys that were removed go
+// back to their defaults, then apply whatever can change under running PTYs
+static void reload_settings(BridgeApp *app) {
+    uint64_t start_ns = relay_now_ns();
+    char state[128];
+    snprintf(state, sizeof(state), "RELOADING=1\nMONOTONIC_USEC=%llu",
+             (unsigned long long)(start_ns / 1000));
+    notify_service_manager(state);
+
+    char *config_path = get_config_file_path();
+    log_message(app, "SIGHUP: reloading %s", config_path);
+    free(config_path);
+
+    // The scratch copy logs where app does, so warnings about the file are seen
+    BridgeApp *fresh = g_new0(BridgeApp, 1);
+    fresh->headless = app->headless;
+    fresh->log_queue = app->log_queue;
+    init_default_settings(fresh);
+    init_sniffing(fresh);
+    load_settings(fresh);
+
+    if (!same_devices(app, fresh)) {
+        log_message(app, "WARNING: Device, line and impairment changes need a restart; "
+                         "keeping the running devices");
+    }
+
+    if (strcmp(app->device_permissions, fresh->device_permissions) != 0) {
+        g_free(app->device_permissions);
+        app->device_permissions = g_strdup(fresh->device_permissions);
+        set_device_permissions(app);
+        log_message(app, "Device permissions now %s", app->device_permissions);
+    }
+
+    if (strcmp(app->stats_socket_path, fresh->stats_socket_path) != 0) {
+        stats_server_free(app->stats_server);
+        app->stats_server = NULL;
+        memcpy(app->stats_socket_path, fresh->stats_socket_path, sizeof(app->stats_socket_path));
+        start_stats_socket(app);
+    }
+
+    if (app->metrics_port != fresh->metrics_port) {
+        metrics_http_server_free(app->metrics_http);
+        app->metrics_http = NULL;
+        app->metrics_port = fresh->metrics_port;
+        start_metrics_endpoint(app);
+    }
+
+    // Sniff clients reconnect; the relay keeps going while the outputs restart
+    if (!same_sniffing(app, fresh)) {
+        stop_sniffing(app);
+        copy_sniffing(app, fresh);
+        if (!start_configured_sniffing(app)) {
+            log_message(app, "WARNING: Sniff outputs did not restart");
+        }
+    }
+
+    g_free(fresh->device_permissions);
+    g_free(fresh->font_family);
+    g_free(fresh->bg_color);
+    g_free(fresh->text_color);
+    g_free(fresh->theme_preference);
+    pthread_mutex_destroy(&fresh->sniff_mutex);
+    g_free(fresh);
+
+    char status[3 * MAX_PATH_LENGTH];
+    format_service_status(app, status, sizeof(status));
+    snprintf(state, sizeof(state), "READY=1\nSTATUS=%.100s", status);
+    notify_service_manager(state);
+    log_message(app, "Reloaded in %.2f ms", (relay_now_ns() - start_ns) / 1e6);
+}
+
+static gboolean on_reload_signal(gpointer data) {
+    Daemon *daemon = (Daemon *)data;
+    reload_settings(daemon->app);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_stop_signal(gpointer data) {
+    Daemon *daemon = (Daemon *)data;
+    log_message(daemon->app, "Shutting down");
+    notify_service_manager("STOPPING=1");
+    g_main_loop_quit(daemon->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+// The status timer notices relay failures and vanished devices; a daemon
+// exits on them and leaves the restart to its service manager
+static gboolean check_bridge(gpointer data) {
+    Daemon *daemon = (Daemon *)data;
+
+    // Left in the error state only once supervision has given up
+    if (daemon->app->state == BRIDGE_STATE_ERROR && daemon->app->restart_timer_id == 0) {
+        log_message(daemon->app, "ERROR: Bridge failed, exiting");
+        notify_service_manager("STATUS=Bridge failed");
+        daemon->exit_status = 1;
+        g_main_loop_quit(daemon->loop);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void signal_ready(BridgeApp *app, uint64_t start_ns, int ready_fd) {
+    char status[3 * MAX_PATH_LENGTH];
+    char state[160];
+    double ready_ms = (relay_now_ns() - start_ns) / 1e6;
+
+    format_service_status(app, status, sizeof(status));
+    snprintf(state, sizeof(state), "READY=1\nSTATUS=%.100s", status);
+    notify_service_manager(state);
+
+    if (ready_fd >= 0) {
+        if (write(ready_fd, "\n", 1) != 1) {
+            log_message(app, "WARNING: Could not write to readiness fd %d: %s", ready_fd, strerror(errno));
+        }
+        close(ready_fd);
+    }
+
+    log_message(app, "Ready in %.2f ms: %s", ready_ms, status);
+}
+
+int daemon_run(BridgeApp *app, uint64_t start_ns, int ready_fd) {
+    Daemon daemon = { .app = app, .loop = g_main_loop_new(NULL, FALSE), .exit_status = 0 };
+
+    char *config_path = get_config_file_path();
+    log_message(app, "BRIDGE starting headless with %s", config_path);
+    free(config_path);
+
+    g_unix_signal_add(SIGHUP, on_reload_signal, &daemon);
+    g_unix_signal_add(SIGTERM, on_stop_signal, &daemon);
+    g_unix_signal_add(SIGINT, on_stop_signal, &daemon);
+
+    start_metrics_endpoint(app);
+
+    // Ready means every device link exists and the sniff outputs are listening
+    if (!create_null_modem(app) || !start_configured_sniffing(app) || !is_null_modem_running(app)) {
+        log_message(app, "ERROR: Bridge did not start");
+        notify_service_manager("STATUS=Bridge did not start");
+        daemon.exit_status = 1;
+    } else {
+        signal_ready(app, start_ns, ready_fd);
+        app->status_timer_id = g_timeout_add(1000, update_status_timer, app);
+        g_timeout_add(1000, check_bridge, &daemon);
+        g_main_loop_run(daemon.loop);
+    }
+
+    cleanup_sniffing(app);
+    stop_null_modem(app);
+    if (app->status_timer_id > 0) {
+        g_source_remove(app->status_timer_id);
+        app->status_timer_id = 0;
+    }
+    metrics_http_server_free(app->metrics_http);
+    app->metrics_http = NULL;
+    g_main_loop_unref(daemon.loop);
+    return daemon.exit_status;
+}
@@ -0,0 +1,17 @@
+/*
+ * Headless daemon header for BRIDGE - Virtual Null Modem Bridge
+ * Runs the configured bridge without a window, for systemd and containers
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "common.h"
+#include <stdint.h>
+
+// Runs until SIGTERM or SIGINT and returns the exit status. start_ns is when
+// the process started (relay_now_ns). Readiness goes to $NOTIFY_SOCKET and,
+// as a newline followed by close, to ready_fd unless it is -1.
+int daemon_run(BridgeApp *app, uint64_t start_ns, int ready_fd);
+
+#endif // DAEMON_H
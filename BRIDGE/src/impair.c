@@ -0,0 +1,283 @@
+/*
+ * Link impairment for BRIDGE - Virtual Null Modem Bridge
+ * Delays, drops, corrupts and cuts the data of one direction of a null modem
+ * pair. Every decision comes from seeded xorshift64* generators, one per kind
+ * of fault. Byte drops and bit flips are drawn as gaps between faults, so the
+ * same seed and the same byte stream give the same drops and flips however
+ * the reads split it.
+ */
+
+#include "impair.h"
+#include <math.h>
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in (0, 1]; never 0, so its logarithm is finite
+static double next_unit(uint64_t *state) {
+    return ((next_random(state) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+// Units passed before the next fault, for a fault probability per unit
+static uint64_t next_gap(uint64_t *state, double rate) {
+    if (rate <= 0.0) return UINT64_MAX;
+    if (rate >= 1.0) return 0;
+
+    double gap = floor(log(next_unit(state)) / log1p(-rate));
+    return gap >= 1.8e19 ? UINT64_MAX : (uint64_t)gap;
+}
+
+static uint64_t next_exponential_ns(uint64_t *state, double mean_ns) {
+    return (uint64_t)(-log(next_unit(state)) * mean_ns);
+}
+
+static uint64_t next_delay_ns(RelayImpairment *impair) {
+    double latency = impair->config.latency_ms * 1e6;
+    double jitter = impair->config.jitter_ms * 1e6;
+    double delay = latency;
+    uint64_t *state = &impair->rng[IMPAIR_RNG_DELAY];
+
+    switch (impair->config.jitter_dist) {
+        case IMPAIR_JITTER_NORMAL: {
+            // Box-Muller
+            double radius = sqrt(-2.0 * log(next_unit(state)));
+            delay += jitter * radius * cos(2.0 * M_PI * next_unit(state));
+            break;
+        }
+        case IMPAIR_JITTER_EXPONENTIAL:
+            delay += -log(next_unit(state)) * jitter;
+            break;
+        default:
+            delay += (2.0 * next_unit(state) - 1.0) * jitter;
+            break;
+    }
+    return delay > 0.0 ? (uint64_t)delay : 0;
+}
+
+gboolean impair_is_active(const LinkImpairment *config) {
+    return config->latency_ms > 0 || config->jitter_ms > 0 || config->drop_rate > 0.0 ||
+           config->bit_error_rate > 0.0 || (config->outage_interval_ms > 0 && config->outage_ms > 0) ||
+           config->rate_limit > 0;
+}
+
+RelayImpairment* impair_create(const LinkImpairment *config, uint64_t seed) {
+    RelayImpairment *impair = calloc(1, sizeof(RelayImpairment));
+    if (!impair) return NULL;
+
+    impair->config = *config;
+
+    // splitmix64 spreads nearby seeds apart; xorshift needs a nonzero state
+    uint64_t z = seed;
+    for (int i = 0; i < IMPAIR_RNG_COUNT; i++) {
+        z += 0x9E3779B97F4A7C15ULL;
+        uint64_t x = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        impair->rng[i] = (x ^ (x >> 31)) | 1;
+    }
+
+    impair->next_drop = next_gap(&impair->rng[IMPAIR_RNG_DROP], config->drop_rate);
+    impair->next_flip = next_gap(&impair->rng[IMPAIR_RNG_FLIP], config->bit_error_rate);
+
+    if (impair_delays(impair)) {
+        impair->ring = malloc(IMPAIR_DELAY_SIZE);
+        if (!impair->ring) {
+            free(impair);
+            return NULL;
+        }
+    }
+    return impair;
+}
+
+void impair_free(RelayImpairment *impair) {
+    if (!impair) return;
+    free(impair->ring);
+    free(impair);
+}
+
+// TRUE while now falls in an outage, scheduling the next one once it is over
+static gboolean in_outage(RelayImpairment *impair, uint64_t now_ns, ImpairStats *stats) {
+    if (impair->config.outage_interval_ms == 0 || impair->config.outage_ms == 0) return FALSE;
+
+    if (impair->outage_start_ns == 0) {
+        impair->outage_end_ns = now_ns;
+    }
+    while (now_ns >= impair->outage_end_ns) {
+        impair->outage_start_ns = impair->outage_end_ns +
+                                  next_exponential_ns(&impair->rng[IMPAIR_RNG_OUTAGE],
+                                                      impair->config.outage_interval_ms * 1e6);
+        impair->outage_end_ns = impair->outage_start_ns + impair->config.outage_ms * 1000000ULL;
+        impair->outage_counted = FALSE;
+    }
+    if (now_ns < impair->outage_start_ns) return FALSE;
+
+    if (!impair->outage_counted) {
+        impair->outage_counted = TRUE;
+        stats->outages++;
+    }
+    return TRUE;
+}
+
+// Apply outages, byte drops and bit flips to a chunk in place. Returns the
+// length left; delays and the rate cap are up to the relay.
+size_t impair_apply(RelayImpairment *impair, char *data, size_t length, uint64_t now_ns,
+                    ImpairStats *stats) {
+    if (in_outage(impair, now_ns, stats)) {
+        stats->outage_bytes += length;
+        return 0;
+    }
+
+    // Close the gaps left by dropped bytes
+    size_t kept = length;
+    if (impair->next_drop < length) {
+        size_t position = 0;
+        kept = 0;
+        while (position < length) {
+            size_t run = length - position;
+            if (impair->next_drop >= run) {
+                memmove(data + kept, data + position, run);
+                kept += run;
+                impair->next_drop -= run;
+                break;
+            }
+            run = impair->next_drop;
+            memmove(data + kept, data + position, run);
+            kept += run;
+            position += run + 1;
+            stats->dropped_bytes++;
+            impair->next_drop = next_gap(&impair->rng[IMPAIR_RNG_DROP], impair->config.drop_rate);
+        }
+    } else if (impair->next_drop != UINT64_MAX) {
+        impair->next_drop -= length;
+    }
+
+    uint64_t bits = (uint64_t)kept * 8;
+    if (impair->next_flip < bits) {
+        uint64_t bit = impair->next_flip;
+        while (bit < bits) {
+            data[bit / 8] ^= (char)(1 << (bit % 8));
+            stats->flipped_bits++;
+            uint64_t gap = next_gap(&impair->rng[IMPAIR_RNG_FLIP], impair->config.bit_error_rate);
+            if (gap >= UINT64_MAX - bit) {
+                bit = UINT64_MAX;
+                break;
+            }
+            bit += gap + 1;
+        }
+        impair->next_flip = bit == UINT64_MAX ? UINT64_MAX : bit - bits;
+    } else if (impair->next_flip != UINT64_MAX) {
+        impair->next_flip -= bits;
+    }
+
+    return kept;
+}
+
+gboolean impair_delays(const RelayImpairment *impair) {
+    return impair->config.latency_ms > 0 || impair->config.jitter_ms > 0;
+}
+
+gboolean impair_delay_has_room(const RelayImpairment *impair) {
+    return impair->ring_tail - impair->ring_head < IMPAIR_DELAY_SIZE &&
+           impair->segment_count < IMPAIR_MAX_SEGMENTS;
+}
+
+// Contiguous free space at the tail of the delay line to read the next chunk into
+char* impair_delay_reserve(RelayImpairment *impair, size_t *size) {
+    size_t offset = impair->ring_tail % IMPAIR_DELAY_SIZE;
+    size_t free_bytes = IMPAIR_DELAY_SIZE - (size_t)(impair->ring_tail - impair->ring_head);
+    size_t contiguous = IMPAIR_DELAY_SIZE - offset;
+
+    *size = MIN(*size, MIN(free_bytes, contiguous));
+    return impair->ring + offset;
+}
+
+// Queue what was read into the reserved space, due after this link's delay
+void impair_delay_commit(RelayImpairment *impair, size_t length, uint64_t read_ns) {
+    if (length == 0) return;
+
+    uint64_t due = read_ns + next_delay_ns(impair);
+    if (due < impair->last_due_ns) due = impair->last_due_ns;
+    impair->last_due_ns = due;
+
+    unsigned int slot = (impair->segment_head + impair->segment_count) % IMPAIR_MAX_SEGMENTS;
+    impair->segments[slot] = (ImpairSegment){ .due_ns = due, .read_ns = read_ns, .length = length };
+    impair->segment_count++;
+    impair->ring_tail += length;
+}
+
+// Copy out the oldest chunk if it is due by now. buffer must hold the largest
+// chunk ever committed.
+gboolean impair_delay_pop(RelayImpairment *impair, uint64_t now_ns, char *buffer, size_t *length,
+                          uint64_t *read_ns) {
+    if (impair->segment_count == 0) return FALSE;
+
+    ImpairSegment *segment = &impair->segments[impair->segment_head];
+    if (segment->due_ns > now_ns) return FALSE;
+
+    memcpy(buffer, impair->ring + impair->ring_head % IMPAIR_DELAY_SIZE, segment->length);
+    *length = segment->length;
+    *read_ns = segment->read_ns;
+    impair->ring_head += segment->length;
+    impair->segment_head = (impair->segment_head + 1) % IMPAIR_MAX_SEGMENTS;
+    impair->segment_count--;
+    return TRUE;
+}
+
+// Due time of the oldest queued chunk, or 0 when the line is empty
+uint64_t impair_delay_next_due(const RelayImpairment *impair) {
+    if (impair->segment_count == 0) return 0;
+    return impair->segments[impair->segment_head].due_ns;
+}
+
+void impair_stats_add(ImpairStats *total, const ImpairStats *stats) {
+    total->delayed_chunks += stats->delayed_chunks;
+    total->dropped_bytes += stats->dropped_bytes;
+    total->flipped_bits += stats->flipped_bits;
+    total->outages += stats->outages;
+    total->outage_bytes += stats->outage_bytes;
+}
+
+const char* impair_jitter_name(ImpairJitter jitter) {
+    switch (jitter) {
+        case IMPAIR_JITTER_NORMAL: return "normal";
+        case IMPAIR_JITTER_EXPONENTIAL: return "exponential";
+        default: return "uniform";
+    }
+}
+
+// Short description of the active impairments, empty for a clean link
+void format_impairment(const LinkImpairment *config, char *buffer, size_t buffer_size) {
+    size_t length = 0;
+    buffer[0] = '\0';
+
+#define APPEND(...) do { \
+        if (length < buffer_size) { \
+            int written = snprintf(buffer + length, buffer_size - length, __VA_ARGS__); \
+            if (written > 0) length += (size_t)written; \
+        } \
+    } while (0)
+
+    if (config->latency_ms > 0 || config->jitter_ms > 0) {
+        APPEND("%u±%u ms %s", config->latency_ms, config->jitter_ms,
+               impair_jitter_name(config->jitter_dist));
+    }
+    if (config->drop_rate > 0.0) {
+        APPEND("%sdrop %g", length ? ", " : "", config->drop_rate);
+    }
+    if (config->bit_error_rate > 0.0) {
+        APPEND("%sBER %g", length ? ", " : "", config->bit_error_rate);
+    }
+    if (config->outage_interval_ms > 0 && config->outage_ms > 0) {
+        APPEND("%s%u ms outage/%u ms", length ? ", " : "", config->outage_ms, config->outage_interval_ms);
+    }
+    if (config->rate_limit > 0) {
+        APPEND("%s%u B/s", length ? ", " : "", config->rate_limit);
+    }
+
+#undef APPEND
+}
@@ -0,0 +1,70 @@
+/*
+ * Link impairment header for BRIDGE - Virtual Null Modem Bridge
+ * Seeded fault injection for one direction of a null modem pair
+ */
+
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+#include "common.h"
+#include <stdint.h>
+
+// Data held back by a delayed link; the port stops reading while it is full
+#define IMPAIR_DELAY_SIZE (256 * 1024)
+#define IMPAIR_MAX_SEGMENTS 1024
+
+// Independent generators, so one kind of fault never shifts another's sequence
+enum {
+    IMPAIR_RNG_DROP,
+    IMPAIR_RNG_FLIP,
+    IMPAIR_RNG_DELAY,
+    IMPAIR_RNG_OUTAGE,
+    IMPAIR_RNG_COUNT
+};
+
+// One chunk waiting in the delay line
+typedef struct {
+    uint64_t due_ns;
+    uint64_t read_ns;
+    size_t length;
+} ImpairSegment;
+
+typedef struct {
+    LinkImpairment config;
+    uint64_t rng[IMPAIR_RNG_COUNT]; // xorshift64* states
+    uint64_t next_drop;             // Bytes to pass before the next dropped one
+    uint64_t next_flip;             // Bits to pass before the next flipped one
+    uint64_t outage_start_ns;       // Current or next outage; 0 until the first chunk
+    uint64_t outage_end_ns;
+    gboolean outage_counted;
+
+    // Delay line; each segment is contiguous in the ring
+    char *ring;                     // IMPAIR_DELAY_SIZE bytes, only when delaying
+    uint64_t ring_head;             // Bytes released so far
+    uint64_t ring_tail;             // Bytes queued so far
+    ImpairSegment segments[IMPAIR_MAX_SEGMENTS];
+    unsigned int segment_head;
+    unsigned int segment_count;
+    uint64_t last_due_ns;           // A serial link never reorders
+} RelayImpairment;
+
+gboolean impair_is_active(const LinkImpairment *config);
+RelayImpairment* impair_create(const LinkImpairment *config, uint64_t seed);
+void impair_free(RelayImpairment *impair);
+size_t impair_apply(RelayImpairment *impair, char *data, size_t length, uint64_t now_ns,
+                    ImpairStats *stats);
+
+// Delay line
+gboolean impair_delays(const RelayImpairment *impair);
+gboolean impair_delay_has_room(const RelayImpairment *impair);
+char* impair_delay_reserve(RelayImpairment *impair, size_t *size);
+void impair_delay_commit(RelayImpairment *impair, size_t length, uint64_t read_ns);
+gboolean impair_delay_pop(RelayImpairment *impair, uint64_t now_ns, char *buffer, size_t *length,
+                          uint64_t *read_ns);
+uint64_t impair_delay_next_due(const RelayImpairment *impair);
+
+void impair_stats_add(ImpairStats *total, const ImpairStats *stats);
+void format_impairment(const LinkImpairment *config, char *buffer, size_t buffer_size);
+const char* impair_jitter_name(ImpairJitter jitter);
+
+#endif // IMPAIR_H
@@ -0,0 +1,90 @@
+/*
+ * Log queue for BRIDGE - Virtual Null Modem Bridge
+ * Bounded ring of message slots, each with a sequence number saying whose turn
+ * it is: producers claim a position with one compare-and-swap and publish the
+ * slot by advancing its sequence, so a stalled main loop costs them a dropped
+ * message rather than a wait.
+ */
+
+#include "log_queue.h"
+#include <stdint.h>
+
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef struct {
+    uint64_t sequence;          // Position + 1 once written, position + slots once read
+    time_t time;                // When it was logged, not when it is shown
+    char text[MAX_LOG_LENGTH];
+} LogSlot;
+
+struct LogQueue {
+    LogSlot slots[LOG_QUEUE_SLOTS];
+    uint64_t enqueue_pos;       // Next position to claim, shared by producers
+    uint64_t dequeue_pos;       // Consumer only
+    unsigned long dropped;
+};
+
+LogQueue* log_queue_new(void) {
+    LogQueue *queue = calloc(1, sizeof(LogQueue));
+    if (!queue) return NULL;
+
+    for (uint64_t i = 0; i < LOG_QUEUE_SLOTS; i++) {
+        queue->slots[i].sequence = i;
+    }
+    return queue;
+}
+
+void log_queue_free(LogQueue *queue) {
+    free(queue);
+}
+
+gboolean log_queue_push(LogQueue *queue, const char *message) {
+    uint64_t pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    LogSlot *slot;
+
+    for (;;) {
+        slot = &queue->slots[pos & (LOG_QUEUE_SLOTS - 1)];
+        int64_t lag = (int64_t)(LOAD(&slot->sequence) - pos);
+        if (lag == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, TRUE,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // pos now holds the position another producer left us
+        } else if (lag < 0) {
+            // The consumer has not freed this slot yet: full
+            __atomic_fetch_add(&queue->dropped, 1, __ATOMIC_RELAXED);
+            return FALSE;
+        } else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->time = time(NULL);
+    snprintf(slot->text, sizeof(slot->text), "%s", message);
+    STORE(&slot->sequence, pos + 1);
+    return TRUE;
+}
+
+int log_queue_drain(LogQueue *queue, GString *out, int max, unsigned long *dropped) {
+    int count = 0;
+
+    while (count < max) {
+        LogSlot *slot = &queue->slots[queue->dequeue_pos & (LOG_QUEUE_SLOTS - 1)];
+        if (LOAD(&slot->sequence) != queue->dequeue_pos + 1) break;
+
+        char timestamp[32];
+        struct tm tm_info;
+        localtime_r(&slot->time, &tm_info);
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+        g_string_append_printf(out, "[%s] %s\n", timestamp, slot->text);
+
+        STORE(&slot->sequence, queue->dequeue_pos + LOG_QUEUE_SLOTS);
+        queue->dequeue_pos++;
+        count++;
+    }
+
+    *dropped = __atomic_exchange_n(&queue->dropped, 0, __ATOMIC_RELAXED);
+    return count;
+}
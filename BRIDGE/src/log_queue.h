@@ -0,0 +1,27 @@
+/*
+ * Log queue header for BRIDGE - Virtual Null Modem Bridge
+ * Lock-free multi-producer, single-consumer queue between log_message, which
+ * any thread may call, and the main loop that owns the log view
+ */
+
+#ifndef LOG_QUEUE_H
+#define LOG_QUEUE_H
+
+#include "common.h"
+
+// Messages waiting for the main loop; must be a power of two
+#define LOG_QUEUE_SLOTS 512
+
+typedef struct LogQueue LogQueue;
+
+LogQueue* log_queue_new(void);
+void log_queue_free(LogQueue *queue);
+
+// Any thread; never blocks. Returns FALSE and counts a drop when the queue is full.
+gboolean log_queue_push(LogQueue *queue, const char *message);
+
+// Consumer only. Appends up to max queued messages to out as "[time] message\n"
+// lines and returns how many. *dropped gets the pushes lost since the last call.
+int log_queue_drain(LogQueue *queue, GString *out, int max, unsigned long *dropped);
+
+#endif // LOG_QUEUE_H
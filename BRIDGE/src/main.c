@@ -10,6 +10,10 @@
 #include "utils.h"
 #include "settings.h"
 #include "callbacks.h"
+#include "metrics_http.h"
+#include "log_queue.h"
+#include "relay.h"
+#include "daemon.h"
 
 // Global application instance (defined here, declared in common.h)
 BridgeApp *g_bridge_app = NULL;
@@ -35,28 +39,63 @@ void cleanup_and_exit(int sig) {
         if (g_bridge_app->status_timer_id > 0) {
             g_source_remove(g_bridge_app->status_timer_id);
         }
+
+        metrics_http_server_free(g_bridge_app->metrics_http);
+        g_bridge_app->metrics_http = NULL;
     }
     
     exit(0);
 }
 
+static void print_usage(const char *program) {
+    printf("Usage: %s [--headless] [--config FILE] [--ready-fd N]\n", program);
+    printf("  --headless, --daemon  Run the configured bridge without a window, logging to stderr\n");
+    printf("  --config FILE         Settings file instead of ~/.bridge_config\n");
+    printf("  --ready-fd N          Write a newline to fd N and close it once the devices exist\n");
+}
+
 int main(int argc, char *argv[]) {
+    // Startup time is reported against this once the devices are ready
+    uint64_t start_ns = relay_now_ns();
+    gboolean headless = FALSE;
+    int ready_fd = -1;
+
+    // Our own options; anything else is left for GTK
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 || strcmp(argv[i], "--daemon") == 0) {
+            headless = TRUE;
+        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            set_config_file_path(argv[++i]);
+        } else if (strcmp(argv[i], "--ready-fd") == 0 && i + 1 < argc) {
+            ready_fd = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+
     // Initialize GTK
-    gtk_init(&argc, &argv);
+    if (!headless) {
+        gtk_init(&argc, &argv);
+    }
     
     // Create and initialize application structure
     BridgeApp app = {0};
     g_bridge_app = &app;
+    app.headless = headless;
     
-    // Set up signal handlers
-    signal(SIGINT, cleanup_and_exit);
-    signal(SIGTERM, cleanup_and_exit);
+    // Set up signal handlers; the daemon handles its own on the main loop
+    if (!headless) {
+        signal(SIGINT, cleanup_and_exit);
+        signal(SIGTERM, cleanup_and_exit);
+    }
+    // Sniff outputs see EPIPE from vanished readers instead of being killed
+    signal(SIGPIPE, SIG_IGN);
     
     // Initialize application state
     app.state = BRIDGE_STATE_STOPPED;
-    app.socat_pid = 0;
+    app.relay = NULL;
     app.running = FALSE;
-    app.monitor_running = FALSE;
     app.status_timer_id = 0;
     
     // Initialize default settings
@@ -67,7 +106,25 @@ int main(int argc, char *argv[]) {
 
     // Load saved settings
     load_settings(&app);
+
+    // No window: start everything from the settings file and run until stopped
+    if (headless) {
+        int status = daemon_run(&app, start_ns, ready_fd);
+        g_free(app.device_permissions);
+        g_free(app.font_family);
+        g_free(app.bg_color);
+        g_free(app.text_color);
+        g_free(app.theme_preference);
+        return status;
+    }
     
+    // Log messages queue up from here and show once the main loop runs. The
+    // queue lives as long as the process, since any thread may still log.
+    app.log_queue = log_queue_new();
+    if (app.log_queue) {
+        app.log_drain_id = g_timeout_add(LOG_DRAIN_INTERVAL_MS, drain_log_queue, &app);
+    }
+
     // Create main window and UI
     create_main_window(&app);
     
@@ -80,6 +137,18 @@ int main(int argc, char *argv[]) {
     // Connect all signals AFTER settings are applied
     connect_signals(&app);
     
+    // Opt-in Prometheus endpoint, for the whole life of the process
+    if (app.metrics_port > 0) {
+        app.metrics_http = metrics_http_server_new(app.metrics_port);
+        if (app.metrics_http) {
+            publish_metrics(&app);
+            log_message(&app, "Metrics: http://127.0.0.1:%d/metrics", app.metrics_port);
+        } else {
+            log_message(&app, "Failed to open metrics endpoint on 127.0.0.1:%d: %s", app.metrics_port,
+                       strerror(errno));
+        }
+    }
+
     // Start status update timer (every second)
     app.status_timer_id = g_timeout_add(1000, update_status_timer, &app);
     
@@ -103,6 +172,7 @@ int main(int argc, char *argv[]) {
     gtk_main();
     
     // Cleanup
+    metrics_http_server_free(app.metrics_http);
     if (app.device_permissions) g_free(app.device_permissions);
     if (app.font_family) g_free(app.font_family);
     if (app.bg_color) g_free(app.bg_color);
@@ -0,0 +1,355 @@
+/*
+ * Relay metrics for BRIDGE - Virtual Null Modem Bridge
+ * The relay thread is the only writer of a direction's metrics, so counters
+ * are bumped with plain relaxed stores and no locks; readers on other threads
+ * load them relaxed and may see a chunk half counted, never a torn value.
+ */
+
+#include "metrics.h"
+#include "relay.h"
+#include "sniff_ring.h"
+#include "sniff_tcp.h"
+#include "utils.h"
+
+static const int window_seconds[3] = { 1, 10, METRICS_WINDOW_SECONDS };
+
+// Single writer: no read-modify-write instruction needed
+static inline void bump(uint64_t *counter, uint64_t amount) {
+    __atomic_store_n(counter, *counter + amount, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static unsigned int bucket_index(uint64_t value) {
+    if (value < 2 * METRICS_SUB_BUCKETS) return (unsigned int)value;
+
+    int shift = 63 - __builtin_clzll(value) - 4;
+    return (unsigned int)((shift + 1) * METRICS_SUB_BUCKETS + ((value >> shift) & (METRICS_SUB_BUCKETS - 1)));
+}
+
+// Largest value that lands in a bucket
+static uint64_t bucket_upper_bound(unsigned int index) {
+    if (index < 2 * METRICS_SUB_BUCKETS) return index;
+
+    int shift = (int)(index / METRICS_SUB_BUCKETS) - 1;
+    uint64_t sub = METRICS_SUB_BUCKETS + index % METRICS_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void metrics_record_read(RelayMetrics *metrics, size_t bytes) {
+    bump(&metrics->bytes_read, bytes);
+}
+
+void metrics_record_chunk(RelayMetrics *metrics, size_t bytes, uint64_t latency_ns, uint64_t now_ns) {
+    LatencyHistogram *histogram = &metrics->latency;
+    bump(&histogram->counts[bucket_index(latency_ns)], 1);
+    bump(&histogram->total, 1);
+    bump(&histogram->sum_ns, latency_ns);
+    bump(&metrics->bytes_written, bytes);
+    if (latency_ns > histogram->max_ns) {
+        __atomic_store_n(&histogram->max_ns, latency_ns, __ATOMIC_RELAXED);
+    }
+
+    // Reuse the slot of a second that has left the window
+    uint64_t second = now_ns / 1000000000ULL;
+    RateSlot *slot = &metrics->rate.slots[second % (METRICS_WINDOW_SECONDS + 1)];
+    if (slot->second != second) {
+        __atomic_store_n(&slot->bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->chunks, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->second, second, __ATOMIC_RELEASE);
+    }
+    bump(&slot->bytes, bytes);
+    bump(&slot->chunks, 1);
+}
+
+void metrics_record_queue(RelayMetrics *metrics, uint64_t depth) {
+    __atomic_store_n(&metrics->queue_depth, depth, __ATOMIC_RELAXED);
+    if (depth > metrics->queue_high_water) {
+        __atomic_store_n(&metrics->queue_high_water, depth, __ATOMIC_RELAXED);
+    }
+}
+
+static uint64_t percentile(const uint64_t *counts, uint64_t total, double fraction, uint64_t max_ns) {
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(fraction * total + 0.999999);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) return MIN(bucket_upper_bound(i), max_ns);
+    }
+    return max_ns;
+}
+
+// Combine several directions, e.g. one direction of every pair. Rates cover
+// whole seconds before the current one.
+void metrics_summarize(RelayMetrics *const *metrics, int count, uint64_t now_ns, MetricsSummary *summary) {
+    uint64_t counts[METRICS_HISTOGRAM_BUCKETS] = {0};
+    uint64_t current = now_ns / 1000000000ULL;
+
+    memset(summary, 0, sizeof(*summary));
+    for (int m = 0; m < count; m++) {
+        const RelayMetrics *source = metrics[m];
+        for (unsigned int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+            uint64_t bucket = load(&source->latency.counts[i]);
+            counts[i] += bucket;
+            summary->chunks += bucket;
+        }
+        summary->max_ns = MAX(summary->max_ns, load(&source->latency.max_ns));
+        summary->queue_depth += load(&source->queue_depth);
+        summary->queue_high_water = MAX(summary->queue_high_water, load(&source->queue_high_water));
+
+        for (int w = 0; w < 3; w++) {
+            uint64_t bytes = 0, chunks = 0;
+            for (int k = 1; k <= window_seconds[w] && (uint64_t)k <= current; k++) {
+                const RateSlot *slot = &source->rate.slots[(current - k) % (METRICS_WINDOW_SECONDS + 1)];
+                if (__atomic_load_n(&slot->second, __ATOMIC_ACQUIRE) == current - k) {
+                    bytes += load(&slot->bytes);
+                    chunks += load(&slot->chunks);
+                }
+            }
+            summary->bytes_per_second[w] += (double)bytes / window_seconds[w];
+            summary->chunks_per_second[w] += (double)chunks / window_seconds[w];
+        }
+    }
+
+    summary->p50_ns = percentile(counts, summary->chunks, 0.50, summary->max_ns);
+    summary->p99_ns = percentile(counts, summary->chunks, 0.99, summary->max_ns);
+    summary->p999_ns = percentile(counts, summary->chunks, 0.999, summary->max_ns);
+}
+
+static const char *direction_names[2] = { "1->2", "2->1" };
+
+static int append_summary(char *buffer, size_t buffer_size, const char *prefix, int direction,
+                          const MetricsSummary *summary) {
+    return snprintf(buffer, buffer_size,
+                    "%s direction=%s chunks=%llu p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f "
+                    "bytes_per_s_1s=%.1f bytes_per_s_10s=%.1f bytes_per_s_60s=%.1f "
+                    "chunks_per_s_1s=%.1f chunks_per_s_10s=%.1f chunks_per_s_60s=%.1f "
+                    "queue_bytes=%llu queue_peak_bytes=%llu\n",
+                    prefix, direction_names[direction], (unsigned long long)summary->chunks,
+                    summary->p50_ns / 1000.0, summary->p99_ns / 1000.0, summary->p999_ns / 1000.0,
+                    summary->max_ns / 1000.0,
+                    summary->bytes_per_second[0], summary->bytes_per_second[1], summary->bytes_per_second[2],
+                    summary->chunks_per_second[0], summary->chunks_per_second[1],
+                    summary->chunks_per_second[2],
+                    (unsigned long long)summary->queue_depth, (unsigned long long)summary->queue_high_water);
+}
+
+// Stats query answer: one key=value line per direction of every pair, then
+// the totals. Latency is from the read on one side to the write on the other.
+void metrics_format_report(BridgeApp *app, char *buffer, size_t buffer_size) {
+    uint64_t now = relay_now_ns();
+    size_t length = 0;
+    int written = snprintf(buffer, buffer_size, "# BRIDGE relay metrics\nuptime_s=%ld pairs=%d\n",
+                           app->state == BRIDGE_STATE_RUNNING ? (long)(time(NULL) - app->start_time) : 0L,
+                           app->pair_count);
+    if (written > 0) length = MIN((size_t)written, buffer_size);
+
+    RelayMetrics *all[2][MAX_BRIDGE_PAIRS];
+    int pairs = 0;
+    for (int i = 0; i < MAX_BRIDGE_PAIRS && app->relay_pairs[i]; i++) {
+        for (int d = 0; d < 2; d++) {
+            MetricsSummary summary;
+            char prefix[32];
+            all[d][i] = &app->relay_pairs[i]->metrics[d];
+            metrics_summarize(&all[d][i], 1, now, &summary);
+            snprintf(prefix, sizeof(prefix), "pair=%d", i);
+            written = append_summary(buffer + length, buffer_size - length, prefix, d, &summary);
+            if (written > 0) length = MIN(length + (size_t)written, buffer_size);
+        }
+        pairs++;
+    }
+    for (int d = 0; d < 2 && pairs > 0; d++) {
+        MetricsSummary summary;
+        metrics_summarize(all[d], pairs, now, &summary);
+        written = append_summary(buffer + length, buffer_size - length, "total", d, &summary);
+        if (written > 0) length = MIN(length + (size_t)written, buffer_size);
+    }
+}
+
+// Two lines per direction over all pairs, for the Status tab
+void metrics_format_status(BridgeApp *app, char *buffer, size_t buffer_size) {
+    RelayMetrics *all[2][MAX_BRIDGE_PAIRS];
+    int pairs = 0;
+    for (int i = 0; i < MAX_BRIDGE_PAIRS && app->relay_pairs[i]; i++) {
+        all[0][i] = &app->relay_pairs[i]->metrics[0];
+        all[1][i] = &app->relay_pairs[i]->metrics[1];
+        pairs++;
+    }
+    if (pairs == 0) {
+        snprintf(buffer, buffer_size, "%s", app->mux ? "Not measured in multiplexer mode" : "Idle");
+        return;
+    }
+
+    uint64_t now = relay_now_ns();
+    size_t length = 0;
+    buffer[0] = '\0';
+    for (int d = 0; d < 2; d++) {
+        MetricsSummary summary;
+        metrics_summarize(all[d], pairs, now, &summary);
+        int written = snprintf(buffer + length, buffer_size - length,
+                               "%s%s  p50 %.1f µs, p99 %.1f µs, p99.9 %.1f µs, max %.1f µs\n"
+                               "      %.1f / %.1f / %.1f B/s, %.1f / %.1f / %.1f msg/s (1/10/60 s), "
+                               "queue peak %llu B",
+                               d ? "\n" : "", d ? "2→1" : "1→2",
+                               summary.p50_ns / 1000.0, summary.p99_ns / 1000.0,
+                               summary.p999_ns / 1000.0, summary.max_ns / 1000.0,
+                               summary.bytes_per_second[0], summary.bytes_per_second[1],
+                               summary.bytes_per_second[2], summary.chunks_per_second[0],
+                               summary.chunks_per_second[1], summary.chunks_per_second[2],
+                               (unsigned long long)summary.queue_high_water);
+        if (written < 0) break;
+        length = MIN(length + (size_t)written, buffer_size - 1);
+    }
+}
+
+// Prometheus histogram bounds for the relay latency. Each is matched to the
+// histogram bucket holding it, so a count may include values up to 1/16 above.
+static const uint64_t latency_bounds_ns[] = {
+    10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+    10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000
+};
+
+static void append_family(GString *out, const char *name, const char *type, const char *help) {
+    g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void append_latency_histogram(GString *out, const char *labels, const LatencyHistogram *histogram) {
+    size_t bound = 0;
+    uint64_t cumulative = 0;
+    for (unsigned int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        while (bound < G_N_ELEMENTS(latency_bounds_ns) && bucket_index(latency_bounds_ns[bound]) < i) {
+            g_string_append_printf(out, "bridge_relay_latency_seconds_bucket{%s,le=\"%g\"} %llu\n", labels,
+                                   latency_bounds_ns[bound] / 1e9, (unsigned long long)cumulative);
+            bound++;
+        }
+        cumulative += load(&histogram->counts[i]);
+    }
+    for (; bound < G_N_ELEMENTS(latency_bounds_ns); bound++) {
+        g_string_append_printf(out, "bridge_relay_latency_seconds_bucket{%s,le=\"%g\"} %llu\n", labels,
+                               latency_bounds_ns[bound] / 1e9, (unsigned long long)cumulative);
+    }
+    g_string_append_printf(out, "bridge_relay_latency_seconds_bucket{%s,le=\"+Inf\"} %llu\n"
+                           "bridge_relay_latency_seconds_sum{%s} %.9f\n"
+                           "bridge_relay_latency_seconds_count{%s} %llu\n",
+                           labels, (unsigned long long)cumulative,
+                           labels, load(&histogram->sum_ns) / 1e9,
+                           labels, (unsigned long long)cumulative);
+}
+
+// Counters and gauges in the Prometheus text format, for the metrics endpoint.
+// Relay figures are per pair and direction; a stopped bridge has no pairs.
+void metrics_format_prometheus(BridgeApp *app, GString *out) {
+    RelayStats stats[MAX_BRIDGE_PAIRS];
+    char labels[MAX_BRIDGE_PAIRS][2][48];
+    int pairs = 0;
+    for (int i = 0; i < MAX_BRIDGE_PAIRS && app->relay_pairs[i]; i++) {
+        relay_pair_get_stats(app->relay_pairs[i], &stats[i]);
+        for (int d = 0; d < 2; d++) {
+            snprintf(labels[i][d], sizeof(labels[i][d]), "pair=\"%d\",direction=\"%s\"", i, direction_names[d]);
+        }
+        pairs++;
+    }
+
+    append_family(out, "bridge_running", "gauge", "1 while the null modem or multiplexer is running");
+    g_string_append_printf(out, "bridge_running %d\n", app->state == BRIDGE_STATE_RUNNING);
+    append_family(out, "bridge_pairs", "gauge", "Null modem pairs being relayed");
+    g_string_append_printf(out, "bridge_pairs %d\n", pairs);
+    append_family(out, "bridge_startup_seconds", "gauge", "Time the last start took to bring up every device");
+    g_string_append_printf(out, "bridge_startup_seconds %.6f\n", app->startup_ns / 1e9);
+
+    // Downtime includes the incident still open, so availability is current
+    guint64 downtime_ns = app->downtime_ns + (app->down_since_ns ? relay_now_ns() - app->down_since_ns : 0);
+    append_family(out, "bridge_incidents_total", "counter", "Times the running bridge failed");
+    g_string_append_printf(out, "bridge_incidents_total %lu\n", app->incident_count);
+    append_family(out, "bridge_restarts_total", "counter", "Automatic restarts after a failure");
+    g_string_append_printf(out, "bridge_restarts_total %lu\n", app->restarts);
+    append_family(out, "bridge_downtime_seconds_total", "counter", "Time spent failed, from failure to recovery or stop");
+    g_string_append_printf(out, "bridge_downtime_seconds_total %.6f\n", downtime_ns / 1e9);
+
+#define PER_DIRECTION(name, type, help, value) do { \
+        append_family(out, name, type, help); \
+        for (int i = 0; i < pairs; i++) { \
+            for (int d = 0; d < 2; d++) { \
+                g_string_append_printf(out, "%s{%s} %llu\n", name, labels[i][d], (unsigned long long)(value)); \
+            } \
+        } \
+    } while (0)
+
+    PER_DIRECTION("bridge_bytes_received_total", "counter", "Bytes read from the sending device",
+                  load(&app->relay_pairs[i]->metrics[d].bytes_read));
+    PER_DIRECTION("bridge_bytes_sent_total", "counter", "Bytes written to the receiving device",
+                  load(&app->relay_pairs[i]->metrics[d].bytes_written));
+    PER_DIRECTION("bridge_relay_queue_bytes", "gauge", "Bytes read but not yet written, including delayed data",
+                  load(&app->relay_pairs[i]->metrics[d].queue_depth));
+    PER_DIRECTION("bridge_relay_queue_peak_bytes", "gauge", "Highest bridge_relay_queue_bytes since the pair was created",
+                  load(&app->relay_pairs[i]->metrics[d].queue_high_water));
+    PER_DIRECTION("bridge_impair_dropped_bytes_total", "counter", "Bytes dropped by the link impairment",
+                  stats[i].impair[d].dropped_bytes);
+    PER_DIRECTION("bridge_impair_flipped_bits_total", "counter", "Bits corrupted by the link impairment",
+                  stats[i].impair[d].flipped_bits);
+    PER_DIRECTION("bridge_impair_outages_total", "counter", "Link outages injected",
+                  stats[i].impair[d].outages);
+    PER_DIRECTION("bridge_impair_outage_bytes_total", "counter", "Bytes lost during link outages",
+                  stats[i].impair[d].outage_bytes);
+#undef PER_DIRECTION
+
+    append_family(out, "bridge_relay_latency_seconds", "histogram",
+                  "Time from reading data on one device to writing it to the other");
+    for (int i = 0; i < pairs; i++) {
+        for (int d = 0; d < 2; d++) {
+            append_latency_histogram(out, labels[i][d], &app->relay_pairs[i]->metrics[d].latency);
+        }
+    }
+
+    append_family(out, "bridge_line_overruns_total", "counter",
+                  "Characters lost to a full emulated device buffer");
+    for (int i = 0; i < pairs; i++) {
+        g_string_append_printf(out, "bridge_line_overruns_total{pair=\"%d\"} %lu\n", i, stats[i].overruns);
+    }
+
+    append_family(out, "bridge_sniff_bytes_captured_total", "counter", "Bytes captured by the sniffer");
+    g_string_append_printf(out, "bridge_sniff_bytes_captured_total %lu\n", app->sniff_bytes_captured);
+    append_family(out, "bridge_sniff_packets_sent_total", "counter", "Packets captured by the sniffer");
+    g_string_append_printf(out, "bridge_sniff_packets_sent_total %lu\n", app->sniff_packets_sent);
+
+    // Sniff outputs: how far each is behind the relay and what it had to skip
+    if (app->sniff_ring) {
+        SniffRing *ring = app->sniff_ring;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        append_family(out, "bridge_sniff_output_lag_packets", "gauge", "Packets a sniff output has yet to read");
+        for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+            SniffConsumer *consumer = &ring->consumers[i];
+            if (!__atomic_load_n(&consumer->in_use, __ATOMIC_ACQUIRE)) continue;
+            uint64_t cursor = __atomic_load_n(&consumer->cursor, __ATOMIC_RELAXED);
+            g_string_append_printf(out, "bridge_sniff_output_lag_packets{output=\"%s\"} %llu\n", consumer->name,
+                                   (unsigned long long)(head > cursor ? head - cursor : 0));
+        }
+        append_family(out, "bridge_sniff_output_dropped_total", "counter",
+                      "Packets a slow sniff output skipped");
+        for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+            SniffConsumer *consumer = &ring->consumers[i];
+            if (!__atomic_load_n(&consumer->in_use, __ATOMIC_ACQUIRE)) continue;
+            g_string_append_printf(out, "bridge_sniff_output_dropped_total{output=\"%s\"} %lu\n", consumer->name,
+                                   __atomic_load_n(&consumer->dropped, __ATOMIC_RELAXED));
+        }
+    }
+
+    if (app->sniff_tcp) {
+        SniffTcpServer *server = app->sniff_tcp;
+        pthread_mutex_lock(&server->clients_mutex);
+        guint clients = server->clients->len;
+        unsigned long connections = server->total_clients;
+        pthread_mutex_unlock(&server->clients_mutex);
+
+        append_family(out, "bridge_sniff_tcp_clients", "gauge", "Sniff TCP clients connected");
+        g_string_append_printf(out, "bridge_sniff_tcp_clients %u\n", clients);
+        append_family(out, "bridge_sniff_tcp_connections_total", "counter",
+                      "Sniff TCP client connections, including reconnects");
+        g_string_append_printf(out, "bridge_sniff_tcp_connections_total %lu\n", connections);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Relay metrics header for BRIDGE - Virtual Null Modem Bridge
+ * Latency histograms, throughput windows and queue depths per direction
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+#include <stdint.h>
+
+// 16 linear sub-buckets per power of two: values up to 31 ns are exact, larger
+// ones are within 1/16 of the bucket's upper bound
+#define METRICS_SUB_BUCKETS 16
+#define METRICS_HISTOGRAM_BUCKETS ((64 - 3) * METRICS_SUB_BUCKETS)
+// One slot per second, plus the one being filled
+#define METRICS_WINDOW_SECONDS 60
+
+// Written by the relay thread only; readers load the counters without locking
+typedef struct {
+    uint64_t counts[METRICS_HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} LatencyHistogram;
+
+typedef struct {
+    uint64_t second;            // Monotonic second the slot counts; stale slots read as empty
+    uint64_t bytes;
+    uint64_t chunks;
+} RateSlot;
+
+typedef struct {
+    RateSlot slots[METRICS_WINDOW_SECONDS + 1];
+} RateWindow;
+
+// One direction of a pair
+typedef struct {
+    LatencyHistogram latency;   // Read on one side to written on the other
+    RateWindow rate;
+    uint64_t bytes_read;        // From the source device, before any impairment
+    uint64_t bytes_written;     // To the other device
+    uint64_t queue_depth;       // Bytes read but not yet written, at the last read
+    uint64_t queue_high_water;
+} RelayMetrics;
+
+// What the Status tab and the stats query show for a set of directions
+typedef struct {
+    uint64_t chunks;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+    double bytes_per_second[3]; // Over the last 1, 10 and 60 seconds
+    double chunks_per_second[3];
+    uint64_t queue_depth;
+    uint64_t queue_high_water;
+} MetricsSummary;
+
+// Relay thread
+void metrics_record_read(RelayMetrics *metrics, size_t bytes);
+void metrics_record_chunk(RelayMetrics *metrics, size_t bytes, uint64_t latency_ns, uint64_t now_ns);
+void metrics_record_queue(RelayMetrics *metrics, uint64_t depth);
+
+// Any thread
+void metrics_summarize(RelayMetrics *const *metrics, int count, uint64_t now_ns, MetricsSummary *summary);
+void metrics_format_report(BridgeApp *app, char *buffer, size_t buffer_size);
+void metrics_format_status(BridgeApp *app, char *buffer, size_t buffer_size);
+
+// Main thread: the pairs must not go away while it runs
+void metrics_format_prometheus(BridgeApp *app, GString *out);
+
+#endif // METRICS_H
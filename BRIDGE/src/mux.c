@@ -0,0 +1,433 @@
+/*
+ * Serial port multiplexer for BRIDGE - Virtual Null Modem Bridge
+ * Opens a real serial port and exposes it as several PTYs on the relay loop.
+ * Port data is read once into a ring that every client is written from at its
+ * own pace; client writes go to the port one whole chunk at a time, in the
+ * order the arbitration policy picks.
+ */
+
+#include "mux.h"
+#include "nullmodem.h"
+#include "utils.h"
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+
+static const struct {
+    int rate;
+    speed_t speed;
+} baud_rates[] = {
+    { 300, B300 }, { 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 },
+    { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 },
+    { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 }
+};
+
+const char* mux_policy_name(MuxPolicy policy) {
+    switch (policy) {
+        case MUX_POLICY_PRIORITY: return "Priority";
+        case MUX_POLICY_EXCLUSIVE: return "Exclusive";
+        default: return "FIFO";
+    }
+}
+
+// Client events: write while port data is waiting for it, read while its last
+// chunk has gone out to the port
+static void update_client_events(RelayLoop *loop, MuxClient *client) {
+    uint32_t events = 0;
+
+    if (client->tx_length == 0) events |= EPOLLIN;
+    if (client->rx_cursor < client->mux->rx_head) events |= EPOLLOUT;
+    relay_loop_modify(loop, &client->endpoint, events);
+}
+
+static void update_port_events(RelayLoop *loop, SerialMux *mux) {
+    relay_loop_modify(loop, &mux->port, EPOLLIN | (mux->writer ? EPOLLOUT : 0));
+}
+
+// Send the client what it has not seen yet, straight from the ring
+static gboolean deliver_to_client(RelayLoop *loop, MuxClient *client) {
+    SerialMux *mux = client->mux;
+    unsigned long delivered = 0;
+
+    while (client->rx_cursor < mux->rx_head) {
+        size_t offset = client->rx_cursor % MUX_RING_SIZE;
+        size_t length = MIN(mux->rx_head - client->rx_cursor, (uint64_t)(MUX_RING_SIZE - offset));
+        ssize_t written = write(client->endpoint.fd, mux->rx_ring + offset, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return FALSE;
+            break;
+        }
+        client->rx_cursor += written;
+        delivered += written;
+    }
+
+    if (delivered > 0) {
+        pthread_mutex_lock(&mux->stats_mutex);
+        client->stats.rx_bytes += delivered;
+        pthread_mutex_unlock(&mux->stats_mutex);
+    }
+    update_client_events(loop, client);
+    return TRUE;
+}
+
+static MuxClient* next_writer(SerialMux *mux) {
+    MuxClient *next = NULL;
+
+    for (int i = 0; i < mux->client_count; i++) {
+        MuxClient *client = &mux->clients[i];
+        if (client->tx_length == 0) continue;
+
+        // Priority goes by client number, FIFO by arrival; the exclusive owner
+        // is the only client with anything accepted
+        if (!next || (mux->policy == MUX_POLICY_FIFO && client->tx_read_ns < next->tx_read_ns)) {
+            next = client;
+        }
+    }
+    return next;
+}
+
+// Write client chunks to the port until it is full or nothing is waiting
+static gboolean pump_port(RelayLoop *loop, SerialMux *mux) {
+    while (TRUE) {
+        if (!mux->writer) {
+            mux->writer = next_writer(mux);
+            if (!mux->writer) break;
+        }
+
+        MuxClient *client = mux->writer;
+        ssize_t written = write(mux->port.fd, client->tx_buffer + client->tx_offset,
+                                client->tx_length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return FALSE;
+            break;
+        }
+        client->tx_offset += written;
+        client->tx_length -= written;
+        if (client->tx_length > 0) continue;
+
+        uint64_t now = relay_now_ns();
+        uint64_t wait = now - client->tx_read_ns;
+        pthread_mutex_lock(&mux->stats_mutex);
+        client->stats.tx_bytes += client->tx_offset;
+        client->stats.tx_chunks++;
+        client->stats.tx_wait_total_ns += wait;
+        if (wait > client->stats.tx_wait_max_ns) {
+            client->stats.tx_wait_max_ns = wait;
+        }
+        mux->port_tx_bytes += client->tx_offset;
+        pthread_mutex_unlock(&mux->stats_mutex);
+
+        if (mux->owner == client) {
+            mux->owner_ns = now;
+        }
+        mux->writer = NULL;
+        update_client_events(loop, client);
+    }
+
+    update_port_events(loop, mux);
+    return TRUE;
+}
+
+static void on_port_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    SerialMux *mux = (SerialMux *)endpoint->owner;
+
+    if ((events & EPOLLOUT) && !pump_port(loop, mux)) {
+        relay_fail(loop, mux->port_path, errno);
+        return;
+    }
+
+    if (events & (EPOLLHUP | EPOLLERR) && !(events & EPOLLIN)) {
+        relay_fail(loop, mux->port_path, EIO);
+        return;
+    }
+    if (!(events & EPOLLIN)) return;
+
+    // Read into the ring, never across its end
+    size_t offset = mux->rx_head % MUX_RING_SIZE;
+    size_t space = MIN((size_t)MUX_READ_SIZE, MUX_RING_SIZE - offset);
+    ssize_t bytes_read = read(endpoint->fd, mux->rx_ring + offset, space);
+    if (bytes_read < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            relay_fail(loop, mux->port_path, errno);
+        }
+        return;
+    }
+    if (bytes_read == 0) {
+        relay_fail(loop, mux->port_path, EIO);  // Device went away
+        return;
+    }
+
+    if (mux->tap) {
+        // The port has its own channel after the clients' so its RX is never
+        // mistaken for client 0
+        mux->tap(mux->tap_data, mux->client_count, (const char *)mux->rx_ring + offset, bytes_read, 'R');
+    }
+    mux->rx_head += bytes_read;
+
+    pthread_mutex_lock(&mux->stats_mutex);
+    mux->port_rx_bytes += bytes_read;
+    for (int i = 0; i < mux->client_count; i++) {
+        MuxClient *client = &mux->clients[i];
+        // What was overwritten is gone for a client this far behind
+        if (mux->rx_head - client->rx_cursor > MUX_RING_SIZE) {
+            client->stats.rx_dropped += mux->rx_head - MUX_RING_SIZE - client->rx_cursor;
+            client->rx_cursor = mux->rx_head - MUX_RING_SIZE;
+        }
+    }
+    pthread_mutex_unlock(&mux->stats_mutex);
+
+    for (int i = 0; i < mux->client_count; i++) {
+        if (!deliver_to_client(loop, &mux->clients[i])) {
+            relay_fail(loop, mux->clients[i].link_path, errno);
+            return;
+        }
+    }
+}
+
+static void on_client_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    MuxClient *client = (MuxClient *)endpoint->owner;
+    SerialMux *mux = client->mux;
+
+    if ((events & EPOLLOUT) && !deliver_to_client(loop, client)) {
+        relay_fail(loop, client->link_path, errno);
+        return;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)) || client->tx_length > 0) {
+        return;
+    }
+
+    uint64_t now = relay_now_ns();
+    ssize_t bytes_read = read(endpoint->fd, client->tx_buffer, MUX_READ_SIZE);
+    if (bytes_read < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            relay_fail(loop, client->link_path, errno);
+        }
+        return;
+    }
+    if (bytes_read == 0) return;
+
+    if (mux->policy == MUX_POLICY_EXCLUSIVE) {
+        // The owner lets go once it has been quiet for a while
+        if (mux->owner && mux->owner != client && mux->owner->tx_length == 0 &&
+            now - mux->owner_ns > MUX_EXCLUSIVE_HOLD_MS * 1000000ULL) {
+            mux->owner = NULL;
+        }
+        if (mux->owner && mux->owner != client) {
+            pthread_mutex_lock(&mux->stats_mutex);
+            client->stats.tx_rejected += bytes_read;
+            pthread_mutex_unlock(&mux->stats_mutex);
+            return;
+        }
+        mux->owner = client;
+        mux->owner_ns = now;
+    }
+
+    if (mux->tap) {
+        mux->tap(mux->tap_data, client->index, client->tx_buffer, bytes_read, 'T');
+    }
+
+    client->tx_read_ns = now;
+    client->tx_offset = 0;
+    client->tx_length = bytes_read;
+    update_client_events(loop, client);
+    if (!pump_port(loop, mux)) {
+        relay_fail(loop, mux->port_path, errno);
+    }
+}
+
+// Real port in raw mode with the configured line settings; the old settings
+// are kept for mux_free
+static gboolean open_serial_port(BridgeApp *app, SerialMux *mux) {
+    speed_t speed = 0;
+    for (size_t i = 0; i < G_N_ELEMENTS(baud_rates); i++) {
+        if (baud_rates[i].rate == app->mux_baud) {
+            speed = baud_rates[i].speed;
+        }
+    }
+    if (!speed) {
+        log_message(app, "ERROR: Unsupported baud rate %d", app->mux_baud);
+        return FALSE;
+    }
+
+    int fd = open(mux->port_path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        log_message(app, "ERROR: Could not open %s: %s", mux->port_path, strerror(errno));
+        return FALSE;
+    }
+    mux->port.fd = fd;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        log_message(app, "ERROR: %s is not a serial port: %s", mux->port_path, strerror(errno));
+        return FALSE;
+    }
+    mux->saved_tio = tio;
+    mux->saved_tio_valid = TRUE;
+
+    // Keep other programs off the port while it is shared through us
+    if (ioctl(fd, TIOCEXCL) != 0) {
+        log_message(app, "WARNING: Could not get exclusive use of %s: %s",
+                   mux->port_path, strerror(errno));
+    }
+
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+
+    tio.c_cflag &= ~CSIZE;
+    switch (app->mux_data_bits) {
+        case 5: tio.c_cflag |= CS5; break;
+        case 6: tio.c_cflag |= CS6; break;
+        case 7: tio.c_cflag |= CS7; break;
+        default: tio.c_cflag |= CS8; break;
+    }
+
+    tio.c_cflag &= ~(PARENB | PARODD);
+    if (app->mux_parity == 'E') {
+        tio.c_cflag |= PARENB;
+    } else if (app->mux_parity == 'O') {
+        tio.c_cflag |= PARENB | PARODD;
+    }
+
+    if (app->mux_stop_bits == 2) {
+        tio.c_cflag |= CSTOPB;
+    } else {
+        tio.c_cflag &= ~CSTOPB;
+    }
+
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (app->mux_flow == MUX_FLOW_HARDWARE) {
+        tio.c_cflag |= CRTSCTS;
+    } else if (app->mux_flow == MUX_FLOW_SOFTWARE) {
+        tio.c_iflag |= IXON | IXOFF;
+    }
+
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        log_message(app, "ERROR: Could not configure %s: %s", mux->port_path, strerror(errno));
+        return FALSE;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return TRUE;
+}
+
+SerialMux* mux_create(BridgeApp *app) {
+    SerialMux *mux = calloc(1, sizeof(SerialMux));
+    if (!mux) return NULL;
+
+    mux->app = app;
+    mux->policy = app->mux_policy;
+    mux->port.fd = -1;
+    mux->port.on_event = on_port_event;
+    mux->port.owner = mux;
+    strncpy(mux->port_path, app->mux_port_path, MAX_PATH_LENGTH - 1);
+    pthread_mutex_init(&mux->stats_mutex, NULL);
+
+    mux->client_count = app->mux_clients;
+    mux->clients = calloc(mux->client_count, sizeof(MuxClient));
+    mux->rx_ring = malloc(MUX_RING_SIZE);
+    if (!mux->clients || !mux->rx_ring) {
+        mux_free(mux);
+        return NULL;
+    }
+
+    for (int i = 0; i < mux->client_count; i++) {
+        MuxClient *client = &mux->clients[i];
+        client->endpoint.fd = -1;
+        client->endpoint.on_event = on_client_event;
+        client->endpoint.owner = client;
+        client->slave_fd = -1;
+        client->index = i;
+        client->mux = mux;
+    }
+
+    if (!open_serial_port(app, mux)) {
+        mux_free(mux);
+        return NULL;
+    }
+
+    // Clients share the path scheme of null modem pairs: /tmp/ttyV0, /tmp/ttyV0_1, ...
+    for (int i = 0; i < mux->client_count; i++) {
+        MuxClient *client = &mux->clients[i];
+        format_pair_device_path(app->device1_path, i, client->link_path, sizeof(client->link_path));
+        client->tx_buffer = malloc(MUX_READ_SIZE);
+        if (!client->tx_buffer ||
+            !relay_open_pty(app, client->link_path, &client->endpoint.fd, &client->slave_fd,
+                            client->slave_name)) {
+            mux_free(mux);
+            return NULL;
+        }
+    }
+
+    return mux;
+}
+
+gboolean mux_attach(RelayLoop *loop, SerialMux *mux) {
+    if (!relay_loop_add(loop, &mux->port, EPOLLIN)) {
+        log_message(loop->app, "ERROR: Could not watch %s: %s", mux->port_path, strerror(errno));
+        return FALSE;
+    }
+    for (int i = 0; i < mux->client_count; i++) {
+        if (!relay_loop_add(loop, &mux->clients[i].endpoint, EPOLLIN)) {
+            log_message(loop->app, "ERROR: Could not watch %s: %s",
+                       mux->clients[i].link_path, strerror(errno));
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Close the port and the PTYs; the loop must be stopped first. Links are left to cleanup_devices.
+void mux_free(SerialMux *mux) {
+    if (!mux) return;
+
+    if (mux->port.fd >= 0) {
+        if (mux->saved_tio_valid) {
+            tcsetattr(mux->port.fd, TCSANOW, &mux->saved_tio);
+        }
+        ioctl(mux->port.fd, TIOCNXCL);
+        close(mux->port.fd);
+    }
+    for (int i = 0; mux->clients && i < mux->client_count; i++) {
+        MuxClient *client = &mux->clients[i];
+        if (client->endpoint.fd >= 0) close(client->endpoint.fd);
+        if (client->slave_fd >= 0) close(client->slave_fd);
+        free(client->tx_buffer);
+    }
+    free(mux->clients);
+    free(mux->rx_ring);
+    pthread_mutex_destroy(&mux->stats_mutex);
+    free(mux);
+}
+
+void mux_get_client_stats(SerialMux *mux, int client, MuxClientStats *stats) {
+    pthread_mutex_lock(&mux->stats_mutex);
+    *stats = mux->clients[client].stats;
+    pthread_mutex_unlock(&mux->stats_mutex);
+}
+
+// Port totals, then one line per client
+void mux_format_stats(SerialMux *mux, char *buffer, size_t buffer_size) {
+    pthread_mutex_lock(&mux->stats_mutex);
+    int offset = snprintf(buffer, buffer_size, "%s: %lu bytes in, %lu bytes out (%s)",
+                          mux->port_path, mux->port_rx_bytes, mux->port_tx_bytes,
+                          mux_policy_name(mux->policy));
+
+    for (int i = 0; i < mux->client_count && offset > 0 && (size_t)offset < buffer_size; i++) {
+        MuxClient *client = &mux->clients[i];
+        MuxClientStats *stats = &client->stats;
+        offset += snprintf(buffer + offset, buffer_size - offset,
+                           "\n%s: rx %lu (%lu dropped), tx %lu in %lu chunks (%lu rejected), "
+                           "wait avg %.1f ms, max %.1f ms",
+                           client->link_path, stats->rx_bytes, stats->rx_dropped,
+                           stats->tx_bytes, stats->tx_chunks, stats->tx_rejected,
+                           stats->tx_chunks ? stats->tx_wait_total_ns / 1e6 / stats->tx_chunks : 0.0,
+                           stats->tx_wait_max_ns / 1e6);
+    }
+    pthread_mutex_unlock(&mux->stats_mutex);
+}
@@ -0,0 +1,77 @@
+/*
+ * Serial port multiplexer header for BRIDGE - Virtual Null Modem Bridge
+ * Shares one real serial port among several virtual PTYs on the relay loop
+ */
+
+#ifndef MUX_H
+#define MUX_H
+
+#include "common.h"
+#include "relay.h"
+#include <stdint.h>
+#include <termios.h>
+
+// Port data waiting for the clients; a client further behind loses the oldest
+#define MUX_RING_SIZE (256 * 1024)
+// Longest single read from the port
+#define MUX_READ_SIZE 4096
+// Exclusive policy: the writing client keeps the port until silent this long
+#define MUX_EXCLUSIVE_HOLD_MS 500
+
+typedef struct SerialMux SerialMux;
+
+typedef struct {
+    unsigned long rx_bytes;     // Port data delivered to this client
+    unsigned long rx_dropped;   // Port data the client fell too far behind for
+    unsigned long tx_bytes;     // Written to the port on this client's behalf
+    unsigned long tx_chunks;
+    unsigned long tx_rejected;  // Bytes discarded while another client held the port
+    uint64_t tx_wait_total_ns;  // Read from the client until written to the port
+    uint64_t tx_wait_max_ns;
+} MuxClientStats;
+
+// One virtual port
+typedef struct MuxClient {
+    RelayEndpoint endpoint;     // PTY master
+    int slave_fd;               // Held open so the master never reports a hangup
+    char slave_name[64];
+    char link_path[MAX_PATH_LENGTH];
+    int index;
+    SerialMux *mux;
+    uint64_t rx_cursor;         // Next ring position to deliver
+    char *tx_buffer;            // MUX_READ_SIZE bytes
+    size_t tx_offset;           // Unwritten part of the chunk waiting for the port
+    size_t tx_length;
+    uint64_t tx_read_ns;
+    MuxClientStats stats;
+} MuxClient;
+
+struct SerialMux {
+    RelayEndpoint port;         // The real serial port
+    char port_path[MAX_PATH_LENGTH];
+    struct termios saved_tio;   // Port settings restored on close
+    gboolean saved_tio_valid;
+    unsigned char *rx_ring;     // MUX_RING_SIZE bytes, written once and sent to every client
+    uint64_t rx_head;           // Bytes read from the port so far
+    MuxClient *clients;
+    int client_count;
+    MuxPolicy policy;
+    MuxClient *writer;          // Client whose chunk is going out; chunks never interleave
+    MuxClient *owner;           // Exclusive policy: client holding the port
+    uint64_t owner_ns;          // When the owner last wrote
+    RelayTapFunc tap;           // Optional, set before the mux is attached
+    void *tap_data;
+    unsigned long port_rx_bytes;
+    unsigned long port_tx_bytes;
+    pthread_mutex_t stats_mutex;
+    BridgeApp *app;
+};
+
+SerialMux* mux_create(BridgeApp *app);
+gboolean mux_attach(RelayLoop *loop, SerialMux *mux);
+void mux_free(SerialMux *mux);
+void mux_get_client_stats(SerialMux *mux, int client, MuxClientStats *stats);
+void mux_format_stats(SerialMux *mux, char *buffer, size_t buffer_size);
+const char* mux_policy_name(MuxPolicy policy);
+
+#endif // MUX_H
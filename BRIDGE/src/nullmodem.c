@@ -1,111 +1,316 @@
 /*
  * Null modem module for BRIDGE - Virtual Null Modem Bridge
- * Handles socat process management and virtual device operations
+ * Null modem lifecycle on top of the in-process PTY relay, and device operations
  */
 
 #include "nullmodem.h"
+#include "relay.h"
+#include "mux.h"
 #include "sniffing.h"
+#include "stats_socket.h"
 #include "utils.h"
+#include <poll.h>
 
-gboolean check_socat_available(void) {
-    int result = system("which socat > /dev/null 2>&1");
-    return (result == 0);
+// Hands relayed data to the sniffer; cheap no-op while sniffing is off
+static void relay_sniff_tap(void *user_data, int channel, const char *data, size_t length,
+                            char direction) {
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    if (app->pair_sniff[channel]) {
+        process_sniff_data(app, channel, data, length, direction);
+    }
 }
 
-gboolean create_null_modem(BridgeApp *app) {
-    if (app->state == BRIDGE_STATE_RUNNING) {
-        log_message(app, "Null modem is already running");
-        return FALSE;
+// Multiplexer tap: client writes follow the client's Sniff toggle, while what
+// the port receives (on the channel after the clients) has none and is always captured
+static void mux_sniff_tap(void *user_data, int channel, const char *data, size_t length,
+                          char direction) {
+    BridgeApp *app = (BridgeApp *)user_data;
+
+    if (direction == 'R' || app->pair_sniff[channel]) {
+        process_sniff_data(app, channel, data, length, direction);
     }
+}
 
-    if (!check_socat_available()) {
-        log_message(app, "ERROR: socat not found. Install with: sudo apt-get install socat");
-        app->state = BRIDGE_STATE_ERROR;
-        return FALSE;
+// Pair 0 uses the configured path as is; pair N appends "_N" (/tmp/ttyV0_3)
+void format_pair_device_path(const char *base, int pair, char *buffer, size_t buffer_size) {
+    if (pair == 0) {
+        snprintf(buffer, buffer_size, "%s", base);
+    } else {
+        snprintf(buffer, buffer_size, "%s_%d", base, pair);
     }
+}
 
-    app->state = BRIDGE_STATE_STARTING;
-    update_ui_state(app);
+// Sniff channels, and pcapng interfaces: one per pair, or one per multiplexer client
+int device_channel_count(BridgeApp *app) {
+    return app->mode == BRIDGE_MODE_MULTIPLEXER ? app->mux_clients : app->pair_count;
+}
 
-    // Clean up any existing devices
-    cleanup_devices(app);
+// Channels a capture can carry: a multiplexer adds one after its clients for
+// what the port receives
+int sniff_channel_count(BridgeApp *app) {
+    return device_channel_count(app) + (app->mode == BRIDGE_MODE_MULTIPLEXER ? 1 : 0);
+}
 
-    // Build socat command with optional data capture
-    char cmd[1024];
-    if (app->sniffing_enabled) {
-        // Create temporary capture file for sniffing
-        char capture_file[MAX_PATH_LENGTH];
-        snprintf(capture_file, sizeof(capture_file), "/tmp/bridge_capture_%d.log", getpid());
+void format_channel_description(BridgeApp *app, int channel, char *buffer, size_t buffer_size) {
+    char path1[MAX_PATH_LENGTH], path2[MAX_PATH_LENGTH];
 
-        snprintf(cmd, sizeof(cmd),
-            "socat -d -d -x pty,raw,echo=0,link=%s pty,raw,echo=0,link=%s 2>%s",
-            app->device1_path, app->device2_path, capture_file);
+    if (app->mode == BRIDGE_MODE_MULTIPLEXER && channel == app->mux_clients) {
+        snprintf(buffer, buffer_size, "%s", app->mux_port_path);
+        return;
+    }
+    format_pair_device_path(app->device1_path, channel, path1, sizeof(path1));
+    if (app->mode == BRIDGE_MODE_MULTIPLEXER) {
+        snprintf(path2, sizeof(path2), "%s", app->mux_port_path);
+    } else {
+        format_pair_device_path(app->device2_path, channel, path2, sizeof(path2));
+    }
+    snprintf(buffer, buffer_size, "%s <-> %s", path1, path2);
+}
 
-        // Store capture file path for monitoring
-        strncpy(app->capture_file_path, capture_file, MAX_PATH_LENGTH - 1);
+// Every link the current mode publishes: both ends of each pair, or each client
+static int device_link_count(BridgeApp *app) {
+    return app->mode == BRIDGE_MODE_MULTIPLEXER ? app->mux_clients : 2 * app->pair_count;
+}
+
+static void format_device_link(BridgeApp *app, int link, char *buffer, size_t buffer_size) {
+    if (app->mode == BRIDGE_MODE_MULTIPLEXER) {
+        format_pair_device_path(app->device1_path, link, buffer, buffer_size);
     } else {
-        snprintf(cmd, sizeof(cmd),
-            "socat -d -d pty,raw,echo=0,link=%s pty,raw,echo=0,link=%s",
-            app->device1_path, app->device2_path);
-    }
-
-    log_message(app, "Starting socat: %s", cmd);
-
-    // Fork and exec socat
-    pid_t pid = fork();
-    if (pid == 0) {
-        // Child process - exec socat
-        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
-        exit(1); // Should never reach here
-    } else if (pid > 0) {
-        // Parent process
-        app->socat_pid = pid;
-        
-        // Wait for devices to be created (with timeout)
-        int timeout_ms = 0;
-        while (timeout_ms < DEVICE_CREATION_TIMEOUT) {
-            if (file_exists(app->device1_path) && file_exists(app->device2_path)) {
-                break;
-            }
-            usleep(100000); // 100ms
-            timeout_ms += 100;
+        format_pair_device_path(link % 2 ? app->device2_path : app->device1_path,
+                                link / 2, buffer, buffer_size);
+    }
+}
+
+// Have the relay thread report a removed link as soon as it happens. Without
+// inotify the status timer still finds it by polling.
+static void watch_device_links(BridgeApp *app) {
+    for (int i = 0; i < device_link_count(app); i++) {
+        char path[MAX_PATH_LENGTH];
+        format_device_link(app, i, path, sizeof(path));
+        if (!relay_loop_watch_link(app->relay, path)) {
+            log_message(app, "WARNING: Cannot watch %s (%s), checking for it every second", path,
+                       strerror(errno));
+            return;
         }
+    }
+}
 
-        if (!file_exists(app->device1_path) || !file_exists(app->device2_path)) {
-            log_message(app, "ERROR: Devices not created within timeout");
-            stop_null_modem(app);
+// All PTYs and their links exist as soon as this returns; every pair
+// shares the one relay thread
+static gboolean create_pairs(BridgeApp *app, uint64_t start_ns) {
+    for (int i = 0; i < app->pair_count; i++) {
+        char path1[MAX_PATH_LENGTH], path2[MAX_PATH_LENGTH];
+        format_pair_device_path(app->device1_path, i, path1, sizeof(path1));
+        format_pair_device_path(app->device2_path, i, path2, sizeof(path2));
+
+        RelayPair *pair = relay_pair_create(app, path1, path2);
+        if (!pair) return FALSE;
+        pair->channel = i;
+        pair->tap = relay_sniff_tap;
+        pair->tap_data = app;
+        app->relay_pairs[i] = pair;
+        if (!relay_pair_set_line(pair, &app->pair_line[i])) {
+            log_message(app, "ERROR: Could not create line timer for pair %d: %s", i, strerror(errno));
             return FALSE;
         }
+        // Each direction draws from its own generator, derived from the one seed
+        for (int d = 0; d < 2; d++) {
+            uint64_t seed = ((uint64_t)app->impair_seed << 32) | (uint64_t)(i * 2 + d);
+            if (!relay_pair_set_impairment(pair, d, &app->pair_impair[i][d], seed)) {
+                log_message(app, "ERROR: Could not set up impairments for pair %d: %s", i, strerror(errno));
+                return FALSE;
+            }
+        }
+        if (!relay_pair_attach(app->relay, pair)) return FALSE;
+    }
+    watch_device_links(app);
+    if (!relay_loop_start(app->relay)) return FALSE;
+
+    RelayPair *first = app->relay_pairs[0];
+    if (app->pair_count == 1) {
+        log_message(app, "✓ Created null modem: %s (%s) <-> %s (%s) in %.2f ms",
+                   first->ports[0].link_path, first->ports[0].slave_name,
+                   first->ports[1].link_path, first->ports[1].slave_name,
+                   (relay_now_ns() - start_ns) / 1e6);
+    } else {
+        RelayPair *last = app->relay_pairs[app->pair_count - 1];
+        log_message(app, "✓ Created %d null modems: %s <-> %s ... %s <-> %s in %.2f ms",
+                   app->pair_count, first->ports[0].link_path, first->ports[1].link_path,
+                   last->ports[0].link_path, last->ports[1].link_path,
+                   (relay_now_ns() - start_ns) / 1e6);
+    }
 
-        // Check if socat is still running
-        if (!is_process_running(app->socat_pid)) {
-            log_message(app, "ERROR: socat process died unexpectedly");
-            app->state = BRIDGE_STATE_ERROR;
-            return FALSE;
+    for (int i = 0; i < app->pair_count; i++) {
+        char line[128];
+        format_line_emulation(&app->pair_line[i], line, sizeof(line));
+        if (line[0]) log_message(app, "  Pair %d paced as a %s line", i, line);
+        for (int d = 0; d < 2; d++) {
+            char faults[160];
+            format_impairment(&app->pair_impair[i][d], faults, sizeof(faults));
+            if (faults[0]) {
+                log_message(app, "  Pair %d %s impaired: %s (seed %u)", i, d == 0 ? "1→2" : "2→1",
+                           faults, app->impair_seed);
+            }
         }
+    }
+    return TRUE;
+}
+
+// The real port and its client PTYs, also on the relay thread
+static gboolean create_multiplexer(BridgeApp *app, uint64_t start_ns) {
+    app->mux = mux_create(app);
+    if (!app->mux) return FALSE;
+    app->mux->tap = mux_sniff_tap;
+    app->mux->tap_data = app;
+    if (!mux_attach(app->relay, app->mux)) return FALSE;
+    watch_device_links(app);
+    if (!relay_loop_start(app->relay)) return FALSE;
+
+    log_message(app, "✓ Multiplexing %s at %d %d%c%d to %d ports (%s ... %s), %s writes, in %.2f ms",
+               app->mux_port_path, app->mux_baud, app->mux_data_bits, app->mux_parity,
+               app->mux_stop_bits, app->mux_clients, app->mux->clients[0].link_path,
+               app->mux->clients[app->mux_clients - 1].link_path,
+               mux_policy_name(app->mux_policy), (relay_now_ns() - start_ns) / 1e6);
+    return TRUE;
+}
+
+static RestartIncident *current_incident(BridgeApp *app) {
+    return &app->incidents[(app->incident_count - 1) % MAX_RESTART_INCIDENTS];
+}
+
+// Closes the open incident, if any, with its downtime
+static void end_incident(BridgeApp *app, gboolean recovered) {
+    if (app->restart_timer_id > 0) {
+        g_source_remove(app->restart_timer_id);
+        app->restart_timer_id = 0;
+    }
+    if (app->down_since_ns == 0) return;
+
+    RestartIncident *incident = current_incident(app);
+    incident->downtime_ns = relay_now_ns() - app->down_since_ns;
+    incident->recovered = recovered;
+    app->downtime_ns += incident->downtime_ns;
+    app->down_since_ns = 0;
+    if (recovered) {
+        log_message(app, "✓ Recovered from %s after %.1f ms down, %d restart%s", incident->reason,
+                   incident->downtime_ns / 1e6, incident->restarts, incident->restarts == 1 ? "" : "s");
+    } else {
+        log_message(app, "Down %.1f ms before being stopped", incident->downtime_ns / 1e6);
+    }
+}
+
+static gboolean restart_timeout(gpointer data);
+
+// Backs off from RESTART_BACKOFF_MIN_MS while the budget lasts; otherwise the
+// bridge stays in the error state
+static void schedule_restart(BridgeApp *app) {
+    time_t now = time(NULL);
+    if (now - app->restart_window_start >= RESTART_WINDOW_SECONDS) {
+        app->restart_window_start = now;
+        app->restart_window_used = 0;
+    }
+    if (app->restart_budget == 0) return;
+    if (app->restart_window_used >= app->restart_budget) {
+        log_message(app, "ERROR: %d restarts in %d minutes, not restarting again", app->restart_window_used,
+                   RESTART_WINDOW_SECONDS / 60);
+        return;
+    }
 
-        // Set device permissions if configured
-        set_device_permissions(app);
+    guint delay_ms = RESTART_BACKOFF_MAX_MS;
+    if (app->restart_attempts < 16) {
+        delay_ms = MIN(RESTART_BACKOFF_MIN_MS << app->restart_attempts, RESTART_BACKOFF_MAX_MS);
+    }
+    log_message(app, "Restarting in %u ms", delay_ms);
+    app->restart_timer_id = g_timeout_add(delay_ms, restart_timeout, app);
+}
+
+// Recreates the relay on the same device paths. Programs holding the old
+// devices see them hang up and have to reopen them.
+static gboolean restart_timeout(gpointer data) {
+    BridgeApp *app = (BridgeApp *)data;
 
-        app->state = BRIDGE_STATE_RUNNING;
-        app->start_time = time(NULL);
-        app->running = TRUE;
+    app->restart_timer_id = 0;
+    if (app->state != BRIDGE_STATE_ERROR) return G_SOURCE_REMOVE;
 
-        // Start monitoring thread
-        app->monitor_running = TRUE;
-        pthread_create(&app->monitor_thread, NULL, monitor_socat_process, app);
+    app->restart_window_used++;
+    app->restarts++;
+    current_incident(app)->restarts++;
+    if (app->relay) relay_loop_stop(app->relay);
+    release_relay(app);
 
-        log_message(app, "✓ Created null modem: %s <-> %s", 
-                   app->device1_path, app->device2_path);
-        
+    if (!create_null_modem(app)) {
+        app->restart_attempts++;
+        schedule_restart(app);
         update_ui_state(app);
-        return TRUE;
-    } else {
-        // Fork failed
-        log_message(app, "ERROR: Failed to fork socat process: %s", strerror(errno));
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void supervise_relay_failure(BridgeApp *app, const char *reason) {
+    if (app->state != BRIDGE_STATE_RUNNING) return;
+
+    app->state = BRIDGE_STATE_ERROR;
+    app->running = FALSE;
+    app->down_since_ns = relay_now_ns();
+    app->restart_attempts = 0;
+    app->incident_count++;
+    RestartIncident *incident = current_incident(app);
+    *incident = (RestartIncident){ .failed_at = time(NULL) };
+    snprintf(incident->reason, sizeof(incident->reason), "%s", reason);
+
+    schedule_restart(app);
+    update_ui_state(app);
+}
+
+gboolean create_null_modem(BridgeApp *app) {
+    if (app->state == BRIDGE_STATE_RUNNING) {
+        log_message(app, "Null modem is already running");
+        return FALSE;
+    }
+
+    app->state = BRIDGE_STATE_STARTING;
+    update_ui_state(app);
+
+    // Clean up any existing devices
+    cleanup_devices(app);
+
+    uint64_t start_ns = relay_now_ns();
+    app->relay = relay_loop_new(app);
+    gboolean created = app->relay &&
+        (app->mode == BRIDGE_MODE_MULTIPLEXER ? create_multiplexer(app, start_ns)
+                                              : create_pairs(app, start_ns));
+
+    if (!created) {
+        log_message(app, "ERROR: Failed to create %s",
+                   app->mode == BRIDGE_MODE_MULTIPLEXER ? "multiplexer" : "null modem");
+        release_relay(app);
+        cleanup_devices(app);
         app->state = BRIDGE_STATE_ERROR;
+        update_ui_state(app);
         return FALSE;
     }
+
+    // Set device permissions if configured
+    set_device_permissions(app);
+
+    // Metrics query; the bridge runs without it if the socket cannot be set up
+    if (app->stats_socket_path[0]) {
+        app->stats_server = stats_server_new(app, app->stats_socket_path);
+        if (app->stats_server) {
+            log_message(app, "Relay metrics: socat - UNIX-CONNECT:%s", app->stats_socket_path);
+        }
+    }
+
+    app->state = BRIDGE_STATE_RUNNING;
+    app->start_time = time(NULL);
+    app->startup_ns = relay_now_ns() - start_ns;
+    app->running = TRUE;
+    log_message(app, "Started in %.2f ms", app->startup_ns / 1e6);
+    end_incident(app, TRUE);
+
+    update_ui_state(app);
+    return TRUE;
 }
 
 void stop_null_modem(BridgeApp *app) {
@@ -114,27 +319,27 @@ void stop_null_modem(BridgeApp *app) {
     }
 
     log_message(app, "Stopping null modem...");
-    app->state = BRIDGE_STATE_STOPPING;
+    app->state = BRIDGE_STATE_STOPPING; // A restart that fires now sees this and backs out
+    end_incident(app, FALSE);
     app->running = FALSE;
 
-    // Stop monitoring thread
-    if (app->monitor_running) {
-        app->monitor_running = FALSE;
-        pthread_join(app->monitor_thread, NULL);
+    // Stop the relay thread before its PTYs go away
+    if (app->relay) {
+        relay_loop_stop(app->relay);
     }
-
-    // Kill socat process
-    if (app->socat_pid > 0) {
-        safe_kill_process(app->socat_pid);
-        app->socat_pid = 0;
+    if (app->relay_pairs[0] || app->mux) {
+        char stats_text[RELAY_STATS_TEXT_SIZE];
+        format_relay_stats(app, stats_text, sizeof(stats_text));
+        log_message(app, "Relay: %s", stats_text);
     }
+    release_relay(app);
 
     // Clean up devices
     cleanup_devices(app);
 
     app->state = BRIDGE_STATE_STOPPED;
     log_message(app, "Null modem stopped");
-    
+
     update_ui_state(app);
 }
 
@@ -143,91 +348,176 @@ gboolean is_null_modem_running(BridgeApp *app) {
         return FALSE;
     }
 
-    // Check if socat process is still alive
-    if (app->socat_pid > 0 && !is_process_running(app->socat_pid)) {
-        log_message(app, "WARNING: socat process died unexpectedly");
-        app->state = BRIDGE_STATE_ERROR;
+    // The relay thread reports its own failures
+    if (!app->relay || !app->relay->running) {
         return FALSE;
     }
 
-    // Check if devices still exist
-    if (!file_exists(app->device1_path) || !file_exists(app->device2_path)) {
-        log_message(app, "WARNING: Devices disappeared");
-        app->state = BRIDGE_STATE_ERROR;
-        return FALSE;
+    // A lost link is reported from the relay thread when it is watched;
+    // otherwise check that the devices still exist
+    if (app->relay->link_count == device_link_count(app)) {
+        return TRUE;
+    }
+    for (int i = 0; i < device_link_count(app); i++) {
+        char path[MAX_PATH_LENGTH];
+        format_device_link(app, i, path, sizeof(path));
+        if (!file_exists(path)) {
+            char reason[MAX_PATH_LENGTH + 32];
+            log_message(app, "WARNING: Device %s disappeared", path);
+            snprintf(reason, sizeof(reason), "%s disappearing", path);
+            supervise_relay_failure(app, reason);
+            return FALSE;
+        }
     }
 
     return TRUE;
 }
 
-gboolean test_null_modem_communication(BridgeApp *app) {
+// Copy what the test needs while the pairs exist. The worker never reads
+// relay_pairs again: a failure restart or Stop may free them while it waits.
+CommunicationTest* communication_test_new(BridgeApp *app) {
     if (!is_null_modem_running(app)) {
         log_message(app, "Cannot test: null modem is not running");
-        return FALSE;
+        return NULL;
+    }
+
+    // The far end is a real device, so there is no loopback to check
+    if (app->mode == BRIDGE_MODE_MULTIPLEXER) {
+        log_message(app, "Communication test is not available for a multiplexed port");
+        return NULL;
+    }
+
+    CommunicationTest *test = g_new0(CommunicationTest, 1);
+    test->app = app;
+    test->pair_count = app->pair_count;
+    for (int i = 0; i < test->pair_count; i++) {
+        for (int end = 0; end < 2; end++) {
+            snprintf(test->link_paths[i][end], MAX_PATH_LENGTH, "%s",
+                     app->relay_pairs[i]->ports[end].link_path);
+        }
     }
 
     app->test_count++;
     log_message(app, "Testing communication...");
+    return test;
+}
 
-    // Simple test: try to open both devices
-    int fd1 = open(app->device1_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd1 < 0) {
-        log_message(app, "✗ Failed to open %s: %s", app->device1_path, strerror(errno));
-        return FALSE;
-    }
+// Send a message from device 1 to device 2 of every pair, then check they all
+// arrived. Only opens the copied paths and logs, so it may run on any thread.
+gboolean communication_test_run(CommunicationTest *test) {
+    BridgeApp *app = test->app;
+    int fds[MAX_BRIDGE_PAIRS][2];
+    char messages[MAX_BRIDGE_PAIRS][32];
+    gboolean passed = TRUE;
+    int opened = 0;
+
+    for (; opened < test->pair_count; opened++) {
+        const char *device1 = test->link_paths[opened][0];
+        const char *device2 = test->link_paths[opened][1];
+        fds[opened][0] = open(device1, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fds[opened][0] < 0) {
+            log_message(app, "✗ Failed to open %s: %s", device1, strerror(errno));
+            passed = FALSE;
+            break;
+        }
 
-    int fd2 = open(app->device2_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd2 < 0) {
-        log_message(app, "✗ Failed to open %s: %s", app->device2_path, strerror(errno));
-        close(fd1);
-        return FALSE;
+        fds[opened][1] = open(device2, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fds[opened][1] < 0) {
+            log_message(app, "✗ Failed to open %s: %s", device2, strerror(errno));
+            close(fds[opened][0]);
+            passed = FALSE;
+            break;
+        }
+
+        // Test data exchange
+        snprintf(messages[opened], sizeof(messages[opened]), "BRIDGE_TEST_%d", opened);
+        size_t length = strlen(messages[opened]);
+        if (write(fds[opened][0], messages[opened], length) != (ssize_t)length) {
+            log_message(app, "✗ Failed to write test data to %s", device1);
+            passed = FALSE;
+        }
     }
 
-    // Test data exchange
-    const char *test_msg = "BRIDGE_TEST";
-    ssize_t written = write(fd1, test_msg, strlen(test_msg));
-    
-    if (written != (ssize_t)strlen(test_msg)) {
-        log_message(app, "✗ Failed to write test data");
-        close(fd1);
-        close(fd2);
-        return FALSE;
+    // Wait for the messages rather than sleeping a fixed time; a second is
+    // plenty even for a slow paced line
+    char received[MAX_BRIDGE_PAIRS][64];
+    size_t received_length[MAX_BRIDGE_PAIRS] = {0};
+    gboolean done[MAX_BRIDGE_PAIRS] = {FALSE};
+    uint64_t sent_ns = relay_now_ns();
+    uint64_t deadline_ns = sent_ns + 1000000000ULL;
+    int pending = opened;
+
+    while (pending > 0) {
+        struct pollfd pfds[MAX_BRIDGE_PAIRS];
+        int slots[MAX_BRIDGE_PAIRS];
+        int count = 0;
+        for (int i = 0; i < opened; i++) {
+            if (!done[i]) {
+                pfds[count].fd = fds[i][1];
+                pfds[count].events = POLLIN;
+                slots[count++] = i;
+            }
+        }
+
+        uint64_t now_ns = relay_now_ns();
+        if (now_ns >= deadline_ns) break;
+        int ready = poll(pfds, count, (int)((deadline_ns - now_ns + 999999) / 1000000));
+        if (ready < 0 && errno != EINTR) break;
+
+        for (int n = 0; ready > 0 && n < count; n++) {
+            if (!(pfds[n].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            int i = slots[n];
+            ssize_t read_bytes = read(fds[i][1], received[i] + received_length[i],
+                                      sizeof(received[i]) - received_length[i]);
+            if (read_bytes < 0 && errno == EAGAIN) continue;
+            if (read_bytes > 0) received_length[i] += read_bytes;
+            if (read_bytes <= 0 || received_length[i] >= strlen(messages[i])) {
+                done[i] = TRUE;
+                pending--;
+            }
+        }
     }
+    double round_trip_ms = (relay_now_ns() - sent_ns) / 1e6;
 
-    // Give some time for data to transfer
-    usleep(100000); // 100ms
+    for (int i = 0; i < opened; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
 
-    char buffer[64];
-    ssize_t read_bytes = read(fd2, buffer, sizeof(buffer) - 1);
-    
-    close(fd1);
-    close(fd2);
-
-    if (read_bytes > 0) {
-        buffer[read_bytes] = '\0';
-        if (strncmp(buffer, test_msg, strlen(test_msg)) == 0) {
-            app->successful_tests++;
-            app->last_test_time = time(NULL);
-            log_message(app, "✓ Communication test passed");
-            return TRUE;
+        if (received_length[i] != strlen(messages[i]) ||
+            memcmp(received[i], messages[i], received_length[i]) != 0) {
+            log_message(app, "✗ No test data on %s", test->link_paths[i][1]);
+            passed = FALSE;
         }
     }
 
-    log_message(app, "✗ Communication test failed");
-    return FALSE;
+    test->passed = passed;
+    if (passed) {
+        log_message(app, "✓ Communication test passed in %.2f ms", round_trip_ms);
+    } else {
+        log_message(app, "✗ Communication test failed");
+    }
+    return passed;
+}
+
+// Record the result; main thread
+void communication_test_free(CommunicationTest *test) {
+    if (test->passed) {
+        test->app->successful_tests++;
+        test->app->last_test_time = time(NULL);
+    }
+    g_free(test);
 }
 
+
 void cleanup_devices(BridgeApp *app) {
-    // Remove device files if they exist
-    if (file_exists(app->device1_path)) {
-        if (unlink(app->device1_path) == 0) {
-            log_message(app, "Removed device: %s", app->device1_path);
-        }
-    }
-    
-    if (file_exists(app->device2_path)) {
-        if (unlink(app->device2_path) == 0) {
-            log_message(app, "Removed device: %s", app->device2_path);
+    // Remove device links if they exist; once the PTYs are closed they dangle,
+    // so look at the link itself
+    for (int i = 0; i < device_link_count(app); i++) {
+        char path[MAX_PATH_LENGTH];
+        struct stat st;
+        format_device_link(app, i, path, sizeof(path));
+        if (lstat(path, &st) == 0 && unlink(path) == 0) {
+            log_message(app, "Removed device: %s", path);
         }
     }
 }
@@ -239,34 +529,29 @@ gboolean set_device_permissions(BridgeApp *app) {
 
     mode_t mode = strtol(app->device_permissions, NULL, 8);
     
-    if (chmod(app->device1_path, mode) != 0) {
-        log_message(app, "WARNING: Could not set permissions for %s: %s", 
-                   app->device1_path, strerror(errno));
-        return FALSE;
-    }
-    
-    if (chmod(app->device2_path, mode) != 0) {
-        log_message(app, "WARNING: Could not set permissions for %s: %s", 
-                   app->device2_path, strerror(errno));
-        return FALSE;
+    for (int i = 0; i < device_link_count(app); i++) {
+        char path[MAX_PATH_LENGTH];
+        format_device_link(app, i, path, sizeof(path));
+        if (chmod(path, mode) != 0) {
+            log_message(app, "WARNING: Could not set permissions for %s: %s",
+                       path, strerror(errno));
+            return FALSE;
+        }
     }
 
     log_message(app, "Set device permissions to %s", app->device_permissions);
     return TRUE;
 }
 
-void* monitor_socat_process(void *data) {
-    BridgeApp *app = (BridgeApp *)data;
-    
-    while (app->monitor_running && app->running) {
-        if (!is_null_modem_running(app)) {
-            // Process died or devices disappeared
-            g_idle_add((GSourceFunc)update_ui_state, app);
-            break;
-        }
-        
-        sleep(1); // Check every second
+void release_relay(BridgeApp *app) {
+    stats_server_free(app->stats_server);
+    app->stats_server = NULL;
+    relay_loop_free(app->relay);
+    app->relay = NULL;
+    mux_free(app->mux);
+    app->mux = NULL;
+    for (int i = 0; i < MAX_BRIDGE_PAIRS; i++) {
+        relay_pair_free(app->relay_pairs[i]);
+        app->relay_pairs[i] = NULL;
     }
-    
-    return NULL;
 }
@@ -1,6 +1,6 @@
 /*
  * Null modem module header for BRIDGE - Virtual Null Modem Bridge
- * Handles socat process management and virtual device operations
+ * Null modem lifecycle on top of the in-process PTY relay, and device operations
  */
 
 #ifndef NULLMODEM_H
@@ -8,14 +8,31 @@
 
 #include "common.h"
 
-// Function declarations
+// Start, stop and the supervised restart share the lifecycle and restart
+// state without a lock; main thread only
 gboolean create_null_modem(BridgeApp *app);
 void stop_null_modem(BridgeApp *app);
 gboolean is_null_modem_running(BridgeApp *app);
-gboolean test_null_modem_communication(BridgeApp *app);
 void cleanup_devices(BridgeApp *app);
-gboolean check_socat_available(void);
-void* monitor_socat_process(void *data);
 gboolean set_device_permissions(BridgeApp *app);
+void release_relay(BridgeApp *app);
+// Marks a running bridge failed and schedules its restart; main thread only
+void supervise_relay_failure(BridgeApp *app, const char *reason);
+// Communication test: set up and finished on the main thread, run on any
+typedef struct {
+    BridgeApp *app;
+    int pair_count;
+    char link_paths[MAX_BRIDGE_PAIRS][2][MAX_PATH_LENGTH];
+    gboolean passed;
+} CommunicationTest;
+
+CommunicationTest* communication_test_new(BridgeApp *app);
+gboolean communication_test_run(CommunicationTest *test);
+void communication_test_free(CommunicationTest *test);
+
+void format_pair_device_path(const char *base, int pair, char *buffer, size_t buffer_size);
+int device_channel_count(BridgeApp *app);
+int sniff_channel_count(BridgeApp *app);
+void format_channel_description(BridgeApp *app, int channel, char *buffer, size_t buffer_size);
 
 #endif // NULLMODEM_H
@@ -0,0 +1,679 @@
+/*
+ * Relay module for BRIDGE - Virtual Null Modem Bridge
+ * Creates PTY pairs with openpty and shuttles bytes between them on a single
+ * epoll thread. Every byte passes through here, which is also where relay
+ * latency is measured.
+ */
+
+#include "relay.h"
+#include "nullmodem.h"
+#include "utils.h"
+#include "ui.h"
+#include <pty.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+
+uint64_t relay_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Main-thread report for a loop that stopped on its own
+static gboolean relay_failed_idle(gpointer data) {
+    BridgeApp *app = (BridgeApp *)data;
+
+    if (app->relay && !app->relay->running && app->relay->error[0]) {
+        log_message(app, "ERROR: Relay stopped: %s", app->relay->error);
+        supervise_relay_failure(app, app->relay->error);
+        app->relay->error[0] = '\0';
+    }
+    return FALSE;
+}
+
+// Stops the loop from its own thread; the main thread reports why
+void relay_fail(RelayLoop *loop, const char *what, int error) {
+    snprintf(loop->error, sizeof(loop->error), "%s: %s", what, strerror(error));
+    loop->running = FALSE;
+    g_idle_add(relay_failed_idle, loop->app);
+}
+
+// Main-thread report for a device link removed behind our back
+static gboolean link_lost_idle(gpointer data) {
+    BridgeApp *app = (BridgeApp *)data;
+
+    if (app->relay && app->relay->lost_link[0] && app->state == BRIDGE_STATE_RUNNING) {
+        char reason[MAX_PATH_LENGTH + 32];
+        log_message(app, "WARNING: Device %s disappeared", app->relay->lost_link);
+        snprintf(reason, sizeof(reason), "%s disappearing", app->relay->lost_link);
+        supervise_relay_failure(app, reason);
+    }
+    return FALSE;
+}
+
+static void on_link_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    (void)events;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+
+    while ((length = read(endpoint->fd, buffer, sizeof(buffer))) > 0) {
+        for (char *next = buffer; next < buffer + length; ) {
+            const struct inotify_event *event = (const struct inotify_event *)next;
+            next += sizeof(*event) + event->len;
+            if (event->len == 0 || loop->lost_link[0]) continue;
+
+            for (int i = 0; i < loop->link_count; i++) {
+                if (loop->links[i].wd == event->wd && strcmp(loop->links[i].name, event->name) == 0) {
+                    snprintf(loop->lost_link, sizeof(loop->lost_link), "%s", loop->links[i].path);
+                    g_idle_add(link_lost_idle, loop->app);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void on_wake(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    (void)loop;
+    (void)events;
+    uint64_t value;
+    ssize_t ignored = read(endpoint->fd, &value, sizeof(value));
+    (void)ignored;
+}
+
+static void* relay_thread_func(void *data) {
+    RelayLoop *loop = (RelayLoop *)data;
+    struct epoll_event events[RELAY_MAX_EVENTS];
+
+    while (loop->running) {
+        int count = epoll_wait(loop->epoll_fd, events, RELAY_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            relay_fail(loop, "epoll_wait", errno);
+            break;
+        }
+
+        for (int i = 0; i < count && loop->running; i++) {
+            RelayEndpoint *endpoint = (RelayEndpoint *)events[i].data.ptr;
+            endpoint->on_event(loop, endpoint, events[i].events);
+        }
+    }
+
+    return NULL;
+}
+
+RelayLoop* relay_loop_new(BridgeApp *app) {
+    RelayLoop *loop = calloc(1, sizeof(RelayLoop));
+    if (!loop) return NULL;
+
+    loop->app = app;
+    loop->link_watch.fd = -1;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop->wake.on_event = on_wake;
+    loop->wake.owner = loop;
+
+    if (loop->epoll_fd < 0 || loop->wake.fd < 0 || !relay_loop_add(loop, &loop->wake, EPOLLIN)) {
+        log_message(app, "ERROR: Could not create relay loop: %s", strerror(errno));
+        relay_loop_free(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+gboolean relay_loop_start(RelayLoop *loop) {
+    loop->running = TRUE;
+    loop->error[0] = '\0';
+
+    if (pthread_create(&loop->thread, NULL, relay_thread_func, loop) != 0) {
+        loop->running = FALSE;
+        log_message(loop->app, "ERROR: Failed to create relay thread");
+        return FALSE;
+    }
+
+    loop->thread_started = TRUE;
+    return TRUE;
+}
+
+void relay_loop_stop(RelayLoop *loop) {
+    if (!loop->thread_started) return;
+
+    loop->running = FALSE;
+    uint64_t one = 1;
+    ssize_t ignored = write(loop->wake.fd, &one, sizeof(one));
+    (void)ignored;
+
+    pthread_join(loop->thread, NULL);
+    loop->thread_started = FALSE;
+}
+
+void relay_loop_free(RelayLoop *loop) {
+    if (!loop) return;
+
+    relay_loop_stop(loop);
+    if (loop->link_watch.fd >= 0) close(loop->link_watch.fd);
+    if (loop->wake.fd >= 0) close(loop->wake.fd);
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+    free(loop);
+}
+
+gboolean relay_loop_add(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    struct epoll_event event = { .events = events, .data.ptr = endpoint };
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, endpoint->fd, &event) != 0) {
+        return FALSE;
+    }
+    endpoint->events = events;
+    return TRUE;
+}
+
+gboolean relay_loop_modify(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    if (endpoint->events == events) return TRUE;
+
+    struct epoll_event event = { .events = events, .data.ptr = endpoint };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, endpoint->fd, &event) != 0) {
+        return FALSE;
+    }
+    endpoint->events = events;
+    return TRUE;
+}
+
+void relay_loop_remove(RelayLoop *loop, RelayEndpoint *endpoint) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, endpoint->fd, NULL);
+    endpoint->events = 0;
+}
+
+// Notice at once when link_path is deleted or renamed, instead of polling for
+// it. Watches the directory, since the link itself may be replaced.
+gboolean relay_loop_watch_link(RelayLoop *loop, const char *link_path) {
+    if (loop->link_count >= RELAY_MAX_LINKS || strlen(link_path) >= MAX_PATH_LENGTH) {
+        errno = ENOSPC;
+        return FALSE;
+    }
+
+    if (loop->link_watch.fd < 0) {
+        loop->link_watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (loop->link_watch.fd < 0) return FALSE;
+        loop->link_watch.on_event = on_link_event;
+        loop->link_watch.owner = loop;
+        if (!relay_loop_add(loop, &loop->link_watch, EPOLLIN)) {
+            int error = errno;
+            close(loop->link_watch.fd);
+            loop->link_watch.fd = -1;
+            errno = error;
+            return FALSE;
+        }
+    }
+
+    RelayLink *link = &loop->links[loop->link_count];
+    snprintf(link->path, sizeof(link->path), "%s", link_path);
+
+    char directory[MAX_PATH_LENGTH];
+    const char *slash = strrchr(link->path, '/');
+    if (!slash) {
+        snprintf(directory, sizeof(directory), ".");
+        link->name = link->path;
+    } else {
+        snprintf(directory, sizeof(directory), "%.*s", slash == link->path ? 1 : (int)(slash - link->path),
+                 link->path);
+        link->name = slash + 1;
+    }
+
+    // Watching the same directory again returns the same descriptor
+    link->wd = inotify_add_watch(loop->link_watch.fd, directory, IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR);
+    if (link->wd < 0) return FALSE;
+
+    loop->link_count++;
+    return TRUE;
+}
+
+// Bytes read from a port and not yet written to its peer
+static void record_queue(RelayPort *port) {
+    uint64_t depth = port->pending_length;
+    if (port->impair && impair_delays(port->impair)) {
+        depth += port->impair->ring_tail - port->impair->ring_head;
+    }
+    metrics_record_queue(&port->pair->metrics[port - port->pair->ports], depth);
+}
+
+static void record_chunk(RelayPort *source, size_t bytes, uint64_t now_ns) {
+    RelayPair *pair = source->pair;
+    uint64_t elapsed_ns = now_ns - source->read_ns;
+
+    pthread_mutex_lock(&pair->stats_mutex);
+    pair->stats.chunks++;
+    pair->stats.bytes += bytes;
+    pair->stats.total_ns += elapsed_ns;
+    if (elapsed_ns > pair->stats.max_ns) {
+        pair->stats.max_ns = elapsed_ns;
+    }
+    pthread_mutex_unlock(&pair->stats_mutex);
+
+    metrics_record_chunk(&pair->metrics[source - pair->ports], bytes, elapsed_ns, now_ns);
+}
+
+// A delayed link keeps reading until its delay line is full; anything else
+// reads once its last chunk has been delivered
+static gboolean port_can_read(const RelayPort *port) {
+    if (port->impair && impair_delays(port->impair)) {
+        return impair_delay_has_room(port->impair);
+    }
+    return port->pending_length == 0;
+}
+
+// Read from a port only while it can take another chunk, and wait for
+// writability only while the peer has a chunk stuck on it. A paced chunk
+// waits on its timer instead, unless the PTY itself was full.
+static void update_port_events(RelayLoop *loop, RelayPort *port) {
+    uint32_t events = 0;
+    RelayPort *peer = port->peer;
+
+    if (port_can_read(port)) events |= EPOLLIN;
+    if (peer->pending_length > 0 && (peer->char_ns == 0 || peer->peer_full)) events |= EPOLLOUT;
+    relay_loop_modify(loop, &port->endpoint, events);
+}
+
+static void arm_line_timer(RelayPort *port, uint64_t due_ns) {
+    struct itimerspec spec = { .it_value = { .tv_sec = due_ns / 1000000000ULL,
+                                             .tv_nsec = due_ns % 1000000000ULL } };
+    timerfd_settime(port->timer.fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+// Paced version of flush_pending: write the characters whose frames have
+// finished on the emulated line by now, then sleep until the next one has.
+// Character k of the chunk is due at line_start_ns + (k + 1) * char_ns.
+static gboolean pace_pending(RelayLoop *loop, RelayPort *source) {
+    RelayPort *target = source->peer;
+    uint64_t now = relay_now_ns();
+    size_t total = source->pending_offset + source->pending_length;
+    size_t due = now > source->line_start_ns ? (now - source->line_start_ns) / source->char_ns : 0;
+    if (due > total) due = total;
+
+    size_t count = due > source->pending_offset ? due - source->pending_offset : 0;
+    size_t written = 0, dropped = 0;
+    uint64_t late_ns = 0;
+
+    if (count > 0) {
+        late_ns = now - (source->line_start_ns + (source->pending_offset + 1) * source->char_ns);
+
+        // A far device with a full buffer loses what arrives next
+        if (source->device_buffer > 0) {
+            int queued = 0;
+            if (ioctl(target->slave_fd, FIONREAD, &queued) == 0) {
+                size_t room = (size_t)queued < source->device_buffer ?
+                              source->device_buffer - (size_t)queued : 0;
+                if (count > room) {
+                    dropped = count - room;
+                    count = room;
+                }
+            }
+        }
+
+        source->peer_full = FALSE;
+        while (written < count) {
+            ssize_t result = write(target->endpoint.fd, source->buffer + source->pending_offset + written,
+                                   count - written);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return FALSE;
+                source->peer_full = TRUE;
+                dropped = 0;            // Still due; retried when the PTY drains
+                break;
+            }
+            written += result;
+        }
+
+        source->pending_offset += written + dropped;
+        source->pending_length -= written + dropped;
+
+        pthread_mutex_lock(&source->pair->stats_mutex);
+        RelayStats *stats = &source->pair->stats;
+        stats->paced_chars += written;
+        stats->overruns += dropped;
+        if (written > 0) {
+            stats->pace_releases++;
+            stats->pace_error_total_ns += late_ns;
+            if (late_ns > stats->pace_error_max_ns) stats->pace_error_max_ns = late_ns;
+        }
+        pthread_mutex_unlock(&source->pair->stats_mutex);
+    }
+
+    if (source->pending_length == 0) {
+        source->line_free_ns = source->line_start_ns + total * source->char_ns;
+        record_chunk(source, total, now);
+    } else if (!source->peer_full) {
+        uint64_t next = source->line_start_ns + (source->pending_offset + 1) * source->char_ns;
+        if (next < now + RELAY_LINE_MIN_TICK_NS) next = now + RELAY_LINE_MIN_TICK_NS;
+        arm_line_timer(source, next);
+    }
+
+    update_port_events(loop, source);
+    update_port_events(loop, target);
+    return TRUE;
+}
+
+// Write the chunk pending in source to its peer. Returns FALSE on a hard error;
+// a full peer just leaves the rest pending until it drains.
+static gboolean flush_pending(RelayLoop *loop, RelayPort *source) {
+    RelayPort *target = source->peer;
+
+    if (source->char_ns > 0) return pace_pending(loop, source);
+
+    while (source->pending_length > 0) {
+        ssize_t written = write(target->endpoint.fd, source->buffer + source->pending_offset,
+                                source->pending_length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return FALSE;
+            break;
+        }
+        source->pending_offset += written;
+        source->pending_length -= written;
+    }
+
+    if (source->pending_length == 0) {
+        record_chunk(source, source->pending_offset, relay_now_ns());
+    }
+
+    update_port_events(loop, source);
+    update_port_events(loop, target);
+    return TRUE;
+}
+
+// Forward the delayed chunks that are due, one at a time as each is
+// delivered, and wake up again for the next one
+static gboolean release_delayed(RelayLoop *loop, RelayPort *port) {
+    uint64_t now = relay_now_ns();
+    size_t length;
+    uint64_t read_ns;
+
+    while (port->pending_length == 0 &&
+           impair_delay_pop(port->impair, now, port->buffer, &length, &read_ns)) {
+        port->read_ns = read_ns;
+        if (port->char_ns > 0) {
+            port->line_start_ns = now > port->line_free_ns ? now : port->line_free_ns;
+        }
+        port->pending_offset = 0;
+        port->pending_length = length;
+        if (!flush_pending(loop, port)) return FALSE;
+    }
+
+    uint64_t due = impair_delay_next_due(port->impair);
+    if (port->pending_length == 0 && due > 0) {
+        arm_line_timer(port, due);
+    }
+    update_port_events(loop, port);
+    return TRUE;
+}
+
+// Read from an impaired port. Faults are applied to the chunk in place after
+// the tap has seen it as sent; a delayed link queues it instead of forwarding it.
+static void read_impaired(RelayLoop *loop, RelayPort *port) {
+    RelayImpairment *impair = port->impair;
+    gboolean delayed = impair_delays(impair);
+    size_t space = RELAY_BUFFER_SIZE;
+    char *data = delayed ? impair_delay_reserve(impair, &space) : port->buffer;
+
+    uint64_t start = relay_now_ns();
+    ssize_t bytes_read = read(port->endpoint.fd, data, space);
+    if (bytes_read < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            relay_fail(loop, port->link_path, errno);
+        }
+        return;
+    }
+    if (bytes_read == 0) return;
+    metrics_record_read(&port->pair->metrics[port - port->pair->ports], bytes_read);
+
+    if (port->pair->tap) {
+        port->pair->tap(port->pair->tap_data, port->pair->channel, data, bytes_read, port->direction);
+    }
+
+    ImpairStats applied = {0};
+    size_t length = impair_apply(impair, data, bytes_read, start, &applied);
+    if (delayed && length > 0) {
+        impair_delay_commit(impair, length, start);
+        applied.delayed_chunks++;
+    }
+
+    pthread_mutex_lock(&port->pair->stats_mutex);
+    impair_stats_add(&port->pair->stats.impair[port - port->pair->ports], &applied);
+    pthread_mutex_unlock(&port->pair->stats_mutex);
+
+    gboolean ok = TRUE;
+    if (delayed) {
+        ok = release_delayed(loop, port);
+    } else if (length > 0) {
+        port->read_ns = start;
+        if (port->char_ns > 0) {
+            port->line_start_ns = start > port->line_free_ns ? start : port->line_free_ns;
+        }
+        port->pending_offset = 0;
+        port->pending_length = length;
+        ok = flush_pending(loop, port);
+    }
+    if (!ok) {
+        relay_fail(loop, port->peer->link_path, errno);
+        return;
+    }
+    record_queue(port);
+}
+
+static void on_port_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    RelayPort *port = (RelayPort *)endpoint->owner;
+    RelayPort *peer = port->peer;
+
+    // The peer's stuck chunk can move on, and with it any delayed ones behind it
+    if ((events & EPOLLOUT) && peer->pending_length > 0) {
+        if (!flush_pending(loop, peer) ||
+            (peer->impair && impair_delays(peer->impair) && !release_delayed(loop, peer))) {
+            relay_fail(loop, port->link_path, errno);
+            return;
+        }
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)) || !port_can_read(port)) {
+        return;
+    }
+    if (port->impair) {
+        read_impaired(loop, port);
+        return;
+    }
+
+    uint64_t start = relay_now_ns();
+    ssize_t bytes_read = read(endpoint->fd, port->buffer, RELAY_BUFFER_SIZE);
+    if (bytes_read < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            relay_fail(loop, port->link_path, errno);
+        }
+        return;
+    }
+    if (bytes_read == 0) return;
+    metrics_record_read(&port->pair->metrics[port - port->pair->ports], bytes_read);
+
+    if (port->pair->tap) {
+        port->pair->tap(port->pair->tap_data, port->pair->channel, port->buffer, bytes_read,
+                        port->direction);
+    }
+
+    port->read_ns = start;
+    if (port->char_ns > 0) {
+        // The line picks the chunk up once it has finished the previous one
+        port->line_start_ns = start > port->line_free_ns ? start : port->line_free_ns;
+    }
+    port->pending_offset = 0;
+    port->pending_length = bytes_read;
+    if (!flush_pending(loop, port)) {
+        relay_fail(loop, port->peer->link_path, errno);
+        return;
+    }
+    record_queue(port);
+}
+
+static void on_line_timer(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    (void)events;
+    RelayPort *port = (RelayPort *)endpoint->owner;
+    uint64_t expirations;
+    ssize_t ignored = read(endpoint->fd, &expirations, sizeof(expirations));
+    (void)ignored;
+
+    if (port->pending_length > 0 && port->char_ns > 0 && !port->peer_full && !pace_pending(loop, port)) {
+        relay_fail(loop, port->peer->link_path, errno);
+        return;
+    }
+    if (port->pending_length == 0 && port->impair && impair_delays(port->impair) &&
+        !release_delayed(loop, port)) {
+        relay_fail(loop, port->peer->link_path, errno);
+    }
+}
+
+// Open a raw PTY, non-blocking on the master side, and publish it under link_path
+gboolean relay_open_pty(BridgeApp *app, const char *link_path, int *master_fd, int *slave_fd,
+                        char *slave_name) {
+    struct termios tio;
+
+    memset(&tio, 0, sizeof(tio));
+    cfmakeraw(&tio);
+    if (openpty(master_fd, slave_fd, slave_name, &tio, NULL) != 0) {
+        log_message(app, "ERROR: openpty failed: %s", strerror(errno));
+        return FALSE;
+    }
+
+    fcntl(*master_fd, F_SETFL, fcntl(*master_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(*master_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(*slave_fd, F_SETFD, FD_CLOEXEC);
+
+    unlink(link_path);
+    if (symlink(slave_name, link_path) != 0) {
+        log_message(app, "ERROR: Could not create %s -> %s: %s",
+                   link_path, slave_name, strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean open_port(BridgeApp *app, RelayPort *port, const char *link_path) {
+    strncpy(port->link_path, link_path, MAX_PATH_LENGTH - 1);
+    if (!relay_open_pty(app, link_path, &port->endpoint.fd, &port->slave_fd, port->slave_name)) {
+        return FALSE;
+    }
+
+    port->buffer = malloc(RELAY_BUFFER_SIZE);
+    return port->buffer != NULL;
+}
+
+RelayPair* relay_pair_create(BridgeApp *app, const char *link1, const char *link2) {
+    RelayPair *pair = calloc(1, sizeof(RelayPair));
+    if (!pair) return NULL;
+
+    pthread_mutex_init(&pair->stats_mutex, NULL);
+    for (int i = 0; i < 2; i++) {
+        RelayPort *port = &pair->ports[i];
+        port->endpoint.fd = -1;
+        port->endpoint.on_event = on_port_event;
+        port->endpoint.owner = port;
+        port->timer.fd = -1;
+        port->timer.on_event = on_line_timer;
+        port->timer.owner = port;
+        port->slave_fd = -1;
+        port->peer = &pair->ports[1 - i];
+        port->pair = pair;
+    }
+    // device1 -> device2 is TX, the other way RX
+    pair->ports[0].direction = 'T';
+    pair->ports[1].direction = 'R';
+
+    if (!open_port(app, &pair->ports[0], link1) || !open_port(app, &pair->ports[1], link2)) {
+        relay_pair_free(pair);
+        return NULL;
+    }
+
+    return pair;
+}
+
+// Line time of one character: start bit, data, parity, stop bits and the gap.
+// Zero when the line is not emulated.
+uint64_t relay_line_char_ns(const LineEmulation *line) {
+    if (!line || line->baud <= 0) return 0;
+
+    int bits = 1 + line->data_bits + (line->parity != 'N' ? 1 : 0) + line->stop_bits;
+    return (uint64_t)bits * 1000000000ULL / (uint64_t)line->baud + (uint64_t)line->gap_us * 1000ULL;
+}
+
+// Pace both directions of the pair as the given serial line; before attaching
+gboolean relay_pair_set_line(RelayPair *pair, const LineEmulation *line) {
+    uint64_t char_ns = relay_line_char_ns(line);
+
+    for (int i = 0; i < 2; i++) {
+        RelayPort *port = &pair->ports[i];
+        port->char_ns = char_ns;
+        port->device_buffer = char_ns > 0 ? line->device_buffer : 0;
+        if (char_ns > 0 && port->timer.fd < 0) {
+            port->timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (port->timer.fd < 0) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Impair the data read on one port of the pair; after relay_pair_set_line.
+// A clean configuration leaves the port untouched. The rate cap paces the
+// port like a line at least that slow.
+gboolean relay_pair_set_impairment(RelayPair *pair, int port_index, const LinkImpairment *config,
+                                   uint64_t seed) {
+    RelayPort *port = &pair->ports[port_index];
+    if (!impair_is_active(config)) return TRUE;
+
+    port->impair = impair_create(config, seed);
+    if (!port->impair) return FALSE;
+
+    if (config->rate_limit > 0) {
+        uint64_t cap_ns = 1000000000ULL / config->rate_limit;
+        if (cap_ns > port->char_ns) port->char_ns = cap_ns;
+    }
+    if ((port->char_ns > 0 || impair_delays(port->impair)) && port->timer.fd < 0) {
+        port->timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (port->timer.fd < 0) return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean relay_pair_attach(RelayLoop *loop, RelayPair *pair) {
+    for (int i = 0; i < 2; i++) {
+        RelayPort *port = &pair->ports[i];
+        if (!relay_loop_add(loop, &port->endpoint, EPOLLIN) ||
+            (port->timer.fd >= 0 && !relay_loop_add(loop, &port->timer, EPOLLIN))) {
+            log_message(loop->app, "ERROR: Could not watch %s: %s",
+                       port->link_path, strerror(errno));
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Close both PTYs; the loop must be stopped first. Links are left to cleanup_devices.
+void relay_pair_free(RelayPair *pair) {
+    if (!pair) return;
+
+    for (int i = 0; i < 2; i++) {
+        RelayPort *port = &pair->ports[i];
+        if (port->endpoint.fd >= 0) close(port->endpoint.fd);
+        if (port->slave_fd >= 0) close(port->slave_fd);
+        if (port->timer.fd >= 0) close(port->timer.fd);
+        impair_free(port->impair);
+        free(port->buffer);
+    }
+    pthread_mutex_destroy(&pair->stats_mutex);
+    free(pair);
+}
+
+void relay_pair_get_stats(RelayPair *pair, RelayStats *stats) {
+    pthread_mutex_lock(&pair->stats_mutex);
+    *stats = pair->stats;
+    pthread_mutex_unlock(&pair->stats_mutex);
+}
@@ -0,0 +1,146 @@
+/*
+ * Relay module header for BRIDGE - Virtual Null Modem Bridge
+ * In-process PTY pairs and the epoll loop that shuttles bytes between them
+ */
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include "common.h"
+#include "impair.h"
+#include "metrics.h"
+#include <stdint.h>
+
+// Bytes read from one side in a single pass
+#define RELAY_BUFFER_SIZE 65536
+// Ready descriptors handled per epoll_wait
+#define RELAY_MAX_EVENTS 32
+// Shortest sleep between paced releases; faster lines release several characters at once
+#define RELAY_LINE_MIN_TICK_NS 50000ULL
+// Device links one loop can watch: both sides of every pair, or every mux client
+#define RELAY_MAX_LINKS (2 * MAX_BRIDGE_PAIRS)
+
+typedef struct RelayLoop RelayLoop;
+typedef struct RelayEndpoint RelayEndpoint;
+typedef struct RelayPair RelayPair;
+
+// Called on the relay thread when the endpoint's descriptor is ready
+typedef void (*RelayEventFunc)(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events);
+
+// Sees every chunk the relay reads, by reference, before it is forwarded.
+// The data is only valid for the duration of the call.
+typedef void (*RelayTapFunc)(void *user_data, int channel, const char *data, size_t length,
+                             char direction);
+
+// Anything the relay loop waits on
+struct RelayEndpoint {
+    int fd;
+    uint32_t events;            // Currently registered epoll events
+    RelayEventFunc on_event;
+    void *owner;
+};
+
+// One side of a null modem
+typedef struct RelayPort {
+    RelayEndpoint endpoint;     // PTY master
+    int slave_fd;               // Held open so the master never reports a hangup
+    char slave_name[64];
+    char link_path[MAX_PATH_LENGTH];
+    struct RelayPort *peer;
+    RelayPair *pair;
+    char direction;             // Sniff direction of data read here: 'T' or 'R'
+    char *buffer;               // RELAY_BUFFER_SIZE bytes
+    size_t pending_offset;      // Unwritten bytes in buffer while the peer is full
+    size_t pending_length;
+    uint64_t read_ns;           // When the chunk in buffer was read
+
+    // Line emulation of data read here; char_ns is 0 when unpaced
+    RelayEndpoint timer;        // timerfd, armed for the next character's due time
+    uint64_t char_ns;           // Line time of one character including the gap
+    uint64_t line_start_ns;     // When the chunk in buffer starts on the line
+    uint64_t line_free_ns;      // When the line finishes the previous chunk
+    unsigned int device_buffer; // Peer's emulated receive buffer; 0 for unbounded
+    gboolean peer_full;         // The peer PTY refused the last due character
+
+    RelayImpairment *impair;    // Faults injected into data read here; NULL for a clean link
+} RelayPort;
+
+// Relay throughput and latency (read on one side to written on the other)
+typedef struct {
+    unsigned long chunks;
+    unsigned long bytes;
+    uint64_t total_ns;
+    uint64_t max_ns;
+
+    // Line emulation: how late paced characters went out, and overruns of
+    // the emulated device buffer
+    unsigned long paced_chars;
+    unsigned long pace_releases;
+    uint64_t pace_error_total_ns;
+    uint64_t pace_error_max_ns;
+    unsigned long overruns;
+
+    ImpairStats impair[2];      // Per port, for the data read there
+} RelayStats;
+
+// Two PTYs connected back to back
+struct RelayPair {
+    RelayPort ports[2];
+    int channel;                // Index of the pair, passed to the tap
+    RelayTapFunc tap;           // Optional, set before the pair is attached
+    void *tap_data;
+    RelayStats stats;
+    pthread_mutex_t stats_mutex;
+    RelayMetrics metrics[2];    // Per port, for the data read there; lock-free
+};
+
+// A device link watched for removal
+typedef struct {
+    int wd;                     // inotify watch on the link's directory
+    char path[MAX_PATH_LENGTH];
+    const char *name;           // Last component of path
+} RelayLink;
+
+struct RelayLoop {
+    int epoll_fd;
+    RelayEndpoint wake;         // eventfd used to stop the loop
+    pthread_t thread;
+    gboolean thread_started;
+    volatile gboolean running;
+    char error[MAX_LOG_LENGTH]; // Set when the loop stops on its own
+    BridgeApp *app;
+
+    // inotify on the directories holding the device links; fd is -1 until a
+    // link is watched. Links are only added before the loop starts.
+    RelayEndpoint link_watch;
+    RelayLink links[RELAY_MAX_LINKS];
+    int link_count;
+    char lost_link[MAX_PATH_LENGTH]; // Set when a watched link is removed
+};
+
+// Event loop
+void relay_fail(RelayLoop *loop, const char *what, int error);
+RelayLoop* relay_loop_new(BridgeApp *app);
+gboolean relay_loop_start(RelayLoop *loop);
+void relay_loop_stop(RelayLoop *loop);
+void relay_loop_free(RelayLoop *loop);
+gboolean relay_loop_add(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events);
+gboolean relay_loop_modify(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events);
+void relay_loop_remove(RelayLoop *loop, RelayEndpoint *endpoint);
+gboolean relay_loop_watch_link(RelayLoop *loop, const char *link_path);
+
+// PTY pairs
+RelayPair* relay_pair_create(BridgeApp *app, const char *link1, const char *link2);
+gboolean relay_pair_set_line(RelayPair *pair, const LineEmulation *line);
+gboolean relay_pair_set_impairment(RelayPair *pair, int port, const LinkImpairment *config,
+                                   uint64_t seed);
+gboolean relay_pair_attach(RelayLoop *loop, RelayPair *pair);
+void relay_pair_free(RelayPair *pair);
+void relay_pair_get_stats(RelayPair *pair, RelayStats *stats);
+gboolean relay_open_pty(BridgeApp *app, const char *link_path, int *master_fd, int *slave_fd,
+                        char *slave_name);
+
+uint64_t relay_now_ns(void);
+uint64_t relay_line_char_ns(const LineEmulation *line);
+
+#endif // RELAY_H
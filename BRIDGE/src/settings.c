@@ -5,8 +5,32 @@
 
 #include "settings.h"
 #include "utils.h"
+#include "ui.h"
+#include "impair.h"
+
+// Set from the command line; NULL for the per-user file
+static const char *config_file_override = NULL;
+
+static const char *sniff_direction_names[] = { "both", "rx", "tx" };
+static const char *sniff_format_names[] = { "raw", "hex", "text", "framed" };
+static const char *sniff_policy_names[] = { "drop_oldest", "disconnect", "block" };
+
+static int find_name(const char *value, const char *const *names, int count, int fallback) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0) return i;
+    }
+    return fallback;
+}
+
+void set_config_file_path(const char *path) {
+    config_file_override = path;
+}
 
 char* get_config_file_path(void) {
+    if (config_file_override) {
+        return strdup(config_file_override);
+    }
+
     const char *home = getenv("HOME");
     if (!home) {
         home = "/tmp";
@@ -21,9 +45,28 @@ void init_default_settings(BridgeApp *app) {
     // Initialize default settings
     strncpy(app->device1_path, DEFAULT_DEVICE1, MAX_PATH_LENGTH - 1);
     strncpy(app->device2_path, DEFAULT_DEVICE2, MAX_PATH_LENGTH - 1);
+    app->pair_count = 1;
+    for (int i = 0; i < MAX_BRIDGE_PAIRS; i++) {
+        app->pair_sniff[i] = TRUE;
+        app->pair_line[i] = (LineEmulation){ .baud = 0, .data_bits = 8, .parity = 'N', .stop_bits = 1 };
+        memset(app->pair_impair[i], 0, sizeof(app->pair_impair[i]));
+    }
+    app->impair_seed = 1;
+    strncpy(app->stats_socket_path, DEFAULT_STATS_SOCKET, MAX_PATH_LENGTH - 1);
+
+    app->mode = BRIDGE_MODE_NULL_MODEM;
+    strncpy(app->mux_port_path, DEFAULT_MUX_PORT, MAX_PATH_LENGTH - 1);
+    app->mux_baud = DEFAULT_MUX_BAUD;
+    app->mux_data_bits = 8;
+    app->mux_parity = 'N';
+    app->mux_stop_bits = 1;
+    app->mux_flow = MUX_FLOW_NONE;
+    app->mux_clients = 2;
+    app->mux_policy = MUX_POLICY_FIFO;
     
     app->auto_start = FALSE;
     app->verbose_logging = FALSE;
+    app->restart_budget = DEFAULT_RESTART_BUDGET;
     app->device_permissions = g_strdup("666");
 
     // Appearance settings (following LAST pattern)
@@ -44,8 +87,12 @@ void load_settings(BridgeApp *app) {
     FILE *file = fopen(config_path, "r");
     
     if (!file) {
+        // Defaults without a config file; one that exists but cannot be read is worth a word
+        if (errno != ENOENT) {
+            log_message(app, "WARNING: Cannot read %s: %s, using defaults", config_path, strerror(errno));
+        }
         free(config_path);
-        return; // Use defaults if no config file
+        return;
     }
     
     char line[512];
@@ -61,13 +108,126 @@ void load_settings(BridgeApp *app) {
                 strncpy(app->device1_path, value, MAX_PATH_LENGTH - 1);
             } else if (strcmp(key, "device2_path") == 0) {
                 strncpy(app->device2_path, value, MAX_PATH_LENGTH - 1);
+            } else if (strcmp(key, "pair_count") == 0) {
+                app->pair_count = CLAMP(atoi(value), 1, MAX_BRIDGE_PAIRS);
+            }
+            // Line emulation: line_N=baud,8N1,gap_us,device_buffer
+            else if (strncmp(key, "line_", 5) == 0) {
+                int pair = atoi(key + 5);
+                LineEmulation line = { 0 };
+                if (pair >= 0 && pair < MAX_BRIDGE_PAIRS &&
+                    sscanf(value, "%d,%1d%c%1d,%u,%u", &line.baud, &line.data_bits, &line.parity,
+                           &line.stop_bits, &line.gap_us, &line.device_buffer) == 6) {
+                    line.data_bits = CLAMP(line.data_bits, 5, 8);
+                    line.parity = (line.parity == 'E' || line.parity == 'O') ? line.parity : 'N';
+                    line.stop_bits = line.stop_bits == 2 ? 2 : 1;
+                    app->pair_line[pair] = line;
+                }
+            }
+            // Impairments: impair_N_D=latency,jitter,distribution,drop,ber,outage_every,outage,rate
+            else if (strcmp(key, "impair_seed") == 0) {
+                app->impair_seed = (unsigned int)strtoul(value, NULL, 10);
+            } else if (strncmp(key, "impair_", 7) == 0) {
+                int pair, direction, distribution;
+                LinkImpairment config = { 0 };
+                if (sscanf(key + 7, "%d_%d", &pair, &direction) == 2 &&
+                    pair >= 0 && pair < MAX_BRIDGE_PAIRS && (direction == 0 || direction == 1) &&
+                    sscanf(value, "%u,%u,%d,%lf,%lf,%u,%u,%u", &config.latency_ms, &config.jitter_ms,
+                           &distribution, &config.drop_rate, &config.bit_error_rate,
+                           &config.outage_interval_ms, &config.outage_ms, &config.rate_limit) == 8) {
+                    config.jitter_dist = (ImpairJitter)CLAMP(distribution, 0, IMPAIR_JITTER_EXPONENTIAL);
+                    config.drop_rate = CLAMP(config.drop_rate, 0.0, 1.0);
+                    config.bit_error_rate = CLAMP(config.bit_error_rate, 0.0, 1.0);
+                    app->pair_impair[pair][direction] = config;
+                }
+            }
+            // Multiplexer settings
+            else if (strcmp(key, "mode") == 0) {
+                app->mode = strcmp(value, "multiplexer") == 0 ? BRIDGE_MODE_MULTIPLEXER
+                                                              : BRIDGE_MODE_NULL_MODEM;
+            } else if (strcmp(key, "mux_port") == 0) {
+                strncpy(app->mux_port_path, value, MAX_PATH_LENGTH - 1);
+            } else if (strcmp(key, "mux_baud") == 0) {
+                app->mux_baud = atoi(value);
+            } else if (strcmp(key, "mux_data_bits") == 0) {
+                app->mux_data_bits = CLAMP(atoi(value), 5, 8);
+            } else if (strcmp(key, "mux_parity") == 0) {
+                app->mux_parity = (value[0] == 'E' || value[0] == 'O') ? value[0] : 'N';
+            } else if (strcmp(key, "mux_stop_bits") == 0) {
+                app->mux_stop_bits = atoi(value) == 2 ? 2 : 1;
+            } else if (strcmp(key, "mux_flow") == 0) {
+                if (strcmp(value, "hardware") == 0) app->mux_flow = MUX_FLOW_HARDWARE;
+                else if (strcmp(value, "software") == 0) app->mux_flow = MUX_FLOW_SOFTWARE;
+                else app->mux_flow = MUX_FLOW_NONE;
+            } else if (strcmp(key, "mux_clients") == 0) {
+                app->mux_clients = CLAMP(atoi(value), 1, MAX_BRIDGE_PAIRS);
+            } else if (strcmp(key, "mux_policy") == 0) {
+                if (strcmp(value, "priority") == 0) app->mux_policy = MUX_POLICY_PRIORITY;
+                else if (strcmp(value, "exclusive") == 0) app->mux_policy = MUX_POLICY_EXCLUSIVE;
+                else app->mux_policy = MUX_POLICY_FIFO;
             } else if (strcmp(key, "auto_start") == 0) {
                 app->auto_start = (strcmp(value, "true") == 0);
             } else if (strcmp(key, "verbose_logging") == 0) {
                 app->verbose_logging = (strcmp(value, "true") == 0);
+            } else if (strcmp(key, "restart_budget") == 0) {
+                app->restart_budget = CLAMP(atoi(value), 0, 1000);
             } else if (strcmp(key, "device_permissions") == 0) {
                 if (app->device_permissions) g_free(app->device_permissions);
                 app->device_permissions = g_strdup(value);
+            } else if (strcmp(key, "metrics_port") == 0) {
+                app->metrics_port = CLAMP(atoi(value), 0, 65535);
+            } else if (strcmp(key, "stats_socket") == 0) {
+                if (strcmp(value, "none") == 0) app->stats_socket_path[0] = '\0';
+                else strncpy(app->stats_socket_path, value, MAX_PATH_LENGTH - 1);
+            }
+            // Sniffing: sniff_outputs=pipe,tcp,udp,file,pcapng or none
+            else if (strcmp(key, "sniffing_enabled") == 0) {
+                app->sniffing_enabled = (strcmp(value, "true") == 0);
+            } else if (strcmp(key, "sniff_outputs") == 0) {
+                app->sniff_output_methods = SNIFF_OUTPUT_NONE;
+                if (strstr(value, "pipe")) app->sniff_output_methods |= SNIFF_OUTPUT_PIPE;
+                if (strstr(value, "tcp")) app->sniff_output_methods |= SNIFF_OUTPUT_TCP;
+                if (strstr(value, "udp")) app->sniff_output_methods |= SNIFF_OUTPUT_UDP;
+                if (strstr(value, "file")) app->sniff_output_methods |= SNIFF_OUTPUT_FILE;
+                if (strstr(value, "pcapng")) app->sniff_output_methods |= SNIFF_OUTPUT_PCAPNG;
+            } else if (strcmp(key, "sniff_direction") == 0) {
+                app->sniff_direction = (SniffDirection)find_name(value, sniff_direction_names, 3,
+                                                                 SNIFF_DIRECTION_BOTH);
+            } else if (strcmp(key, "sniff_format") == 0) {
+                app->sniff_format = (SniffFormat)find_name(value, sniff_format_names, 4, SNIFF_FORMAT_HEX);
+            } else if (strcmp(key, "sniff_policy") == 0) {
+                app->sniff_slow_policy = (SniffSlowPolicy)find_name(value, sniff_policy_names, 3,
+                                                                    SNIFF_POLICY_DROP_OLDEST);
+            } else if (strcmp(key, "sniff_pipe") == 0) {
+                strncpy(app->sniff_pipe_path, value, MAX_PATH_LENGTH - 1);
+            } else if (strcmp(key, "sniff_tcp_port") == 0) {
+                app->sniff_tcp_port = CLAMP(atoi(value), 1, 65535);
+            } else if (strcmp(key, "sniff_udp_addr") == 0) {
+                strncpy(app->sniff_udp_addr, value, sizeof(app->sniff_udp_addr) - 1);
+            } else if (strcmp(key, "sniff_udp_port") == 0) {
+                app->sniff_udp_port = CLAMP(atoi(value), 1, 65535);
+            } else if (strcmp(key, "sniff_udp_ttl") == 0) {
+                app->sniff_udp_ttl = atoi(value) > 0 ? atoi(value) : DEFAULT_SNIFF_UDP_TTL;
+            } else if (strcmp(key, "sniff_udp_iface") == 0) {
+                strncpy(app->sniff_udp_iface, value, sizeof(app->sniff_udp_iface) - 1);
+            } else if (strcmp(key, "sniff_log_file") == 0) {
+                strncpy(app->sniff_log_file, value, MAX_PATH_LENGTH - 1);
+            } else if (strcmp(key, "sniff_file_gzip") == 0) {
+                app->sniff_file_gzip = (strcmp(value, "true") == 0);
+            } else if (strcmp(key, "sniff_file_rotate_mb") == 0) {
+                app->sniff_file_rotate_mb = atoi(value) > 0 ? atoi(value) : 0;
+            } else if (strcmp(key, "sniff_file_rotate_seconds") == 0) {
+                app->sniff_file_rotate_seconds = atoi(value) > 0 ? atoi(value) : 0;
+            } else if (strcmp(key, "sniff_file_keep") == 0) {
+                app->sniff_file_keep = atoi(value) > 0 ? atoi(value) : 0;
+            } else if (strcmp(key, "sniff_pcap") == 0) {
+                strncpy(app->sniff_pcap_path, value, MAX_PATH_LENGTH - 1);
+            } else if (strcmp(key, "sniff_pcap_live") == 0) {
+                app->sniff_pcap_live = (strcmp(value, "true") == 0);
+            } else if (strcmp(key, "sniff_pcap_rotate_mb") == 0) {
+                app->sniff_pcap_rotate_mb = atoi(value) > 0 ? atoi(value) : 0;
+            } else if (strcmp(key, "sniff_pcap_rotate_seconds") == 0) {
+                app->sniff_pcap_rotate_seconds = atoi(value) > 0 ? atoi(value) : 0;
             }
             // Appearance settings
             else if (strcmp(key, "theme") == 0) {
@@ -84,6 +244,8 @@ void load_settings(BridgeApp *app) {
             } else if (strcmp(key, "text_color") == 0) {
                 if (app->text_color) g_free(app->text_color);
                 app->text_color = g_strdup(value);
+            } else {
+                log_message(app, "WARNING: Unknown setting %s in %s, ignored", key, config_path);
             }
         }
     }
@@ -117,13 +279,91 @@ void save_settings(BridgeApp *app) {
     fprintf(file, "[Device]\n");
     fprintf(file, "device1_path=%s\n", app->device1_path);
     fprintf(file, "device2_path=%s\n", app->device2_path);
+    fprintf(file, "pair_count=%d\n", app->pair_count);
     fprintf(file, "device_permissions=%s\n", app->device_permissions ? app->device_permissions : "666");
+    fprintf(file, "metrics_port=%d\n", app->metrics_port);
+    fprintf(file, "stats_socket=%s\n", app->stats_socket_path[0] ? app->stats_socket_path : "none");
+    fprintf(file, "mode=%s\n", app->mode == BRIDGE_MODE_MULTIPLEXER ? "multiplexer" : "null_modem");
+    fprintf(file, "\n");
+
+    // Line emulation, only for the pairs that have it
+    fprintf(file, "[Line Emulation]\n");
+    for (int i = 0; i < MAX_BRIDGE_PAIRS; i++) {
+        const LineEmulation *line = &app->pair_line[i];
+        if (line->baud > 0) {
+            fprintf(file, "line_%d=%d,%d%c%d,%u,%u\n", i, line->baud, line->data_bits, line->parity,
+                    line->stop_bits, line->gap_us, line->device_buffer);
+        }
+    }
+    fprintf(file, "\n");
+
+    // Impairments, only for the directions that have any
+    fprintf(file, "[Impairments]\n");
+    fprintf(file, "impair_seed=%u\n", app->impair_seed);
+    for (int i = 0; i < MAX_BRIDGE_PAIRS; i++) {
+        for (int d = 0; d < 2; d++) {
+            const LinkImpairment *config = &app->pair_impair[i][d];
+            if (impair_is_active(config)) {
+                fprintf(file, "impair_%d_%d=%u,%u,%d,%g,%g,%u,%u,%u\n", i, d, config->latency_ms,
+                        config->jitter_ms, (int)config->jitter_dist, config->drop_rate,
+                        config->bit_error_rate, config->outage_interval_ms, config->outage_ms,
+                        config->rate_limit);
+            }
+        }
+    }
+    fprintf(file, "\n");
+
+    // Multiplexer settings
+    static const char *flow_names[] = { "none", "hardware", "software" };
+    static const char *policy_names[] = { "fifo", "priority", "exclusive" };
+    fprintf(file, "[Multiplexer]\n");
+    fprintf(file, "mux_port=%s\n", app->mux_port_path);
+    fprintf(file, "mux_baud=%d\n", app->mux_baud);
+    fprintf(file, "mux_data_bits=%d\n", app->mux_data_bits);
+    fprintf(file, "mux_parity=%c\n", app->mux_parity);
+    fprintf(file, "mux_stop_bits=%d\n", app->mux_stop_bits);
+    fprintf(file, "mux_flow=%s\n", flow_names[app->mux_flow]);
+    fprintf(file, "mux_clients=%d\n", app->mux_clients);
+    fprintf(file, "mux_policy=%s\n", policy_names[app->mux_policy]);
+    fprintf(file, "\n");
+
+    // Sniffing; empty paths are left out and mean auto-generated
+    fprintf(file, "[Sniffing]\n");
+    fprintf(file, "sniffing_enabled=%s\n", app->sniffing_enabled ? "true" : "false");
+    static const char *output_names[] = { "pipe", "tcp", "udp", "file", "pcapng" };
+    char outputs[64] = "";
+    for (int i = 0; i < 5; i++) {
+        if (app->sniff_output_methods & (1 << i)) {
+            if (outputs[0]) strcat(outputs, ",");
+            strcat(outputs, output_names[i]);
+        }
+    }
+    fprintf(file, "sniff_outputs=%s\n", outputs[0] ? outputs : "none");
+    fprintf(file, "sniff_direction=%s\n", sniff_direction_names[app->sniff_direction]);
+    fprintf(file, "sniff_format=%s\n", sniff_format_names[app->sniff_format]);
+    fprintf(file, "sniff_policy=%s\n", sniff_policy_names[app->sniff_slow_policy]);
+    fprintf(file, "sniff_pipe=%s\n", app->sniff_pipe_path);
+    fprintf(file, "sniff_tcp_port=%d\n", app->sniff_tcp_port);
+    fprintf(file, "sniff_udp_addr=%s\n", app->sniff_udp_addr);
+    fprintf(file, "sniff_udp_port=%d\n", app->sniff_udp_port);
+    fprintf(file, "sniff_udp_ttl=%d\n", app->sniff_udp_ttl);
+    if (app->sniff_udp_iface[0]) fprintf(file, "sniff_udp_iface=%s\n", app->sniff_udp_iface);
+    if (app->sniff_log_file[0]) fprintf(file, "sniff_log_file=%s\n", app->sniff_log_file);
+    fprintf(file, "sniff_file_gzip=%s\n", app->sniff_file_gzip ? "true" : "false");
+    fprintf(file, "sniff_file_rotate_mb=%u\n", app->sniff_file_rotate_mb);
+    fprintf(file, "sniff_file_rotate_seconds=%u\n", app->sniff_file_rotate_seconds);
+    fprintf(file, "sniff_file_keep=%u\n", app->sniff_file_keep);
+    if (app->sniff_pcap_path[0]) fprintf(file, "sniff_pcap=%s\n", app->sniff_pcap_path);
+    fprintf(file, "sniff_pcap_live=%s\n", app->sniff_pcap_live ? "true" : "false");
+    fprintf(file, "sniff_pcap_rotate_mb=%u\n", app->sniff_pcap_rotate_mb);
+    fprintf(file, "sniff_pcap_rotate_seconds=%u\n", app->sniff_pcap_rotate_seconds);
     fprintf(file, "\n");
     
     // Application settings
     fprintf(file, "[Application]\n");
     fprintf(file, "auto_start=%s\n", app->auto_start ? "true" : "false");
     fprintf(file, "verbose_logging=%s\n", app->verbose_logging ? "true" : "false");
+    fprintf(file, "restart_budget=%d\n", app->restart_budget);
     fprintf(file, "\n");
     
     fclose(file);
@@ -138,7 +378,73 @@ void apply_loaded_settings(BridgeApp *app) {
     if (app->device2_entry) {
         gtk_entry_set_text(GTK_ENTRY(app->device2_entry), app->device2_path);
     }
+    if (app->pair_count_spin) {
+        gtk_spin_button_set_value(GTK_SPIN_BUTTON(app->pair_count_spin), app->pair_count);
+    }
+
+    // Apply multiplexer settings; the combo IDs are the values as saved
+    if (app->mode_combo) {
+        char id[16];
+        gtk_entry_set_text(GTK_ENTRY(app->mux_port_entry), app->mux_port_path);
+        snprintf(id, sizeof(id), "%d", app->mux_baud);
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->mux_baud_combo), id);
+        snprintf(id, sizeof(id), "%d", app->mux_data_bits);
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->mux_data_bits_combo), id);
+        snprintf(id, sizeof(id), "%c", app->mux_parity);
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->mux_parity_combo), id);
+        snprintf(id, sizeof(id), "%d", app->mux_stop_bits);
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->mux_stop_bits_combo), id);
+        gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_flow_combo), app->mux_flow);
+        gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_policy_combo), app->mux_policy);
+        gtk_spin_button_set_value(GTK_SPIN_BUTTON(app->mux_clients_spin), app->mux_clients);
+        gtk_combo_box_set_active(GTK_COMBO_BOX(app->mode_combo), app->mode);
+    }
+    if (app->line_pair_spin) {
+        show_line_settings(app);
+    }
+    if (app->impair_pair_spin) {
+        show_impairment_settings(app);
+    }
     
+    // Apply sniffing settings; the start button reads them back from here
+    if (app->sniffing_enable_check) {
+        char number[16];
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniffing_enable_check), app->sniffing_enabled);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniff_pipe_check),
+                                     app->sniff_output_methods & SNIFF_OUTPUT_PIPE);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniff_tcp_check),
+                                     app->sniff_output_methods & SNIFF_OUTPUT_TCP);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniff_udp_check),
+                                     app->sniff_output_methods & SNIFF_OUTPUT_UDP);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniff_file_check),
+                                     app->sniff_output_methods & SNIFF_OUTPUT_FILE);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniff_pcap_check),
+                                     app->sniff_output_methods & SNIFF_OUTPUT_PCAPNG);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_pipe_entry), app->sniff_pipe_path);
+        snprintf(number, sizeof(number), "%d", app->sniff_tcp_port);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_tcp_port_entry), number);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_udp_addr_entry), app->sniff_udp_addr);
+        snprintf(number, sizeof(number), "%d", app->sniff_udp_port);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_udp_port_entry), number);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_udp_iface_entry), app->sniff_udp_iface);
+        snprintf(number, sizeof(number), "%d", app->sniff_udp_ttl);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_udp_ttl_entry), number);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_file_entry), app->sniff_log_file);
+        gtk_entry_set_text(GTK_ENTRY(app->sniff_pcap_entry), app->sniff_pcap_path);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->sniff_pcap_live_check), app->sniff_pcap_live);
+        if (app->sniff_pcap_rotate_mb > 0) {
+            snprintf(number, sizeof(number), "%u", app->sniff_pcap_rotate_mb);
+            gtk_entry_set_text(GTK_ENTRY(app->sniff_pcap_size_entry), number);
+        }
+        if (app->sniff_pcap_rotate_seconds > 0) {
+            snprintf(number, sizeof(number), "%u", app->sniff_pcap_rotate_seconds);
+            gtk_entry_set_text(GTK_ENTRY(app->sniff_pcap_time_entry), number);
+        }
+        gtk_combo_box_set_active(GTK_COMBO_BOX(app->sniff_direction_combo), app->sniff_direction);
+        gtk_combo_box_set_active(GTK_COMBO_BOX(app->sniff_format_combo), app->sniff_format);
+        gtk_combo_box_set_active(GTK_COMBO_BOX(app->sniff_policy_combo), app->sniff_slow_policy);
+    }
+
     // Apply checkboxes
     if (app->auto_start_check) {
         gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(app->auto_start_check), app->auto_start);
@@ -14,6 +14,7 @@ void save_settings(BridgeApp *app);
 void apply_appearance_settings(BridgeApp *app);
 void apply_loaded_settings(BridgeApp *app);
 char* get_config_file_path(void);
+void set_config_file_path(const char *path);
 void init_default_settings(BridgeApp *app);
 
 #endif // SETTINGS_H
@@ -0,0 +1,482 @@
+/*
+ * Sniff log file writer for BRIDGE - Virtual Null Modem Bridge
+ * The file consumer's thread formats packets into a buffer and hands full or
+ * idle buffers to the writer thread, which gzip compresses them if asked and
+ * writes them out. Rotated files are written as name.part and renamed once
+ * complete, so anything without the suffix can be read, copied or removed.
+ * Every file gets a name.idx time index (layout in sniff_protocol.h); in a
+ * gzip file each indexed point is a full flush, so a reader can start there.
+ */
+
+#include "sniff_file.h"
+#include "relay.h"
+#include "utils.h"
+
+#define STAT_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define STAT_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+
+static gboolean rotating(SniffFileWriter *writer) {
+    return writer->max_file_bytes || writer->max_file_seconds;
+}
+
+// Writer thread side
+
+static gboolean write_all(SniffFileWriter *writer, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(writer->fd, data, len);
+        if (written > 0) {
+            data += written;
+            len -= written;
+            writer->file_out += written;
+            STAT_ADD(&writer->bytes_out, (uint64_t)written);
+        } else if (written < 0 && errno != EINTR) {
+            STAT_ADD(&writer->write_errors, 1);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Runs the compressor until it has taken all the input and, for a sync or
+// finish, emitted everything it holds
+static void deflate_out(SniffFileWriter *writer, const char *data, size_t len, int flush) {
+    writer->stream.next_in = (Bytef *)data;
+    writer->stream.avail_in = (uInt)len;
+    do {
+        writer->stream.next_out = writer->compressed;
+        writer->stream.avail_out = SNIFF_FILE_BUFFER_SIZE;
+        deflate(&writer->stream, flush);
+        size_t produced = SNIFF_FILE_BUFFER_SIZE - writer->stream.avail_out;
+        if (produced > 0) write_all(writer, writer->compressed, produced);
+    } while (writer->stream.avail_out == 0);
+}
+
+static gboolean write_index(SniffFileWriter *writer, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(writer->index_fd, data, len);
+        if (written > 0) {
+            data += written;
+            len -= written;
+        } else if (written < 0 && errno != EINTR) {
+            STAT_ADD(&writer->write_errors, 1);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// A missing index only costs seeking, so failing to write one is not fatal
+static void open_index(SniffFileWriter *writer) {
+    unsigned char header[SNIFF_INDEX_HEADER_SIZE];
+
+    snprintf(writer->index_path, sizeof(writer->index_path), "%s%s%s", writer->final_path,
+             SNIFF_INDEX_SUFFIX, rotating(writer) ? SNIFF_FILE_PART_SUFFIX : "");
+    writer->index_fd = open(writer->index_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->index_fd < 0) {
+        log_message(writer->app, "Failed to open index %s: %s", writer->index_path, strerror(errno));
+        STAT_ADD(&writer->write_errors, 1);
+        return;
+    }
+
+    sniff_index_encode_header(header, writer->gzip ? SNIFF_INDEX_GZIP : 0);
+    write_index(writer, header, sizeof(header));
+    writer->index_written_ns = 0;
+}
+
+// Records where the block about to be written starts. Entries never go back in
+// time, so after the clock is stepped back indexing resumes once it catches up.
+static void add_index_entry(SniffFileWriter *writer, uint64_t timestamp_ns) {
+    if (writer->index_fd < 0 || timestamp_ns < writer->index_written_ns) return;
+
+    // Drops the compressor's history, so inflate needs nothing from before here;
+    // at the start of a file this also puts the gzip header behind us
+    if (writer->stream_active) {
+        deflate_out(writer, NULL, 0, Z_FULL_FLUSH);
+    }
+
+    SniffIndexEntry entry = {
+        .timestamp_ns = timestamp_ns,
+        .offset = writer->file_out,
+        .data_offset = writer->file_in
+    };
+    unsigned char encoded[SNIFF_INDEX_ENTRY_SIZE];
+    sniff_index_encode_entry(encoded, &entry);
+    if (write_index(writer, encoded, sizeof(encoded))) {
+        writer->index_written_ns = timestamp_ns;
+        STAT_ADD(&writer->index_entries, 1);
+    }
+}
+
+static gboolean open_output(SniffFileWriter *writer, const char *path) {
+    snprintf(writer->final_path, sizeof(writer->final_path), "%s", path);
+    snprintf(writer->writing_path, sizeof(writer->writing_path), "%s%s", path,
+             rotating(writer) ? SNIFF_FILE_PART_SUFFIX : "");
+
+    writer->fd = open(writer->writing_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        log_message(writer->app, "Failed to open log file %s: %s", writer->writing_path, strerror(errno));
+        STAT_ADD(&writer->write_errors, 1);
+        return FALSE;
+    }
+    writer->file_in = 0;
+    writer->file_out = 0;
+
+    // windowBits + 16 writes a gzip header and trailer, so gzip -d and zcat read it
+    if (writer->gzip) {
+        memset(&writer->stream, 0, sizeof(writer->stream));
+        if (deflateInit2(&writer->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            log_message(writer->app, "Failed to start gzip compression for %s", writer->writing_path);
+            close(writer->fd);
+            writer->fd = -1;
+            STAT_ADD(&writer->write_errors, 1);
+            return FALSE;
+        }
+        writer->stream_active = TRUE;
+    }
+
+    open_index(writer);
+    STAT_ADD(&writer->files_opened, 1);
+    return TRUE;
+}
+
+// Rotated files beyond the retention count go, oldest first
+static void retain(SniffFileWriter *writer, const char *path) {
+    if (writer->keep == 0) return;
+
+    char *slot = writer->finished[writer->finished_count % writer->keep];
+    if (writer->finished_count >= writer->keep) {
+        char index_path[MAX_PATH_LENGTH + sizeof(SNIFF_INDEX_SUFFIX)];
+        snprintf(index_path, sizeof(index_path), "%s%s", slot, SNIFF_INDEX_SUFFIX);
+        unlink(index_path);
+        if (unlink(slot) == 0) {
+            STAT_ADD(&writer->files_removed, 1);
+        }
+    }
+    snprintf(slot, MAX_PATH_LENGTH, "%s", path);
+    writer->finished_count++;
+}
+
+static void close_output(SniffFileWriter *writer) {
+    if (writer->fd < 0) return;
+
+    if (writer->stream_active) {
+        deflate_out(writer, NULL, 0, Z_FINISH);
+        deflateEnd(&writer->stream);
+        writer->stream_active = FALSE;
+    }
+    close(writer->fd);
+    writer->fd = -1;
+    if (writer->index_fd >= 0) {
+        close(writer->index_fd);
+        writer->index_fd = -1;
+    }
+
+    if (rotating(writer)) {
+        // The index first, so a published file never lacks its finished index
+        char index_final[MAX_PATH_LENGTH + sizeof(SNIFF_INDEX_SUFFIX)];
+        snprintf(index_final, sizeof(index_final), "%s%s", writer->final_path, SNIFF_INDEX_SUFFIX);
+        rename(writer->index_path, index_final);
+        if (rename(writer->writing_path, writer->final_path) != 0) {
+            log_message(writer->app, "Failed to rename %s: %s", writer->writing_path, strerror(errno));
+            return;
+        }
+        retain(writer, writer->final_path);
+    }
+}
+
+static void process_block(SniffFileWriter *writer, SniffFileBlock *block) {
+    switch (block->command) {
+        case SNIFF_FILE_DATA:
+            // Data for a file that failed to open is lost, up to the next rotation
+            if (writer->fd < 0) break;
+            if (block->index_ns) add_index_entry(writer, block->index_ns);
+            writer->file_in += block->length;
+            STAT_ADD(&writer->bytes_in, (uint64_t)block->length);
+            if (writer->stream_active) {
+                deflate_out(writer, block->data, block->length, block->sync ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            } else {
+                write_all(writer, (const unsigned char *)block->data, block->length);
+            }
+            break;
+        case SNIFF_FILE_OPEN:
+            open_output(writer, block->path);
+            break;
+        case SNIFF_FILE_CLOSE:
+            close_output(writer);
+            break;
+    }
+}
+
+static void* writer_thread_func(void *data) {
+    SniffFileWriter *writer = (SniffFileWriter *)data;
+
+    for (;;) {
+        pthread_mutex_lock(&writer->mutex);
+        while (writer->queue_count == 0 && !writer->stopping) {
+            pthread_cond_wait(&writer->ready_cond, &writer->mutex);
+        }
+        if (writer->queue_count == 0) {
+            pthread_mutex_unlock(&writer->mutex);
+            break;
+        }
+        SniffFileBlock *block = &writer->queue[writer->queue_head];
+        pthread_mutex_unlock(&writer->mutex);
+
+        // The consumer leaves queued blocks alone, so this needs no lock
+        uint64_t started = relay_now_ns();
+        process_block(writer, block);
+        STAT_ADD(&writer->busy_ns, relay_now_ns() - started);
+
+        pthread_mutex_lock(&writer->mutex);
+        if (block->data) {
+            writer->free_buffers[writer->free_count++] = block->data;
+            block->data = NULL;
+        }
+        writer->queue_head = (writer->queue_head + 1) % SNIFF_FILE_QUEUE_BLOCKS;
+        writer->queue_count--;
+        pthread_cond_signal(&writer->space_cond);
+        pthread_mutex_unlock(&writer->mutex);
+    }
+
+    close_output(writer);
+    return NULL;
+}
+
+// Consumer thread side
+
+// Waits while the writer thread is SNIFF_FILE_QUEUE_BLOCKS behind
+static void enqueue(SniffFileWriter *writer, SniffFileCommand command, gboolean sync, const char *path) {
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->queue_count == SNIFF_FILE_QUEUE_BLOCKS) {
+        pthread_cond_wait(&writer->space_cond, &writer->mutex);
+    }
+
+    SniffFileBlock *block = &writer->queue[(writer->queue_head + writer->queue_count) % SNIFF_FILE_QUEUE_BLOCKS];
+    block->command = command;
+    block->sync = sync;
+    block->index_ns = 0;
+    block->data = NULL;
+    block->length = 0;
+    if (path) snprintf(block->path, sizeof(block->path), "%s", path);
+
+    // One more buffer than queue slots, so a free one is always left for the consumer
+    if (command == SNIFF_FILE_DATA) {
+        block->data = writer->buffer;
+        block->length = writer->length;
+        block->index_ns = writer->index_ns;
+        writer->index_ns = 0;
+        writer->buffer = writer->free_buffers[--writer->free_count];
+        writer->length = 0;
+    }
+
+    writer->queue_count++;
+    pthread_cond_signal(&writer->ready_cond);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+static void hand_over(SniffFileWriter *writer, gboolean sync) {
+    if (writer->length == 0 && !(sync && writer->buffered_since_ns)) return;
+    enqueue(writer, SNIFF_FILE_DATA, sync, NULL);
+    if (sync) writer->buffered_since_ns = 0;
+}
+
+// Rotated files are named like the pcapng ones: base_00001_YYYYmmddHHMMSS.ext
+static void next_path(SniffFileWriter *writer, time_t now, char *buffer, size_t buffer_size) {
+    const char *suffix = writer->gzip ? ".gz" : "";
+    size_t path_len = strlen(writer->path);
+
+    if (!rotating(writer)) {
+        gboolean has_gz = path_len > 3 && strcmp(writer->path + path_len - 3, ".gz") == 0;
+        snprintf(buffer, buffer_size, "%s%s", writer->path, has_gz ? "" : suffix);
+        return;
+    }
+
+    const char *slash = strrchr(writer->path, '/');
+    const char *dot = strrchr(slash ? slash : writer->path, '.');
+    int stem_len = dot ? (int)(dot - writer->path) : (int)path_len;
+    char stamp[32];
+    struct tm tm_info;
+
+    localtime_r(&now, &tm_info);
+    strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &tm_info);
+    snprintf(buffer, buffer_size, "%.*s_%05u_%s%s%s", stem_len, writer->path,
+             writer->file_index, stamp, dot ? dot : ".log", suffix);
+}
+
+static void begin_file(SniffFileWriter *writer, time_t now) {
+    writer->file_index++;
+    next_path(writer, now, writer->current_path, sizeof(writer->current_path));
+    writer->file_start = now;
+    writer->file_bytes = 0;
+    writer->file_packets = 0;
+}
+
+// An index point every SNIFF_INDEX_RECORDS records or SNIFF_INDEX_INTERVAL_MS,
+// and always at the first record of a file
+static gboolean index_due(SniffFileWriter *writer, uint64_t timestamp_ns) {
+    if (writer->file_packets == 0) return TRUE;
+    if (writer->index_records >= SNIFF_INDEX_RECORDS) return TRUE;
+    return timestamp_ns >= writer->last_index_ns + SNIFF_INDEX_INTERVAL_MS * 1000000ULL;
+}
+
+// Checked before each packet, so a file always holds at least one
+static gboolean rotation_due(SniffFileWriter *writer, const SniffPacket *packet, size_t length) {
+    if (writer->file_packets == 0) return FALSE;
+    if (writer->max_file_bytes && writer->file_bytes + length > writer->max_file_bytes) return TRUE;
+    if (writer->max_file_seconds &&
+        packet->timestamp.tv_sec - writer->file_start >= (time_t)writer->max_file_seconds) return TRUE;
+    return FALSE;
+}
+
+SniffFileWriter* sniff_file_writer_new(BridgeApp *app, const char *path, gboolean gzip,
+                                       unsigned int max_file_mb, unsigned int max_file_seconds,
+                                       unsigned int keep) {
+    SniffFileWriter *writer = calloc(1, sizeof(SniffFileWriter));
+    if (!writer) return NULL;
+
+    writer->app = app;
+    writer->fd = -1;
+    writer->index_fd = -1;
+    writer->gzip = gzip;
+    strncpy(writer->path, path, MAX_PATH_LENGTH - 1);
+    writer->max_file_bytes = (uint64_t)max_file_mb * 1024 * 1024;
+    writer->max_file_seconds = max_file_seconds;
+    writer->keep = rotating(writer) ? keep : 0;
+    writer->start_ns = relay_now_ns();
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->ready_cond, NULL);
+    pthread_cond_init(&writer->space_cond, NULL);
+
+    gboolean allocated = (writer->buffer = malloc(SNIFF_FILE_BUFFER_SIZE)) != NULL;
+    for (int i = 0; i < SNIFF_FILE_QUEUE_BLOCKS && allocated; i++) {
+        allocated = (writer->free_buffers[i] = malloc(SNIFF_FILE_BUFFER_SIZE)) != NULL;
+        if (allocated) writer->free_count++;
+    }
+    if (allocated && gzip) allocated = (writer->compressed = malloc(SNIFF_FILE_BUFFER_SIZE)) != NULL;
+    if (allocated && writer->keep) allocated = (writer->finished = calloc(writer->keep, MAX_PATH_LENGTH)) != NULL;
+    if (!allocated) {
+        sniff_file_writer_free(writer);
+        return NULL;
+    }
+
+    // The first file is opened here so a bad path fails the sniff start
+    begin_file(writer, time(NULL));
+    if (!open_output(writer, writer->current_path)) {
+        sniff_file_writer_free(writer);
+        return NULL;
+    }
+
+    if (pthread_create(&writer->thread, NULL, writer_thread_func, writer) != 0) {
+        log_message(app, "Failed to start log file writer: %s", strerror(errno));
+        sniff_file_writer_free(writer);
+        return NULL;
+    }
+    writer->thread_started = TRUE;
+    return writer;
+}
+
+// Called once the file consumer has stopped
+void sniff_file_writer_free(SniffFileWriter *writer) {
+    if (!writer) return;
+
+    if (writer->thread_started) {
+        hand_over(writer, TRUE);
+        pthread_mutex_lock(&writer->mutex);
+        writer->stopping = TRUE;
+        pthread_cond_signal(&writer->ready_cond);
+        pthread_mutex_unlock(&writer->mutex);
+        pthread_join(writer->thread, NULL);
+    } else {
+        close_output(writer);
+    }
+
+    free(writer->buffer);
+    for (int i = 0; i < writer->free_count; i++) {
+        free(writer->free_buffers[i]);
+    }
+    free(writer->compressed);
+    free(writer->finished);
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->ready_cond);
+    pthread_cond_destroy(&writer->space_cond);
+    free(writer);
+}
+
+gboolean sniff_file_append(SniffFileWriter *writer, const SniffPacket *packet,
+                           const char *data, size_t length) {
+    if (rotation_due(writer, packet, length)) {
+        hand_over(writer, FALSE);
+        enqueue(writer, SNIFF_FILE_CLOSE, FALSE, NULL);
+        begin_file(writer, packet->timestamp.tv_sec);
+        enqueue(writer, SNIFF_FILE_OPEN, FALSE, writer->current_path);
+        writer->buffered_since_ns = 0;
+        log_message(writer->app, "Sniff log continues in %s", writer->current_path);
+    }
+
+    // The indexed record has to start a block of its own
+    uint64_t timestamp_ns = (uint64_t)packet->timestamp.tv_sec * 1000000000ULL + packet->timestamp.tv_nsec;
+    if (index_due(writer, timestamp_ns)) {
+        hand_over(writer, FALSE);
+        writer->index_ns = timestamp_ns;
+        writer->last_index_ns = timestamp_ns;
+        writer->index_records = 0;
+    }
+    writer->index_records++;
+
+    if (writer->buffered_since_ns == 0) {
+        writer->buffered_since_ns = relay_now_ns();
+    }
+    writer->file_bytes += length;
+    writer->file_packets++;
+    writer->packets_written++;
+
+    // Larger packets than the buffer go through in several pieces
+    while (length > 0) {
+        if (writer->length == SNIFF_FILE_BUFFER_SIZE) {
+            hand_over(writer, FALSE);
+        }
+        size_t chunk = MIN(length, SNIFF_FILE_BUFFER_SIZE - writer->length);
+        memcpy(writer->buffer + writer->length, data, chunk);
+        writer->length += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return TRUE;
+}
+
+// Called whenever the output has caught up with the capture; bounds how long
+// data waits before it is on disk and, compressed, readable with zcat
+void sniff_file_idle(SniffFileWriter *writer) {
+    if (writer->buffered_since_ns &&
+        relay_now_ns() - writer->buffered_since_ns >= SNIFF_FILE_FLUSH_MS * 1000000ULL) {
+        hand_over(writer, TRUE);
+    }
+}
+
+void sniff_file_format_stats(SniffFileWriter *writer, char *buffer, size_t buffer_size) {
+    double in_mb = STAT_LOAD(&writer->bytes_in) / (1024.0 * 1024.0);
+    double out_mb = STAT_LOAD(&writer->bytes_out) / (1024.0 * 1024.0);
+    double elapsed = (relay_now_ns() - writer->start_ns) / 1e9;
+    uint64_t busy_ns = STAT_LOAD(&writer->busy_ns);
+    unsigned long files = STAT_LOAD(&writer->files_opened);
+    unsigned long removed = STAT_LOAD(&writer->files_removed);
+    unsigned long entries = STAT_LOAD(&writer->index_entries);
+    char compression[64] = "";
+    char retention[48] = "";
+
+    if (writer->gzip) {
+        snprintf(compression, sizeof(compression), " → %.1f MB gzip (%.1f:1)", out_mb,
+                 out_mb > 0 ? in_mb / out_mb : 0.0);
+    }
+    if (removed > 0) {
+        snprintf(retention, sizeof(retention), ", %lu removed", removed);
+    }
+    snprintf(buffer, buffer_size,
+             "File: %lu packets in %lu file%s%s, %.1f MB%s, %.2f MB/s, writer %.0f MB/s, "
+             "%lu index entr%s, %lu write errors",
+             writer->packets_written, files, files == 1 ? "" : "s", retention, in_mb, compression,
+             elapsed > 0 ? in_mb / elapsed : 0.0, busy_ns > 0 ? in_mb / (busy_ns / 1e9) : 0.0,
+             entries, entries == 1 ? "y" : "ies",
+             STAT_LOAD(&writer->write_errors));
+}
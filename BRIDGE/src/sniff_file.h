@@ -0,0 +1,114 @@
+/*
+ * Sniff log file writer header for BRIDGE - Virtual Null Modem Bridge
+ * Writes the formatted capture to a file, or to rotating files with a retention
+ * count, optionally gzip compressed, each with a time index next to it. The
+ * file sniff consumer only fills buffers; a writer thread of its own
+ * compresses and writes them.
+ */
+
+#ifndef SNIFF_FILE_H
+#define SNIFF_FILE_H
+
+#include "common.h"
+#include "sniffing.h"
+#include "sniff_protocol.h"
+#include <stdint.h>
+#include <zlib.h>
+
+// Formatted packets are collected here and handed over in one go
+#define SNIFF_FILE_BUFFER_SIZE (256 * 1024)
+// Buffers waiting for the writer thread before the consumer has to wait
+#define SNIFF_FILE_QUEUE_BLOCKS 8
+// Longest captured data stays buffered while no new packets arrive
+#define SNIFF_FILE_FLUSH_MS 1000
+// A rotated file carries this suffix until it is complete
+#define SNIFF_FILE_PART_SUFFIX ".part"
+
+struct SniffConsumer;
+
+typedef enum {
+    SNIFF_FILE_DATA,            // Write data; sync also flushes the compressor
+    SNIFF_FILE_OPEN,            // Start path
+    SNIFF_FILE_CLOSE            // Finish the current file and publish it
+} SniffFileCommand;
+
+typedef struct {
+    SniffFileCommand command;
+    char *data;
+    size_t length;
+    gboolean sync;
+    uint64_t index_ns;          // Non-zero: data starts with a record to index at this capture time
+    char path[MAX_PATH_LENGTH];
+} SniffFileBlock;
+
+typedef struct SniffFileWriter {
+    char path[MAX_PATH_LENGTH]; // As configured; the base name when rotating
+    char current_path[MAX_PATH_LENGTH]; // Name the current file will have once complete
+    gboolean gzip;
+    uint64_t max_file_bytes;    // Start a new file beyond this much uncompressed data; 0 for no limit
+    unsigned int max_file_seconds; // Start a new file after this long; 0 for no limit
+    unsigned int keep;          // Rotated files kept, oldest removed first; 0 keeps all
+
+    // Consumer thread
+    char *buffer;
+    size_t length;
+    uint64_t buffered_since_ns;
+    uint64_t file_bytes;
+    time_t file_start;
+    unsigned long file_packets;
+    unsigned int file_index;
+    unsigned long packets_written;
+    uint64_t index_ns;          // Index point for the next block handed over
+    uint64_t last_index_ns;
+    unsigned long index_records; // Records since the last index point
+
+    // Hand-off to the writer thread
+    SniffFileBlock queue[SNIFF_FILE_QUEUE_BLOCKS];
+    int queue_head;
+    int queue_count;
+    char *free_buffers[SNIFF_FILE_QUEUE_BLOCKS];
+    int free_count;
+    gboolean stopping;
+    pthread_mutex_t mutex;
+    pthread_cond_t ready_cond;  // Signalled when a block is queued or on stop
+    pthread_cond_t space_cond;  // Signalled when a block is done
+    pthread_t thread;
+    gboolean thread_started;
+
+    // Writer thread
+    int fd;
+    char writing_path[MAX_PATH_LENGTH + sizeof(SNIFF_FILE_PART_SUFFIX)];
+    char final_path[MAX_PATH_LENGTH];
+    int index_fd;
+    char index_path[MAX_PATH_LENGTH + sizeof(SNIFF_INDEX_SUFFIX SNIFF_FILE_PART_SUFFIX)];
+    uint64_t file_in;           // Uncompressed bytes in the current file
+    uint64_t file_out;          // Bytes written to the current file
+    uint64_t index_written_ns;  // Newest entry in the current index
+    z_stream stream;
+    gboolean stream_active;
+    unsigned char *compressed;
+    char (*finished)[MAX_PATH_LENGTH]; // Ring of the last keep rotated files
+    unsigned int finished_count;
+
+    // Statistics, written by the writer thread
+    uint64_t start_ns;
+    uint64_t bytes_in;          // Formatted capture
+    uint64_t bytes_out;         // Written to disk
+    uint64_t busy_ns;           // Writer thread time spent compressing and writing
+    unsigned long files_opened;
+    unsigned long files_removed;
+    unsigned long index_entries;
+    unsigned long write_errors;
+    BridgeApp *app;
+} SniffFileWriter;
+
+SniffFileWriter* sniff_file_writer_new(BridgeApp *app, const char *path, gboolean gzip,
+                                       unsigned int max_file_mb, unsigned int max_file_seconds,
+                                       unsigned int keep);
+void sniff_file_writer_free(SniffFileWriter *writer);
+gboolean sniff_file_append(SniffFileWriter *writer, const SniffPacket *packet,
+                           const char *data, size_t length);
+void sniff_file_idle(SniffFileWriter *writer);
+void sniff_file_format_stats(SniffFileWriter *writer, char *buffer, size_t buffer_size);
+
+#endif // SNIFF_FILE_H
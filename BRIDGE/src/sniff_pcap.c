@@ -0,0 +1,364 @@
+/*
+ * Sniff pcapng writer for BRIDGE - Virtual Null Modem Bridge
+ * Runs on the pcapng sniff consumer's thread. Every packet becomes an
+ * Enhanced Packet Block with a nanosecond timestamp and its direction in
+ * epb_flags. Blocks are collected in a buffer and written when it fills, when
+ * the output has been idle for a while, or at once in live FIFO mode.
+ */
+
+#include "sniff_pcap.h"
+#include "sniff_ring.h"
+#include "relay.h"
+#include "utils.h"
+#include "nullmodem.h"
+#include <sys/stat.h>
+
+#define PCAPNG_BLOCK_SHB 0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB 0x00000001
+#define PCAPNG_BLOCK_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+
+#define PCAPNG_OPT_ENDOFOPT 0
+#define PCAPNG_OPT_SHB_USERAPPL 4
+#define PCAPNG_OPT_IF_NAME 2
+#define PCAPNG_OPT_IF_DESCRIPTION 3
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_OPT_EPB_FLAGS 2
+
+#define PCAPNG_FLAG_INBOUND 1
+#define PCAPNG_FLAG_OUTBOUND 2
+
+#define PAD4(n) (((n) + 3) & ~(size_t)3)
+
+// Blocks are written in host byte order; readers detect it from the byte order magic
+static void put(SniffPcapWriter *writer, const void *data, size_t len) {
+    memcpy(writer->buffer + writer->length, data, len);
+    writer->length += len;
+}
+
+static void put_u16(SniffPcapWriter *writer, uint16_t value) {
+    put(writer, &value, sizeof(value));
+}
+
+static void put_u32(SniffPcapWriter *writer, uint32_t value) {
+    put(writer, &value, sizeof(value));
+}
+
+static void put_padding(SniffPcapWriter *writer, size_t len) {
+    static const unsigned char zeros[4];
+    put(writer, zeros, PAD4(len) - len);
+}
+
+static void put_option(SniffPcapWriter *writer, uint16_t code, const void *value, uint16_t len) {
+    put_u16(writer, code);
+    put_u16(writer, len);
+    if (len > 0) put(writer, value, len);
+    put_padding(writer, len);
+}
+
+// The total length goes at both ends of a block; the first is filled in by end_block
+static size_t begin_block(SniffPcapWriter *writer, uint32_t type) {
+    size_t start = writer->length;
+    put_u32(writer, type);
+    put_u32(writer, 0);
+    return start;
+}
+
+static void end_block(SniffPcapWriter *writer, size_t start) {
+    uint32_t total = (uint32_t)(writer->length - start + sizeof(uint32_t));
+    memcpy(writer->buffer + start + sizeof(uint32_t), &total, sizeof(total));
+    put_u32(writer, total);
+}
+
+// Section header and one interface per null modem pair or multiplexer client
+static void put_headers(SniffPcapWriter *writer) {
+    size_t start = begin_block(writer, PCAPNG_BLOCK_SHB);
+    put_u32(writer, PCAPNG_BYTE_ORDER_MAGIC);
+    put_u16(writer, 1);
+    put_u16(writer, 0);
+    put_u32(writer, 0xFFFFFFFF);    // Section length unknown
+    put_u32(writer, 0xFFFFFFFF);
+    put_option(writer, PCAPNG_OPT_SHB_USERAPPL, "BRIDGE", 6);
+    put_option(writer, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+    end_block(writer, start);
+
+    writer->interfaces = MAX(sniff_channel_count(writer->app), 1);
+    for (int i = 0; i < writer->interfaces; i++) {
+        char name[16];
+        char description[2 * MAX_PATH_LENGTH + 16];
+        snprintf(name, sizeof(name), "bridge%d", i);
+        format_channel_description(writer->app, i, description, sizeof(description));
+        uint8_t tsresol = 9;        // Nanoseconds
+
+        start = begin_block(writer, PCAPNG_BLOCK_IDB);
+        put_u16(writer, SNIFF_PCAP_LINKTYPE);
+        put_u16(writer, 0);
+        put_u32(writer, SNIFF_PCAP_PSEUDO_HEADER_SIZE + SNIFF_RING_MAX_PACKET);
+        put_option(writer, PCAPNG_OPT_IF_NAME, name, (uint16_t)strlen(name));
+        put_option(writer, PCAPNG_OPT_IF_DESCRIPTION, description, (uint16_t)strlen(description));
+        put_option(writer, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1);
+        put_option(writer, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+        end_block(writer, start);
+    }
+}
+
+// Size of the Enhanced Packet Block for len bytes of data
+static size_t packet_block_size(size_t len) {
+    return 28 + PAD4(SNIFF_PCAP_PSEUDO_HEADER_SIZE + len) + 12 + 4;
+}
+
+static void put_packet(SniffPcapWriter *writer, const SniffPacket *packet) {
+    uint64_t timestamp = (uint64_t)packet->timestamp.tv_sec * 1000000000ULL + packet->timestamp.tv_nsec;
+    uint32_t captured = (uint32_t)(SNIFF_PCAP_PSEUDO_HEADER_SIZE + packet->data_len);
+    unsigned char pseudo_header[SNIFF_PCAP_PSEUDO_HEADER_SIZE] = {
+        (unsigned char)packet->direction, packet->channel, 0, 0
+    };
+    uint32_t flags = packet->direction == 'T' ? PCAPNG_FLAG_OUTBOUND : PCAPNG_FLAG_INBOUND;
+    // Pairs added after the headers went out land on the first interface
+    uint32_t interface = packet->channel < writer->interfaces ? packet->channel : 0;
+
+    size_t start = begin_block(writer, PCAPNG_BLOCK_EPB);
+    put_u32(writer, interface);
+    put_u32(writer, (uint32_t)(timestamp >> 32));
+    put_u32(writer, (uint32_t)timestamp);
+    put_u32(writer, captured);
+    put_u32(writer, captured);
+    put(writer, pseudo_header, sizeof(pseudo_header));
+    put(writer, packet->data, packet->data_len);
+    put_padding(writer, captured);
+    put_option(writer, PCAPNG_OPT_EPB_FLAGS, &flags, sizeof(flags));
+    put_option(writer, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+    end_block(writer, start);
+}
+
+// Through the consumer while it runs, so stopping sniffing interrupts a stalled
+// reader; the final flush after that writes whatever goes through at once
+static gboolean write_all(SniffPcapWriter *writer, struct SniffConsumer *consumer,
+                          const unsigned char *data, size_t len) {
+    if (consumer && consumer->running) {
+        return sniff_consumer_write(consumer, writer->fd, (const char *)data, len);
+    }
+
+    while (len > 0) {
+        ssize_t written = write(writer->fd, data, len);
+        if (written > 0) {
+            data += written;
+            len -= written;
+        } else if (written < 0 && errno != EINTR) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void close_output(SniffPcapWriter *writer) {
+    if (writer->fd >= 0) {
+        close(writer->fd);
+        writer->fd = -1;
+    }
+}
+
+static void flush(SniffPcapWriter *writer, struct SniffConsumer *consumer) {
+    if (writer->length == 0) return;
+
+    if (writer->fd >= 0 && !write_all(writer, consumer, writer->buffer, writer->length)) {
+        writer->write_errors++;
+        if (writer->live) {
+            // The reader went away, possibly mid-block; the next one starts a fresh section
+            log_message(writer->app, "pcapng FIFO reader disconnected from %s", writer->path);
+            close_output(writer);
+        }
+    }
+    writer->length = 0;
+}
+
+// Live mode: a FIFO can only be opened for writing once somebody reads it
+static gboolean open_reader(SniffPcapWriter *writer) {
+    if (writer->fd >= 0) return TRUE;
+
+    uint64_t now = relay_now_ns();
+    if (now < writer->next_open_ns) return FALSE;
+    writer->next_open_ns = now + SNIFF_PCAP_REOPEN_MS * 1000000ULL;
+
+    writer->fd = open(writer->path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (writer->fd < 0) return FALSE;
+
+    // Room for bursts while Wireshark is busy redrawing
+    fcntl(writer->fd, F_SETPIPE_SZ, SNIFF_PCAP_BUFFER_SIZE);
+    writer->length = 0;
+    writer->files_opened++;
+    put_headers(writer);
+    log_message(writer->app, "pcapng FIFO reader connected to %s", writer->path);
+    return TRUE;
+}
+
+// Rotated files are named like dumpcap's ring buffer: base_00001_YYYYmmddHHMMSS.ext
+static void rotated_path(SniffPcapWriter *writer, time_t now, char *buffer, size_t buffer_size) {
+    const char *slash = strrchr(writer->path, '/');
+    const char *dot = strrchr(slash ? slash : writer->path, '.');
+    int stem_len = dot ? (int)(dot - writer->path) : (int)strlen(writer->path);
+    char stamp[32];
+    struct tm tm_info;
+
+    localtime_r(&now, &tm_info);
+    strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &tm_info);
+    snprintf(buffer, buffer_size, "%.*s_%05u_%s%s", stem_len, writer->path,
+             writer->file_index, stamp, dot ? dot : ".pcapng");
+}
+
+static gboolean open_file(SniffPcapWriter *writer) {
+    time_t now = time(NULL);
+
+    writer->file_index++;
+    if (writer->max_file_bytes || writer->max_file_seconds) {
+        rotated_path(writer, now, writer->current_path, sizeof(writer->current_path));
+    } else {
+        strncpy(writer->current_path, writer->path, MAX_PATH_LENGTH - 1);
+    }
+
+    writer->fd = open(writer->current_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        log_message(writer->app, "Failed to open pcapng file %s: %s",
+                    writer->current_path, strerror(errno));
+        return FALSE;
+    }
+
+    writer->files_opened++;
+    writer->file_start = now;
+    writer->file_bytes = 0;
+    writer->file_packets = 0;
+    put_headers(writer);
+    writer->file_bytes = writer->length;
+    return TRUE;
+}
+
+// Checked before each packet, so a file always holds at least one and an idle
+// capture does not leave a trail of empty files
+static gboolean rotation_due(SniffPcapWriter *writer, const SniffPacket *packet, size_t block) {
+    if (writer->live || writer->file_packets == 0) return FALSE;
+    if (writer->max_file_bytes && writer->file_bytes + block > writer->max_file_bytes) return TRUE;
+    if (writer->max_file_seconds &&
+        packet->timestamp.tv_sec - writer->file_start >= (time_t)writer->max_file_seconds) return TRUE;
+    return FALSE;
+}
+
+SniffPcapWriter* sniff_pcap_writer_new(BridgeApp *app, const char *path, gboolean live,
+                                       unsigned int max_file_mb, unsigned int max_file_seconds) {
+    SniffPcapWriter *writer = calloc(1, sizeof(SniffPcapWriter));
+    if (!writer) return NULL;
+
+    writer->app = app;
+    writer->fd = -1;
+    writer->live = live;
+    strncpy(writer->path, path, MAX_PATH_LENGTH - 1);
+    writer->max_file_bytes = live ? 0 : (uint64_t)max_file_mb * 1024 * 1024;
+    writer->max_file_seconds = live ? 0 : max_file_seconds;
+    writer->buffer = malloc(SNIFF_PCAP_BUFFER_SIZE);
+    if (!writer->buffer) {
+        sniff_pcap_writer_free(writer);
+        return NULL;
+    }
+
+    if (!live) {
+        if (!open_file(writer)) {
+            sniff_pcap_writer_free(writer);
+            return NULL;
+        }
+        return writer;
+    }
+
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        if (!S_ISFIFO(st.st_mode)) {
+            log_message(app, "pcapng live output %s exists and is not a FIFO", path);
+            sniff_pcap_writer_free(writer);
+            return NULL;
+        }
+    } else if (mkfifo(path, 0666) == 0) {
+        writer->created_fifo = TRUE;
+    } else {
+        log_message(app, "Failed to create pcapng FIFO %s: %s", path, strerror(errno));
+        sniff_pcap_writer_free(writer);
+        return NULL;
+    }
+
+    strncpy(writer->current_path, path, MAX_PATH_LENGTH - 1);
+    open_reader(writer);
+    return writer;
+}
+
+void sniff_pcap_writer_free(SniffPcapWriter *writer) {
+    if (!writer) return;
+
+    if (writer->buffer) {
+        flush(writer, NULL);
+    }
+    close_output(writer);
+    if (writer->created_fifo) {
+        unlink(writer->path);
+    }
+    free(writer->buffer);
+    free(writer);
+}
+
+gboolean sniff_pcap_append(SniffPcapWriter *writer, struct SniffConsumer *consumer,
+                           const SniffPacket *packet) {
+    if (writer->live && !open_reader(writer)) {
+        writer->packets_skipped++;
+        return TRUE;
+    }
+
+    size_t block = packet_block_size(packet->data_len);
+    if (rotation_due(writer, packet, block)) {
+        flush(writer, consumer);
+        close_output(writer);
+        if (!open_file(writer)) {
+            return FALSE;
+        }
+        log_message(writer->app, "Sniff pcapng continues in %s", writer->current_path);
+    }
+
+    if (writer->length + block > SNIFF_PCAP_BUFFER_SIZE) {
+        flush(writer, consumer);
+        if (writer->fd < 0) {
+            writer->packets_skipped++;
+            return TRUE;
+        }
+    }
+
+    if (writer->length == 0) {
+        writer->buffered_since_ns = relay_now_ns();
+    }
+    put_packet(writer, packet);
+    writer->file_bytes += block;
+    writer->file_packets++;
+    writer->packets_written++;
+    return TRUE;
+}
+
+// Called whenever the output has caught up with the capture
+void sniff_pcap_idle(SniffPcapWriter *writer, struct SniffConsumer *consumer) {
+    if (writer->live) {
+        // Sends the headers as soon as Wireshark opens the FIFO, and every packet without delay
+        open_reader(writer);
+        flush(writer, consumer);
+        return;
+    }
+
+    if (writer->length > 0 &&
+        relay_now_ns() - writer->buffered_since_ns >= SNIFF_PCAP_FLUSH_MS * 1000000ULL) {
+        flush(writer, consumer);
+    }
+}
+
+void sniff_pcap_format_stats(SniffPcapWriter *writer, char *buffer, size_t buffer_size) {
+    if (writer->live) {
+        snprintf(buffer, buffer_size, "pcapng: %s, %lu packets, %lu skipped without reader",
+                 writer->fd >= 0 ? "reader attached" : "waiting for reader",
+                 writer->packets_written, writer->packets_skipped);
+    } else {
+        snprintf(buffer, buffer_size, "pcapng: %lu packets in %lu file%s, %lu write errors",
+                 writer->packets_written, writer->files_opened,
+                 writer->files_opened == 1 ? "" : "s", writer->write_errors);
+    }
+}
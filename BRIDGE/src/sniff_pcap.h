@@ -0,0 +1,68 @@
+/*
+ * Sniff pcapng writer header for BRIDGE - Virtual Null Modem Bridge
+ * Writes sniffed packets as pcapng for Wireshark and tshark, to rotating
+ * files or to a FIFO read live by "wireshark -k -i <fifo>"
+ */
+
+#ifndef SNIFF_PCAP_H
+#define SNIFF_PCAP_H
+
+#include "common.h"
+#include "sniffing.h"
+#include <stdint.h>
+
+// There is no standard serial link type that records direction, so packets use
+// LINKTYPE_USER0 with a small pseudo-header in front of the data:
+//   byte 0: direction, 'T' or 'R'
+//   byte 1: channel, the null modem pair (see sniff_protocol.h for the multiplexer)
+//   bytes 2-3: reserved, 0
+// Direction is also set in each block's epb_flags (T outbound, R inbound),
+// which Wireshark shows without any configuration. Each pair is also its own
+// interface, named bridge0, bridge1, ...
+#define SNIFF_PCAP_LINKTYPE 147
+#define SNIFF_PCAP_PSEUDO_HEADER_SIZE 4
+
+// Blocks are collected here and written in one go
+#define SNIFF_PCAP_BUFFER_SIZE (256 * 1024)
+// Longest a file keeps buffered blocks while no new packets arrive
+#define SNIFF_PCAP_FLUSH_MS 1000
+// How often a live FIFO without a reader is tried again
+#define SNIFF_PCAP_REOPEN_MS 200
+
+struct SniffConsumer;
+
+typedef struct SniffPcapWriter {
+    int fd;                     // Current file, or the FIFO once a reader has it open; -1 otherwise
+    char path[MAX_PATH_LENGTH]; // As configured; the base name when rotating
+    char current_path[MAX_PATH_LENGTH];
+    gboolean live;              // path is a FIFO; blocks are flushed as soon as the output is idle
+    gboolean created_fifo;      // Removed again when the writer is freed
+    uint64_t max_file_bytes;    // Start a new file beyond this size; 0 for no limit
+    unsigned int max_file_seconds; // Start a new file after this long; 0 for no limit
+    int interfaces;             // Interface blocks in the current section, one per pair
+
+    unsigned char *buffer;
+    size_t length;
+    uint64_t buffered_since_ns;
+    uint64_t file_bytes;
+    time_t file_start;
+    unsigned long file_packets;
+    unsigned int file_index;
+    uint64_t next_open_ns;      // Live mode: next attempt to find a reader
+
+    unsigned long packets_written;
+    unsigned long packets_skipped; // Live mode: captured while no reader was attached
+    unsigned long files_opened;
+    unsigned long write_errors;
+    BridgeApp *app;
+} SniffPcapWriter;
+
+SniffPcapWriter* sniff_pcap_writer_new(BridgeApp *app, const char *path, gboolean live,
+                                       unsigned int max_file_mb, unsigned int max_file_seconds);
+void sniff_pcap_writer_free(SniffPcapWriter *writer);
+gboolean sniff_pcap_append(SniffPcapWriter *writer, struct SniffConsumer *consumer,
+                           const SniffPacket *packet);
+void sniff_pcap_idle(SniffPcapWriter *writer, struct SniffConsumer *consumer);
+void sniff_pcap_format_stats(SniffPcapWriter *writer, char *buffer, size_t buffer_size);
+
+#endif // SNIFF_PCAP_H
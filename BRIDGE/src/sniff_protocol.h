@@ -0,0 +1,177 @@
+/*
+ * Sniff wire protocol for BRIDGE - Virtual Null Modem Bridge
+ * Layouts shared by BRIDGE and its clients (see examples/sniff_lib.h).
+ * Self-contained on purpose: clients include it without the rest of BRIDGE.
+ * All multi-byte fields are big-endian.
+ */
+
+#ifndef SNIFF_PROTOCOL_H
+#define SNIFF_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Framed format: every captured packet becomes a header followed by its bytes
+//
+//   0  magic         u32  "BSFR"
+//   4  version       u8   SNIFF_FRAME_VERSION
+//   5  direction     u8   'T' (device1 -> device2) or 'R'
+//   6  channel       u8   Null modem pair the data came from; with the port
+//                         multiplexer, the virtual port, and one past the
+//                         last virtual port for data the port received
+//   7  flags         u8   Zero; unknown flags must be ignored
+//   8  sequence      u64  Capture sequence; a gap means this output dropped packets
+//  16  timestamp_ns  u64  Capture time, nanoseconds since the epoch
+//  24  length        u32  Number of data bytes that follow
+#define SNIFF_FRAME_MAGIC 0x42534652
+#define SNIFF_FRAME_VERSION 1
+#define SNIFF_FRAME_HEADER_SIZE 28
+// Captures are never larger than this, which lets decoders spot garbage
+#define SNIFF_FRAME_MAX_LENGTH 65536
+
+typedef struct {
+    uint8_t version;
+    char direction;
+    uint8_t channel;
+    uint8_t flags;
+    uint64_t sequence;
+    uint64_t timestamp_ns;
+    uint32_t length;
+} SniffFrameHeader;
+
+// UDP output: every datagram starts with this, ahead of the formatted data
+//
+//   0  magic         u32  "BSNF"
+//   4  sequence      u32  One more than the previous datagram; gaps are lost datagrams
+//   8  timestamp_us  u64  Capture time of the first payload byte, microseconds since the epoch
+#define SNIFF_UDP_MAGIC 0x42534E46
+#define SNIFF_UDP_HEADER_SIZE 16
+
+typedef struct {
+    uint32_t sequence;
+    uint64_t timestamp_us;
+} SniffUdpHeader;
+
+// Time index: a sniff log file name.idx sits next to it (LAST writes the same
+// for its capture log). A header, then fixed-size entries in capture order, one
+// every SNIFF_INDEX_RECORDS records or SNIFF_INDEX_INTERVAL_MS, so a reader
+// binary searches for the last entry at or before the time it wants.
+//
+//   0  magic         u32  "BSIX"
+//   4  version       u8   SNIFF_INDEX_VERSION
+//   5  flags         u8   SNIFF_INDEX_GZIP: the file is gzip compressed
+//   6  reserved      u16  Zero
+//
+// Entry:
+//   0  timestamp_ns  u64  Capture time of the first record at this point, nanoseconds since the epoch
+//   8  offset        u64  Byte offset of that record in the file. For gzip, the compressed
+//                         offset of a full flush point: raw inflate can start there.
+//                         SNIFF_INDEX_NO_OFFSET when unknown (a rebuilt gzip index)
+//  16  data_offset   u64  The same record's offset in the uncompressed capture
+#define SNIFF_INDEX_MAGIC 0x42534958
+#define SNIFF_INDEX_VERSION 1
+#define SNIFF_INDEX_GZIP 0x01
+#define SNIFF_INDEX_HEADER_SIZE 8
+#define SNIFF_INDEX_ENTRY_SIZE 24
+#define SNIFF_INDEX_NO_OFFSET UINT64_MAX
+#define SNIFF_INDEX_SUFFIX ".idx"
+#define SNIFF_INDEX_RECORDS 10000
+#define SNIFF_INDEX_INTERVAL_MS 1000
+
+typedef struct {
+    uint64_t timestamp_ns;
+    uint64_t offset;
+    uint64_t data_offset;
+} SniffIndexEntry;
+
+static inline void sniff_put_u32(unsigned char *p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static inline void sniff_put_u64(unsigned char *p, uint64_t value) {
+    sniff_put_u32(p, (uint32_t)(value >> 32));
+    sniff_put_u32(p + 4, (uint32_t)value);
+}
+
+static inline uint32_t sniff_get_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t sniff_get_u64(const unsigned char *p) {
+    return ((uint64_t)sniff_get_u32(p) << 32) | sniff_get_u32(p + 4);
+}
+
+static inline void sniff_frame_encode(unsigned char *out, const SniffFrameHeader *header) {
+    sniff_put_u32(out, SNIFF_FRAME_MAGIC);
+    out[4] = header->version;
+    out[5] = (unsigned char)header->direction;
+    out[6] = header->channel;
+    out[7] = header->flags;
+    sniff_put_u64(out + 8, header->sequence);
+    sniff_put_u64(out + 16, header->timestamp_ns);
+    sniff_put_u32(out + 24, header->length);
+}
+
+// Returns 0 if in does not start with a plausible frame header
+static inline int sniff_frame_decode(const unsigned char *in, SniffFrameHeader *header) {
+    if (sniff_get_u32(in) != SNIFF_FRAME_MAGIC || in[4] != SNIFF_FRAME_VERSION) {
+        return 0;
+    }
+    header->version = in[4];
+    header->direction = (char)in[5];
+    header->channel = in[6];
+    header->flags = in[7];
+    header->sequence = sniff_get_u64(in + 8);
+    header->timestamp_ns = sniff_get_u64(in + 16);
+    header->length = sniff_get_u32(in + 24);
+    return header->length <= SNIFF_FRAME_MAX_LENGTH;
+}
+
+static inline void sniff_udp_encode(unsigned char *out, const SniffUdpHeader *header) {
+    sniff_put_u32(out, SNIFF_UDP_MAGIC);
+    sniff_put_u32(out + 4, header->sequence);
+    sniff_put_u64(out + 8, header->timestamp_us);
+}
+
+static inline int sniff_udp_decode(const unsigned char *in, size_t length, SniffUdpHeader *header) {
+    if (length < SNIFF_UDP_HEADER_SIZE || sniff_get_u32(in) != SNIFF_UDP_MAGIC) {
+        return 0;
+    }
+    header->sequence = sniff_get_u32(in + 4);
+    header->timestamp_us = sniff_get_u64(in + 8);
+    return 1;
+}
+
+static inline void sniff_index_encode_header(unsigned char *out, uint8_t flags) {
+    sniff_put_u32(out, SNIFF_INDEX_MAGIC);
+    out[4] = SNIFF_INDEX_VERSION;
+    out[5] = flags;
+    out[6] = 0;
+    out[7] = 0;
+}
+
+// Returns 0 if in is not an index header; *flags gets its flags
+static inline int sniff_index_decode_header(const unsigned char *in, uint8_t *flags) {
+    if (sniff_get_u32(in) != SNIFF_INDEX_MAGIC || in[4] != SNIFF_INDEX_VERSION) {
+        return 0;
+    }
+    *flags = in[5];
+    return 1;
+}
+
+static inline void sniff_index_encode_entry(unsigned char *out, const SniffIndexEntry *entry) {
+    sniff_put_u64(out, entry->timestamp_ns);
+    sniff_put_u64(out + 8, entry->offset);
+    sniff_put_u64(out + 16, entry->data_offset);
+}
+
+static inline void sniff_index_decode_entry(const unsigned char *in, SniffIndexEntry *entry) {
+    entry->timestamp_ns = sniff_get_u64(in);
+    entry->offset = sniff_get_u64(in + 8);
+    entry->data_offset = sniff_get_u64(in + 16);
+}
+
+#endif // SNIFF_PROTOCOL_H
@@ -0,0 +1,383 @@
+/*
+ * Sniff ring for BRIDGE - Virtual Null Modem Bridge
+ * The relay thread is the only producer. It copies each tapped chunk into the
+ * ring and publishes it by advancing head; it never waits for a consumer
+ * unless that consumer asked to block. Each output runs on its own thread
+ * and reads through its own cursor, so one slow reader only affects itself:
+ * it either skips ahead (drop oldest), is disconnected, or holds back the
+ * producer (block).
+ *
+ * Consumers copy a packet out and then check that the producer did not
+ * overwrite it meanwhile, so producer and consumers share no locks.
+ */
+
+#include "sniff_ring.h"
+#include "utils.h"
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#define SLOT_MASK (SNIFF_RING_SLOTS - 1)
+// How long an idle consumer or a blocked producer sleeps before rechecking
+#define SNIFF_RING_WAIT_MS 200
+
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+SniffRing* sniff_ring_new(BridgeApp *app) {
+    SniffRing *ring = calloc(1, sizeof(SniffRing));
+    if (!ring) return NULL;
+
+    ring->data = malloc(SNIFF_RING_DATA_SIZE);
+    if (!ring->data) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->app = app;
+    pthread_mutex_init(&ring->space_mutex, NULL);
+    pthread_cond_init(&ring->space_cond, NULL);
+    return ring;
+}
+
+static void wake_producer(SniffRing *ring) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (LOAD(&ring->producer_waiting)) {
+        pthread_mutex_lock(&ring->space_mutex);
+        pthread_cond_broadcast(&ring->space_cond);
+        pthread_mutex_unlock(&ring->space_mutex);
+    }
+}
+
+static void wake_consumer(SniffConsumer *consumer) {
+    uint64_t one = 1;
+    ssize_t ignored = write(consumer->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+// Copy packet seq out of the ring. Returns FALSE if the producer has lapped it.
+static gboolean copy_packet(SniffRing *ring, uint64_t seq, char *buffer, SniffPacket *packet) {
+    if (LOAD(&ring->head) - seq >= SNIFF_RING_SLOTS) return FALSE;
+
+    SniffSlot slot = ring->slots[seq & SLOT_MASK];
+    if (LOAD(&ring->data_reserved) - slot.data_pos > SNIFF_RING_DATA_SIZE ||
+        slot.length > SNIFF_RING_MAX_PACKET) {
+        return FALSE;
+    }
+    memcpy(buffer, ring->data + slot.data_pos % SNIFF_RING_DATA_SIZE, slot.length);
+
+    // Only trust the copy if neither the slot nor its bytes were reused meanwhile
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (LOAD(&ring->head) - seq >= SNIFF_RING_SLOTS ||
+        LOAD(&ring->data_reserved) - slot.data_pos > SNIFF_RING_DATA_SIZE) {
+        return FALSE;
+    }
+
+    packet->timestamp = slot.timestamp;
+    packet->direction = slot.direction;
+    packet->channel = slot.channel;
+    packet->sequence = seq;
+    packet->data_len = slot.length;
+    packet->data = buffer;
+    return TRUE;
+}
+
+// Where a lapped consumer resumes: halfway into what is still readable,
+// leaving some room before the producer catches up again
+static uint64_t resume_point(SniffRing *ring) {
+    uint64_t head = LOAD(&ring->head);
+    uint64_t reserved = LOAD(&ring->data_reserved);
+    uint64_t limit = head >= SNIFF_RING_SLOTS ? head - SNIFF_RING_SLOTS + 1 : 0;
+    uint64_t oldest = head;
+
+    while (oldest > limit &&
+           reserved - ring->slots[(oldest - 1) & SLOT_MASK].data_pos <= SNIFF_RING_DATA_SIZE) {
+        oldest--;
+    }
+    return oldest + (head - oldest) / 2;
+}
+
+static void* consumer_thread_func(void *data) {
+    SniffConsumer *consumer = (SniffConsumer *)data;
+    SniffRing *ring = consumer->ring;
+
+    while (consumer->running) {
+        uint64_t cursor = consumer->cursor;
+
+        if (LOAD(&ring->head) == cursor) {
+            if (consumer->idle) consumer->idle(consumer);
+
+            // Announce the sleep before the final check so a publish cannot slip by
+            __atomic_store_n(&consumer->sleeping, 1, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (LOAD(&ring->head) == cursor && consumer->running) {
+                struct pollfd pfd = { .fd = consumer->wake_fd, .events = POLLIN };
+                poll(&pfd, 1, SNIFF_RING_WAIT_MS);
+            }
+            __atomic_store_n(&consumer->sleeping, 0, __ATOMIC_SEQ_CST);
+
+            uint64_t value;
+            ssize_t ignored = read(consumer->wake_fd, &value, sizeof(value));
+            (void)ignored;
+            continue;
+        }
+
+        SniffPacket packet;
+        if (!copy_packet(ring, cursor, consumer->scratch, &packet)) {
+            if (consumer->policy == SNIFF_POLICY_DISCONNECT) {
+                STORE(&consumer->dropped, consumer->dropped + (LOAD(&ring->head) - cursor));
+                break;
+            }
+            uint64_t resume = resume_point(ring);
+            STORE(&consumer->dropped, consumer->dropped + (resume - cursor));
+            STORE(&consumer->cursor, resume);
+            continue;
+        }
+
+        if (!consumer->deliver(consumer, &packet)) {
+            break;
+        }
+
+        STORE(&consumer->delivered, consumer->delivered + 1);
+        STORE(&consumer->cursor, cursor + 1);
+        wake_producer(ring);
+    }
+
+    if (consumer->idle) consumer->idle(consumer);
+    consumer->running = FALSE;
+    STORE(&consumer->finished, TRUE);
+    wake_producer(ring);
+    return NULL;
+}
+
+// Block policy: whether every blocking consumer has room for the next packet
+static gboolean has_space(SniffRing *ring, uint64_t head, uint64_t data_end) {
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+        SniffConsumer *consumer = &ring->consumers[i];
+        if (!LOAD(&consumer->in_use) || !consumer->running ||
+            consumer->policy != SNIFF_POLICY_BLOCK) {
+            continue;
+        }
+
+        // Publishing makes head - cursor one larger, and readers treat a full
+        // ring of SNIFF_RING_SLOTS as lapped
+        uint64_t cursor = LOAD(&consumer->cursor);
+        if (head + 1 - cursor >= SNIFF_RING_SLOTS ||
+            (cursor != head &&
+             data_end - ring->slots[cursor & SLOT_MASK].data_pos > SNIFF_RING_DATA_SIZE)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean wait_for_space(SniffRing *ring, uint64_t head, uint64_t data_end) {
+    if (has_space(ring, head, data_end)) return TRUE;
+
+    pthread_mutex_lock(&ring->space_mutex);
+    // Announce the wait before rechecking, so a consumer that moves on after
+    // the check is sure to see the flag and signal
+    __atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!has_space(ring, head, data_end) && !LOAD(&ring->stopping)) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SNIFF_RING_WAIT_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&ring->space_cond, &ring->space_mutex, &deadline);
+    }
+    STORE(&ring->producer_waiting, 0);
+    pthread_mutex_unlock(&ring->space_mutex);
+
+    return !LOAD(&ring->stopping);
+}
+
+// Relay thread only
+void sniff_ring_publish(SniffRing *ring, const SniffPacket *packet) {
+    size_t length = packet->data_len > SNIFF_RING_MAX_PACKET ? SNIFF_RING_MAX_PACKET : packet->data_len;
+    uint64_t head = ring->head;
+    uint64_t pos = ring->data_head;
+
+    // Keep each packet contiguous
+    if (pos % SNIFF_RING_DATA_SIZE + length > SNIFF_RING_DATA_SIZE) {
+        pos += SNIFF_RING_DATA_SIZE - pos % SNIFF_RING_DATA_SIZE;
+    }
+
+    if (!wait_for_space(ring, head, pos + length)) {
+        return;
+    }
+
+    // Claim the bytes before touching them so readers can detect the overwrite
+    STORE(&ring->data_reserved, pos + length);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    memcpy(ring->data + pos % SNIFF_RING_DATA_SIZE, packet->data, length);
+    SniffSlot *slot = &ring->slots[head & SLOT_MASK];
+    slot->data_pos = pos;
+    slot->length = (uint32_t)length;
+    slot->direction = packet->direction;
+    slot->channel = packet->channel;
+    slot->timestamp = packet->timestamp;
+    ring->data_head = pos + length;
+
+    STORE(&ring->head, head + 1);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Only consumers that went to sleep cost a syscall
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+        SniffConsumer *consumer = &ring->consumers[i];
+        if (LOAD(&consumer->in_use) && __atomic_exchange_n(&consumer->sleeping, 0, __ATOMIC_SEQ_CST)) {
+            wake_consumer(consumer);
+        }
+    }
+}
+
+// Start a consumer at the current head; it sees only packets published from now on.
+// NULL with errno set (ENOSPC when every slot is taken) if it cannot be started.
+SniffConsumer* sniff_ring_add_consumer(SniffRing *ring, const char *name, int fd,
+                                       SniffDeliverFunc deliver, SniffIdleFunc idle,
+                                       SniffSlowPolicy policy) {
+    SniffConsumer *consumer = NULL;
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+        if (!LOAD(&ring->consumers[i].in_use)) {
+            consumer = &ring->consumers[i];
+            break;
+        }
+    }
+    if (!consumer) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    memset(consumer, 0, sizeof(*consumer));
+    strncpy(consumer->name, name, sizeof(consumer->name) - 1);
+    consumer->ring = ring;
+    consumer->policy = policy;
+    consumer->deliver = deliver;
+    consumer->idle = idle;
+    consumer->fd = fd;
+    consumer->cursor = LOAD(&ring->head);
+    consumer->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    consumer->scratch = malloc(SNIFF_RING_MAX_PACKET);
+    consumer->running = TRUE;
+
+    // Visible to the producer before the thread can go to sleep
+    STORE(&consumer->in_use, 1);
+    int error = consumer->wake_fd < 0 ? errno : !consumer->scratch ? ENOMEM :
+                pthread_create(&consumer->thread, NULL, consumer_thread_func, consumer);
+    if (error != 0) {
+        consumer->running = FALSE;
+        STORE(&consumer->in_use, 0);
+        if (consumer->wake_fd >= 0) close(consumer->wake_fd);
+        free(consumer->scratch);
+        consumer->scratch = NULL;
+        errno = error;
+        return NULL;
+    }
+
+    return consumer;
+}
+
+static void release_consumer(SniffConsumer *consumer) {
+    pthread_join(consumer->thread, NULL);
+    close(consumer->wake_fd);
+    free(consumer->scratch);
+    consumer->scratch = NULL;
+    STORE(&consumer->in_use, 0);
+}
+
+// Release consumers that ended on their own; returns how many
+int sniff_ring_reap(SniffRing *ring) {
+    int reaped = 0;
+
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+        SniffConsumer *consumer = &ring->consumers[i];
+        if (LOAD(&consumer->in_use) && LOAD(&consumer->finished)) {
+            log_message(ring->app, "Sniff output %s closed (%lu packets, %lu dropped)",
+                       consumer->name, consumer->delivered, consumer->dropped);
+            release_consumer(consumer);
+            reaped++;
+        }
+    }
+    return reaped;
+}
+
+// Unblock the producer and all consumers; safe to call from any thread
+void sniff_ring_stop(SniffRing *ring) {
+    STORE(&ring->stopping, 1);
+    pthread_mutex_lock(&ring->space_mutex);
+    pthread_cond_broadcast(&ring->space_cond);
+    pthread_mutex_unlock(&ring->space_mutex);
+
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+        SniffConsumer *consumer = &ring->consumers[i];
+        if (LOAD(&consumer->in_use)) {
+            consumer->running = FALSE;
+            wake_consumer(consumer);
+        }
+    }
+}
+
+// The producer must no longer be publishing
+void sniff_ring_free(SniffRing *ring) {
+    if (!ring) return;
+
+    sniff_ring_stop(ring);
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS; i++) {
+        if (LOAD(&ring->consumers[i].in_use)) {
+            release_consumer(&ring->consumers[i]);
+        }
+    }
+
+    pthread_cond_destroy(&ring->space_cond);
+    pthread_mutex_destroy(&ring->space_mutex);
+    free(ring->data);
+    free(ring);
+}
+
+// Write all of data to fd from a consumer thread, waiting for the output to
+// drain. Gives up when the consumer is stopped or the descriptor fails.
+gboolean sniff_consumer_write(SniffConsumer *consumer, int fd, const char *data, size_t len) {
+    while (len > 0 && consumer->running) {
+        ssize_t written = write(fd, data, len);
+        if (written > 0) {
+            data += written;
+            len -= written;
+            continue;
+        }
+        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return FALSE;
+        }
+
+        struct pollfd pfds[2] = {
+            { .fd = fd, .events = POLLOUT },
+            { .fd = consumer->wake_fd, .events = POLLIN }
+        };
+        poll(pfds, 2, SNIFF_RING_WAIT_MS);
+        if (pfds[0].revents & (POLLERR | POLLHUP)) {
+            return FALSE;
+        }
+    }
+    return len == 0;
+}
+
+// One line per output: lag behind the producer and packets dropped
+void sniff_ring_format_stats(SniffRing *ring, char *buffer, size_t buffer_size) {
+    uint64_t head = LOAD(&ring->head);
+    size_t offset = 0;
+
+    buffer[0] = '\0';
+    for (int i = 0; i < MAX_SNIFF_CONSUMERS && offset < buffer_size; i++) {
+        SniffConsumer *consumer = &ring->consumers[i];
+        if (!LOAD(&consumer->in_use)) continue;
+
+        uint64_t cursor = LOAD(&consumer->cursor);
+        offset += snprintf(buffer + offset, buffer_size - offset,
+                           "%s%s: lag %llu, dropped %lu",
+                           offset ? "\n" : "", consumer->name,
+                           (unsigned long long)(head > cursor ? head - cursor : 0),
+                           (unsigned long)LOAD(&consumer->dropped));
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * Sniff ring header for BRIDGE - Virtual Null Modem Bridge
+ * Single-producer, multi-consumer packet ring between the relay tap and the
+ * sniff outputs. Every output reads at its own pace through its own cursor.
+ */
+
+#ifndef SNIFF_RING_H
+#define SNIFF_RING_H
+
+#include "common.h"
+#include "sniffing.h"
+#include <stdint.h>
+
+// Packet slots; must be a power of two
+#define SNIFF_RING_SLOTS 4096
+// Bytes of packet data held in the ring
+#define SNIFF_RING_DATA_SIZE (4 * 1024 * 1024)
+// Larger packets are truncated (the relay never reads more than this)
+#define SNIFF_RING_MAX_PACKET 65536
+// Pipe, TCP, UDP, file and pcapng
+#define MAX_SNIFF_CONSUMERS 5
+
+typedef struct SniffRing SniffRing;
+typedef struct SniffConsumer SniffConsumer;
+
+// Writes one packet to the output; returns FALSE when the output is gone
+typedef gboolean (*SniffDeliverFunc)(SniffConsumer *consumer, const SniffPacket *packet);
+// Called when the consumer has caught up, before it sleeps, and once when it ends
+typedef void (*SniffIdleFunc)(SniffConsumer *consumer);
+
+typedef struct {
+    uint64_t data_pos;          // Absolute position of the data in the ring
+    uint32_t length;
+    char direction;
+    uint8_t channel;
+    struct timespec timestamp;
+} SniffSlot;
+
+struct SniffConsumer {
+    int in_use;                 // Slot taken; published last when adding
+    char name[64];
+    SniffRing *ring;
+    SniffSlowPolicy policy;
+    SniffDeliverFunc deliver;
+    SniffIdleFunc idle;         // Optional, flushes output batched by deliver
+    int fd;                     // Output descriptor, -1 if the output has its own
+
+    uint64_t cursor;            // Sequence of the next packet to read
+    unsigned long delivered;
+    unsigned long dropped;
+
+    int wake_fd;                // eventfd, written only while sleeping is set
+    int sleeping;
+    volatile gboolean running;
+    gboolean finished;          // Ended on its own and waits to be reaped
+    pthread_t thread;
+    char *scratch;              // Private copy of the packet being delivered
+};
+
+struct SniffRing {
+    SniffSlot slots[SNIFF_RING_SLOTS];
+    char *data;
+    uint64_t head;              // Sequence of the next packet; published after it is written
+    uint64_t data_head;         // Producer-only write position
+    uint64_t data_reserved;     // End of the bytes the producer may be overwriting
+
+    SniffConsumer consumers[MAX_SNIFF_CONSUMERS];
+
+    int stopping;
+    int producer_waiting;       // Producer is blocked by a slow blocking consumer
+    pthread_mutex_t space_mutex;
+    pthread_cond_t space_cond;
+    BridgeApp *app;
+};
+
+SniffRing* sniff_ring_new(BridgeApp *app);
+void sniff_ring_stop(SniffRing *ring);
+void sniff_ring_free(SniffRing *ring);
+void sniff_ring_publish(SniffRing *ring, const SniffPacket *packet);
+
+SniffConsumer* sniff_ring_add_consumer(SniffRing *ring, const char *name, int fd,
+                                       SniffDeliverFunc deliver, SniffIdleFunc idle,
+                                       SniffSlowPolicy policy);
+int sniff_ring_reap(SniffRing *ring);
+gboolean sniff_consumer_write(SniffConsumer *consumer, int fd, const char *data, size_t len);
+void sniff_ring_format_stats(SniffRing *ring, char *buffer, size_t buffer_size);
+
+#endif // SNIFF_RING_H
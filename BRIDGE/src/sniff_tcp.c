@@ -0,0 +1,319 @@
+/*
+ * Sniff TCP server for BRIDGE - Virtual Null Modem Bridge
+ * One epoll loop accepts clients and drains their queues; the sniff ring's TCP
+ * consumer formats each packet once and hands it to every client. A client
+ * that keeps up gets the data straight from send(); one that falls behind
+ * buffers into its own bounded queue, and only that client is affected when
+ * the queue fills.
+ */
+
+#include "sniff_tcp.h"
+#include "sniff_ring.h"
+#include "utils.h"
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+
+// How long a blocked broadcast waits before rechecking the consumer
+#define SNIFF_TCP_WAIT_MS 200
+
+static void close_client(SniffTcpServer *server, SniffTcpClient *client) {
+    pthread_mutex_lock(&server->clients_mutex);
+    g_ptr_array_remove(server->clients, client);
+    relay_loop_remove(server->loop, &client->endpoint);
+    pthread_cond_broadcast(&server->drained_cond);
+    pthread_mutex_unlock(&server->clients_mutex);
+
+    log_message(server->app, "TCP client disconnected: %s (%lu bytes, %lu packets dropped)",
+               client->name, client->bytes_sent, client->dropped);
+    close(client->endpoint.fd);
+    free(client->queue);
+    free(client);
+}
+
+// Shut a client down from any thread; the loop thread sees the hangup and frees it
+static void shutdown_client(SniffTcpClient *client) {
+    if (!client->closing) {
+        client->closing = TRUE;
+        shutdown(client->endpoint.fd, SHUT_RDWR);
+    }
+}
+
+// Send as much of the queue as the socket takes. Caller holds clients_mutex.
+static void flush_queue(SniffTcpServer *server, SniffTcpClient *client) {
+    while (client->queue_length > 0) {
+        size_t chunk = client->queue_length;
+        if (client->queue_start + chunk > SNIFF_TCP_QUEUE_SIZE) {
+            chunk = SNIFF_TCP_QUEUE_SIZE - client->queue_start;
+        }
+
+        ssize_t sent = send(client->endpoint.fd, client->queue + client->queue_start, chunk,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) shutdown_client(client);
+            break;
+        }
+        client->bytes_sent += sent;
+        client->queue_start = (client->queue_start + sent) % SNIFF_TCP_QUEUE_SIZE;
+        client->queue_length -= sent;
+    }
+
+    if (client->queue_length == 0) {
+        client->queue_start = 0;
+    }
+    relay_loop_modify(server->loop, &client->endpoint,
+                      EPOLLIN | EPOLLRDHUP | (client->queue_length > 0 ? EPOLLOUT : 0));
+    pthread_cond_broadcast(&server->drained_cond);
+}
+
+static void on_client_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    (void)loop;
+    SniffTcpClient *client = (SniffTcpClient *)endpoint->owner;
+    SniffTcpServer *server = client->server;
+
+    if (events & EPOLLOUT) {
+        pthread_mutex_lock(&server->clients_mutex);
+        flush_queue(server, client);
+        pthread_mutex_unlock(&server->clients_mutex);
+    }
+
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        // Clients have nothing to say; anything they send is discarded
+        char discard[512];
+        ssize_t bytes_read = recv(endpoint->fd, discard, sizeof(discard), MSG_DONTWAIT);
+        if (bytes_read == 0 || (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) ||
+            (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+            close_client(server, client);
+        }
+    }
+}
+
+static void on_listener_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    (void)events;
+    SniffTcpServer *server = (SniffTcpServer *)endpoint->owner;
+
+    // Take everything that is waiting; the loop only wakes once per burst
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept4(endpoint->fd, (struct sockaddr*)&client_addr, &client_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_message(server->app, "TCP accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        int sndbuf = SNIFF_TCP_SNDBUF;
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+        SniffTcpClient *client = calloc(1, sizeof(SniffTcpClient));
+        if (!client) {
+            close(client_fd);
+            continue;
+        }
+        client->endpoint.fd = client_fd;
+        client->endpoint.on_event = on_client_event;
+        client->endpoint.owner = client;
+        client->server = server;
+        snprintf(client->name, sizeof(client->name), "%s:%d",
+                 inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+
+        pthread_mutex_lock(&server->clients_mutex);
+        gboolean added = relay_loop_add(loop, &client->endpoint, EPOLLIN | EPOLLRDHUP);
+        if (added) {
+            g_ptr_array_add(server->clients, client);
+            server->total_clients++;
+        }
+        pthread_mutex_unlock(&server->clients_mutex);
+
+        if (!added) {
+            log_message(server->app, "TCP client rejected: %s", strerror(errno));
+            close(client_fd);
+            free(client);
+            continue;
+        }
+        log_message(server->app, "TCP client connected: %s", client->name);
+    }
+}
+
+SniffTcpServer* sniff_tcp_server_new(BridgeApp *app, int port) {
+    struct sockaddr_in server_addr;
+
+    SniffTcpServer *server = calloc(1, sizeof(SniffTcpServer));
+    if (!server) return NULL;
+
+    server->app = app;
+    server->clients = g_ptr_array_new();
+    pthread_mutex_init(&server->clients_mutex, NULL);
+    pthread_cond_init(&server->drained_cond, NULL);
+    server->listener.on_event = on_listener_event;
+    server->listener.owner = server;
+
+    // Create TCP socket
+    server->listener.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listener.fd < 0) {
+        log_message(app, "Failed to create TCP socket: %s", strerror(errno));
+        sniff_tcp_server_free(server);
+        return NULL;
+    }
+
+    // Set socket options
+    int opt = 1;
+    setsockopt(server->listener.fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // Bind to port
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+
+    if (bind(server->listener.fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        log_message(app, "Failed to bind TCP socket to port %d: %s", port, strerror(errno));
+        sniff_tcp_server_free(server);
+        return NULL;
+    }
+
+    if (listen(server->listener.fd, SOMAXCONN) < 0) {
+        log_message(app, "Failed to listen on TCP socket: %s", strerror(errno));
+        sniff_tcp_server_free(server);
+        return NULL;
+    }
+
+    server->loop = relay_loop_new(app);
+    if (!server->loop || !relay_loop_add(server->loop, &server->listener, EPOLLIN) ||
+        !relay_loop_start(server->loop)) {
+        log_message(app, "Failed to start TCP server loop");
+        sniff_tcp_server_free(server);
+        return NULL;
+    }
+
+    return server;
+}
+
+// The TCP ring consumer must be stopped first
+void sniff_tcp_server_free(SniffTcpServer *server) {
+    if (!server) return;
+
+    relay_loop_free(server->loop);
+    for (guint i = 0; i < server->clients->len; i++) {
+        SniffTcpClient *client = g_ptr_array_index(server->clients, i);
+        close(client->endpoint.fd);
+        free(client->queue);
+        free(client);
+    }
+    g_ptr_array_free(server->clients, TRUE);
+    if (server->listener.fd >= 0) close(server->listener.fd);
+    pthread_cond_destroy(&server->drained_cond);
+    pthread_mutex_destroy(&server->clients_mutex);
+    free(server);
+}
+
+static void append_to_queue(SniffTcpClient *client, const char *data, size_t len) {
+    size_t tail = (client->queue_start + client->queue_length) % SNIFF_TCP_QUEUE_SIZE;
+    size_t first = len < SNIFF_TCP_QUEUE_SIZE - tail ? len : SNIFF_TCP_QUEUE_SIZE - tail;
+
+    memcpy(client->queue + tail, data, first);
+    memcpy(client->queue, data + first, len - first);
+    client->queue_length += len;
+}
+
+// Block policy: wait until every client's queue can take len more bytes.
+// Clients may come and go meanwhile, so none is held across the wait.
+// Caller holds clients_mutex.
+static void wait_for_room(SniffTcpServer *server, struct SniffConsumer *consumer, size_t len) {
+    for (;;) {
+        gboolean room = TRUE;
+        for (guint i = 0; i < server->clients->len && room; i++) {
+            SniffTcpClient *client = g_ptr_array_index(server->clients, i);
+            room = client->closing || SNIFF_TCP_QUEUE_SIZE - client->queue_length >= len;
+        }
+        if (room || !consumer->running) return;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SNIFF_TCP_WAIT_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&server->drained_cond, &server->clients_mutex, &deadline);
+    }
+}
+
+// Called on the TCP consumer thread with one formatted packet
+void sniff_tcp_broadcast(SniffTcpServer *server, struct SniffConsumer *consumer,
+                         const char *data, size_t len) {
+    if (len > SNIFF_TCP_QUEUE_SIZE) len = SNIFF_TCP_QUEUE_SIZE;
+
+    pthread_mutex_lock(&server->clients_mutex);
+    if (consumer->policy == SNIFF_POLICY_BLOCK) {
+        wait_for_room(server, consumer, len);
+    }
+
+    for (guint i = 0; i < server->clients->len; i++) {
+        SniffTcpClient *client = g_ptr_array_index(server->clients, i);
+        if (client->closing) continue;
+
+        const char *remaining = data;
+        size_t remaining_len = len;
+
+        // Fast path: nothing queued, so the socket can take it directly
+        if (client->queue_length == 0) {
+            ssize_t sent = send(client->endpoint.fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                shutdown_client(client);
+                continue;
+            }
+            if (sent > 0) {
+                client->bytes_sent += sent;
+                remaining += sent;
+                remaining_len -= sent;
+            }
+        }
+        if (remaining_len == 0) continue;
+
+        if (!client->queue) {
+            client->queue = malloc(SNIFF_TCP_QUEUE_SIZE);
+            if (!client->queue) {
+                shutdown_client(client);
+                continue;
+            }
+        }
+
+        // Packets are only ever queued whole, so skipping one keeps the stream aligned
+        if (SNIFF_TCP_QUEUE_SIZE - client->queue_length < remaining_len) {
+            if (consumer->policy == SNIFF_POLICY_DISCONNECT) {
+                log_message(server->app, "TCP client %s too slow, disconnecting", client->name);
+                shutdown_client(client);
+                continue;
+            }
+            client->dropped++;
+            continue;
+        }
+
+        append_to_queue(client, remaining, remaining_len);
+        relay_loop_modify(server->loop, &client->endpoint, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+    }
+    pthread_mutex_unlock(&server->clients_mutex);
+}
+
+void sniff_tcp_format_stats(SniffTcpServer *server, char *buffer, size_t buffer_size) {
+    unsigned long queued = 0, dropped = 0;
+
+    pthread_mutex_lock(&server->clients_mutex);
+    guint clients = server->clients->len;
+    for (guint i = 0; i < clients; i++) {
+        SniffTcpClient *client = g_ptr_array_index(server->clients, i);
+        queued += client->queue_length;
+        dropped += client->dropped;
+    }
+    pthread_mutex_unlock(&server->clients_mutex);
+
+    snprintf(buffer, buffer_size, "TCP clients: %u connected (%lu total), %lu KB queued, %lu dropped",
+             clients, server->total_clients, queued / 1024, dropped);
+}
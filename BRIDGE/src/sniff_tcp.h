@@ -0,0 +1,49 @@
+/*
+ * Sniff TCP server header for BRIDGE - Virtual Null Modem Bridge
+ * Event-driven fan-out of sniffed data to any number of TCP clients
+ */
+
+#ifndef SNIFF_TCP_H
+#define SNIFF_TCP_H
+
+#include "common.h"
+#include "relay.h"
+
+// Bytes a client may have queued before the slow reader policy applies.
+// Larger than the biggest formatted packet, so a client that keeps up never drops.
+#define SNIFF_TCP_QUEUE_SIZE (256 * 1024)
+// Kernel send buffer requested for each client
+#define SNIFF_TCP_SNDBUF (256 * 1024)
+
+typedef struct SniffTcpServer SniffTcpServer;
+struct SniffConsumer;
+
+typedef struct {
+    RelayEndpoint endpoint;     // Client socket
+    SniffTcpServer *server;
+    char name[64];              // "ip:port"
+    char *queue;                // SNIFF_TCP_QUEUE_SIZE bytes, allocated the first time it is needed
+    size_t queue_start;
+    size_t queue_length;
+    gboolean closing;           // Shut down; freed by the loop thread
+    unsigned long bytes_sent;
+    unsigned long dropped;      // Packets skipped while the queue was full
+} SniffTcpClient;
+
+struct SniffTcpServer {
+    RelayLoop *loop;            // Accepts and drains clients on its own thread
+    RelayEndpoint listener;
+    GPtrArray *clients;
+    pthread_mutex_t clients_mutex;
+    pthread_cond_t drained_cond; // Signalled when a queue shrinks, for the block policy
+    unsigned long total_clients;
+    BridgeApp *app;
+};
+
+SniffTcpServer* sniff_tcp_server_new(BridgeApp *app, int port);
+void sniff_tcp_server_free(SniffTcpServer *server);
+void sniff_tcp_broadcast(SniffTcpServer *server, struct SniffConsumer *consumer,
+                         const char *data, size_t len);
+void sniff_tcp_format_stats(SniffTcpServer *server, char *buffer, size_t buffer_size);
+
+#endif // SNIFF_TCP_H
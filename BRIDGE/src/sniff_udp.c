@@ -0,0 +1,182 @@
+/*
+ * Sniff UDP sender for BRIDGE - Virtual Null Modem Bridge
+ * Runs on the UDP sniff consumer's thread. Small packets are coalesced into
+ * datagrams of up to SNIFF_UDP_DATAGRAM_SIZE and large ones split across
+ * several; full batches go out with a single sendmmsg(). A batch is flushed
+ * as soon as the consumer catches up, so coalescing only happens under load
+ * and never holds data longer than SNIFF_UDP_MAX_DELAY_MS.
+ */
+
+#include "sniff_udp.h"
+#include "relay.h"
+#include "utils.h"
+#include <netdb.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static gboolean resolve_destination(BridgeApp *app, const char *address, int port,
+                                    struct sockaddr_in *destination) {
+    struct addrinfo hints, *result;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    int error = getaddrinfo(address, NULL, &hints, &result);
+    if (error != 0) {
+        log_message(app, "Failed to resolve UDP address %s: %s", address, gai_strerror(error));
+        return FALSE;
+    }
+
+    memcpy(destination, result->ai_addr, sizeof(*destination));
+    destination->sin_port = htons(port);
+    freeaddrinfo(result);
+    return TRUE;
+}
+
+// Interface given by address ("192.168.1.10") or by name ("eth0")
+static gboolean set_multicast_interface(BridgeApp *app, int fd, const char *interface) {
+    struct ip_mreqn request;
+
+    memset(&request, 0, sizeof(request));
+    if (inet_pton(AF_INET, interface, &request.imr_address) != 1) {
+        request.imr_ifindex = if_nametoindex(interface);
+        if (request.imr_ifindex == 0) {
+            log_message(app, "Unknown multicast interface %s", interface);
+            return FALSE;
+        }
+    }
+
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request)) < 0) {
+        log_message(app, "Failed to use multicast interface %s: %s", interface, strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+SniffUdpSender* sniff_udp_sender_new(BridgeApp *app, const char *address, int port,
+                                     int ttl, const char *interface) {
+    SniffUdpSender *sender = calloc(1, sizeof(SniffUdpSender));
+    if (!sender) return NULL;
+
+    sender->app = app;
+    sender->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sender->fd < 0) {
+        log_message(app, "Failed to create UDP socket: %s", strerror(errno));
+        sniff_udp_sender_free(sender);
+        return NULL;
+    }
+
+    if (!resolve_destination(app, address, port, &sender->destination)) {
+        sniff_udp_sender_free(sender);
+        return NULL;
+    }
+
+    if (IN_MULTICAST(ntohl(sender->destination.sin_addr.s_addr))) {
+        if (setsockopt(sender->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+            log_message(app, "Failed to set multicast TTL %d: %s", ttl, strerror(errno));
+            sniff_udp_sender_free(sender);
+            return NULL;
+        }
+        if (interface && interface[0] && !set_multicast_interface(app, sender->fd, interface)) {
+            sniff_udp_sender_free(sender);
+            return NULL;
+        }
+    } else {
+        // Broadcast addresses are refused without this
+        int opt = 1;
+        setsockopt(sender->fd, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt));
+    }
+
+    if (connect(sender->fd, (struct sockaddr*)&sender->destination, sizeof(sender->destination)) < 0) {
+        log_message(app, "Failed to set UDP destination %s:%d: %s", address, port, strerror(errno));
+        sniff_udp_sender_free(sender);
+        return NULL;
+    }
+
+    return sender;
+}
+
+void sniff_udp_sender_free(SniffUdpSender *sender) {
+    if (!sender) return;
+
+    if (sender->fd >= 0) close(sender->fd);
+    free(sender);
+}
+
+void sniff_udp_flush(SniffUdpSender *sender) {
+    struct mmsghdr messages[SNIFF_UDP_BATCH];
+    struct iovec vectors[SNIFF_UDP_BATCH];
+    int sent = 0;
+
+    memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < sender->count; i++) {
+        vectors[i].iov_base = sender->datagrams[i];
+        vectors[i].iov_len = sender->lengths[i];
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (sent < sender->count) {
+        int result = sendmmsg(sender->fd, messages + sent, sender->count - sent, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            // Nobody listening on a unicast port, or a full queue: the datagram is lost
+            // and the receiver sees the sequence gap
+            sender->send_errors++;
+            sent++;
+            continue;
+        }
+        sent += result;
+        sender->datagrams_sent += result;
+    }
+
+    sender->count = 0;
+}
+
+// Start a datagram carrying data captured at timestamp
+static void start_datagram(SniffUdpSender *sender, const struct timespec *timestamp) {
+    if (sender->count == SNIFF_UDP_BATCH) {
+        sniff_udp_flush(sender);
+    }
+    if (sender->count == 0) {
+        sender->batch_start_ns = relay_now_ns();
+    }
+
+    SniffUdpHeader header;
+    header.sequence = sender->sequence++;
+    header.timestamp_us = (uint64_t)timestamp->tv_sec * 1000000ULL + timestamp->tv_nsec / 1000;
+
+    sniff_udp_encode((unsigned char *)sender->datagrams[sender->count], &header);
+    sender->lengths[sender->count] = SNIFF_UDP_HEADER_SIZE;
+    sender->count++;
+}
+
+void sniff_udp_append(SniffUdpSender *sender, const struct timespec *timestamp,
+                      const char *data, size_t len) {
+    while (len > 0) {
+        if (sender->count == 0 || sender->lengths[sender->count - 1] == SNIFF_UDP_DATAGRAM_SIZE) {
+            start_datagram(sender, timestamp);
+        }
+
+        int last = sender->count - 1;
+        size_t room = SNIFF_UDP_DATAGRAM_SIZE - sender->lengths[last];
+        size_t chunk = len < room ? len : room;
+
+        memcpy(sender->datagrams[last] + sender->lengths[last], data, chunk);
+        sender->lengths[last] += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+
+    if (sender->count > 0 &&
+        relay_now_ns() - sender->batch_start_ns >= SNIFF_UDP_MAX_DELAY_MS * 1000000ULL) {
+        sniff_udp_flush(sender);
+    }
+}
+
+void sniff_udp_format_stats(SniffUdpSender *sender, char *buffer, size_t buffer_size) {
+    snprintf(buffer, buffer_size, "UDP datagrams: %lu sent, %lu failed, next seq %u",
+             sender->datagrams_sent, sender->send_errors, sender->sequence);
+}
@@ -0,0 +1,42 @@
+/*
+ * Sniff UDP sender header for BRIDGE - Virtual Null Modem Bridge
+ * Packs sniffed data into sequenced, MTU-sized datagrams sent in batches
+ */
+
+#ifndef SNIFF_UDP_H
+#define SNIFF_UDP_H
+
+#include "common.h"
+#include "sniff_protocol.h"
+#include <stdint.h>
+#include <netinet/in.h>
+
+// Largest datagram sent, header included: a 1500 byte Ethernet MTU less IP and UDP headers
+#define SNIFF_UDP_DATAGRAM_SIZE 1472
+// Datagrams handed to the kernel in one sendmmsg call
+#define SNIFF_UDP_BATCH 64
+// Longest a byte waits in a partly filled batch while the output is busy
+#define SNIFF_UDP_MAX_DELAY_MS 2
+
+typedef struct SniffUdpSender {
+    int fd;                     // Connected to the destination, so it is resolved once
+    struct sockaddr_in destination;
+    uint32_t sequence;
+    char datagrams[SNIFF_UDP_BATCH][SNIFF_UDP_DATAGRAM_SIZE];
+    size_t lengths[SNIFF_UDP_BATCH];
+    int count;                  // Datagrams in the batch; the last may still be filling
+    uint64_t batch_start_ns;
+    unsigned long datagrams_sent;
+    unsigned long send_errors;
+    BridgeApp *app;
+} SniffUdpSender;
+
+SniffUdpSender* sniff_udp_sender_new(BridgeApp *app, const char *address, int port,
+                                     int ttl, const char *interface);
+void sniff_udp_sender_free(SniffUdpSender *sender);
+void sniff_udp_append(SniffUdpSender *sender, const struct timespec *timestamp,
+                      const char *data, size_t len);
+void sniff_udp_flush(SniffUdpSender *sender);
+void sniff_udp_format_stats(SniffUdpSender *sender, char *buffer, size_t buffer_size);
+
+#endif // SNIFF_UDP_H
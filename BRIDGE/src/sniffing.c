@@ -4,7 +4,14 @@
  */
 
 #include "sniffing.h"
+#include "sniff_ring.h"
+#include "sniff_tcp.h"
+#include "sniff_udp.h"
+#include "sniff_pcap.h"
+#include "sniff_file.h"
+#include "sniff_protocol.h"
 #include "utils.h"
+#include "nullmodem.h"
 #include <sys/stat.h>
 #include <fcntl.h>
 
@@ -13,24 +20,33 @@ gboolean init_sniffing(BridgeApp *app) {
     app->sniffing_enabled = FALSE;
     app->sniff_output_methods = SNIFF_OUTPUT_NONE;
     app->sniff_direction = SNIFF_DIRECTION_BOTH;
-    app->sniff_format = SNIFF_FORMAT_RAW;
+    app->sniff_format = SNIFF_FORMAT_HEX;   // As the Sniffing tab starts out
+    app->sniff_slow_policy = SNIFF_POLICY_DROP_OLDEST;
     
     strncpy(app->sniff_pipe_path, DEFAULT_SNIFF_PIPE, MAX_PATH_LENGTH - 1);
     app->sniff_tcp_port = DEFAULT_SNIFF_TCP_PORT;
     app->sniff_udp_port = DEFAULT_SNIFF_UDP_PORT;
     strncpy(app->sniff_udp_addr, DEFAULT_SNIFF_UDP_ADDR, 63);
+    app->sniff_udp_ttl = DEFAULT_SNIFF_UDP_TTL;
+    app->sniff_udp_iface[0] = '\0';
+    app->sniff_pcap_path[0] = '\0';
+    app->sniff_pcap_live = FALSE;
+    app->sniff_pcap_rotate_mb = 0;
+    app->sniff_pcap_rotate_seconds = 0;
+    app->sniff_file_gzip = FALSE;
+    app->sniff_file_rotate_mb = 0;
+    app->sniff_file_rotate_seconds = 0;
+    app->sniff_file_keep = 0;
     
     // Initialize runtime state
     app->sniff_thread_running = FALSE;
     app->sniff_pipe_fd = -1;
-    app->sniff_tcp_server_fd = -1;
-    app->sniff_udp_fd = -1;
-    app->sniff_log_fp = NULL;
-    
-    // Initialize client connections
-    for (int i = 0; i < MAX_SNIFF_CLIENTS; i++) {
-        app->sniff_tcp_client_fds[i] = -1;
-    }
+    app->sniff_tcp = NULL;
+    app->sniff_udp = NULL;
+    app->sniff_file = NULL;
+    app->sniff_pcap = NULL;
+    app->sniff_ring = NULL;
+    pthread_mutex_init(&app->sniff_mutex, NULL);
     
     // Initialize statistics
     app->sniff_bytes_captured = 0;
@@ -49,6 +65,17 @@ void cleanup_sniffing(BridgeApp *app) {
     cleanup_sniff_tcp_server(app);
     cleanup_sniff_udp_socket(app);
     cleanup_sniff_log_file(app);
+    cleanup_sniff_pcap(app);
+}
+
+// An output that gets no consumer would be open but never fed
+static gboolean add_output_consumer(BridgeApp *app, const char *name, int fd,
+                                    SniffDeliverFunc deliver, SniffIdleFunc idle) {
+    if (sniff_ring_add_consumer(app->sniff_ring, name, fd, deliver, idle, app->sniff_slow_policy)) {
+        return TRUE;
+    }
+    log_message(app, "Failed to start the %s sniff output: %s", name, strerror(errno));
+    return FALSE;
 }
 
 gboolean start_sniffing(BridgeApp *app) {
@@ -82,20 +109,56 @@ gboolean start_sniffing(BridgeApp *app) {
     if (app->sniff_output_methods & SNIFF_OUTPUT_FILE) {
         setup_success &= setup_sniff_log_file(app);
     }
+
+    if (app->sniff_output_methods & SNIFF_OUTPUT_PCAPNG) {
+        setup_success &= setup_sniff_pcap(app);
+    }
     
     if (!setup_success) {
         log_message(app, "Failed to setup sniffing outputs");
         cleanup_sniffing(app);
         return FALSE;
     }
+
+    // Each output reads the ring on its own thread; all TCP clients share one
+    app->sniff_ring = sniff_ring_new(app);
+    if (!app->sniff_ring) {
+        log_message(app, "Failed to allocate sniff ring");
+        cleanup_sniffing(app);
+        return FALSE;
+    }
+    gboolean consumers_started = TRUE;
+    if (app->sniff_pipe_fd >= 0) {
+        consumers_started &= add_output_consumer(app, "Pipe", app->sniff_pipe_fd, deliver_to_pipe, NULL);
+    }
+    if (consumers_started && app->sniff_tcp) {
+        consumers_started &= add_output_consumer(app, "TCP", -1, deliver_to_tcp_clients, NULL);
+    }
+    if (consumers_started && app->sniff_udp) {
+        consumers_started &= add_output_consumer(app, "UDP", app->sniff_udp->fd, deliver_to_udp, flush_udp);
+    }
+    if (consumers_started && app->sniff_file) {
+        consumers_started &= add_output_consumer(app, "File", -1, deliver_to_log_file, flush_log_file);
+    }
+    if (consumers_started && app->sniff_pcap) {
+        consumers_started &= add_output_consumer(app, "pcapng", -1, deliver_to_pcap, flush_pcap);
+    }
+    if (!consumers_started) {
+        release_sniff_ring(app);
+        cleanup_sniffing(app);
+        return FALSE;
+    }
     
-    // Start sniffing thread
+    // Start sniffing thread; the relay tap starts delivering data from here on
+    app->sniff_bytes_captured = 0;
+    app->sniff_packets_sent = 0;
     app->sniff_thread_running = TRUE;
     app->sniff_start_time = time(NULL);
     
     if (pthread_create(&app->sniff_thread, NULL, sniffing_thread_func, app) != 0) {
         log_message(app, "Failed to create sniffing thread");
         app->sniff_thread_running = FALSE;
+        release_sniff_ring(app);
         cleanup_sniffing(app);
         return FALSE;
     }
@@ -111,9 +174,13 @@ void stop_sniffing(BridgeApp *app) {
     
     log_message(app, "Stopping sniffing...");
     
-    // Stop sniffing thread
+    // Stop sniffing thread; stopping the ring first releases a relay blocked on it
     app->sniff_thread_running = FALSE;
+    if (app->sniff_ring) {
+        sniff_ring_stop(app->sniff_ring);
+    }
     pthread_join(app->sniff_thread, NULL);
+    release_sniff_ring(app);
     
     // Cleanup outputs
     cleanup_sniffing(app);
@@ -121,6 +188,14 @@ void stop_sniffing(BridgeApp *app) {
     log_message(app, "Sniffing stopped");
 }
 
+// Free the ring once the relay tap can no longer be inside it
+void release_sniff_ring(BridgeApp *app) {
+    pthread_mutex_lock(&app->sniff_mutex);
+    sniff_ring_free(app->sniff_ring);
+    app->sniff_ring = NULL;
+    pthread_mutex_unlock(&app->sniff_mutex);
+}
+
 gboolean is_sniffing_active(BridgeApp *app) {
     return app->sniff_thread_running;
 }
@@ -136,8 +211,9 @@ gboolean setup_sniff_pipe(BridgeApp *app) {
         return FALSE;
     }
     
-    // Open pipe for writing (non-blocking)
-    app->sniff_pipe_fd = open(app->sniff_pipe_path, O_WRONLY | O_NONBLOCK);
+    // Open read-write so the open succeeds without a reader and writes never
+    // raise SIGPIPE; data is dropped while nobody drains the pipe
+    app->sniff_pipe_fd = open(app->sniff_pipe_path, O_RDWR | O_NONBLOCK);
     if (app->sniff_pipe_fd < 0) {
         log_message(app, "Failed to open sniff pipe %s: %s", 
                    app->sniff_pipe_path, strerror(errno));
@@ -150,61 +226,24 @@ gboolean setup_sniff_pipe(BridgeApp *app) {
 }
 
 gboolean setup_sniff_tcp_server(BridgeApp *app) {
-    struct sockaddr_in server_addr;
-    
-    // Create TCP socket
-    app->sniff_tcp_server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (app->sniff_tcp_server_fd < 0) {
-        log_message(app, "Failed to create TCP socket: %s", strerror(errno));
+    // Clients are accepted and served on the server's own event loop
+    app->sniff_tcp = sniff_tcp_server_new(app, app->sniff_tcp_port);
+    if (!app->sniff_tcp) {
         return FALSE;
     }
-    
-    // Set socket options
-    int opt = 1;
-    setsockopt(app->sniff_tcp_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    // Bind to port
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(app->sniff_tcp_port);
-    
-    if (bind(app->sniff_tcp_server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        log_message(app, "Failed to bind TCP socket to port %d: %s", 
-                   app->sniff_tcp_port, strerror(errno));
-        close(app->sniff_tcp_server_fd);
-        app->sniff_tcp_server_fd = -1;
-        return FALSE;
-    }
-    
-    // Listen for connections
-    if (listen(app->sniff_tcp_server_fd, MAX_SNIFF_CLIENTS) < 0) {
-        log_message(app, "Failed to listen on TCP socket: %s", strerror(errno));
-        close(app->sniff_tcp_server_fd);
-        app->sniff_tcp_server_fd = -1;
-        return FALSE;
-    }
-    
+
     log_message(app, "✓ TCP server listening on port %d", app->sniff_tcp_port);
     return TRUE;
 }
 
 gboolean setup_sniff_udp_socket(BridgeApp *app) {
-    struct sockaddr_in udp_addr;
-    
-    // Create UDP socket
-    app->sniff_udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (app->sniff_udp_fd < 0) {
-        log_message(app, "Failed to create UDP socket: %s", strerror(errno));
+    // Destination, TTL and interface are settled here, not per packet
+    app->sniff_udp = sniff_udp_sender_new(app, app->sniff_udp_addr, app->sniff_udp_port,
+                                          app->sniff_udp_ttl, app->sniff_udp_iface);
+    if (!app->sniff_udp) {
         return FALSE;
     }
-    
-    // Set up broadcast address
-    memset(&udp_addr, 0, sizeof(udp_addr));
-    udp_addr.sin_family = AF_INET;
-    udp_addr.sin_port = htons(app->sniff_udp_port);
-    inet_pton(AF_INET, app->sniff_udp_addr, &udp_addr.sin_addr);
-    
+
     log_message(app, "✓ UDP socket ready for %s:%d", app->sniff_udp_addr, app->sniff_udp_port);
     return TRUE;
 }
@@ -220,14 +259,43 @@ gboolean setup_sniff_log_file(BridgeApp *app) {
                 tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec);
     }
     
-    app->sniff_log_fp = fopen(app->sniff_log_file, "w");
-    if (!app->sniff_log_fp) {
-        log_message(app, "Failed to open log file %s: %s", 
-                   app->sniff_log_file, strerror(errno));
+    app->sniff_file = sniff_file_writer_new(app, app->sniff_log_file, app->sniff_file_gzip,
+                                            app->sniff_file_rotate_mb, app->sniff_file_rotate_seconds,
+                                            app->sniff_file_keep);
+    if (!app->sniff_file) {
         return FALSE;
     }
     
-    log_message(app, "✓ Sniff log file opened: %s", app->sniff_log_file);
+    log_message(app, "✓ Sniff log file opened: %s", app->sniff_file->current_path);
+    return TRUE;
+}
+
+gboolean setup_sniff_pcap(BridgeApp *app) {
+    if (strlen(app->sniff_pcap_path) == 0) {
+        if (app->sniff_pcap_live) {
+            strncpy(app->sniff_pcap_path, DEFAULT_SNIFF_PCAP_FIFO, MAX_PATH_LENGTH - 1);
+        } else {
+            time_t now = time(NULL);
+            struct tm *tm_info = localtime(&now);
+            snprintf(app->sniff_pcap_path, MAX_PATH_LENGTH,
+                    "bridge_sniff_%04d%02d%02d_%02d%02d%02d.pcapng",
+                    tm_info->tm_year + 1900, tm_info->tm_mon + 1, tm_info->tm_mday,
+                    tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec);
+        }
+    }
+
+    // Live mode waits for a reader on its own; rotation only applies to files
+    app->sniff_pcap = sniff_pcap_writer_new(app, app->sniff_pcap_path, app->sniff_pcap_live,
+                                            app->sniff_pcap_rotate_mb, app->sniff_pcap_rotate_seconds);
+    if (!app->sniff_pcap) {
+        return FALSE;
+    }
+
+    if (app->sniff_pcap_live) {
+        log_message(app, "✓ pcapng FIFO ready: wireshark -k -i %s", app->sniff_pcap_path);
+    } else {
+        log_message(app, "✓ Sniff pcapng file opened: %s", app->sniff_pcap->current_path);
+    }
     return TRUE;
 }
 
@@ -240,25 +308,30 @@ void cleanup_sniff_pipe(BridgeApp *app) {
 }
 
 void cleanup_sniff_tcp_server(BridgeApp *app) {
-    cleanup_tcp_clients(app);
-    
-    if (app->sniff_tcp_server_fd >= 0) {
-        close(app->sniff_tcp_server_fd);
-        app->sniff_tcp_server_fd = -1;
+    if (app->sniff_tcp) {
+        sniff_tcp_server_free(app->sniff_tcp);
+        app->sniff_tcp = NULL;
     }
 }
 
 void cleanup_sniff_udp_socket(BridgeApp *app) {
-    if (app->sniff_udp_fd >= 0) {
-        close(app->sniff_udp_fd);
-        app->sniff_udp_fd = -1;
+    if (app->sniff_udp) {
+        sniff_udp_sender_free(app->sniff_udp);
+        app->sniff_udp = NULL;
     }
 }
 
 void cleanup_sniff_log_file(BridgeApp *app) {
-    if (app->sniff_log_fp) {
-        fclose(app->sniff_log_fp);
-        app->sniff_log_fp = NULL;
+    if (app->sniff_file) {
+        sniff_file_writer_free(app->sniff_file);
+        app->sniff_file = NULL;
+    }
+}
+
+void cleanup_sniff_pcap(BridgeApp *app) {
+    if (app->sniff_pcap) {
+        sniff_pcap_writer_free(app->sniff_pcap);
+        app->sniff_pcap = NULL;
     }
 }
 
@@ -268,67 +341,62 @@ void* sniffing_thread_func(void *arg) {
     log_message(app, "Sniffing thread started");
 
     while (app->sniff_thread_running) {
-        // Accept new TCP clients if TCP output is enabled
-        if (app->sniff_output_methods & SNIFF_OUTPUT_TCP) {
-            accept_tcp_clients(app);
-        }
-
-        // Sleep briefly to avoid busy waiting
         usleep(100000); // 100ms
+
+        // Release outputs whose consumer gave up (disconnect policy)
+        sniff_ring_reap(app->sniff_ring);
     }
 
     log_message(app, "Sniffing thread stopped");
     return NULL;
 }
 
-void process_sniff_data(BridgeApp *app, const char *data, size_t len, char direction) {
+// Relay tap: called on the relay thread for every chunk it moves. The data is
+// only referenced, and nothing is done at all while sniffing is off.
+void process_sniff_data(BridgeApp *app, int channel, const char *data, size_t len, char direction) {
     if (!is_sniffing_active(app) || !should_capture_direction(app, direction)) {
         return;
     }
 
-    // Create sniff packet
     SniffPacket packet;
-    packet.timestamp = time(NULL);
+    clock_gettime(CLOCK_REALTIME, &packet.timestamp);
     packet.direction = direction;
-    packet.data_len = (len > MAX_SNIFF_BUFFER_SIZE) ? MAX_SNIFF_BUFFER_SIZE : len;
-    memcpy(packet.data, data, packet.data_len);
-
-    // Stream to all configured outputs
-    stream_to_outputs(app, &packet);
-
-    // Update statistics
-    update_sniff_statistics(app, packet.data_len);
-}
-
-void stream_to_outputs(BridgeApp *app, const SniffPacket *packet) {
-    char *formatted_data = format_sniff_data(packet, app->sniff_format);
-    if (!formatted_data) {
-        return;
-    }
+    packet.channel = (uint8_t)channel;
+    packet.sequence = 0;        // Numbered by the ring
+    packet.data_len = len;
+    packet.data = data;
 
-    // Send to each enabled output method
-    if (app->sniff_output_methods & SNIFF_OUTPUT_PIPE) {
-        write_to_pipe(app, formatted_data);
-    }
+    pthread_mutex_lock(&app->sniff_mutex);
+    if (app->sniff_ring) {
+        // One copy into the ring; the outputs read it from there at their own pace
+        sniff_ring_publish(app->sniff_ring, &packet);
 
-    if (app->sniff_output_methods & SNIFF_OUTPUT_TCP) {
-        write_to_tcp_clients(app, formatted_data);
-    }
-
-    if (app->sniff_output_methods & SNIFF_OUTPUT_UDP) {
-        write_to_udp(app, formatted_data);
+        // Update statistics
+        update_sniff_statistics(app, packet.data_len);
     }
+    pthread_mutex_unlock(&app->sniff_mutex);
+}
 
-    if (app->sniff_output_methods & SNIFF_OUTPUT_FILE) {
-        write_to_log_file(app, formatted_data);
+// Bytes to send for packet in the configured format. Raw output is the packet
+// itself; otherwise *formatted is set and must be freed by the caller.
+static const char* format_for_output(BridgeApp *app, const SniffPacket *packet,
+                                     size_t *len, char **formatted) {
+    *formatted = NULL;
+    if (app->sniff_format == SNIFF_FORMAT_RAW) {
+        *len = packet->data_len;
+        return packet->data;
     }
 
-    free(formatted_data);
+    // Pairs are only told apart when there is more than one
+    *formatted = format_sniff_data(packet, app->sniff_format, sniff_channel_count(app) > 1, len);
+    return *formatted;
 }
 
-char* format_sniff_data(const SniffPacket *packet, SniffFormat format) {
+char* format_sniff_data(const SniffPacket *packet, SniffFormat format, gboolean with_channel,
+                        size_t *formatted_len) {
     char *result = NULL;
     size_t result_size = 0;
+    int offset = 0;
 
     // Calculate required buffer size based on format
     switch (format) {
@@ -338,6 +406,7 @@ char* format_sniff_data(const SniffPacket *packet, SniffFormat format) {
             if (result) {
                 memcpy(result, packet->data, packet->data_len);
                 result[packet->data_len] = '\0';
+                offset = (int)packet->data_len;
             }
             break;
 
@@ -346,134 +415,141 @@ char* format_sniff_data(const SniffPacket *packet, SniffFormat format) {
             result_size = 64 + (packet->data_len * 3) + 1;
             result = malloc(result_size);
             if (result) {
-                char timestamp_str[32];
-                struct tm *tm_info = localtime(&packet->timestamp);
-                strftime(timestamp_str, sizeof(timestamp_str), "%H:%M:%S", tm_info);
-
-                int offset = snprintf(result, result_size, "%s %c: ", timestamp_str, packet->direction);
+                offset = format_sniff_timestamp(packet, with_channel, result, result_size);
 
                 for (size_t i = 0; i < packet->data_len; i++) {
                     offset += snprintf(result + offset, result_size - offset, "%02X ",
                                      (unsigned char)packet->data[i]);
                 }
-                snprintf(result + offset, result_size - offset, "\n");
+                offset += snprintf(result + offset, result_size - offset, "\n");
             }
             break;
 
+        case SNIFF_FORMAT_FRAMED: {
+            // Binary safe and self-describing; the header carries what RAW loses
+            SniffFrameHeader header = {
+                .version = SNIFF_FRAME_VERSION,
+                .direction = packet->direction,
+                .channel = packet->channel,
+                .flags = 0,
+                .sequence = packet->sequence,
+                .timestamp_ns = (uint64_t)packet->timestamp.tv_sec * 1000000000ULL + packet->timestamp.tv_nsec,
+                .length = (uint32_t)packet->data_len
+            };
+            result_size = SNIFF_FRAME_HEADER_SIZE + packet->data_len;
+            result = malloc(result_size);
+            if (result) {
+                sniff_frame_encode((unsigned char *)result, &header);
+                memcpy(result + SNIFF_FRAME_HEADER_SIZE, packet->data, packet->data_len);
+                offset = (int)result_size;
+            }
+            break;
+        }
+
         case SNIFF_FORMAT_TEXT:
             // Format: "TIMESTAMP DIR: TEXT_DATA\n"
             result_size = 64 + packet->data_len + 1;
             result = malloc(result_size);
             if (result) {
-                char timestamp_str[32];
-                struct tm *tm_info = localtime(&packet->timestamp);
-                strftime(timestamp_str, sizeof(timestamp_str), "%H:%M:%S", tm_info);
-
-                snprintf(result, result_size, "%s %c: %.*s\n",
-                        timestamp_str, packet->direction,
-                        (int)packet->data_len, packet->data);
+                offset = format_sniff_timestamp(packet, with_channel, result, result_size);
+                memcpy(result + offset, packet->data, packet->data_len);
+                offset += (int)packet->data_len;
+                result[offset++] = '\n';
+                result[offset] = '\0';
             }
             break;
     }
 
+    if (formatted_len) {
+        *formatted_len = result ? (size_t)offset : 0;
+    }
     return result;
 }
 
-void write_to_pipe(BridgeApp *app, const char *formatted_data) {
-    if (app->sniff_pipe_fd >= 0) {
-        ssize_t written = write(app->sniff_pipe_fd, formatted_data, strlen(formatted_data));
-        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-            // Pipe error (reader disconnected, etc.)
-            log_message(app, "Pipe write error: %s", strerror(errno));
-        }
+// "HH:MM:SS.uuuuuu D: " prefix for the text formats, "HH:MM:SS.uuuuuu #N D: " with the pair
+int format_sniff_timestamp(const SniffPacket *packet, gboolean with_channel,
+                           char *buffer, size_t buffer_size) {
+    char timestamp_str[32];
+    char channel_str[8] = "";
+    struct tm tm_info;
+
+    localtime_r(&packet->timestamp.tv_sec, &tm_info);
+    strftime(timestamp_str, sizeof(timestamp_str), "%H:%M:%S", &tm_info);
+    if (with_channel) {
+        snprintf(channel_str, sizeof(channel_str), "#%u ", packet->channel);
     }
+    return snprintf(buffer, buffer_size, "%s.%06ld %s%c: ", timestamp_str,
+                    packet->timestamp.tv_nsec / 1000, channel_str, packet->direction);
 }
 
-void write_to_tcp_clients(BridgeApp *app, const char *formatted_data) {
-    size_t data_len = strlen(formatted_data);
+// Consumer delivery functions; each runs on its output's own thread
 
-    for (int i = 0; i < MAX_SNIFF_CLIENTS; i++) {
-        if (app->sniff_tcp_client_fds[i] >= 0) {
-            ssize_t written = write(app->sniff_tcp_client_fds[i], formatted_data, data_len);
-            if (written < 0) {
-                // Client disconnected or error
-                close(app->sniff_tcp_client_fds[i]);
-                app->sniff_tcp_client_fds[i] = -1;
-            }
-        }
-    }
+gboolean deliver_to_pipe(SniffConsumer *consumer, const SniffPacket *packet) {
+    char *formatted;
+    size_t len;
+    const char *output = format_for_output(consumer->ring->app, packet, &len, &formatted);
+    if (!output) return TRUE;
+
+    // A pipe error is not fatal; the next reader gets the data from here on
+    sniff_consumer_write(consumer, consumer->fd, output, len);
+    free(formatted);
+    return TRUE;
 }
 
-void write_to_udp(BridgeApp *app, const char *formatted_data) {
-    if (app->sniff_udp_fd >= 0) {
-        struct sockaddr_in udp_addr;
-        memset(&udp_addr, 0, sizeof(udp_addr));
-        udp_addr.sin_family = AF_INET;
-        udp_addr.sin_port = htons(app->sniff_udp_port);
-        inet_pton(AF_INET, app->sniff_udp_addr, &udp_addr.sin_addr);
+// Formatted once and fanned out to every connected client
+gboolean deliver_to_tcp_clients(SniffConsumer *consumer, const SniffPacket *packet) {
+    BridgeApp *app = consumer->ring->app;
+    char *formatted;
+    size_t len;
+    const char *output = format_for_output(app, packet, &len, &formatted);
+    if (!output) return TRUE;
 
-        sendto(app->sniff_udp_fd, formatted_data, strlen(formatted_data), 0,
-               (struct sockaddr*)&udp_addr, sizeof(udp_addr));
-    }
+    sniff_tcp_broadcast(app->sniff_tcp, consumer, output, len);
+    free(formatted);
+    return TRUE;
 }
 
-void write_to_log_file(BridgeApp *app, const char *formatted_data) {
-    if (app->sniff_log_fp) {
-        fprintf(app->sniff_log_fp, "%s", formatted_data);
-        fflush(app->sniff_log_fp);
-    }
-}
+// Batched into datagrams; flush_udp sends them once the consumer catches up
+gboolean deliver_to_udp(SniffConsumer *consumer, const SniffPacket *packet) {
+    BridgeApp *app = consumer->ring->app;
+    char *formatted;
+    size_t len;
+    const char *output = format_for_output(app, packet, &len, &formatted);
+    if (!output) return TRUE;
 
-void accept_tcp_clients(BridgeApp *app) {
-    if (app->sniff_tcp_server_fd < 0) {
-        return;
-    }
+    sniff_udp_append(app->sniff_udp, &packet->timestamp, output, len);
+    free(formatted);
+    return TRUE;
+}
 
-    // Set socket to non-blocking for accept
-    int flags = fcntl(app->sniff_tcp_server_fd, F_GETFL, 0);
-    fcntl(app->sniff_tcp_server_fd, F_SETFL, flags | O_NONBLOCK);
+void flush_udp(SniffConsumer *consumer) {
+    sniff_udp_flush(consumer->ring->app->sniff_udp);
+}
 
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
+gboolean deliver_to_log_file(SniffConsumer *consumer, const SniffPacket *packet) {
+    BridgeApp *app = consumer->ring->app;
+    char *formatted;
+    size_t len;
+    const char *output = format_for_output(app, packet, &len, &formatted);
+    if (!output) return TRUE;
 
-    int client_fd = accept(app->sniff_tcp_server_fd, (struct sockaddr*)&client_addr, &client_len);
-    if (client_fd >= 0) {
-        // Find empty slot for new client
-        for (int i = 0; i < MAX_SNIFF_CLIENTS; i++) {
-            if (app->sniff_tcp_client_fds[i] < 0) {
-                app->sniff_tcp_client_fds[i] = client_fd;
-                log_message(app, "TCP client connected: %s", inet_ntoa(client_addr.sin_addr));
-                break;
-            }
-        }
+    // Buffered; the file's own thread compresses and writes it
+    sniff_file_append(app->sniff_file, packet, output, len);
+    free(formatted);
+    return TRUE;
+}
 
-        // If no slots available, close connection
-        if (client_fd >= 0) {
-            gboolean slot_found = FALSE;
-            for (int i = 0; i < MAX_SNIFF_CLIENTS; i++) {
-                if (app->sniff_tcp_client_fds[i] == client_fd) {
-                    slot_found = TRUE;
-                    break;
-                }
-            }
-            if (!slot_found) {
-                close(client_fd);
-                log_message(app, "TCP client rejected: maximum clients reached");
-            }
-        }
-    }
+void flush_log_file(SniffConsumer *consumer) {
+    sniff_file_idle(consumer->ring->app->sniff_file);
+}
 
-    // Restore blocking mode
-    fcntl(app->sniff_tcp_server_fd, F_SETFL, flags);
+// Always pcapng, whatever the configured format
+gboolean deliver_to_pcap(SniffConsumer *consumer, const SniffPacket *packet) {
+    return sniff_pcap_append(consumer->ring->app->sniff_pcap, consumer, packet);
 }
 
-void cleanup_tcp_clients(BridgeApp *app) {
-    for (int i = 0; i < MAX_SNIFF_CLIENTS; i++) {
-        if (app->sniff_tcp_client_fds[i] >= 0) {
-            close(app->sniff_tcp_client_fds[i]);
-            app->sniff_tcp_client_fds[i] = -1;
-        }
-    }
+void flush_pcap(SniffConsumer *consumer) {
+    sniff_pcap_idle(consumer->ring->app->sniff_pcap, consumer);
 }
 
 gboolean should_capture_direction(BridgeApp *app, char direction) {
@@ -7,16 +7,19 @@
 #define SNIFFING_H
 
 #include "common.h"
+#include <stdint.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 // Sniffing data packet structure
 typedef struct {
-    time_t timestamp;
+    struct timespec timestamp;  // Wall clock when the relay read the data
     char direction; // 'R' for RX, 'T' for TX
+    uint8_t channel;            // Null modem pair the data came through
+    uint64_t sequence;          // Position in the capture, set when read from the sniff ring
     size_t data_len;
-    char data[MAX_SNIFF_BUFFER_SIZE];
+    const char *data;           // Borrowed from the relay buffer for the duration of the call
 } SniffPacket;
 
 // Function declarations
@@ -31,27 +34,35 @@ gboolean setup_sniff_pipe(BridgeApp *app);
 gboolean setup_sniff_tcp_server(BridgeApp *app);
 gboolean setup_sniff_udp_socket(BridgeApp *app);
 gboolean setup_sniff_log_file(BridgeApp *app);
+gboolean setup_sniff_pcap(BridgeApp *app);
 
 void cleanup_sniff_pipe(BridgeApp *app);
 void cleanup_sniff_tcp_server(BridgeApp *app);
 void cleanup_sniff_udp_socket(BridgeApp *app);
 void cleanup_sniff_log_file(BridgeApp *app);
+void cleanup_sniff_pcap(BridgeApp *app);
 
 // Data processing and streaming
 void* sniffing_thread_func(void *arg);
-void process_sniff_data(BridgeApp *app, const char *data, size_t len, char direction);
-void stream_to_outputs(BridgeApp *app, const SniffPacket *packet);
+void process_sniff_data(BridgeApp *app, int channel, const char *data, size_t len, char direction);
+void release_sniff_ring(BridgeApp *app);
 
 // Output formatting
-char* format_sniff_data(const SniffPacket *packet, SniffFormat format);
-void write_to_pipe(BridgeApp *app, const char *formatted_data);
-void write_to_tcp_clients(BridgeApp *app, const char *formatted_data);
-void write_to_udp(BridgeApp *app, const char *formatted_data);
-void write_to_log_file(BridgeApp *app, const char *formatted_data);
-
-// TCP client management
-void accept_tcp_clients(BridgeApp *app);
-void cleanup_tcp_clients(BridgeApp *app);
+char* format_sniff_data(const SniffPacket *packet, SniffFormat format, gboolean with_channel,
+                        size_t *formatted_len);
+int format_sniff_timestamp(const SniffPacket *packet, gboolean with_channel,
+                           char *buffer, size_t buffer_size);
+
+// Output delivery, one sniff ring consumer per output
+struct SniffConsumer;
+gboolean deliver_to_pipe(struct SniffConsumer *consumer, const SniffPacket *packet);
+gboolean deliver_to_tcp_clients(struct SniffConsumer *consumer, const SniffPacket *packet);
+gboolean deliver_to_udp(struct SniffConsumer *consumer, const SniffPacket *packet);
+void flush_udp(struct SniffConsumer *consumer);
+gboolean deliver_to_log_file(struct SniffConsumer *consumer, const SniffPacket *packet);
+void flush_log_file(struct SniffConsumer *consumer);
+gboolean deliver_to_pcap(struct SniffConsumer *consumer, const SniffPacket *packet);
+void flush_pcap(struct SniffConsumer *consumer);
 
 // Utility functions
 gboolean should_capture_direction(BridgeApp *app, char direction);
@@ -0,0 +1,122 @@
+/*
+ * Stats socket for BRIDGE - Virtual Null Modem Bridge
+ * "socat - UNIX-CONNECT:/tmp/bridge_stats.sock" prints the latency percentiles,
+ * throughput and queue depths of every pair. The report is built from the
+ * lock-free relay metrics, so a query never holds up the relay.
+ */
+
+#include "stats_socket.h"
+#include "metrics.h"
+#include "utils.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static void send_report(StatsServer *server, int client_fd) {
+    char *report = malloc(STATS_REPORT_SIZE);
+    if (!report) return;
+
+    metrics_format_report(server->app, report, STATS_REPORT_SIZE);
+
+    // The report fits in the socket buffer; a client that does not read just misses it
+    size_t length = strlen(report);
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t sent = send(client_fd, report + offset, length - offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        offset += sent;
+    }
+    free(report);
+}
+
+static void on_listener_event(RelayLoop *loop, RelayEndpoint *endpoint, uint32_t events) {
+    (void)loop;
+    (void)events;
+    StatsServer *server = (StatsServer *)endpoint->owner;
+
+    for (;;) {
+        int client_fd = accept4(endpoint->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_message(server->app, "Stats socket accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        send_report(server, client_fd);
+        close(client_fd);
+        server->queries++;
+    }
+}
+
+StatsServer* stats_server_new(BridgeApp *app, const char *path) {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_message(app, "Stats socket path is too long: %s", path);
+        return NULL;
+    }
+
+    StatsServer *server = calloc(1, sizeof(StatsServer));
+    if (!server) return NULL;
+
+    server->app = app;
+    snprintf(server->path, sizeof(server->path), "%s", path);
+    server->listener.on_event = on_listener_event;
+    server->listener.owner = server;
+
+    server->listener.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listener.fd < 0) {
+        log_message(app, "Failed to create stats socket: %s", strerror(errno));
+        free(server);
+        return NULL;
+    }
+
+    // A previous instance that did not exit cleanly leaves its socket behind
+    unlink(path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    if (bind(server->listener.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        log_message(app, "Failed to bind stats socket %s: %s", path, strerror(errno));
+        close(server->listener.fd);
+        free(server);
+        return NULL;
+    }
+
+    if (listen(server->listener.fd, SOMAXCONN) < 0) {
+        log_message(app, "Failed to listen on stats socket: %s", strerror(errno));
+        stats_server_free(server);
+        return NULL;
+    }
+
+    server->loop = relay_loop_new(app);
+    if (!server->loop || !relay_loop_add(server->loop, &server->listener, EPOLLIN) ||
+        !relay_loop_start(server->loop)) {
+        log_message(app, "Failed to start stats socket loop");
+        stats_server_free(server);
+        return NULL;
+    }
+
+    return server;
+}
+
+// Must be freed before the relay pairs it reports on
+void stats_server_free(StatsServer *server) {
+    if (!server) return;
+
+    relay_loop_free(server->loop);
+    if (server->listener.fd >= 0) {
+        close(server->listener.fd);
+        unlink(server->path);
+    }
+    free(server);
+}
@@ -0,0 +1,26 @@
+/*
+ * Stats socket header for BRIDGE - Virtual Null Modem Bridge
+ * Answers every connection on a unix socket with the relay metrics report
+ */
+
+#ifndef STATS_SOCKET_H
+#define STATS_SOCKET_H
+
+#include "common.h"
+#include "relay.h"
+
+// Room for the header, one line per direction of every pair and the totals
+#define STATS_REPORT_SIZE (1024 + (MAX_BRIDGE_PAIRS + 1) * 2 * 512)
+
+typedef struct StatsServer {
+    RelayLoop *loop;            // Accepts queries on its own thread, off the relay thread
+    RelayEndpoint listener;
+    char path[MAX_PATH_LENGTH];
+    unsigned long queries;
+    BridgeApp *app;
+} StatsServer;
+
+StatsServer* stats_server_new(BridgeApp *app, const char *path);
+void stats_server_free(StatsServer *server);
+
+#endif // STATS_SOCKET_H
@@ -5,6 +5,10 @@
 
 #include "ui.h"
 #include "utils.h"
+#include "log_queue.h"
+#include "nullmodem.h"
+#include "relay.h"
+#include "mux.h"
 
 void create_main_window(BridgeApp *app) {
     // Create main window
@@ -58,6 +62,7 @@ void create_main_window(BridgeApp *app) {
     create_configuration_tab(app, app->notebook);
     create_status_tab(app, app->notebook);
     create_sniffing_tab(app, app->notebook);
+    create_impairments_tab(app, app->notebook);
     create_settings_tab(app, app->notebook);
 
     // Apply theme
@@ -83,21 +88,171 @@ void create_configuration_tab(BridgeApp *app, GtkWidget *notebook) {
     gtk_grid_set_row_spacing(GTK_GRID(config_grid), 5);
     gtk_grid_set_column_spacing(GTK_GRID(config_grid), 10);
 
+    // Mode
+    GtkWidget *mode_label = gtk_label_new("Mode:");
+    gtk_grid_attach(GTK_GRID(config_grid), mode_label, 0, 0, 1, 1);
+
+    app->mode_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mode_combo), "Null Modem");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mode_combo), "Port Multiplexer");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->mode_combo), 0);
+    gtk_grid_attach(GTK_GRID(config_grid), app->mode_combo, 1, 0, 1, 1);
+
     // Device 1
     GtkWidget *device1_label = gtk_label_new("Device 1:");
-    gtk_grid_attach(GTK_GRID(config_grid), device1_label, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(config_grid), device1_label, 0, 1, 1, 1);
     
     app->device1_entry = gtk_entry_new();
     gtk_entry_set_text(GTK_ENTRY(app->device1_entry), DEFAULT_DEVICE1);
-    gtk_grid_attach(GTK_GRID(config_grid), app->device1_entry, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(config_grid), app->device1_entry, 1, 1, 1, 1);
 
     // Device 2
     GtkWidget *device2_label = gtk_label_new("Device 2:");
-    gtk_grid_attach(GTK_GRID(config_grid), device2_label, 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(config_grid), device2_label, 0, 2, 1, 1);
     
     app->device2_entry = gtk_entry_new();
     gtk_entry_set_text(GTK_ENTRY(app->device2_entry), DEFAULT_DEVICE2);
-    gtk_grid_attach(GTK_GRID(config_grid), app->device2_entry, 1, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(config_grid), app->device2_entry, 1, 2, 1, 1);
+
+    // Number of pairs; pair N > 0 appends "_N" to both paths
+    GtkWidget *pairs_label = gtk_label_new("Pairs:");
+    gtk_grid_attach(GTK_GRID(config_grid), pairs_label, 0, 3, 1, 1);
+
+    app->pair_count_spin = gtk_spin_button_new_with_range(1, MAX_BRIDGE_PAIRS, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(app->pair_count_spin), 1);
+    gtk_widget_set_tooltip_text(app->pair_count_spin,
+                                "Extra pairs use the paths above with _1, _2, ... appended");
+    gtk_grid_attach(GTK_GRID(config_grid), app->pair_count_spin, 1, 3, 1, 1);
+
+    // Combo IDs are the setting values, see apply_loaded_settings
+    static const char *bauds[] = { "300", "1200", "2400", "4800", "9600", "19200", "38400",
+                                   "57600", "115200", "230400", "460800", "921600" };
+
+    // Serial timing of each null modem pair; Off relays as fast as the PTYs allow
+    app->line_frame = gtk_frame_new("Line Emulation");
+    gtk_box_pack_start(GTK_BOX(vbox), app->line_frame, FALSE, FALSE, 0);
+
+    GtkWidget *line_grid = gtk_grid_new();
+    gtk_container_add(GTK_CONTAINER(app->line_frame), line_grid);
+    gtk_container_set_border_width(GTK_CONTAINER(line_grid), 10);
+    gtk_grid_set_row_spacing(GTK_GRID(line_grid), 5);
+    gtk_grid_set_column_spacing(GTK_GRID(line_grid), 10);
+
+    GtkWidget *line_pair_label = gtk_label_new("Pair:");
+    gtk_grid_attach(GTK_GRID(line_grid), line_pair_label, 0, 0, 1, 1);
+
+    app->line_pair_spin = gtk_spin_button_new_with_range(0, MAX_BRIDGE_PAIRS - 1, 1);
+    gtk_grid_attach(GTK_GRID(line_grid), app->line_pair_spin, 1, 0, 1, 1);
+
+    app->line_baud_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->line_baud_combo), "0", "Off");
+    for (size_t i = 0; i < G_N_ELEMENTS(bauds); i++) {
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->line_baud_combo), bauds[i], bauds[i]);
+    }
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->line_baud_combo), "0");
+    gtk_grid_attach(GTK_GRID(line_grid), app->line_baud_combo, 2, 0, 1, 1);
+
+    static const char *formats[] = { "8N1", "8E1", "8O1", "8N2", "7E1", "7O1", "7N2" };
+    app->line_format_combo = gtk_combo_box_text_new();
+    for (size_t i = 0; i < G_N_ELEMENTS(formats); i++) {
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->line_format_combo), formats[i], formats[i]);
+    }
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->line_format_combo), "8N1");
+    gtk_grid_attach(GTK_GRID(line_grid), app->line_format_combo, 3, 0, 1, 1);
+
+    GtkWidget *line_gap_label = gtk_label_new("Gap (µs):");
+    gtk_grid_attach(GTK_GRID(line_grid), line_gap_label, 0, 1, 1, 1);
+
+    app->line_gap_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(app->line_gap_entry), "0");
+    gtk_widget_set_tooltip_text(app->line_gap_entry, "Idle line time after every character");
+    gtk_grid_attach(GTK_GRID(line_grid), app->line_gap_entry, 1, 1, 1, 1);
+
+    GtkWidget *line_buffer_label = gtk_label_new("Device buffer:");
+    gtk_grid_attach(GTK_GRID(line_grid), line_buffer_label, 2, 1, 1, 1);
+
+    app->line_buffer_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(app->line_buffer_entry), "0");
+    gtk_widget_set_tooltip_text(app->line_buffer_entry,
+                                "Bytes the receiving program may leave unread before further "
+                                "characters are lost as overruns; 0 for no limit");
+    gtk_grid_attach(GTK_GRID(line_grid), app->line_buffer_entry, 3, 1, 1, 1);
+
+    app->line_apply_all_button = gtk_button_new_with_label("Apply to All Pairs");
+    gtk_grid_attach(GTK_GRID(line_grid), app->line_apply_all_button, 3, 2, 1, 1);
+
+    // Multiplexer: one real port shared by virtual ports at the Device 1 paths
+    app->mux_frame = gtk_frame_new("Port Multiplexer");
+    gtk_box_pack_start(GTK_BOX(vbox), app->mux_frame, FALSE, FALSE, 0);
+
+    GtkWidget *mux_grid = gtk_grid_new();
+    gtk_container_add(GTK_CONTAINER(app->mux_frame), mux_grid);
+    gtk_container_set_border_width(GTK_CONTAINER(mux_grid), 10);
+    gtk_grid_set_row_spacing(GTK_GRID(mux_grid), 5);
+    gtk_grid_set_column_spacing(GTK_GRID(mux_grid), 10);
+
+    GtkWidget *mux_port_label = gtk_label_new("Serial Port:");
+    gtk_grid_attach(GTK_GRID(mux_grid), mux_port_label, 0, 0, 1, 1);
+
+    app->mux_port_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(app->mux_port_entry), DEFAULT_MUX_PORT);
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_port_entry, 1, 0, 2, 1);
+
+    app->mux_baud_combo = gtk_combo_box_text_new();
+    for (size_t i = 0; i < G_N_ELEMENTS(bauds); i++) {
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_baud_combo), bauds[i], bauds[i]);
+    }
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->mux_baud_combo), "4800");
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_baud_combo, 3, 0, 1, 1);
+
+    app->mux_data_bits_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_data_bits_combo), "8", "8 data");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_data_bits_combo), "7", "7 data");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_data_bits_combo), "6", "6 data");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_data_bits_combo), "5", "5 data");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_data_bits_combo), 0);
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_data_bits_combo, 0, 1, 1, 1);
+
+    app->mux_parity_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_parity_combo), "N", "No parity");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_parity_combo), "E", "Even");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_parity_combo), "O", "Odd");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_parity_combo), 0);
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_parity_combo, 1, 1, 1, 1);
+
+    app->mux_stop_bits_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_stop_bits_combo), "1", "1 stop");
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(app->mux_stop_bits_combo), "2", "2 stop");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_stop_bits_combo), 0);
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_stop_bits_combo, 2, 1, 1, 1);
+
+    // Order matches MuxFlowControl
+    app->mux_flow_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mux_flow_combo), "No flow control");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mux_flow_combo), "RTS/CTS");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mux_flow_combo), "XON/XOFF");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_flow_combo), 0);
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_flow_combo, 3, 1, 1, 1);
+
+    GtkWidget *mux_clients_label = gtk_label_new("Virtual Ports:");
+    gtk_grid_attach(GTK_GRID(mux_grid), mux_clients_label, 0, 2, 1, 1);
+
+    app->mux_clients_spin = gtk_spin_button_new_with_range(1, MAX_BRIDGE_PAIRS, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(app->mux_clients_spin), 2);
+    gtk_widget_set_tooltip_text(app->mux_clients_spin,
+                                "Virtual ports use the Device 1 path, then _1, _2, ... appended");
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_clients_spin, 1, 2, 1, 1);
+
+    // Order matches MuxPolicy
+    app->mux_policy_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mux_policy_combo), "FIFO writes");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mux_policy_combo), "Priority writes");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->mux_policy_combo), "Exclusive writer");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->mux_policy_combo), 0);
+    gtk_widget_set_tooltip_text(app->mux_policy_combo,
+                                "FIFO: in arrival order. Priority: lower port number first. "
+                                "Exclusive: one port at a time, others discarded until it is quiet");
+    gtk_grid_attach(GTK_GRID(mux_grid), app->mux_policy_combo, 2, 2, 2, 1);
 
     // Control buttons frame
     GtkWidget *control_frame = gtk_frame_new("Control");
@@ -124,10 +279,13 @@ void create_configuration_tab(BridgeApp *app, GtkWidget *notebook) {
 
     GtkWidget *instructions_label = gtk_label_new(
         "1. Configure device paths above (default: /tmp/ttyV0 and /tmp/ttyV1)\n"
+        "   With more than one pair, pair N uses /tmp/ttyV0_N and /tmp/ttyV1_N\n"
         "2. Click 'Start Virtual Null Modem' to create the devices\n"
         "3. Use the device paths in your applications (like LAST)\n"
         "4. Data sent to one device will appear on the other\n"
-        "5. Click 'Test Communication' to verify the connection works");
+        "5. Click 'Test Communication' to verify the connection works\n"
+        "Port Multiplexer mode shares a real serial port: every virtual port at the\n"
+        "Device 1 path(s) receives all its data, and their writes are merged");
     gtk_label_set_justify(GTK_LABEL(instructions_label), GTK_JUSTIFY_LEFT);
     gtk_container_add(GTK_CONTAINER(instructions_frame), instructions_label);
     gtk_container_set_border_width(GTK_CONTAINER(instructions_frame), 10);
@@ -172,6 +330,66 @@ void create_status_tab(BridgeApp *app, GtkWidget *notebook) {
     app->connection_time_label = gtk_label_new("00:00:00");
     gtk_grid_attach(GTK_GRID(status_grid), app->connection_time_label, 1, 2, 1, 1);
 
+    // Relay throughput and latency
+    GtkWidget *relay_text_label = gtk_label_new("Relay:");
+    gtk_grid_attach(GTK_GRID(status_grid), relay_text_label, 0, 3, 1, 1);
+
+    app->relay_stats_label = gtk_label_new("Idle");
+    gtk_grid_attach(GTK_GRID(status_grid), app->relay_stats_label, 1, 3, 1, 1);
+
+    // Latency percentiles, throughput windows and queue peaks per direction
+    GtkWidget *metrics_text_label = gtk_label_new("Latency:");
+    gtk_grid_attach(GTK_GRID(status_grid), metrics_text_label, 0, 4, 1, 1);
+
+    app->metrics_label = gtk_label_new("Idle");
+    gtk_grid_attach(GTK_GRID(status_grid), app->metrics_label, 1, 4, 1, 1);
+
+    // Per pair paths, sniff selection and relay statistics
+    GtkWidget *pairs_frame = gtk_frame_new("Pairs & Virtual Ports");
+    gtk_box_pack_start(GTK_BOX(vbox), pairs_frame, FALSE, FALSE, 0);
+
+    GtkWidget *pairs_scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(pairs_scrolled),
+                                  GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(pairs_scrolled), 110);
+    gtk_container_set_border_width(GTK_CONTAINER(pairs_scrolled), 10);
+    gtk_container_add(GTK_CONTAINER(pairs_frame), pairs_scrolled);
+
+    app->pairs_store = gtk_list_store_new(PAIR_COLUMN_COUNT, G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING,
+                                          G_TYPE_BOOLEAN, G_TYPE_ULONG, G_TYPE_ULONG,
+                                          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+    app->pairs_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(app->pairs_store));
+    g_object_unref(app->pairs_store);   // The view holds the reference
+    gtk_container_add(GTK_CONTAINER(pairs_scrolled), app->pairs_view);
+
+    static const struct {
+        const char *title;
+        int column;
+    } text_columns[] = {
+        { "#", PAIR_COLUMN_INDEX },
+        { "Device 1", PAIR_COLUMN_DEVICE1 },
+        { "Device 2", PAIR_COLUMN_DEVICE2 },
+        { NULL, PAIR_COLUMN_SNIFF },
+        { "Bytes", PAIR_COLUMN_BYTES },
+        { "Chunks", PAIR_COLUMN_CHUNKS },
+        { "Avg µs", PAIR_COLUMN_AVG },
+        { "Max µs", PAIR_COLUMN_MAX },
+        { "Line", PAIR_COLUMN_LINE }
+    };
+    for (size_t i = 0; i < G_N_ELEMENTS(text_columns); i++) {
+        GtkTreeViewColumn *column;
+        if (text_columns[i].column == PAIR_COLUMN_SNIFF) {
+            app->pair_sniff_renderer = gtk_cell_renderer_toggle_new();
+            column = gtk_tree_view_column_new_with_attributes("Sniff", app->pair_sniff_renderer,
+                                                              "active", PAIR_COLUMN_SNIFF, NULL);
+        } else {
+            column = gtk_tree_view_column_new_with_attributes(text_columns[i].title,
+                                                              gtk_cell_renderer_text_new(),
+                                                              "text", text_columns[i].column, NULL);
+        }
+        gtk_tree_view_append_column(GTK_TREE_VIEW(app->pairs_view), column);
+    }
+
     // Log frame
     GtkWidget *log_frame = gtk_frame_new("Log");
     gtk_box_pack_start(GTK_BOX(vbox), log_frame, TRUE, TRUE, 0);
@@ -202,6 +420,87 @@ void create_status_tab(BridgeApp *app, GtkWidget *notebook) {
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox, tab_label);
 }
 
+// Label and entry in one row of a grid
+static GtkWidget* attach_entry(GtkWidget *grid, const char *label, int column, int row,
+                               const char *tooltip) {
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(label), column, row, 1, 1);
+
+    GtkWidget *entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(entry), "0");
+    gtk_entry_set_width_chars(GTK_ENTRY(entry), 10);
+    if (tooltip) gtk_widget_set_tooltip_text(entry, tooltip);
+    gtk_grid_attach(GTK_GRID(grid), entry, column + 1, row, 1, 1);
+    return entry;
+}
+
+void create_impairments_tab(BridgeApp *app, GtkWidget *notebook) {
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 15);
+
+    GtkWidget *title = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(title), "<b>Link Impairments</b>");
+    gtk_box_pack_start(GTK_BOX(vbox), title, FALSE, FALSE, 0);
+
+    // Faults for one direction of one pair, applied when the pairs are created
+    app->impair_frame = gtk_frame_new("Faults");
+    gtk_box_pack_start(GTK_BOX(vbox), app->impair_frame, FALSE, FALSE, 0);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_container_add(GTK_CONTAINER(app->impair_frame), grid);
+    gtk_container_set_border_width(GTK_CONTAINER(grid), 10);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 5);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 10);
+
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Pair:"), 0, 0, 1, 1);
+    app->impair_pair_spin = gtk_spin_button_new_with_range(0, MAX_BRIDGE_PAIRS - 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), app->impair_pair_spin, 1, 0, 1, 1);
+
+    app->impair_direction_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->impair_direction_combo), "Device 1 → Device 2");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->impair_direction_combo), "Device 2 → Device 1");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->impair_direction_combo), 0);
+    gtk_grid_attach(GTK_GRID(grid), app->impair_direction_combo, 2, 0, 2, 1);
+
+    app->impair_latency_entry = attach_entry(grid, "Latency (ms):", 0, 1, NULL);
+    app->impair_jitter_entry = attach_entry(grid, "Jitter (ms):", 2, 1, NULL);
+
+    // Order matches ImpairJitter
+    app->impair_jitter_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->impair_jitter_combo), "Uniform ±jitter");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->impair_jitter_combo), "Normal, σ = jitter");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->impair_jitter_combo), "Exponential tail");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->impair_jitter_combo), 0);
+    gtk_grid_attach(GTK_GRID(grid), app->impair_jitter_combo, 4, 1, 1, 1);
+
+    app->impair_drop_entry = attach_entry(grid, "Byte drop rate:", 0, 2,
+                                          "Probability of losing each byte, e.g. 0.001");
+    app->impair_ber_entry = attach_entry(grid, "Bit error rate:", 2, 2,
+                                         "Probability of flipping each bit, e.g. 1e-5");
+    app->impair_outage_interval_entry = attach_entry(grid, "Outage every (ms):", 0, 3,
+                                                     "Mean time between outages; 0 for none");
+    app->impair_outage_entry = attach_entry(grid, "Outage length (ms):", 2, 3,
+                                            "Everything sent during an outage is lost");
+    app->impair_rate_entry = attach_entry(grid, "Rate cap (B/s):", 0, 4, "0 for no cap");
+    app->impair_seed_entry = attach_entry(grid, "Seed:", 2, 4,
+                                          "The same seed gives the same drops and bit errors "
+                                          "for the same data; shared by all pairs");
+
+    app->impair_apply_all_button = gtk_button_new_with_label("Apply to All Pairs");
+    gtk_grid_attach(GTK_GRID(grid), app->impair_apply_all_button, 4, 4, 1, 1);
+
+    // Counters of the running pairs
+    GtkWidget *stats_frame = gtk_frame_new("Statistics");
+    gtk_box_pack_start(GTK_BOX(vbox), stats_frame, FALSE, FALSE, 0);
+
+    app->impair_stats_label = gtk_label_new("Not running");
+    gtk_label_set_justify(GTK_LABEL(app->impair_stats_label), GTK_JUSTIFY_LEFT);
+    gtk_container_set_border_width(GTK_CONTAINER(stats_frame), 10);
+    gtk_container_add(GTK_CONTAINER(stats_frame), app->impair_stats_label);
+
+    GtkWidget *tab_label = gtk_label_new("Impairments");
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox, tab_label);
+}
+
 void create_settings_tab(BridgeApp *app, GtkWidget *notebook) {
     GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
     gtk_container_set_border_width(GTK_CONTAINER(vbox), 15);
@@ -319,14 +618,59 @@ void create_sniffing_tab(BridgeApp *app, GtkWidget *notebook) {
     gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_udp_port_entry), 6);
     gtk_grid_attach(GTK_GRID(output_grid), app->sniff_udp_port_entry, 2, 2, 1, 1);
 
+    // Multicast interface and TTL for the UDP stream
+    GtkWidget *udp_mcast_label = gtk_label_new("Mcast:");
+    gtk_widget_set_halign(udp_mcast_label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(output_grid), udp_mcast_label, 0, 3, 1, 1);
+
+    app->sniff_udp_iface_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(app->sniff_udp_iface_entry), "Default iface");
+    gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_udp_iface_entry), 12);
+    gtk_widget_set_tooltip_text(app->sniff_udp_iface_entry, "Interface name or address for multicast");
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_udp_iface_entry, 1, 3, 1, 1);
+
+    app->sniff_udp_ttl_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(app->sniff_udp_ttl_entry), "1");
+    gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_udp_ttl_entry), 6);
+    gtk_widget_set_tooltip_text(app->sniff_udp_ttl_entry, "Multicast TTL (hops)");
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_udp_ttl_entry, 2, 3, 1, 1);
+
     // Log File - compact layout
     app->sniff_file_check = gtk_check_button_new_with_label("File:");
-    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_file_check, 0, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_file_check, 0, 4, 1, 1);
 
     app->sniff_file_entry = gtk_entry_new();
     gtk_entry_set_placeholder_text(GTK_ENTRY(app->sniff_file_entry), "Auto-generated");
     gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_file_entry), 20);
-    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_file_entry, 1, 3, 2, 1);
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_file_entry, 1, 4, 2, 1);
+
+    // pcapng capture for Wireshark - compact layout
+    app->sniff_pcap_check = gtk_check_button_new_with_label("pcapng:");
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_pcap_check, 0, 5, 1, 1);
+
+    app->sniff_pcap_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(app->sniff_pcap_entry), "Auto-generated");
+    gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_pcap_entry), 20);
+    gtk_widget_set_tooltip_text(app->sniff_pcap_entry, "Capture file, or the FIFO in live mode");
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_pcap_entry, 1, 5, 2, 1);
+
+    // Live FIFO or file rotation
+    app->sniff_pcap_live_check = gtk_check_button_new_with_label("Live");
+    gtk_widget_set_tooltip_text(app->sniff_pcap_live_check,
+                                "Write to a FIFO for: wireshark -k -i " DEFAULT_SNIFF_PCAP_FIFO);
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_pcap_live_check, 0, 6, 1, 1);
+
+    app->sniff_pcap_size_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(app->sniff_pcap_size_entry), "Rotate MB");
+    gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_pcap_size_entry), 12);
+    gtk_widget_set_tooltip_text(app->sniff_pcap_size_entry, "Start a new file after this many MB");
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_pcap_size_entry, 1, 6, 1, 1);
+
+    app->sniff_pcap_time_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(app->sniff_pcap_time_entry), "Rotate s");
+    gtk_entry_set_width_chars(GTK_ENTRY(app->sniff_pcap_time_entry), 6);
+    gtk_widget_set_tooltip_text(app->sniff_pcap_time_entry, "Start a new file after this many seconds");
+    gtk_grid_attach(GTK_GRID(output_grid), app->sniff_pcap_time_entry, 2, 6, 1, 1);
 
     // Configuration frame - compact
     GtkWidget *config_frame = gtk_frame_new("Configuration");
@@ -357,9 +701,21 @@ void create_sniffing_tab(BridgeApp *app, GtkWidget *notebook) {
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_format_combo), "Raw");
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_format_combo), "Hex");
     gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_format_combo), "Text");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_format_combo), "Framed");
     gtk_combo_box_set_active(GTK_COMBO_BOX(app->sniff_format_combo), 1); // Default to Hex
     gtk_grid_attach(GTK_GRID(config_grid), app->sniff_format_combo, 1, 1, 1, 1);
 
+    // Slow reader policy - compact
+    GtkWidget *policy_label = gtk_label_new("Slow Reader:");
+    gtk_grid_attach(GTK_GRID(config_grid), policy_label, 0, 2, 1, 1);
+
+    app->sniff_policy_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_policy_combo), "Drop Oldest");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_policy_combo), "Disconnect");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(app->sniff_policy_combo), "Block Relay");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->sniff_policy_combo), 0);
+    gtk_grid_attach(GTK_GRID(config_grid), app->sniff_policy_combo, 1, 2, 1, 1);
+
     // === RIGHT COLUMN ===
 
     // Statistics frame
@@ -382,7 +738,8 @@ void create_sniffing_tab(BridgeApp *app, GtkWidget *notebook) {
         "5. Data streams to selected outputs\n\n"
         "TCP: Connect to localhost:8888\n"
         "UDP: Listen on 239.1.1.1:9999\n"
-        "Pipe: Read from /tmp/bridge_sniff_pipe");
+        "Pipe: Read from /tmp/bridge_sniff_pipe\n"
+        "pcapng Live: wireshark -k -i " DEFAULT_SNIFF_PCAP_FIFO);
     gtk_label_set_justify(GTK_LABEL(sniff_instructions_label), GTK_JUSTIFY_LEFT);
     gtk_label_set_line_wrap(GTK_LABEL(sniff_instructions_label), TRUE);
     gtk_widget_set_size_request(sniff_instructions_label, 250, -1);
@@ -399,6 +756,8 @@ gboolean update_ui_state(gpointer data) {
     const char *status_text = "Unknown";
     const char *status_color = "black";
 
+    if (!app->window) return FALSE; // Headless: there is nothing to update
+
     switch (app->state) {
         case BRIDGE_STATE_STOPPED:
             status_text = "Stopped";
@@ -428,8 +787,16 @@ gboolean update_ui_state(gpointer data) {
                                    app->sniffing_enabled && !is_sniffing_active(app));
 
             char devices_text[512];
-            snprintf(devices_text, sizeof(devices_text), "%.240s ↔ %.240s",
-                    app->device1_path, app->device2_path);
+            if (app->mode == BRIDGE_MODE_MULTIPLEXER) {
+                snprintf(devices_text, sizeof(devices_text), "%.220s → %d virtual ports from %.220s",
+                        app->mux_port_path, app->mux_clients, app->device1_path);
+            } else if (app->pair_count > 1) {
+                snprintf(devices_text, sizeof(devices_text), "%.220s ↔ %.220s (+%d more)",
+                        app->device1_path, app->device2_path, app->pair_count - 1);
+            } else {
+                snprintf(devices_text, sizeof(devices_text), "%.240s ↔ %.240s",
+                        app->device1_path, app->device2_path);
+            }
             gtk_label_set_text(GTK_LABEL(app->devices_label), devices_text);
             break;
 
@@ -442,15 +809,27 @@ gboolean update_ui_state(gpointer data) {
             break;
 
         case BRIDGE_STATE_ERROR:
-            status_text = "Error";
+            // Stop cancels a pending restart; Start waits until there is none
+            status_text = app->restart_timer_id > 0 ? "Error - restarting..." : "Error";
             status_color = "red";
-            gtk_widget_set_sensitive(app->start_button, TRUE);
-            gtk_widget_set_sensitive(app->stop_button, FALSE);
+            gtk_widget_set_sensitive(app->start_button, app->restart_timer_id == 0);
+            gtk_widget_set_sensitive(app->stop_button, app->restart_timer_id > 0);
             gtk_widget_set_sensitive(app->test_button, FALSE);
             gtk_label_set_text(GTK_LABEL(app->devices_label), "None");
             break;
     }
 
+    // Mode settings only apply to the next start
+    gboolean stopped = app->state == BRIDGE_STATE_STOPPED ||
+                       (app->state == BRIDGE_STATE_ERROR && app->restart_timer_id == 0);
+    gboolean multiplexer = app->mode == BRIDGE_MODE_MULTIPLEXER;
+    gtk_widget_set_sensitive(app->mode_combo, stopped);
+    gtk_widget_set_sensitive(app->pair_count_spin, stopped && !multiplexer);
+    gtk_widget_set_sensitive(app->device2_entry, !multiplexer);
+    gtk_widget_set_sensitive(app->mux_frame, stopped && multiplexer);
+    gtk_widget_set_sensitive(app->line_frame, stopped && !multiplexer);
+    gtk_widget_set_sensitive(app->impair_frame, stopped && !multiplexer);
+
     // Update status label with color
     char markup[256];
     snprintf(markup, sizeof(markup), "<span color=\"%s\">%s</span>", status_color, status_text);
@@ -459,40 +838,169 @@ gboolean update_ui_state(gpointer data) {
     return FALSE; // Don't repeat if called from g_idle_add
 }
 
-void append_log_message(BridgeApp *app, const char *message, gboolean timestamp) {
-    if (!app->log_buffer) return;
-    
-    GtkTextIter iter;
-    gtk_text_buffer_get_end_iter(app->log_buffer, &iter);
-    
-    if (timestamp) {
+// One row per configured pair or multiplexer client, with statistics while it runs.
+// For a client, Bytes counts both directions and the times are its write queueing.
+void update_pairs_view(BridgeApp *app) {
+    if (!app->pairs_store) return;
+
+    int rows = device_channel_count(app);
+    GtkTreeModel *model = GTK_TREE_MODEL(app->pairs_store);
+    if (gtk_tree_model_iter_n_children(model, NULL) != rows) {
+        gtk_list_store_clear(app->pairs_store);
+        for (int i = 0; i < rows; i++) {
+            GtkTreeIter iter;
+            gtk_list_store_append(app->pairs_store, &iter);
+            gtk_list_store_set(app->pairs_store, &iter, PAIR_COLUMN_INDEX, i, -1);
+        }
+    }
+
+    GtkTreeIter iter;
+    gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
+    for (int i = 0; valid; i++) {
+        char path1[MAX_PATH_LENGTH], path2[MAX_PATH_LENGTH];
+        format_pair_device_path(app->device1_path, i, path1, sizeof(path1));
+        if (app->mode == BRIDGE_MODE_MULTIPLEXER) {
+            snprintf(path2, sizeof(path2), "%s", app->mux_port_path);
+        } else {
+            format_pair_device_path(app->device2_path, i, path2, sizeof(path2));
+        }
+
+        RelayStats stats = {0};
+        char average[32] = "";
+        char maximum[32] = "";
+        if (app->mux && i < app->mux->client_count) {
+            MuxClientStats client;
+            mux_get_client_stats(app->mux, i, &client);
+            stats.bytes = client.rx_bytes + client.tx_bytes;
+            stats.chunks = client.tx_chunks;
+            stats.total_ns = client.tx_wait_total_ns;
+            stats.max_ns = client.tx_wait_max_ns;
+        } else if (app->relay_pairs[i]) {
+            relay_pair_get_stats(app->relay_pairs[i], &stats);
+        }
+        if (stats.chunks > 0) {
+            snprintf(average, sizeof(average), "%.1f", (double)stats.total_ns / stats.chunks / 1000.0);
+            snprintf(maximum, sizeof(maximum), "%.1f", stats.max_ns / 1000.0);
+        }
+
+        // Emulated line and, once it has run, how far its timing slipped
+        char line[128] = "";
+        if (app->mode != BRIDGE_MODE_MULTIPLEXER) {
+            format_line_emulation(&app->pair_line[i], line, sizeof(line));
+            size_t length = strlen(line);
+            if (stats.pace_releases > 0 && length < sizeof(line)) {
+                snprintf(line + length, sizeof(line) - length, " (late ≤%.0f µs, %lu overruns)",
+                         stats.pace_error_max_ns / 1000.0, stats.overruns);
+            }
+        }
+
+        gtk_list_store_set(app->pairs_store, &iter,
+                           PAIR_COLUMN_DEVICE1, path1,
+                           PAIR_COLUMN_DEVICE2, path2,
+                           PAIR_COLUMN_SNIFF, app->pair_sniff[i],
+                           PAIR_COLUMN_BYTES, stats.bytes,
+                           PAIR_COLUMN_CHUNKS, stats.chunks,
+                           PAIR_COLUMN_AVG, average,
+                           PAIR_COLUMN_MAX, maximum,
+                           PAIR_COLUMN_LINE, line,
+                           -1);
+        valid = gtk_tree_model_iter_next(model, &iter);
+    }
+}
+
+// Fill the line widgets from the pair selected in the pair spin
+void show_line_settings(BridgeApp *app) {
+    int pair = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->line_pair_spin));
+    LineEmulation *line = &app->pair_line[pair];
+    char text[16];
+
+    app->line_loading = TRUE;
+    snprintf(text, sizeof(text), "%d", line->baud);
+    if (!gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->line_baud_combo), text)) {
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->line_baud_combo), "0");
+    }
+    snprintf(text, sizeof(text), "%d%c%d", line->data_bits, line->parity, line->stop_bits);
+    if (!gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->line_format_combo), text)) {
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(app->line_format_combo), "8N1");
+    }
+    snprintf(text, sizeof(text), "%u", line->gap_us);
+    gtk_entry_set_text(GTK_ENTRY(app->line_gap_entry), text);
+    snprintf(text, sizeof(text), "%u", line->device_buffer);
+    gtk_entry_set_text(GTK_ENTRY(app->line_buffer_entry), text);
+    app->line_loading = FALSE;
+}
+
+// Fill the impairment widgets from the selected pair and direction
+void show_impairment_settings(BridgeApp *app) {
+    int pair = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(app->impair_pair_spin));
+    int direction = MAX(gtk_combo_box_get_active(GTK_COMBO_BOX(app->impair_direction_combo)), 0);
+    LinkImpairment *config = &app->pair_impair[pair][direction];
+    char text[32];
+
+    app->impair_loading = TRUE;
+    snprintf(text, sizeof(text), "%u", config->latency_ms);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_latency_entry), text);
+    snprintf(text, sizeof(text), "%u", config->jitter_ms);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_jitter_entry), text);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app->impair_jitter_combo), config->jitter_dist);
+    snprintf(text, sizeof(text), "%g", config->drop_rate);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_drop_entry), text);
+    snprintf(text, sizeof(text), "%g", config->bit_error_rate);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_ber_entry), text);
+    snprintf(text, sizeof(text), "%u", config->outage_interval_ms);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_outage_interval_entry), text);
+    snprintf(text, sizeof(text), "%u", config->outage_ms);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_outage_entry), text);
+    snprintf(text, sizeof(text), "%u", config->rate_limit);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_rate_entry), text);
+    snprintf(text, sizeof(text), "%u", app->impair_seed);
+    gtk_entry_set_text(GTK_ENTRY(app->impair_seed_entry), text);
+    app->impair_loading = FALSE;
+}
+
+// Moves queued log messages into the view: one insert, one scroll and at most
+// one trim per batch, however busy the producers are
+gboolean drain_log_queue(gpointer data) {
+    BridgeApp *app = (BridgeApp *)data;
+    GString *text = g_string_new(NULL);
+    unsigned long dropped = 0;
+
+    int count = log_queue_drain(app->log_queue, text, LOG_DRAIN_BATCH, &dropped);
+    if (dropped > 0) {
         char *ts = get_current_timestamp();
-        char full_message[MAX_LOG_LENGTH + 64];
-        snprintf(full_message, sizeof(full_message), "[%s] %s\n", ts, message);
-        gtk_text_buffer_insert(app->log_buffer, &iter, full_message, -1);
+        g_string_append_printf(text, "[%s] WARNING: %lu log messages dropped\n", ts, dropped);
         free(ts);
-    } else {
-        gtk_text_buffer_insert(app->log_buffer, &iter, message, -1);
-        gtk_text_buffer_insert(app->log_buffer, &iter, "\n", -1);
+        count++;
     }
-    
-    // Auto-scroll to bottom
-    GtkTextMark *mark = gtk_text_buffer_get_insert(app->log_buffer);
-    gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(app->log_text), mark);
-    
-    // Limit log length
-    gint line_count = gtk_text_buffer_get_line_count(app->log_buffer);
-    if (line_count > 500) {
-        GtkTextIter start, end;
-        gtk_text_buffer_get_start_iter(app->log_buffer, &start);
-        gtk_text_buffer_get_iter_at_line(app->log_buffer, &end, 100);
-        gtk_text_buffer_delete(app->log_buffer, &start, &end);
+
+    if (count > 0 && app->log_buffer) {
+        GtkTextIter iter;
+        gtk_text_buffer_get_end_iter(app->log_buffer, &iter);
+        gtk_text_buffer_insert(app->log_buffer, &iter, text->str, (gint)text->len);
+        app->log_lines += count;
+
+        // Keep the newest LOG_MAX_LINES, trimming only once LOG_TRIM_LINES more have piled up
+        if (app->log_lines > LOG_MAX_LINES + LOG_TRIM_LINES) {
+            GtkTextIter start, end;
+            gtk_text_buffer_get_start_iter(app->log_buffer, &start);
+            gtk_text_buffer_get_iter_at_line(app->log_buffer, &end, app->log_lines - LOG_MAX_LINES);
+            gtk_text_buffer_delete(app->log_buffer, &start, &end);
+            app->log_lines = LOG_MAX_LINES;
+        }
+
+        // Auto-scroll to bottom
+        GtkTextMark *mark = gtk_text_buffer_get_insert(app->log_buffer);
+        gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(app->log_text), mark);
     }
+
+    g_string_free(text, TRUE);
+    return G_SOURCE_CONTINUE;
 }
 
 void clear_log(BridgeApp *app) {
     if (app->log_buffer) {
         gtk_text_buffer_set_text(app->log_buffer, "", -1);
+        app->log_lines = 0;
     }
 }
 
@@ -8,14 +8,39 @@
 
 #include "common.h"
 
+// Columns of the pairs list on the Status tab
+enum {
+    PAIR_COLUMN_INDEX,
+    PAIR_COLUMN_DEVICE1,
+    PAIR_COLUMN_DEVICE2,
+    PAIR_COLUMN_SNIFF,
+    PAIR_COLUMN_BYTES,
+    PAIR_COLUMN_CHUNKS,
+    PAIR_COLUMN_AVG,
+    PAIR_COLUMN_MAX,
+    PAIR_COLUMN_LINE,
+    PAIR_COLUMN_COUNT
+};
+
+// The log view takes at most LOG_DRAIN_BATCH messages per LOG_DRAIN_INTERVAL_MS
+// and keeps the newest LOG_MAX_LINES
+#define LOG_DRAIN_INTERVAL_MS 100
+#define LOG_DRAIN_BATCH 200
+#define LOG_MAX_LINES 500
+#define LOG_TRIM_LINES 100
+
 // Function declarations
 void create_main_window(BridgeApp *app);
 gboolean update_ui_state(gpointer data);
-void append_log_message(BridgeApp *app, const char *message, gboolean timestamp);
+gboolean drain_log_queue(gpointer data);
 void clear_log(BridgeApp *app);
+void update_pairs_view(BridgeApp *app);
+void show_line_settings(BridgeApp *app);
 void create_configuration_tab(BridgeApp *app, GtkWidget *notebook);
 void create_status_tab(BridgeApp *app, GtkWidget *notebook);
 void create_sniffing_tab(BridgeApp *app, GtkWidget *notebook);
+void create_impairments_tab(BridgeApp *app, GtkWidget *notebook);
+void show_impairment_settings(BridgeApp *app);
 void create_settings_tab(BridgeApp *app, GtkWidget *notebook);
 void apply_ui_theme(BridgeApp *app);
 
@@ -5,6 +5,17 @@
 
 #include "utils.h"
 #include "ui.h"
+#include "nullmodem.h"
+#include "relay.h"
+#include "mux.h"
+#include "sniffing.h"
+#include "sniff_ring.h"
+#include "sniff_tcp.h"
+#include "sniff_udp.h"
+#include "sniff_pcap.h"
+#include "sniff_file.h"
+#include "metrics_http.h"
+#include "log_queue.h"
 
 char* get_current_timestamp(void) {
     time_t now = time(NULL);
@@ -14,6 +25,18 @@ char* get_current_timestamp(void) {
     return timestamp;
 }
 
+// Under systemd the journal stamps each line and takes a <level> prefix
+static void log_to_stderr(const char *message) {
+    if (getenv("JOURNAL_STREAM")) {
+        int level = strncmp(message, "ERROR", 5) == 0 ? 3 : strncmp(message, "WARNING", 7) == 0 ? 4 : 6;
+        fprintf(stderr, "<%d>%s\n", level, message);
+    } else {
+        char *timestamp = get_current_timestamp();
+        fprintf(stderr, "[%s] %s\n", timestamp, message);
+        free(timestamp);
+    }
+}
+
 void log_message(BridgeApp *app, const char *format, ...) {
     va_list args;
     va_start(args, format);
@@ -22,6 +45,12 @@ void log_message(BridgeApp *app, const char *format, ...) {
     vsnprintf(message, sizeof(message), format, args);
     va_end(args);
     
+    // Without a window the log is stderr, which journald picks up as is
+    if (app->headless) {
+        log_to_stderr(message);
+        return;
+    }
+
     // Print to console if verbose logging is enabled
     if (app->verbose_logging) {
         char *timestamp = get_current_timestamp();
@@ -29,19 +58,91 @@ void log_message(BridgeApp *app, const char *format, ...) {
         free(timestamp);
     }
     
-    // Add to GUI log
-    append_log_message(app, message, TRUE);
+    // Any thread may log; the main loop moves the queue into the GUI log
+    if (app->log_queue) {
+        log_queue_push(app->log_queue, message);
+    }
 }
 
 gboolean update_status_timer(gpointer data) {
     BridgeApp *app = (BridgeApp *)data;
     
+    // Notice devices that were removed behind our back
+    if (app->state == BRIDGE_STATE_RUNNING) {
+        is_null_modem_running(app);
+    }
+
     // Update connection time display
     if (app->connection_time_label && app->state == BRIDGE_STATE_RUNNING) {
         char time_buffer[64];
         format_connection_time(app, time_buffer, sizeof(time_buffer));
         gtk_label_set_text(GTK_LABEL(app->connection_time_label), time_buffer);
     }
+
+    if (app->sniff_stats_label && is_sniffing_active(app) && app->sniff_ring) {
+        char consumers_buffer[1024];
+        char tcp_buffer[128] = "";
+        char udp_buffer[128] = "";
+        char pcap_buffer[128] = "";
+        char file_buffer[192] = "";
+        char sniff_buffer[1600];
+        sniff_ring_format_stats(app->sniff_ring, consumers_buffer, sizeof(consumers_buffer));
+        if (app->sniff_tcp) {
+            tcp_buffer[0] = '\n';
+            sniff_tcp_format_stats(app->sniff_tcp, tcp_buffer + 1, sizeof(tcp_buffer) - 1);
+        }
+        if (app->sniff_udp) {
+            udp_buffer[0] = '\n';
+            sniff_udp_format_stats(app->sniff_udp, udp_buffer + 1, sizeof(udp_buffer) - 1);
+        }
+        if (app->sniff_pcap) {
+            pcap_buffer[0] = '\n';
+            sniff_pcap_format_stats(app->sniff_pcap, pcap_buffer + 1, sizeof(pcap_buffer) - 1);
+        }
+        if (app->sniff_file) {
+            file_buffer[0] = '\n';
+            sniff_file_format_stats(app->sniff_file, file_buffer + 1, sizeof(file_buffer) - 1);
+        }
+        snprintf(sniff_buffer, sizeof(sniff_buffer), "Captured %lu bytes in %lu packets\n%s%s%s%s%s",
+                 app->sniff_bytes_captured, app->sniff_packets_sent, consumers_buffer,
+                 tcp_buffer, udp_buffer, pcap_buffer, file_buffer);
+        gtk_label_set_text(GTK_LABEL(app->sniff_stats_label), sniff_buffer);
+    }
+
+    // Faults injected so far, kept with the communication test counts
+    memset(&app->impair_stats, 0, sizeof(app->impair_stats));
+    for (int i = 0; i < MAX_BRIDGE_PAIRS && app->relay_pairs[i]; i++) {
+        RelayStats pair_stats;
+        relay_pair_get_stats(app->relay_pairs[i], &pair_stats);
+        impair_stats_add(&app->impair_stats, &pair_stats.impair[0]);
+        impair_stats_add(&app->impair_stats, &pair_stats.impair[1]);
+    }
+    if (app->impair_stats_label) {
+        char impair_buffer[512];
+        const ImpairStats *stats = &app->impair_stats;
+        snprintf(impair_buffer, sizeof(impair_buffer),
+                 "Communication tests: %lu run, %lu passed\n"
+                 "Delayed chunks: %lu\nDropped bytes: %lu\nFlipped bits: %lu\n"
+                 "Outages: %lu (%lu bytes lost)",
+                 app->test_count, app->successful_tests, stats->delayed_chunks,
+                 stats->dropped_bytes, stats->flipped_bits, stats->outages, stats->outage_bytes);
+        gtk_label_set_text(GTK_LABEL(app->impair_stats_label), impair_buffer);
+    }
+
+    if (app->relay_stats_label) {
+        char stats_buffer[RELAY_STATS_TEXT_SIZE];
+        format_relay_stats(app, stats_buffer, sizeof(stats_buffer));
+        gtk_label_set_text(GTK_LABEL(app->relay_stats_label), stats_buffer);
+    }
+    if (app->metrics_http) {
+        publish_metrics(app);
+    }
+    if (app->metrics_label) {
+        char metrics_buffer[512];
+        metrics_format_status(app, metrics_buffer, sizeof(metrics_buffer));
+        gtk_label_set_text(GTK_LABEL(app->metrics_label), metrics_buffer);
+    }
+    update_pairs_view(app);
     
     // Update status if needed
     update_ui_state(app);
@@ -49,6 +150,14 @@ gboolean update_status_timer(gpointer data) {
     return TRUE; // Continue timer
 }
 
+// Hand the metrics endpoint a fresh snapshot; built here, on the main thread,
+// so scrapes never reach into the relay pairs or the sniffer
+void publish_metrics(BridgeApp *app) {
+    GString *text = g_string_sized_new(16384);
+    metrics_format_prometheus(app, text);
+    metrics_http_publish(app->metrics_http, text);
+}
+
 void format_connection_time(BridgeApp *app, char *buffer, size_t buffer_size) {
     if (app->state != BRIDGE_STATE_RUNNING) {
         snprintf(buffer, buffer_size, "Not running");
@@ -58,6 +167,67 @@ void format_connection_time(BridgeApp *app, char *buffer, size_t buffer_size) {
     format_uptime(app->start_time, buffer, buffer_size);
 }
 
+void format_relay_stats(BridgeApp *app, char *buffer, size_t buffer_size) {
+    if (app->mux) {
+        mux_format_stats(app->mux, buffer, buffer_size);
+        return;
+    }
+    if (!app->relay_pairs[0]) {
+        snprintf(buffer, buffer_size, "Idle");
+        return;
+    }
+
+    // Totals over all pairs; the pairs view has the breakdown
+    RelayStats stats = {0};
+    for (int i = 0; i < MAX_BRIDGE_PAIRS && app->relay_pairs[i]; i++) {
+        RelayStats pair_stats;
+        relay_pair_get_stats(app->relay_pairs[i], &pair_stats);
+        stats.chunks += pair_stats.chunks;
+        stats.bytes += pair_stats.bytes;
+        stats.total_ns += pair_stats.total_ns;
+        stats.max_ns = MAX(stats.max_ns, pair_stats.max_ns);
+        stats.paced_chars += pair_stats.paced_chars;
+        stats.pace_releases += pair_stats.pace_releases;
+        stats.pace_error_total_ns += pair_stats.pace_error_total_ns;
+        stats.pace_error_max_ns = MAX(stats.pace_error_max_ns, pair_stats.pace_error_max_ns);
+        stats.overruns += pair_stats.overruns;
+    }
+    if (stats.chunks == 0 && stats.pace_releases == 0) {
+        snprintf(buffer, buffer_size, "No data yet");
+        return;
+    }
+
+    int length = snprintf(buffer, buffer_size, "%lu bytes in %lu chunks, avg %.1f µs, max %.1f µs",
+                          stats.bytes, stats.chunks,
+                          stats.chunks ? (double)stats.total_ns / stats.chunks / 1000.0 : 0.0,
+                          stats.max_ns / 1000.0);
+
+    // Emulated lines: how late characters left against their line timing
+    if (stats.pace_releases > 0 && length > 0 && (size_t)length < buffer_size) {
+        snprintf(buffer + length, buffer_size - length,
+                 "\nLine timing: %lu chars, late avg %.1f µs, max %.1f µs, %lu overruns",
+                 stats.paced_chars, (double)stats.pace_error_total_ns / stats.pace_releases / 1000.0,
+                 stats.pace_error_max_ns / 1000.0, stats.overruns);
+    }
+}
+
+// "9600 8N1", plus the gap and device buffer when set; empty when not emulated
+void format_line_emulation(const LineEmulation *line, char *buffer, size_t buffer_size) {
+    if (line->baud <= 0) {
+        snprintf(buffer, buffer_size, "%s", "");
+        return;
+    }
+
+    int length = snprintf(buffer, buffer_size, "%d %d%c%d", line->baud, line->data_bits,
+                          line->parity, line->stop_bits);
+    if (line->gap_us > 0 && length > 0 && (size_t)length < buffer_size) {
+        length += snprintf(buffer + length, buffer_size - length, " +%u µs", line->gap_us);
+    }
+    if (line->device_buffer > 0 && length > 0 && (size_t)length < buffer_size) {
+        snprintf(buffer + length, buffer_size - length, ", %u B buffer", line->device_buffer);
+    }
+}
+
 void format_uptime(time_t start_time, char *buffer, size_t buffer_size) {
     time_t current_time = time(NULL);
     int duration = (int)(current_time - start_time);
@@ -9,11 +9,17 @@
 #include "common.h"
 #include <stdarg.h>
 
+// Room for format_relay_stats; multiplexer stats have a line per client
+#define RELAY_STATS_TEXT_SIZE 4096
+
 // Function declarations
 char* get_current_timestamp(void);
 void log_message(BridgeApp *app, const char *format, ...);
 gboolean update_status_timer(gpointer data);
+void publish_metrics(BridgeApp *app);
 void format_connection_time(BridgeApp *app, char *buffer, size_t buffer_size);
+void format_relay_stats(BridgeApp *app, char *buffer, size_t buffer_size);
+void format_line_emulation(const LineEmulation *line, char *buffer, size_t buffer_size);
 void format_uptime(time_t start_time, char *buffer, size_t buffer_size);
 gboolean file_exists(const char *path);
 gboolean is_process_running(pid_t pid);
@@ -9,6 +9,8 @@
  */
 
 // Connection callbacks
+void connect_from_ui(SerialTerminal *terminal);
+void disconnect_from_ui(SerialTerminal *terminal);
 void on_connection_type_changed(GtkWidget *widget, gpointer data);
 void on_connect_clicked(GtkWidget *widget, gpointer data);
 void on_disconnect_clicked(GtkWidget *widget, gpointer data);
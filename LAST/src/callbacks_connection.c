@@ -7,6 +7,8 @@
 #include "serial.h"
 #include "network.h"
 #include "settings.h"
+#include "file_ops.h"
+#include "ui.h"
 
 void on_connection_type_changed(GtkWidget *widget, gpointer data) {
     SerialTerminal *terminal = (SerialTerminal *)data;
@@ -32,14 +34,12 @@ void on_connection_type_changed(GtkWidget *widget, gpointer data) {
     save_settings(terminal);
 }
 
-void on_connect_clicked(GtkWidget *widget, gpointer data) {
-    (void)widget;
-    SerialTerminal *terminal = (SerialTerminal *)data;
+// Connect with the settings selected in the UI
+void connect_from_ui(SerialTerminal *terminal) {
+    // The engine reads the saved_* copies, so bring them in step with the widgets
+    update_settings_from_ui(terminal);
 
-    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
-        connect_serial(terminal);
-    } else {
-        // Network connection logic
+    if (terminal->connection_type != CONNECTION_TYPE_SERIAL) {
         const char *host = gtk_entry_get_text(GTK_ENTRY(terminal->network_host_entry));
         const char *port_str = gtk_entry_get_text(GTK_ENTRY(terminal->network_port_entry));
 
@@ -53,89 +53,77 @@ void on_connect_clicked(GtkWidget *widget, gpointer data) {
             return;
         }
 
-        int port = atoi(port_str);
-        gboolean success = FALSE;
-
         // Store network settings
         strncpy(terminal->network_host, host, MAX_HOSTNAME_LENGTH - 1);
         terminal->network_host[MAX_HOSTNAME_LENGTH - 1] = '\0';
         strncpy(terminal->network_port, port_str, MAX_PORT_LENGTH - 1);
         terminal->network_port[MAX_PORT_LENGTH - 1] = '\0';
+    }
 
-        // Initialize connection fields
-        terminal->connection_fd = -1;
-        terminal->server_fd = -1;
-
-        switch (terminal->connection_type) {
-            case CONNECTION_TYPE_TCP_CLIENT:
-                success = connect_tcp_client(terminal, host, port);
-                break;
-            case CONNECTION_TYPE_TCP_SERVER:
-                success = connect_tcp_server(terminal, port);
-                break;
-            case CONNECTION_TYPE_UDP_CLIENT:
-                success = connect_udp_client(terminal, host, port);
-                break;
-            case CONNECTION_TYPE_UDP_SERVER:
-                success = connect_udp_server(terminal, port);
-                break;
-            default:
-                success = FALSE;
-                break;
-        }
+    if (!connection_open(terminal)) return;
 
-        if (success) {
-            // Initialize statistics
-            terminal->bytes_sent = 0;
-            terminal->bytes_received = 0;
-            terminal->connection_start_time = time(NULL);
-
-            // Start read thread
-            terminal->connected = TRUE;
-            terminal->thread_running = TRUE;
-            pthread_create(&terminal->read_thread, NULL, network_read_thread_func, terminal);
-
-            // Update UI
-            gtk_widget_set_sensitive(terminal->connect_button, FALSE);
-            gtk_widget_set_sensitive(terminal->disconnect_button, TRUE);
-
-            // Show connection info
-            char *info = get_network_connection_info(terminal);
-            if (info) {
-                show_network_status(terminal, info);
-                free(info);
-            }
-        }
+    // Update UI
+    gtk_widget_set_sensitive(terminal->connect_button, FALSE);
+    gtk_widget_set_sensitive(terminal->disconnect_button, TRUE);
+
+    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
+        gtk_widget_set_sensitive(terminal->send_entry, TRUE);
+        gtk_widget_set_sensitive(terminal->send_button, TRUE);
+        gtk_widget_set_sensitive(terminal->send_file_button, TRUE);
+        gtk_widget_set_sensitive(terminal->send_file_repeat_check, TRUE);
+        gtk_widget_set_sensitive(terminal->send_file_interval_combo, TRUE);
+        gtk_widget_set_sensitive(terminal->break_button, TRUE);
+
+        // Start signal line monitoring
+        start_signal_monitoring(terminal);
     }
 }
 
-void on_disconnect_clicked(GtkWidget *widget, gpointer data) {
-    (void)widget;
-    SerialTerminal *terminal = (SerialTerminal *)data;
+void disconnect_from_ui(SerialTerminal *terminal) {
+    if (!terminal->connected) return;
 
-    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
-        disconnect_serial(terminal);
-    } else {
-        // Network disconnect
-        if (terminal->connected) {
-            terminal->thread_running = FALSE;
+    gboolean serial = terminal->connection_type == CONNECTION_TYPE_SERIAL;
+    if (serial) {
+        // Stop repeat file sending if active
+        stop_repeat_file_sending(terminal);
 
-            if (terminal->read_thread) {
-                pthread_join(terminal->read_thread, NULL);
-            }
+        // Stop signal line monitoring
+        stop_signal_monitoring(terminal);
+    }
 
-            disconnect_network(terminal);
-            terminal->connected = FALSE;
+    connection_close(terminal);
 
-            // Update UI
-            gtk_widget_set_sensitive(terminal->connect_button, TRUE);
-            gtk_widget_set_sensitive(terminal->disconnect_button, FALSE);
+    // Update UI
+    gtk_widget_set_sensitive(terminal->connect_button, TRUE);
+    gtk_widget_set_sensitive(terminal->disconnect_button, FALSE);
 
-            show_network_status(terminal, "Disconnected");
-        }
+    if (serial) {
+        // Force immediate update of indicators to show inactive state
+        update_signal_indicators(terminal);
+
+        // Close log file if open
+        connection_log_close(terminal);
+
+        gtk_widget_set_sensitive(terminal->send_entry, FALSE);
+        gtk_widget_set_sensitive(terminal->send_button, FALSE);
+        gtk_widget_set_sensitive(terminal->send_file_button, FALSE);
+        gtk_widget_set_sensitive(terminal->send_file_repeat_check, FALSE);
+        gtk_widget_set_sensitive(terminal->send_file_interval_combo, FALSE);
+        gtk_widget_set_sensitive(terminal->send_file_stop_button, FALSE);
+        gtk_widget_set_sensitive(terminal->break_button, FALSE);
     }
 }
 
+void on_connect_clicked(GtkWidget *widget, gpointer data) {
+    (void)widget;
+    connect_from_ui((SerialTerminal *)data);
+}
+
+void on_disconnect_clicked(GtkWidget *widget, gpointer data) {
+    (void)widget;
+    disconnect_from_ui((SerialTerminal *)data);
+}
+
 void on_refresh_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     SerialTerminal *terminal = (SerialTerminal *)data;
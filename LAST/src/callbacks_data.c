@@ -8,6 +8,19 @@
 #include "file_ops.h"
 #include "ui.h"
 
+// Send the entry text with the configured line ending
+static void send_data(SerialTerminal *terminal) {
+    if (!terminal->connected) return;
+
+    const char *text = gtk_entry_get_text(GTK_ENTRY(terminal->send_entry));
+    if (strlen(text) == 0) return;
+
+    connection_send_line(terminal, text, terminal->line_ending);
+
+    // Clear entry
+    gtk_entry_set_text(GTK_ENTRY(terminal->send_entry), "");
+}
+
 // Data transmission callbacks
 void on_send_activate(GtkWidget *widget, gpointer data) {
     (void)widget;
@@ -54,13 +67,15 @@ void on_log_toggled(GtkWidget *widget, gpointer data) {
 
 // Control signal callbacks
 void on_dtr_toggled(GtkWidget *widget, gpointer data) {
-    (void)widget;
-    set_control_signals((SerialTerminal *)data);
+    SerialTerminal *terminal = (SerialTerminal *)data;
+    terminal->dtr_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
+    set_control_signals(terminal);
 }
 
 void on_rts_toggled(GtkWidget *widget, gpointer data) {
-    (void)widget;
-    set_control_signals((SerialTerminal *)data);
+    SerialTerminal *terminal = (SerialTerminal *)data;
+    terminal->rts_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
+    set_control_signals(terminal);
 }
 
 void on_break_clicked(GtkWidget *widget, gpointer data) {
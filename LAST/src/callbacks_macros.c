@@ -12,85 +12,6 @@
 #include "settings.h"
 #include "scripting.h"
 
-// Forward declarations for macro chaining
-void send_single_command(SerialTerminal *terminal, const char *command, gboolean add_line_ending);
-void send_macro_command_parts(SerialTerminal *terminal, const char *command, int macro_index);
-
-void send_single_command(SerialTerminal *terminal, const char *command, gboolean add_line_ending) {
-    if (!terminal || !command || !terminal->connected || strlen(command) == 0) return;
-
-    // Send the command based on connection type
-    ssize_t bytes_written = 0;
-
-    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
-        bytes_written = write(terminal->connection_fd, command, strlen(command));
-    } else {
-        bytes_written = network_send_data(terminal, command, strlen(command));
-    }
-
-    if (bytes_written > 0) {
-        terminal->bytes_sent += bytes_written;
-        // Mark TX activity
-        terminal->tx_active = TRUE;
-        terminal->tx_last_activity = time(NULL);
-    }
-
-    // Add line ending if requested and configured
-    if (add_line_ending && terminal->line_ending && strlen(terminal->line_ending) > 0) {
-        if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
-            bytes_written = write(terminal->connection_fd, terminal->line_ending, strlen(terminal->line_ending));
-        } else {
-            bytes_written = network_send_data(terminal, terminal->line_ending, strlen(terminal->line_ending));
-        }
-
-        if (bytes_written > 0) {
-            terminal->bytes_sent += bytes_written;
-            // Mark TX activity for line ending too
-            terminal->tx_active = TRUE;
-            terminal->tx_last_activity = time(NULL);
-        }
-    }
-
-    // Log to file if enabled
-    if (terminal->log_file) {
-        char *timestamp = get_current_timestamp();
-        fprintf(terminal->log_file, "[%s] TX: %s\n", timestamp, command);
-        fflush(terminal->log_file);
-        free(timestamp);
-    }
-
-    // Local echo if enabled
-    if (terminal->local_echo) {
-        char echo_text[1024];
-        snprintf(echo_text, sizeof(echo_text), "TX: %s", command);
-        append_to_receive_text(terminal, echo_text, FALSE);
-    }
-}
-
-void send_macro_command_parts(SerialTerminal *terminal, const char *command, int macro_index) {
-    if (!terminal || !command || !terminal->connected) return;
-
-    // Parse command into parts to handle macro chaining properly
-    MacroParts *parts = parse_macro_command(terminal, command, macro_index);
-    if (!parts) {
-        // Fallback to sending as single command
-        send_single_command(terminal, command, TRUE);
-        return;
-    }
-
-    // Send each part
-    for (int i = 0; i < parts->count; i++) {
-        if (parts->parts[i] && strlen(parts->parts[i]) > 0) {
-            // Each macro reference gets its own line ending
-            // Regular text parts are combined until the next macro reference
-            gboolean add_ending = parts->is_macro_ref[i] || (i == parts->count - 1);
-            send_single_command(terminal, parts->parts[i], add_ending);
-        }
-    }
-
-    free_macro_parts(parts);
-}
-
 void on_macro_button_clicked(GtkWidget *widget, gpointer data) {
     SerialTerminal *terminal = (SerialTerminal *)data;
 
@@ -107,7 +28,7 @@ void on_macro_button_clicked(GtkWidget *widget, gpointer data) {
     // Only send if command is not empty
     if (strlen(command) > 0) {
         // Send the command with macro chaining support
-        send_macro_command_parts(terminal, command, macro_index);
+        send_macro_command(terminal, command, macro_index);
     }
 }
 
@@ -134,6 +55,11 @@ void on_script_window_destroy(GtkWidget *widget, gpointer data) {
     (void)widget;
     SerialTerminal *terminal = (SerialTerminal *)data;
     terminal->script_window = NULL;
+    terminal->script_stats_label = NULL;
+    if (terminal->script_stats_timer_id) {
+        g_source_remove(terminal->script_stats_timer_id);
+        terminal->script_stats_timer_id = 0;
+    }
 }
 
 void on_script_enable_toggled(GtkWidget *widget, gpointer data) {
@@ -19,7 +19,7 @@ void on_window_destroy(GtkWidget *widget, gpointer data) {
 
     // Clean up before exit
     if (terminal->connected) {
-        disconnect_serial(terminal);
+        disconnect_from_ui(terminal);
     }
 
     // Clean up scripting engine
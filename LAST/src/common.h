@@ -43,6 +43,19 @@
 #define MAX_PORT_LENGTH 8
 #define DEFAULT_NETWORK_PORT 10110  // Common NMEA 0183 over TCP port
 
+// Script event accounting (one slot per ScriptContext)
+#define MAX_SCRIPT_EVENT_TYPES 5
+// Handler duration histogram, 10 µs to 1 s (bounds in scripting.c)
+#define SCRIPT_DURATION_BUCKETS 10
+
+typedef struct {
+    unsigned long calls;
+    unsigned long errors;
+    guint64 total_ns;
+    guint64 max_ns;
+    unsigned long durations[SCRIPT_DURATION_BUCKETS]; // Calls up to each bound, not cumulative
+} ScriptEventStats;
+
 // Connection types
 typedef enum {
     CONNECTION_TYPE_SERIAL = 0,
@@ -52,8 +65,15 @@ typedef enum {
     CONNECTION_TYPE_UDP_SERVER
 } ConnectionType;
 
+typedef struct SerialTerminal SerialTerminal;
+
+// Front-end output hooks; the GTK window and the headless console each install
+// their own. May be called from the read thread.
+typedef void (*ReceiveSinkFunc)(SerialTerminal *terminal, const char *data, size_t length);
+typedef void (*TextSinkFunc)(SerialTerminal *terminal, const char *text);
+
 // Main application data structure
-typedef struct {
+struct SerialTerminal {
     // Main window and layout
     GtkWidget *window;
     GtkWidget *main_hbox;
@@ -142,6 +162,8 @@ typedef struct {
     gboolean connected;
     pthread_t read_thread;
     gboolean thread_running;
+    gboolean dtr_enabled;               // Control line levels applied on connect
+    gboolean rts_enabled;
 
     // Network connection details
     char network_host[MAX_HOSTNAME_LENGTH];
@@ -155,6 +177,12 @@ typedef struct {
     unsigned long bytes_sent;
     unsigned long bytes_received;
     time_t connection_start_time;
+    unsigned long connection_count;     // Connections opened since startup, reconnects included
+    gint close_notified;                // on_connection_close has run for this connection
+
+    // Opt-in loopback Prometheus endpoint
+    int metrics_port;                   // 0 when off
+    struct MetricsHttpServer *metrics_http;
 
     // Settings
     gboolean hex_display;
@@ -171,7 +199,7 @@ typedef struct {
     char *text_color;
     char *theme_preference; // "dark", "light", or "system"
 
-    // Connection settings (for persistence)
+    // Connection settings (persisted; connection_open reads the serial ones)
     char *saved_connection_type;
     char *saved_port;
     char *saved_baudrate;
@@ -184,8 +212,12 @@ typedef struct {
 
     // Scripting engine
     void *lua_state;                    // lua_State* (void* to avoid including lua.h here)
+    pthread_mutex_t script_mutex;       // Guards lua_state between the read thread and hot reloads
     gboolean scripting_enabled;
     char *script_content;
+    ScriptEventStats script_event_stats[MAX_SCRIPT_EVENT_TYPES]; // Guarded by script_mutex
+    GPtrArray *script_waiters;          // Suspended await()/sleep() tasks, guarded by script_mutex
+    guint script_timer_id;              // Timeout tick, only while a task has a deadline
 
     // Script UI widgets
     GtkWidget *script_window;
@@ -195,10 +227,16 @@ typedef struct {
     GtkWidget *script_clear_button;
     GtkWidget *script_enable_check;
     GtkWidget *script_test_button;
+    GtkWidget *script_stats_label;
+    guint script_stats_timer_id;
 
-    // File logging
+    // File logging; the read thread logs RX and the main thread the rest
+    pthread_mutex_t log_mutex;      // Guards log_file, log_index and the index state
     FILE *log_file;
     char *log_filename;
+    FILE *log_index;
+    time_t log_index_time;          // Second of the newest index entry
+    unsigned int log_index_records; // Records logged since it
 
     // Repeat file sending
     gboolean repeat_file_sending;
@@ -227,7 +265,12 @@ typedef struct {
     char macro_labels[MAX_MACRO_BUTTONS][MAX_MACRO_LABEL_LENGTH];
     char macro_commands[MAX_MACRO_BUTTONS][MAX_MACRO_COMMAND_LENGTH];
     gboolean macro_panel_visible;
-} SerialTerminal;
+
+    // Front end
+    ReceiveSinkFunc receive_sink;       // Received data the scripts did not suppress
+    TextSinkFunc text_sink;             // Local echo and notes for the receive area
+    TextSinkFunc status_sink;           // Connection status messages
+};
 
 // Global terminal instance (declared here, defined in main.c)
 extern SerialTerminal *g_terminal;
@@ -131,9 +131,8 @@ void send_file_once(SerialTerminal *terminal, const char *filename) {
 
         while (fgets(buffer, sizeof(buffer), file)) {
             size_t len = strlen(buffer);
-            ssize_t bytes_written = write(terminal->connection_fd, buffer, len);
+            ssize_t bytes_written = connection_send(terminal, buffer, len, NULL);
             if (bytes_written > 0) {
-                terminal->bytes_sent += bytes_written;
                 total_sent += bytes_written;
             }
             usleep(10000); // 10ms delay between lines
@@ -234,7 +233,7 @@ void toggle_logging(SerialTerminal *terminal) {
             if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
                 char *selected_filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
                 gtk_entry_set_text(GTK_ENTRY(terminal->log_file_entry), selected_filename);
-                filename = selected_filename;
+                filename = gtk_entry_get_text(GTK_ENTRY(terminal->log_file_entry));
                 g_free(selected_filename);
             } else {
                 gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(terminal->log_file_button), FALSE);
@@ -245,26 +244,11 @@ void toggle_logging(SerialTerminal *terminal) {
             gtk_widget_destroy(dialog);
         }
 
-        terminal->log_file = fopen(filename, "a");
-        if (terminal->log_file) {
-            char *timestamp = get_current_timestamp();
-            fprintf(terminal->log_file, "\n=== Log started at %s ===\n", timestamp);
-            fflush(terminal->log_file);
-            free(timestamp);
-
-            if (terminal->log_filename) free(terminal->log_filename);
-            terminal->log_filename = strdup(filename);
-        } else {
+        if (!connection_log_open(terminal, filename)) {
             gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(terminal->log_file_button), FALSE);
         }
     } else {
-        if (terminal->log_file) {
-            char *timestamp = get_current_timestamp();
-            fprintf(terminal->log_file, "=== Log ended at %s ===\n\n", timestamp);
-            fclose(terminal->log_file);
-            terminal->log_file = NULL;
-            free(timestamp);
-        }
+        connection_log_close(terminal);
     }
 }
 
@@ -360,45 +344,11 @@ gboolean line_by_line_timer_callback(gpointer data) {
             len--;
         }
 
-        // Send the line content
-        ssize_t bytes_written = 0;
-        if (len > 0) {
-            bytes_written = write(terminal->connection_fd, line, len);
-            if (bytes_written > 0) {
-                terminal->bytes_sent += bytes_written;
-                // Mark TX activity
-                terminal->tx_active = TRUE;
-                terminal->tx_last_activity = time(NULL);
-            }
-        }
-
-        // Always add CR-LF line ending
-        const char *line_ending = "\r\n";
-        ssize_t ending_bytes = write(terminal->connection_fd, line_ending, strlen(line_ending));
-        if (ending_bytes > 0) {
-            terminal->bytes_sent += ending_bytes;
-            // Mark TX activity for line ending too
-            terminal->tx_active = TRUE;
-            terminal->tx_last_activity = time(NULL);
-        }
+        // Send the line content, always with a CR-LF line ending
+        connection_send_line(terminal, line, "\r\n");
 
         terminal->current_line_number++;
 
-        // Log to file if enabled
-        if (terminal->log_file) {
-            char *timestamp = get_current_timestamp();
-            fprintf(terminal->log_file, "[%s] TX: %s\n", timestamp, line);
-            fflush(terminal->log_file);
-            free(timestamp);
-        }
-
-        // Local echo if enabled
-        if (terminal->local_echo) {
-            char echo_text[1024];
-            snprintf(echo_text, sizeof(echo_text), "TX: %s", line);
-            append_to_receive_text(terminal, echo_text, FALSE);
-        }
-
         // Force GUI updates to be processed immediately for real-time display
         while (gtk_events_pending()) {
             gtk_main_iteration();
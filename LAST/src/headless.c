@@ -0,0 +1,406 @@
+/*
+ * Headless front end for LAST - Linux Advanced Serial Transceiver
+ * Drives the connection, scripting, logging and macro engine from the command
+ * line: received data goes to stdout, status and echo to stderr
+ */
+
+#include "headless.h"
+#include "serial.h"
+#include "network.h"
+#include "scripting.h"
+#include "metrics_http.h"
+#include "utils.h"
+#include <glib-unix.h>
+#include <signal.h>
+#include <strings.h>
+
+// Something to transmit once connected, in command line order
+typedef struct {
+    gboolean macro;             // text names a stored macro (number or label)
+    const char *text;
+} HeadlessSend;
+
+static struct {
+    GMainLoop *loop;
+    gboolean hex_output;
+    gboolean quiet;
+    int status;                 // Exit status decided inside the loop
+    GArray *sends;              // Sent once connected
+    guint accept_id;            // --tcp-listen: waiting for the client
+} run;
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [--headless OPTIONS]\n"
+            "\n"
+            "Without --headless LAST opens its window. Headless options:\n"
+            "  --port DEVICE          Serial device, e.g. /dev/ttyUSB0\n"
+            "  --baud RATE            Baud rate (default from settings, else 9600)\n"
+            "  --databits 5|6|7|8     Data bits\n"
+            "  --parity none|even|odd\n"
+            "  --stopbits 1|2\n"
+            "  --flow none|hardware|software\n"
+            "  --dtr, --rts           Assert DTR / RTS once connected\n"
+            "  --tcp HOST:PORT        TCP client instead of a serial port\n"
+            "  --tcp-listen PORT      TCP server (waits for one client)\n"
+            "  --udp HOST:PORT        UDP client\n"
+            "  --udp-listen PORT      UDP server\n"
+            "  --script FILE          Load and enable a Lua script\n"
+            "  --log FILE             Append a capture log (same format as the GUI log)\n"
+            "  --send TEXT            Send TEXT and the line ending once connected\n"
+            "  --macro N|LABEL        Send a stored macro once connected\n"
+            "  --line-ending none|cr|lf|crlf\n"
+            "  --duration SECONDS     Disconnect and exit after SECONDS\n"
+            "  --hex                  Print received data as hex\n"
+            "  --quiet                Do not print received data\n"
+            "  --metrics-port PORT    Serve /metrics on 127.0.0.1:PORT, 0 = off\n"
+            "\n"
+            "--send and --macro may be repeated and run in the order given.\n",
+            program);
+}
+
+gboolean headless_requested(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 ||
+            strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Output sinks: data is binary-safe on stdout, everything else on stderr
+
+static void headless_receive_sink(SerialTerminal *terminal, const char *data, size_t length) {
+    (void)terminal;
+    if (run.quiet) return;
+
+    if (run.hex_output) {
+        char *hex = format_data_for_display(data, length, TRUE);
+        fputs(hex, stdout);
+        free(hex);
+    } else {
+        fwrite(data, 1, length, stdout);
+    }
+    fflush(stdout);
+}
+
+static void headless_text_sink(SerialTerminal *terminal, const char *text) {
+    (void)terminal;
+    fprintf(stderr, "%s\n", text);
+}
+
+static void headless_print_handler(const gchar *string) {
+    // Script log() output and engine messages must not mix with received data
+    fputs(string, stderr);
+}
+
+static void set_string(char **field, const char *value) {
+    if (*field) free(*field);
+    *field = strdup(value);
+}
+
+// Map a case-insensitive choice onto the spelling the settings use
+static const char *find_choice(const char *value, const char *const *choices) {
+    for (int i = 0; choices[i]; i++) {
+        if (strcasecmp(value, choices[i]) == 0) return choices[i];
+    }
+    return NULL;
+}
+
+// Split HOST:PORT into the terminal's network fields
+static gboolean set_host_port(SerialTerminal *terminal, const char *value) {
+    const char *colon = strrchr(value, ':');
+    if (!colon || colon == value) return FALSE;
+
+    size_t host_length = (size_t)(colon - value);
+    if (host_length >= MAX_HOSTNAME_LENGTH) return FALSE;
+    memcpy(terminal->network_host, value, host_length);
+    terminal->network_host[host_length] = '\0';
+
+    if (!is_valid_hostname(terminal->network_host) || !is_valid_port(colon + 1)) return FALSE;
+    g_strlcpy(terminal->network_port, colon + 1, MAX_PORT_LENGTH);
+    return TRUE;
+}
+
+static gboolean on_quit_signal(gpointer data) {
+    (void)data;
+    g_main_loop_quit(run.loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_duration_elapsed(gpointer data) {
+    (void)data;
+    g_main_loop_quit(run.loop);
+    return G_SOURCE_CONTINUE; // Removed with the other sources after the loop
+}
+
+// The network read thread stops on its own when the peer closes or fails
+static gboolean watch_connection(gpointer data) {
+    SerialTerminal *terminal = (SerialTerminal *)data;
+
+    if (terminal->connected && !terminal->thread_running) {
+        g_main_loop_quit(run.loop);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean publish_metrics_timer(gpointer data) {
+    publish_metrics((SerialTerminal *)data);
+    return G_SOURCE_CONTINUE;
+}
+
+static int send_queued(SerialTerminal *terminal, GArray *sends) {
+    for (guint i = 0; i < sends->len; i++) {
+        HeadlessSend *send = &g_array_index(sends, HeadlessSend, i);
+
+        if (!send->macro) {
+            connection_send_line(terminal, send->text, terminal->line_ending);
+            continue;
+        }
+
+        int index = resolve_macro_by_number(send->text);
+        if (index < 0) index = resolve_macro_by_name(terminal, send->text);
+        if (index < 0 || strlen(terminal->macro_commands[index]) == 0) {
+            fprintf(stderr, "last: no macro %s\n", send->text);
+            return 1;
+        }
+        send_macro_command(terminal, terminal->macro_commands[index], index);
+    }
+    return 0;
+}
+
+// --tcp-listen: the client is accepted from inside the loop, so a signal or
+// --duration can end the run while nobody has connected
+static gboolean on_tcp_client(gint fd, GIOCondition condition, gpointer data) {
+    (void)fd;
+    (void)condition;
+    SerialTerminal *terminal = (SerialTerminal *)data;
+
+    if (!connection_open(terminal)) {
+        // A client that left before it was accepted; keep listening
+        if (terminal->server_fd >= 0) return G_SOURCE_CONTINUE;
+        run.status = 1;
+    } else {
+        run.status = send_queued(terminal, run.sends);
+    }
+
+    if (run.status != 0) g_main_loop_quit(run.loop);
+    run.accept_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+// Open the listening socket and watch it for the client
+static gboolean start_tcp_listen(SerialTerminal *terminal) {
+    if (!listen_tcp_server(terminal, atoi(terminal->network_port))) return FALSE;
+
+    int flags = fcntl(terminal->server_fd, F_GETFL);
+    fcntl(terminal->server_fd, F_SETFL, flags | O_NONBLOCK);
+    run.accept_id = g_unix_fd_add(terminal->server_fd, G_IO_IN, on_tcp_client, terminal);
+
+    char message[128];
+    snprintf(message, sizeof(message), "Waiting for a TCP client on port %s", terminal->network_port);
+    show_network_status(terminal, message);
+    return TRUE;
+}
+
+void headless_init(SerialTerminal *terminal) {
+    g_set_print_handler(headless_print_handler);
+
+    terminal->receive_sink = headless_receive_sink;
+    terminal->text_sink = headless_text_sink;
+    terminal->status_sink = headless_text_sink;
+}
+
+int headless_main(SerialTerminal *terminal, int argc, char *argv[]) {
+    static const char *const parities[] = {"None", "Even", "Odd", NULL};
+    static const char *const flows[] = {"None", "Hardware", "Software", NULL};
+
+    const char *script = NULL;
+    const char *log = NULL;
+    double duration = 0;
+    gboolean have_connection = FALSE;
+    GArray *sends = g_array_new(FALSE, FALSE, sizeof(HeadlessSend));
+    int status = 0;
+
+    memset(&run, 0, sizeof(run));
+
+    // Only --script enables scripting; the settings file keeps the GUI's choice
+    terminal->scripting_enabled = FALSE;
+
+    for (int i = 1; i < argc && status == 0; i++) {
+        const char *arg = argv[i];
+        const char *value = NULL;
+
+        if (strcmp(arg, "--headless") == 0) continue;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_usage(argv[0]);
+            g_array_free(sends, TRUE);
+            return 0;
+        }
+
+        // Flags without a value
+        if (strcmp(arg, "--dtr") == 0) { terminal->dtr_enabled = TRUE; continue; }
+        if (strcmp(arg, "--rts") == 0) { terminal->rts_enabled = TRUE; continue; }
+        if (strcmp(arg, "--hex") == 0) { run.hex_output = TRUE; continue; }
+        if (strcmp(arg, "--quiet") == 0) { run.quiet = TRUE; continue; }
+
+        if (strncmp(arg, "--", 2) != 0 || i + 1 >= argc) {
+            fprintf(stderr, "last: %s %s\n", arg,
+                    strncmp(arg, "--", 2) != 0 ? "is not an option" : "needs a value");
+            status = 2;
+            break;
+        }
+        value = argv[++i];
+
+        if (strcmp(arg, "--port") == 0) {
+            terminal->connection_type = CONNECTION_TYPE_SERIAL;
+            set_string(&terminal->saved_port, value);
+            have_connection = TRUE;
+        } else if (strcmp(arg, "--baud") == 0) {
+            if (!is_supported_baudrate(value)) status = 2;
+            else set_string(&terminal->saved_baudrate, value);
+        } else if (strcmp(arg, "--databits") == 0) {
+            if (strlen(value) != 1 || value[0] < '5' || value[0] > '8') status = 2;
+            else set_string(&terminal->saved_databits, value);
+        } else if (strcmp(arg, "--parity") == 0) {
+            const char *parity = find_choice(value, parities);
+            if (!parity) status = 2;
+            else set_string(&terminal->saved_parity, parity);
+        } else if (strcmp(arg, "--stopbits") == 0) {
+            if (strcmp(value, "1") != 0 && strcmp(value, "2") != 0) status = 2;
+            else set_string(&terminal->saved_stopbits, value);
+        } else if (strcmp(arg, "--flow") == 0) {
+            const char *flow = find_choice(value, flows);
+            if (!flow) status = 2;
+            else set_string(&terminal->saved_flowcontrol, flow);
+        } else if (strcmp(arg, "--tcp") == 0 || strcmp(arg, "--udp") == 0) {
+            terminal->connection_type = arg[2] == 't' ? CONNECTION_TYPE_TCP_CLIENT
+                                                      : CONNECTION_TYPE_UDP_CLIENT;
+            if (!set_host_port(terminal, value)) status = 2;
+            have_connection = TRUE;
+        } else if (strcmp(arg, "--tcp-listen") == 0 || strcmp(arg, "--udp-listen") == 0) {
+            terminal->connection_type = arg[2] == 't' ? CONNECTION_TYPE_TCP_SERVER
+                                                      : CONNECTION_TYPE_UDP_SERVER;
+            if (!is_valid_port(value)) status = 2;
+            else g_strlcpy(terminal->network_port, value, MAX_PORT_LENGTH);
+            have_connection = TRUE;
+        } else if (strcmp(arg, "--script") == 0) {
+            script = value;
+        } else if (strcmp(arg, "--log") == 0) {
+            log = value;
+        } else if (strcmp(arg, "--send") == 0 || strcmp(arg, "--macro") == 0) {
+            HeadlessSend send = { strcmp(arg, "--macro") == 0, value };
+            g_array_append_val(sends, send);
+        } else if (strcmp(arg, "--line-ending") == 0) {
+            static const char *const names[] = {"none", "cr", "lf", "crlf", NULL};
+            static const char *const endings[] = {"", "\r", "\n", "\r\n"};
+            const char *name = find_choice(value, names);
+            if (!name) status = 2;
+            for (int n = 0; name && names[n]; n++) {
+                if (names[n] == name) set_string(&terminal->line_ending, endings[n]);
+            }
+        } else if (strcmp(arg, "--duration") == 0) {
+            char *end;
+            duration = strtod(value, &end);
+            if (*end != '\0' || duration <= 0) status = 2;
+        } else if (strcmp(arg, "--metrics-port") == 0) {
+            if (strcmp(value, "0") == 0) terminal->metrics_port = 0;
+            else if (!is_valid_port(value)) status = 2;
+            else terminal->metrics_port = atoi(value);
+        } else {
+            fprintf(stderr, "last: unknown option %s\n", arg);
+            status = 2;
+            break;
+        }
+
+        if (status != 0) fprintf(stderr, "last: invalid %s value: %s\n", arg, value);
+    }
+
+    if (status == 0 && !have_connection) {
+        fprintf(stderr, "last: --headless needs --port, --tcp, --tcp-listen, --udp or --udp-listen\n");
+        status = 2;
+    }
+    if (status != 0) {
+        fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+        g_array_free(sends, TRUE);
+        return status;
+    }
+
+    // A closed TCP peer or stdout pipe should end the run cleanly, not kill it
+    signal(SIGPIPE, SIG_IGN);
+
+    if (script && !scripting_load_script_file(terminal, script)) {
+        fprintf(stderr, "last: could not load script %s\n", script);
+        status = 1;
+    }
+    if (status == 0 && log && !connection_log_open(terminal, log)) {
+        fprintf(stderr, "last: could not open log %s: %s\n", log, strerror(errno));
+        status = 1;
+    }
+
+    if (status == 0 && terminal->metrics_port > 0) {
+        terminal->metrics_http = metrics_http_server_new(terminal->metrics_port);
+        if (terminal->metrics_http) {
+            publish_metrics(terminal);
+            g_print("Metrics: http://127.0.0.1:%d/metrics\n", terminal->metrics_port);
+        } else {
+            g_warning("Failed to open metrics endpoint on 127.0.0.1:%d: %s",
+                      terminal->metrics_port, strerror(errno));
+        }
+    }
+
+    if (status == 0) {
+        // Signals and --duration first, so they also cover connecting
+        run.loop = g_main_loop_new(NULL, FALSE);
+        run.sends = sends;
+        guint sigint_id = g_unix_signal_add(SIGINT, on_quit_signal, NULL);
+        guint sigterm_id = g_unix_signal_add(SIGTERM, on_quit_signal, NULL);
+        guint watch_id = g_timeout_add(100, watch_connection, terminal);
+        guint metrics_id = terminal->metrics_http ?
+                           g_timeout_add(1000, publish_metrics_timer, terminal) : 0;
+        guint duration_id = duration > 0 ?
+                            g_timeout_add((guint)(duration * 1000), on_duration_elapsed, NULL) : 0;
+
+        if (terminal->connection_type == CONNECTION_TYPE_TCP_SERVER) {
+            if (!start_tcp_listen(terminal)) status = 1;
+        } else if (!connection_open(terminal)) {
+            status = 1;
+        } else {
+            status = send_queued(terminal, sends);
+        }
+
+        if (status == 0) {
+            g_main_loop_run(run.loop);
+            status = run.status;
+        }
+
+        if (run.accept_id) g_source_remove(run.accept_id);
+        g_source_remove(sigint_id);
+        g_source_remove(sigterm_id);
+        g_source_remove(watch_id);
+        if (metrics_id) g_source_remove(metrics_id);
+        if (duration_id) g_source_remove(duration_id);
+        g_main_loop_unref(run.loop);
+        run.loop = NULL;
+        run.accept_id = 0;
+    }
+
+    if (terminal->connected) {
+        time_t elapsed = time(NULL) - terminal->connection_start_time;
+        connection_close(terminal);
+        fprintf(stderr, "Sent %lu bytes, received %lu bytes in %ld s\n",
+                terminal->bytes_sent, terminal->bytes_received, (long)elapsed);
+    }
+
+    // Still listening when the run ended before a client came
+    if (!terminal->connected) disconnect_network(terminal);
+
+    connection_log_close(terminal);
+    metrics_http_server_free(terminal->metrics_http);
+    terminal->metrics_http = NULL;
+    scripting_cleanup(terminal);
+    g_array_free(sends, TRUE);
+
+    return status;
+}
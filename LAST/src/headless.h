@@ -0,0 +1,21 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "common.h"
+
+/*
+ * Headless front end for LAST
+ * Runs one connection from the command line, with no display
+ */
+
+// TRUE when argv asks for the headless front end (--headless, or --help)
+gboolean headless_requested(int argc, char *argv[]);
+
+// Installs the console output sinks; call before anything can report
+void headless_init(SerialTerminal *terminal);
+
+// Parses the headless options, connects and runs until SIGINT/SIGTERM,
+// --duration or the peer closing. Returns the process exit status.
+int headless_main(SerialTerminal *terminal, int argc, char *argv[]);
+
+#endif // HEADLESS_H
@@ -12,16 +12,30 @@
 #include "settings.h"
 #include "callbacks.h"
 #include "scripting.h"
+#include "metrics_http.h"
+#include "headless.h"
 
 // Global terminal instance (defined here, declared in common.h)
 SerialTerminal *g_terminal = NULL;
 
 int main(int argc, char *argv[]) {
-    gtk_init(&argc, &argv);
+    // The headless front end runs the same engine without a display
+    gboolean headless = headless_requested(argc, argv);
+    if (!headless) {
+        gtk_init(&argc, &argv);
+    }
 
     SerialTerminal terminal = {0};
     g_terminal = &terminal;
 
+    if (headless) {
+        headless_init(&terminal);
+    } else {
+        terminal.receive_sink = ui_receive_sink;
+        terminal.text_sink = ui_text_sink;
+        terminal.status_sink = ui_status_sink;
+    }
+
     // Initialize settings
     terminal.hex_display = TRUE;  // Default to showing hex display
     terminal.hex_bytes_per_line = 0;  // 0 = Auto mode (CR+LF detection)
@@ -31,6 +45,7 @@ int main(int argc, char *argv[]) {
     terminal.line_ending = strdup("\r\n");
     terminal.log_file = NULL;
     terminal.log_filename = NULL;
+    pthread_mutex_init(&terminal.log_mutex, NULL);
 
     // Initialize appearance settings
     terminal.font_family = strdup("Monospace");
@@ -106,6 +121,10 @@ int main(int argc, char *argv[]) {
     // Load settings before creating UI
     load_settings(&terminal);
 
+    if (headless) {
+        return headless_main(&terminal, argc, argv);
+    }
+
     // Create main interface
     create_main_interface(&terminal);
 
@@ -121,6 +140,18 @@ int main(int argc, char *argv[]) {
     // Connect all signals AFTER settings are applied
     connect_signals(&terminal);
 
+    // Opt-in Prometheus endpoint; the statistics timer keeps its snapshot fresh
+    if (terminal.metrics_port > 0) {
+        terminal.metrics_http = metrics_http_server_new(terminal.metrics_port);
+        if (terminal.metrics_http) {
+            publish_metrics(&terminal);
+            g_print("Metrics: http://127.0.0.1:%d/metrics\n", terminal.metrics_port);
+        } else {
+            g_warning("Failed to open metrics endpoint on 127.0.0.1:%d: %s",
+                      terminal.metrics_port, strerror(errno));
+        }
+    }
+
     // Start statistics update timer (every second)
     g_timeout_add(1000, update_statistics_timer, &terminal);
 
@@ -139,5 +170,7 @@ int main(int argc, char *argv[]) {
     // Run main loop
     gtk_main();
 
+    metrics_http_server_free(terminal.metrics_http);
+
     return 0;
 }
@@ -0,0 +1,177 @@
+/*
+ * Metrics HTTP endpoint, shared by BRIDGE and LAST
+ * "curl http://127.0.0.1:<port>/metrics" returns the latest snapshot the
+ * program published, in the Prometheus text format. A scrape only copies
+ * that snapshot, so it never waits on the threads that produce the counters.
+ * Keep this file identical in both programs; see metrics_http.h.
+ */
+
+#include "metrics_http.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static void send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += sent;
+        length -= sent;
+    }
+}
+
+// A HEAD reply carries the same headers as GET, including the body's length,
+// but not the body itself
+static void send_response(int fd, const char *status, const char *body, size_t body_length,
+                          int head) {
+    char header[256];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.0 %s\r\n"
+                          "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                          "Content-Length: %zu\r\n"
+                          "Connection: close\r\n\r\n",
+                          status, body_length);
+    send_all(fd, header, (size_t)length);
+    if (!head) send_all(fd, body, body_length);
+}
+
+// One request per connection; scrapers do not need keep-alive
+static void handle_client(MetricsHttpServer *server, int fd) {
+    char request[METRICS_HTTP_REQUEST_SIZE];
+    size_t length = 0;
+
+    while (length < sizeof(request) - 1) {
+        ssize_t received = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) break;
+        length += received;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[length] = '\0';
+
+    char method[8], path[256];
+    if (sscanf(request, "%7s %255s", method, path) != 2) {
+        send_response(fd, "400 Bad Request", "Bad request\n", 12, 0);
+        return;
+    }
+    if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) {
+        send_response(fd, "405 Method Not Allowed", "Only GET is supported\n", 22, 0);
+        return;
+    }
+    int head = strcmp(method, "HEAD") == 0;
+    if (strcmp(path, "/metrics") != 0 && strcmp(path, "/") != 0) {
+        send_response(fd, "404 Not Found", "Try /metrics\n", 13, head);
+        return;
+    }
+
+    pthread_mutex_lock(&server->snapshot_mutex);
+    size_t body_length = server->snapshot_length;
+    char *body = malloc(body_length + 1);
+    if (body) memcpy(body, server->snapshot ? server->snapshot : "", body_length);
+    pthread_mutex_unlock(&server->snapshot_mutex);
+
+    if (!body) {
+        send_response(fd, "503 Service Unavailable", "Out of memory\n", 14, head);
+        return;
+    }
+    send_response(fd, "200 OK", body, body_length, head);
+    free(body);
+}
+
+static void *metrics_http_thread_func(void *arg) {
+    MetricsHttpServer *server = (MetricsHttpServer *)arg;
+
+    while (g_atomic_int_get(&server->running)) {
+        struct pollfd pfd = { .fd = server->listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 100) <= 0) continue;     // 100 ms, to notice a stop
+
+        int client_fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) continue;
+
+        // A stalled scraper must not hold up the next one for long
+        struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handle_client(server, client_fd);
+        close(client_fd);
+    }
+
+    return NULL;
+}
+
+MetricsHttpServer* metrics_http_server_new(int port) {
+    MetricsHttpServer *server = calloc(1, sizeof(MetricsHttpServer));
+    if (!server) return NULL;
+
+    server->port = port;
+    pthread_mutex_init(&server->snapshot_mutex, NULL);
+
+    // Loopback only: the counters are not meant for the network at large
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) {
+        int saved_errno = errno;
+        metrics_http_server_free(server);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    int opt = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server->listen_fd, SOMAXCONN) < 0) {
+        int saved_errno = errno;
+        metrics_http_server_free(server);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    g_atomic_int_set(&server->running, 1);
+    int error = pthread_create(&server->thread, NULL, metrics_http_thread_func, server);
+    if (error != 0) {
+        g_atomic_int_set(&server->running, 0);
+        metrics_http_server_free(server);
+        errno = error;
+        return NULL;
+    }
+
+    return server;
+}
+
+void metrics_http_server_free(MetricsHttpServer *server) {
+    if (!server) return;
+
+    if (g_atomic_int_get(&server->running)) {
+        g_atomic_int_set(&server->running, 0);
+        pthread_join(server->thread, NULL);
+    }
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    pthread_mutex_destroy(&server->snapshot_mutex);
+    g_free(server->snapshot);
+    free(server);
+}
+
+// Take over the text of a freshly built snapshot; the GString is freed
+void metrics_http_publish(MetricsHttpServer *server, GString *text) {
+    size_t length = text->len;
+    char *snapshot = g_string_free(text, FALSE);
+
+    pthread_mutex_lock(&server->snapshot_mutex);
+    char *old = server->snapshot;
+    server->snapshot = snapshot;
+    server->snapshot_length = length;
+    pthread_mutex_unlock(&server->snapshot_mutex);
+
+    g_free(old);
+}
@@ -0,0 +1,38 @@
+/*
+ * Metrics HTTP endpoint header, shared by BRIDGE and LAST
+ * Serves the latest metrics snapshot to Prometheus on a loopback port.
+ *
+ * BRIDGE/src/metrics_http.[ch] and LAST/src/metrics_http.[ch] are the same
+ * files, copied because the two programs build separately. Change both. The
+ * metrics themselves are formatted by each program (metrics_format_prometheus)
+ * and handed over with metrics_http_publish.
+ */
+
+#ifndef METRICS_HTTP_H
+#define METRICS_HTTP_H
+
+#include "common.h"
+
+// Largest request header read before answering
+#define METRICS_HTTP_REQUEST_SIZE 4096
+
+typedef struct MetricsHttpServer {
+    int listen_fd;
+    int port;
+    pthread_t thread;           // Answers scrapes, one at a time
+    gint running;
+
+    // Published by the main thread, copied out by each scrape
+    pthread_mutex_t snapshot_mutex;
+    char *snapshot;
+    size_t snapshot_length;
+} MetricsHttpServer;
+
+// NULL with errno set when the port cannot be opened
+MetricsHttpServer* metrics_http_server_new(int port);
+void metrics_http_server_free(MetricsHttpServer *server);
+
+// Take over a freshly formatted snapshot; main thread
+void metrics_http_publish(MetricsHttpServer *server, GString *text);
+
+#endif // METRICS_HTTP_H
@@ -90,7 +90,8 @@ gboolean connect_tcp_client(SerialTerminal *terminal, const char *host, int port
     return TRUE;
 }
 
-gboolean connect_tcp_server(SerialTerminal *terminal, int port) {
+// Open the listening socket in server_fd; no client is accepted yet
+gboolean listen_tcp_server(SerialTerminal *terminal, int port) {
     int opt = 1;
     
     // Create socket
@@ -130,10 +131,21 @@ gboolean connect_tcp_server(SerialTerminal *terminal, int port) {
         return FALSE;
     }
     
-    // Accept connection (blocking)
-    terminal->client_addr_len = sizeof(terminal->client_addr);
-    terminal->connection_fd = accept(terminal->server_fd, (struct sockaddr*)&terminal->client_addr, &terminal->client_addr_len);
+    return TRUE;
+}
+
+// Accept the client on server_fd. This blocks unless the caller made server_fd
+// nonblocking; then a client that is not there (yet) fails with EAGAIN and the
+// listening socket stays open for the next try.
+gboolean accept_tcp_client(SerialTerminal *terminal) {
+    do {
+        terminal->client_addr_len = sizeof(terminal->client_addr);
+        terminal->connection_fd = accept(terminal->server_fd, (struct sockaddr*)&terminal->client_addr,
+                                         &terminal->client_addr_len);
+    } while (terminal->connection_fd < 0 && errno == EINTR);
+
     if (terminal->connection_fd < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return FALSE;
         close(terminal->server_fd);
         terminal->server_fd = -1;
         show_network_status(terminal, "Failed to accept TCP connection");
@@ -143,6 +155,14 @@ gboolean connect_tcp_server(SerialTerminal *terminal, int port) {
     return TRUE;
 }
 
+// Listen unless a listening socket is already open, then wait for the client
+gboolean connect_tcp_server(SerialTerminal *terminal, int port) {
+    if (terminal->server_fd < 0 && !listen_tcp_server(terminal, port)) {
+        return FALSE;
+    }
+    return accept_tcp_client(terminal);
+}
+
 gboolean connect_udp_client(SerialTerminal *terminal, const char *host, int port) {
     struct hostent *server;
     
@@ -234,9 +254,7 @@ ssize_t network_send_data(SerialTerminal *terminal, const void *data, size_t len
 }
 
 void show_network_status(SerialTerminal *terminal, const char *message) {
-    if (terminal && terminal->status_label) {
-        gtk_label_set_text(GTK_LABEL(terminal->status_label), message);
-    }
+    show_status_message(terminal, message);
 }
 
 char* get_network_connection_info(SerialTerminal *terminal) {
@@ -309,40 +327,22 @@ void *network_read_thread_func(void *arg) {
             }
 
             if (bytes_read > 0) {
-                // Update statistics
-                terminal->bytes_received += bytes_read;
-
-                // Mark RX activity
-                terminal->rx_active = TRUE;
-                terminal->rx_last_activity = time(NULL);
-
-                // Log to file if enabled
-                if (terminal->log_file) {
-                    char *timestamp = get_current_timestamp();
-                    // For file logging, null-terminate for text output
-                    buffer[bytes_read] = '\0';
-                    fprintf(terminal->log_file, "[%s] RX: %s", timestamp, buffer);
-                    fflush(terminal->log_file);
-                    free(timestamp);
-                }
-
-                // Create dual display data structure (reuse from serial.c)
-                DualDisplayData *dual_data = malloc(sizeof(DualDisplayData));
-                dual_data->text_data = format_data_for_display(buffer, bytes_read, FALSE);
-                dual_data->hex_data = format_data_for_display(buffer, bytes_read, TRUE);
-                dual_data->show_hex = terminal->hex_display;
-                g_idle_add(append_to_dual_display_idle, dual_data);
+                connection_handle_received(terminal, buffer, bytes_read);
 
             } else if (bytes_read == 0) {
                 // Connection closed by peer (TCP only)
                 if (terminal->connection_type == CONNECTION_TYPE_TCP_CLIENT ||
                     terminal->connection_type == CONNECTION_TYPE_TCP_SERVER) {
                     show_network_status(terminal, "Connection closed by peer");
+                    connection_notify_close(terminal);
+                    terminal->thread_running = FALSE; // Lets a headless run notice
                     break;
                 }
             } else if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
                 // Real error occurred
                 show_network_status(terminal, "Network read error");
+                connection_notify_close(terminal);
+                terminal->thread_running = FALSE;
                 break;
             }
         }
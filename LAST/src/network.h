@@ -11,6 +11,8 @@
 // Network connection management functions
 gboolean connect_tcp_client(SerialTerminal *terminal, const char *host, int port);
 gboolean connect_tcp_server(SerialTerminal *terminal, int port);
+gboolean listen_tcp_server(SerialTerminal *terminal, int port);
+gboolean accept_tcp_client(SerialTerminal *terminal);
 gboolean connect_udp_client(SerialTerminal *terminal, const char *host, int port);
 gboolean connect_udp_server(SerialTerminal *terminal, int port);
 void disconnect_network(SerialTerminal *terminal);
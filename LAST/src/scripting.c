@@ -1,40 +1,111 @@
 #include "scripting.h"
 #include "network.h"
+#include "serial.h"
 #include "utils.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+// Deepest table nesting copied across a hot reload
+#define MAX_STATE_COPY_DEPTH 32
+
+// Create a Lua state with the standard libraries and the LAST API registered
+static lua_State* create_script_state(SerialTerminal *terminal) {
+    lua_State *L = luaL_newstate();
+    if (!L) return NULL;
+
+    // Load standard Lua libraries
+    luaL_openlibs(L);
+
+    // Register LAST API functions
+    lua_register(L, "log", lua_last_log);
+    lua_register(L, "send", lua_last_send);
+    lua_register(L, "get_connection_info", lua_last_get_connection_info);
+    lua_register(L, "get_statistics", lua_last_get_statistics);
+    lua_register(L, "parse_nmea", lua_last_parse_nmea);
+    lua_register(L, "create_nmea", lua_last_create_nmea);
+    lua_register(L, "calculate_checksum", lua_last_calculate_checksum);
+    scripting_buffer_register(L);
+    scripting_async_register(L);
+
+    // Store terminal reference in Lua registry for API functions
+    lua_pushlightuserdata(L, terminal);
+    lua_setfield(L, LUA_REGISTRYINDEX, "terminal");
+
+    return L;
+}
+
+// Copy a plain-data value (boolean, number, string or table) between two states.
+// Functions, userdata and coroutines cannot cross states and arrive as nil.
+static void copy_lua_value(lua_State *from, int index, lua_State *to, int depth) {
+    index = lua_absindex(from, index);
+
+    if (!lua_checkstack(to, 3) || !lua_checkstack(from, 2)) {
+        lua_pushnil(to);
+        return;
+    }
+
+    switch (lua_type(from, index)) {
+        case LUA_TBOOLEAN:
+            lua_pushboolean(to, lua_toboolean(from, index));
+            break;
+        case LUA_TNUMBER:
+            if (lua_isinteger(from, index)) {
+                lua_pushinteger(to, lua_tointeger(from, index));
+            } else {
+                lua_pushnumber(to, lua_tonumber(from, index));
+            }
+            break;
+        case LUA_TSTRING: {
+            size_t length;
+            const char *str = lua_tolstring(from, index, &length);
+            lua_pushlstring(to, str, length);
+            break;
+        }
+        case LUA_TTABLE:
+            if (depth >= MAX_STATE_COPY_DEPTH) {
+                lua_pushnil(to);
+                break;
+            }
+            lua_newtable(to);
+            lua_pushnil(from);
+            while (lua_next(from, index) != 0) {
+                int key_type = lua_type(from, -2);
+                if (key_type == LUA_TSTRING || key_type == LUA_TNUMBER || key_type == LUA_TBOOLEAN) {
+                    copy_lua_value(from, -2, to, depth + 1);
+                    copy_lua_value(from, -1, to, depth + 1);
+                    lua_rawset(to, -3);
+                }
+                lua_pop(from, 1);
+            }
+            break;
+        default:
+            lua_pushnil(to);
+            break;
+    }
+}
+
 // Initialize Lua scripting engine
 gboolean scripting_init(SerialTerminal *terminal) {
     if (!terminal) return FALSE;
-    
+
+    // Recursive so that send() from inside a handler can re-enter the engine
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&terminal->script_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
     // Create new Lua state
-    terminal->lua_state = luaL_newstate();
+    terminal->lua_state = create_script_state(terminal);
     if (!terminal->lua_state) {
         g_print("Error: Failed to create Lua state\n");
         return FALSE;
     }
-    
-    // Load standard Lua libraries
-    luaL_openlibs(terminal->lua_state);
-    
-    // Register LAST API functions
-    lua_register(terminal->lua_state, "log", lua_last_log);
-    lua_register(terminal->lua_state, "send", lua_last_send);
-    lua_register(terminal->lua_state, "get_connection_info", lua_last_get_connection_info);
-    lua_register(terminal->lua_state, "get_statistics", lua_last_get_statistics);
-    lua_register(terminal->lua_state, "parse_nmea", lua_last_parse_nmea);
-    lua_register(terminal->lua_state, "create_nmea", lua_last_create_nmea);
-    lua_register(terminal->lua_state, "calculate_checksum", lua_last_calculate_checksum);
-    
-    // Store terminal reference in Lua registry for API functions
-    lua_pushlightuserdata(terminal->lua_state, terminal);
-    lua_setfield(terminal->lua_state, LUA_REGISTRYINDEX, "terminal");
-    
+
     terminal->scripting_enabled = FALSE;
     terminal->script_content = NULL;
-    
+
     g_print("Lua scripting engine initialized successfully\n");
     return TRUE;
 }
@@ -42,45 +113,102 @@ gboolean scripting_init(SerialTerminal *terminal) {
 // Cleanup Lua scripting engine
 void scripting_cleanup(SerialTerminal *terminal) {
     if (!terminal) return;
-    
+
+    pthread_mutex_lock(&terminal->script_mutex);
+
     if (terminal->lua_state) {
+        scripting_async_drop_state(terminal, terminal->lua_state);
         lua_close(terminal->lua_state);
         terminal->lua_state = NULL;
     }
-    
+
+    if (terminal->script_timer_id) {
+        g_source_remove(terminal->script_timer_id);
+        terminal->script_timer_id = 0;
+    }
+    if (terminal->script_waiters) {
+        g_ptr_array_free(terminal->script_waiters, TRUE);
+        terminal->script_waiters = NULL;
+    }
+
     if (terminal->script_content) {
         g_free(terminal->script_content);
         terminal->script_content = NULL;
     }
-    
+
     terminal->scripting_enabled = FALSE;
+
+    pthread_mutex_unlock(&terminal->script_mutex);
 }
 
-// Load script content
+// Load script content (hot reload).
+// The new script is compiled in a fresh state while the old one keeps handling events.
+// Its top-level chunk then runs under script_mutex: a task it spawns can suspend in
+// await(), and the read thread and the timer tick resume waiters under that lock, so
+// they must not reach the new state until it is installed. The old state's global
+// `state` table is then copied across and handed to on_reload(old_state) if the new
+// script defines it; otherwise it replaces the new script's `state`. The swap happens
+// in the same locked section, between events, so every chunk of data is handled by
+// exactly one of the two scripts. On any error the previously loaded script stays active.
 gboolean scripting_load_script(SerialTerminal *terminal, const char *script_content) {
     if (!terminal || !terminal->lua_state || !script_content) return FALSE;
-    
-    // Clear existing script
-    if (terminal->script_content) {
-        g_free(terminal->script_content);
+
+    lua_State *new_state = create_script_state(terminal);
+    if (!new_state) {
+        g_print("Error: Failed to create Lua state\n");
+        return FALSE;
+    }
+
+    // Compile (or fetch cached bytecode), then run the top-level chunk so the handlers get defined
+    int result = scripting_cache_load(new_state, script_content, strlen(script_content));
+    pthread_mutex_lock(&terminal->script_mutex);
+    if (result == LUA_OK) {
+        result = lua_pcall(new_state, 0, 0, 0);
     }
-    
-    // Store new script content
-    terminal->script_content = g_strdup(script_content);
-    
-    // Test script compilation
-    int result = luaL_loadstring(terminal->lua_state, script_content);
     if (result != LUA_OK) {
-        const char *error = lua_tostring(terminal->lua_state, -1);
-        g_print("Script compilation error: %s\n", error);
-        lua_pop(terminal->lua_state, 1);
+        g_print("Script compilation error: %s\n", lua_tostring(new_state, -1));
+        scripting_async_drop_state(terminal, new_state);
+        pthread_mutex_unlock(&terminal->script_mutex);
+        lua_close(new_state);
         return FALSE;
     }
-    
-    // Pop the compiled function
-    lua_pop(terminal->lua_state, 1);
-    
+
+    lua_State *old_state = terminal->lua_state;
+
+    // Carry the exported state table across
+    lua_getglobal(old_state, "state");
+    if (lua_istable(old_state, -1)) {
+        lua_getglobal(new_state, "on_reload");
+        gboolean has_hook = lua_isfunction(new_state, -1);
+        copy_lua_value(old_state, -1, new_state, 0);
+
+        if (has_hook) {
+            if (lua_pcall(new_state, 1, 0, 0) != LUA_OK) {
+                g_print("Script on_reload error: %s\n", lua_tostring(new_state, -1));
+                lua_pop(old_state, 1);
+                scripting_async_drop_state(terminal, new_state);
+                pthread_mutex_unlock(&terminal->script_mutex);
+                lua_close(new_state);
+                return FALSE;
+            }
+        } else {
+            lua_setglobal(new_state, "state");
+            lua_pop(new_state, 1);
+        }
+    }
+    lua_pop(old_state, 1);
+
+    // Swap in the new script; tasks still suspended in the old one are cancelled
+    scripting_async_drop_state(terminal, old_state);
+    terminal->lua_state = new_state;
+    g_free(terminal->script_content);
+    terminal->script_content = g_strdup(script_content);
     terminal->scripting_enabled = TRUE;
+
+    pthread_mutex_unlock(&terminal->script_mutex);
+
+    lua_close(old_state);
+
     g_print("Script loaded successfully\n");
     return TRUE;
 }
@@ -108,84 +236,171 @@ gboolean scripting_load_script_file(SerialTerminal *terminal, const char *filena
 // Clear loaded script
 void scripting_clear_script(SerialTerminal *terminal) {
     if (!terminal) return;
-    
+
+    // Replace the state too, so handlers of the old script are gone
+    lua_State *old_state = NULL;
+    lua_State *new_state = create_script_state(terminal);
+
+    pthread_mutex_lock(&terminal->script_mutex);
+
     if (terminal->script_content) {
         g_free(terminal->script_content);
         terminal->script_content = NULL;
     }
-    
+
+    if (new_state) {
+        old_state = terminal->lua_state;
+        scripting_async_drop_state(terminal, old_state);
+        terminal->lua_state = new_state;
+    }
+
     terminal->scripting_enabled = FALSE;
+
+    pthread_mutex_unlock(&terminal->script_mutex);
+
+    if (old_state) {
+        lua_close(old_state);
+    }
     g_print("Script cleared\n");
 }
 
-// Execute script function with context
-static ScriptResult* execute_script_function(SerialTerminal *terminal, const char *function_name, 
-                                           const char *data, size_t length) {
-    if (!terminal || !terminal->lua_state || !terminal->scripting_enabled || !function_name) {
+// Handler called for each dispatched event
+static const char *script_event_handlers[MAX_SCRIPT_EVENT_TYPES] = {
+    "on_data_received",     // SCRIPT_CONTEXT_DATA_RECEIVED
+    "on_data_send",         // SCRIPT_CONTEXT_DATA_SEND
+    "on_connection_open",   // SCRIPT_CONTEXT_CONNECTION_OPEN
+    "on_connection_close",  // SCRIPT_CONTEXT_CONNECTION_CLOSE
+    NULL                    // SCRIPT_CONTEXT_MANUAL
+};
+
+static const guint64 script_duration_bounds_ns[SCRIPT_DURATION_BUCKETS] = {
+    10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000, 100000000, 1000000000
+};
+
+static guint64 monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * 1000000000ULL + (guint64)ts.tv_nsec;
+}
+
+// Account the cost of one handler call; caller holds script_mutex
+static void record_event_cost(SerialTerminal *terminal, ScriptContext context,
+                              guint64 start_ns, gboolean failed) {
+    ScriptEventStats *stats = &terminal->script_event_stats[context];
+    guint64 elapsed = monotonic_ns() - start_ns;
+
+    stats->calls++;
+    stats->total_ns += elapsed;
+    if (elapsed > stats->max_ns) {
+        stats->max_ns = elapsed;
+    }
+    for (int i = 0; i < SCRIPT_DURATION_BUCKETS; i++) {
+        if (elapsed <= script_duration_bounds_ns[i]) {
+            stats->durations[i]++;
+            break;
+        }
+    }
+    if (failed) {
+        stats->errors++;
+    }
+}
+
+// Single dispatch path for every script event, whatever the connection type
+ScriptResult* scripting_dispatch_event(SerialTerminal *terminal, ScriptContext context,
+                                       const char *data, size_t length) {
+    if (!terminal || !terminal->lua_state || !terminal->scripting_enabled ||
+        (unsigned)context >= MAX_SCRIPT_EVENT_TYPES || !script_event_handlers[context]) {
         return NULL;
     }
-    
+
+    const char *function_name = script_event_handlers[context];
     ScriptResult *result = g_malloc0(sizeof(ScriptResult));
     result->success = FALSE;
     result->suppress_original = FALSE;
-    
-    // Load the script
-    int load_result = luaL_loadstring(terminal->lua_state, terminal->script_content);
-    if (load_result != LUA_OK) {
-        const char *error = lua_tostring(terminal->lua_state, -1);
-        result->error_message = g_strdup(error);
-        lua_pop(terminal->lua_state, 1);
-        return result;
-    }
-    
-    // Execute the script to define functions
-    int exec_result = lua_pcall(terminal->lua_state, 0, 0, 0);
-    if (exec_result != LUA_OK) {
-        const char *error = lua_tostring(terminal->lua_state, -1);
-        result->error_message = g_strdup(error);
-        lua_pop(terminal->lua_state, 1);
+
+    // Held for the whole event so a hot reload can only swap states between events
+    pthread_mutex_lock(&terminal->script_mutex);
+    lua_State *L = terminal->lua_state;
+
+    if (!L || !terminal->script_content) {
+        pthread_mutex_unlock(&terminal->script_mutex);
+        result->success = TRUE;
         return result;
     }
     
     // Get the function
-    lua_getglobal(terminal->lua_state, function_name);
-    if (!lua_isfunction(terminal->lua_state, -1)) {
-        lua_pop(terminal->lua_state, 1);
+    lua_getglobal(L, function_name);
+    if (!lua_isfunction(L, -1)) {
+        lua_pop(L, 1);
+        pthread_mutex_unlock(&terminal->script_mutex);
         result->success = TRUE; // Function doesn't exist, but that's OK
         return result;
     }
+
+    guint64 start_ns = monotonic_ns();
     
     // Push arguments
     if (data && length > 0) {
-        lua_pushlstring(terminal->lua_state, data, length);
+        if (scripting_buffer_mode(L)) {
+            scripting_buffer_push_view(L, data, length);
+        } else {
+            lua_pushlstring(L, data, length);
+        }
     } else {
-        lua_pushnil(terminal->lua_state);
+        lua_pushnil(L);
     }
     
     // Call the function
-    int call_result = lua_pcall(terminal->lua_state, 1, 2, 0);
+    int call_result = lua_pcall(L, 1, 2, 0);
     if (call_result != LUA_OK) {
-        const char *error = lua_tostring(terminal->lua_state, -1);
+        const char *error = lua_tostring(L, -1);
         result->error_message = g_strdup(error);
-        lua_pop(terminal->lua_state, 1);
+        lua_pop(L, 1);
+        scripting_buffer_invalidate_views(L);
+        record_event_cost(terminal, context, start_ns, TRUE);
+        pthread_mutex_unlock(&terminal->script_mutex);
         return result;
     }
     
     // Get return values
-    if (lua_isstring(terminal->lua_state, -2)) {
+    ScriptBuffer *returned = scripting_buffer_test(L, -2);
+    if (returned) {
+        if (!scripting_buffer_is_valid(returned)) {
+            result->error_message = g_strdup("handler returned a buffer that is no longer valid");
+            lua_pop(L, 2);
+            scripting_buffer_invalidate_views(L);
+            record_event_cost(terminal, context, start_ns, TRUE);
+            pthread_mutex_unlock(&terminal->script_mutex);
+            return result;
+        }
+        result->result_length = returned->length;
+        if (returned->epoch) {
+            // View onto the input: hand back a pointer into the caller's data
+            result->result_data = (char*)returned->data;
+            result->result_borrowed = TRUE;
+        } else {
+            // Script-owned memory is copied: the script may keep the buffer
+            result->result_data = g_malloc(returned->length + 1);
+            memcpy(result->result_data, returned->data, returned->length);
+            result->result_data[returned->length] = '\0';
+        }
+    } else if (lua_isstring(L, -2)) {
         size_t result_len;
-        const char *result_data = lua_tolstring(terminal->lua_state, -2, &result_len);
+        const char *result_data = lua_tolstring(L, -2, &result_len);
         result->result_data = g_malloc(result_len + 1);
         memcpy(result->result_data, result_data, result_len);
         result->result_data[result_len] = '\0';
         result->result_length = result_len;
     }
     
-    if (lua_isboolean(terminal->lua_state, -1)) {
-        result->suppress_original = lua_toboolean(terminal->lua_state, -1);
+    if (lua_isboolean(L, -1)) {
+        result->suppress_original = lua_toboolean(L, -1);
     }
     
-    lua_pop(terminal->lua_state, 2);
+    lua_pop(L, 2);
+    scripting_buffer_invalidate_views(L);
+    record_event_cost(terminal, context, start_ns, FALSE);
+    pthread_mutex_unlock(&terminal->script_mutex);
     result->success = TRUE;
     
     return result;
@@ -193,22 +408,27 @@ static ScriptResult* execute_script_function(SerialTerminal *terminal, const cha
 
 // Execute script on data received
 ScriptResult* scripting_execute_on_data_received(SerialTerminal *terminal, const char *data, size_t length) {
-    return execute_script_function(terminal, "on_data_received", data, length);
+    // Pending await() calls see the data before the handler runs, so a task
+    // started by the handler only matches what arrives after it
+    if (terminal && terminal->scripting_enabled) {
+        scripting_async_feed(terminal, data, length);
+    }
+    return scripting_dispatch_event(terminal, SCRIPT_CONTEXT_DATA_RECEIVED, data, length);
 }
 
 // Execute script on data send
 ScriptResult* scripting_execute_on_data_send(SerialTerminal *terminal, const char *data, size_t length) {
-    return execute_script_function(terminal, "on_data_send", data, length);
+    return scripting_dispatch_event(terminal, SCRIPT_CONTEXT_DATA_SEND, data, length);
 }
 
 // Execute script on connection open
 ScriptResult* scripting_execute_on_connection_open(SerialTerminal *terminal) {
-    return execute_script_function(terminal, "on_connection_open", NULL, 0);
+    return scripting_dispatch_event(terminal, SCRIPT_CONTEXT_CONNECTION_OPEN, NULL, 0);
 }
 
 // Execute script on connection close
 ScriptResult* scripting_execute_on_connection_close(SerialTerminal *terminal) {
-    return execute_script_function(terminal, "on_connection_close", NULL, 0);
+    return scripting_dispatch_event(terminal, SCRIPT_CONTEXT_CONNECTION_CLOSE, NULL, 0);
 }
 
 // Execute manual script code
@@ -218,13 +438,20 @@ ScriptResult* scripting_execute_manual(SerialTerminal *terminal, const char *scr
     ScriptResult *result = g_malloc0(sizeof(ScriptResult));
     result->success = FALSE;
     
-    int exec_result = luaL_dostring(terminal->lua_state, script_code);
+    pthread_mutex_lock(&terminal->script_mutex);
+    lua_State *L = terminal->lua_state;
+    guint64 start_ns = monotonic_ns();
+    int exec_result = luaL_dostring(L, script_code);
     if (exec_result != LUA_OK) {
-        const char *error = lua_tostring(terminal->lua_state, -1);
+        const char *error = lua_tostring(L, -1);
         result->error_message = g_strdup(error);
-        lua_pop(terminal->lua_state, 1);
+        lua_pop(L, 1);
+        record_event_cost(terminal, SCRIPT_CONTEXT_MANUAL, start_ns, TRUE);
+        pthread_mutex_unlock(&terminal->script_mutex);
         return result;
     }
+    record_event_cost(terminal, SCRIPT_CONTEXT_MANUAL, start_ns, FALSE);
+    pthread_mutex_unlock(&terminal->script_mutex);
     
     result->success = TRUE;
     return result;
@@ -234,7 +461,7 @@ ScriptResult* scripting_execute_manual(SerialTerminal *terminal, const char *scr
 void scripting_free_result(ScriptResult *result) {
     if (!result) return;
     
-    if (result->result_data) {
+    if (result->result_data && !result->result_borrowed) {
         g_free(result->result_data);
     }
     if (result->error_message) {
@@ -255,18 +482,79 @@ const char* script_context_to_string(ScriptContext context) {
     }
 }
 
-// Validate Lua script syntax
-gboolean is_valid_lua_script(const char *script_content) {
-    if (!script_content) return FALSE;
-
-    lua_State *test_state = luaL_newstate();
-    if (!test_state) return FALSE;
+// Human-readable per-event cost summary; caller frees with g_free
+char* scripting_format_event_stats(SerialTerminal *terminal) {
+    GString *text = g_string_new(NULL);
+
+    pthread_mutex_lock(&terminal->script_mutex);
+    for (int i = 0; i < MAX_SCRIPT_EVENT_TYPES; i++) {
+        const ScriptEventStats *stats = &terminal->script_event_stats[i];
+        if (stats->calls == 0) continue;
+
+        g_string_append_printf(text, "%s%s: %lu calls, avg %.1f µs, max %.1f µs",
+                               text->len > 0 ? "\n" : "",
+                               script_context_to_string((ScriptContext)i), stats->calls,
+                               stats->total_ns / 1000.0 / stats->calls, stats->max_ns / 1000.0);
+        if (stats->errors > 0) {
+            g_string_append_printf(text, ", %lu errors", stats->errors);
+        }
+    }
+    pthread_mutex_unlock(&terminal->script_mutex);
 
-    int result = luaL_loadstring(test_state, script_content);
-    gboolean valid = (result == LUA_OK);
+    if (text->len == 0) {
+        g_string_append(text, "No script events yet");
+    }
+    return g_string_free(text, FALSE);
+}
 
-    lua_close(test_state);
-    return valid;
+// Script cost in the Prometheus text format, one series per handler
+void scripting_format_prometheus(SerialTerminal *terminal, GString *out) {
+    ScriptEventStats stats[MAX_SCRIPT_EVENT_TYPES];
+    unsigned int waiters;
+
+    // Copy out, so the read thread is never kept waiting on the formatting
+    pthread_mutex_lock(&terminal->script_mutex);
+    memcpy(stats, terminal->script_event_stats, sizeof(stats));
+    waiters = terminal->script_waiters ? terminal->script_waiters->len : 0;
+    pthread_mutex_unlock(&terminal->script_mutex);
+
+    g_string_append(out, "# HELP last_script_calls_total Script handler calls\n"
+                         "# TYPE last_script_calls_total counter\n");
+    for (int i = 0; i < MAX_SCRIPT_EVENT_TYPES; i++) {
+        const char *name = script_event_handlers[i] ? script_event_handlers[i] : "manual";
+        g_string_append_printf(out, "last_script_calls_total{handler=\"%s\"} %lu\n", name, stats[i].calls);
+    }
+    g_string_append(out, "# HELP last_script_errors_total Script handler calls that raised an error\n"
+                         "# TYPE last_script_errors_total counter\n");
+    for (int i = 0; i < MAX_SCRIPT_EVENT_TYPES; i++) {
+        const char *name = script_event_handlers[i] ? script_event_handlers[i] : "manual";
+        g_string_append_printf(out, "last_script_errors_total{handler=\"%s\"} %lu\n", name, stats[i].errors);
+    }
+    g_string_append(out, "# HELP last_script_duration_seconds Time spent in each script handler call\n"
+                         "# TYPE last_script_duration_seconds histogram\n");
+    for (int i = 0; i < MAX_SCRIPT_EVENT_TYPES; i++) {
+        const char *name = script_event_handlers[i] ? script_event_handlers[i] : "manual";
+        unsigned long cumulative = 0;
+        for (int b = 0; b < SCRIPT_DURATION_BUCKETS; b++) {
+            cumulative += stats[i].durations[b];
+            g_string_append_printf(out, "last_script_duration_seconds_bucket{handler=\"%s\",le=\"%g\"} %lu\n",
+                                   name, script_duration_bounds_ns[b] / 1e9, cumulative);
+        }
+        g_string_append_printf(out, "last_script_duration_seconds_bucket{handler=\"%s\",le=\"+Inf\"} %lu\n"
+                               "last_script_duration_seconds_sum{handler=\"%s\"} %.9f\n"
+                               "last_script_duration_seconds_count{handler=\"%s\"} %lu\n",
+                               name, stats[i].calls, name, stats[i].total_ns / 1e9, name, stats[i].calls);
+    }
+    g_string_append(out, "# HELP last_script_max_duration_seconds Longest script handler call\n"
+                         "# TYPE last_script_max_duration_seconds gauge\n");
+    for (int i = 0; i < MAX_SCRIPT_EVENT_TYPES; i++) {
+        const char *name = script_event_handlers[i] ? script_event_handlers[i] : "manual";
+        g_string_append_printf(out, "last_script_max_duration_seconds{handler=\"%s\"} %.9f\n",
+                               name, stats[i].max_ns / 1e9);
+    }
+    g_string_append_printf(out, "# HELP last_script_waiters Script tasks suspended in await() or sleep()\n"
+                                "# TYPE last_script_waiters gauge\n"
+                                "last_script_waiters %u\n", waiters);
 }
 
 // Lua API Functions (exposed to scripts)
@@ -292,12 +580,8 @@ int lua_last_send(lua_State *L) {
     size_t length;
     const char *data = luaL_checklstring(L, 1, &length);
 
-    ssize_t sent = 0;
-    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
-        sent = write(terminal->connection_fd, data, length);
-    } else {
-        sent = network_send_data(terminal, data, length);
-    }
+    // Script output goes straight to the wire; it is not fed back into on_data_send
+    ssize_t sent = connection_send_raw(terminal, data, length);
 
     lua_pushboolean(L, sent > 0);
     return 1;
@@ -326,15 +610,13 @@ int lua_last_get_connection_info(lua_State *L) {
 
     if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
         // Serial-specific info
-        const char *port = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->port_combo));
-        if (port) {
-            lua_pushstring(L, port);
+        if (terminal->saved_port) {
+            lua_pushstring(L, terminal->saved_port);
             lua_setfield(L, -2, "port");
         }
 
-        const char *baud = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->baudrate_combo));
-        if (baud) {
-            lua_pushstring(L, baud);
+        if (terminal->saved_baudrate) {
+            lua_pushstring(L, terminal->saved_baudrate);
             lua_setfield(L, -2, "baud_rate");
         }
     } else {
@@ -374,6 +656,27 @@ int lua_last_get_statistics(lua_State *L) {
         lua_setfield(L, -2, "connection_duration");
     }
 
+    // Per-event script cost, keyed by handler name
+    lua_newtable(L);
+    pthread_mutex_lock(&terminal->script_mutex);
+    for (int i = 0; i < MAX_SCRIPT_EVENT_TYPES; i++) {
+        const ScriptEventStats *stats = &terminal->script_event_stats[i];
+        const char *name = script_event_handlers[i] ? script_event_handlers[i] : "manual";
+
+        lua_newtable(L);
+        lua_pushinteger(L, (lua_Integer)stats->calls);
+        lua_setfield(L, -2, "calls");
+        lua_pushinteger(L, (lua_Integer)stats->errors);
+        lua_setfield(L, -2, "errors");
+        lua_pushnumber(L, stats->calls ? stats->total_ns / 1000.0 / stats->calls : 0.0);
+        lua_setfield(L, -2, "avg_us");
+        lua_pushnumber(L, stats->max_ns / 1000.0);
+        lua_setfield(L, -2, "max_us");
+        lua_setfield(L, -2, name);
+    }
+    pthread_mutex_unlock(&terminal->script_mutex);
+    lua_setfield(L, -2, "script_events");
+
     return 1;
 }
 
@@ -22,8 +22,19 @@ typedef struct {
     size_t result_length;   // Length of result data
     char *error_message;    // Error message (if failed)
     gboolean suppress_original; // If true, don't send/display original data
+    gboolean result_borrowed;   // result_data points into the caller's input, not freed
 } ScriptResult;
 
+// Buffer userdata (scripting_buffer.c)
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    gboolean owned;             // data was allocated for this buffer and is freed with it
+    gboolean writable;          // script-owned memory (buffer.new and its slices)
+    const unsigned long *epoch; // views only: valid while *epoch == view_epoch
+    unsigned long view_epoch;
+} ScriptBuffer;
+
 // Script management functions
 gboolean scripting_init(SerialTerminal *terminal);
 void scripting_cleanup(SerialTerminal *terminal);
@@ -32,6 +43,8 @@ gboolean scripting_load_script_file(SerialTerminal *terminal, const char *filena
 void scripting_clear_script(SerialTerminal *terminal);
 
 // Script execution functions
+ScriptResult* scripting_dispatch_event(SerialTerminal *terminal, ScriptContext context,
+                                       const char *data, size_t length);
 ScriptResult* scripting_execute_on_data_received(SerialTerminal *terminal, const char *data, size_t length);
 ScriptResult* scripting_execute_on_data_send(SerialTerminal *terminal, const char *data, size_t length);
 ScriptResult* scripting_execute_on_connection_open(SerialTerminal *terminal);
@@ -50,8 +63,31 @@ int lua_last_parse_nmea(lua_State *L);    // parse_nmea(sentence) - parse NMEA s
 int lua_last_create_nmea(lua_State *L);   // create_nmea(talker, sentence, data) - create NMEA sentence
 int lua_last_calculate_checksum(lua_State *L); // calculate_checksum(data) - calculate NMEA checksum
 
+// Buffer userdata management
+void scripting_buffer_register(lua_State *L);
+gboolean scripting_buffer_mode(lua_State *L);
+ScriptBuffer* scripting_buffer_push_view(lua_State *L, const char *data, size_t length);
+void scripting_buffer_invalidate_views(lua_State *L);
+ScriptBuffer* scripting_buffer_test(lua_State *L, int index);
+gboolean scripting_buffer_is_valid(const ScriptBuffer *buf);
+int lua_last_set_buffer_mode(lua_State *L); // set_buffer_mode(enabled) - pass Buffer views to data handlers
+
 // Utility functions
 const char* script_context_to_string(ScriptContext context);
-gboolean is_valid_lua_script(const char *script_content);
+char* scripting_format_event_stats(SerialTerminal *terminal);
+void scripting_format_prometheus(SerialTerminal *terminal, GString *out);
+
+// Coroutine tasks (scripting_async.c)
+void scripting_async_register(lua_State *L);
+void scripting_async_feed(SerialTerminal *terminal, const char *data, size_t length);
+void scripting_async_drop_state(SerialTerminal *terminal, lua_State *L);
+guint scripting_async_pending(SerialTerminal *terminal);
+int lua_last_spawn(lua_State *L);         // spawn(fn, ...) - run fn as a coroutine task
+int lua_last_await(lua_State *L);         // await(pattern, timeout_ms) - wait for data in a task
+int lua_last_sleep(lua_State *L);         // sleep(ms) - suspend a task
+
+// Bytecode cache (scripting_cache.c)
+int scripting_cache_load(lua_State *L, const char *script_content, size_t length);
+char* scripting_cache_dir(void);
 
 #endif // SCRIPTING_H
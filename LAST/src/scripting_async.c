@@ -0,0 +1,338 @@
+/*
+ * Coroutine tasks for LAST Lua scripts
+ *
+ * spawn(fn, ...) runs fn as a coroutine. Inside it, await(pattern, timeout_ms)
+ * and sleep(ms) suspend the task without blocking the read thread. Pending
+ * awaits are matched here in C against incoming data, so a chunk only enters
+ * Lua when it completes a match; timeouts and sleeps are driven by a main-loop
+ * timer that only runs while some task has a deadline.
+ *
+ * All waiter bookkeeping is guarded by script_mutex.
+ */
+
+#include "scripting.h"
+#include <string.h>
+
+// Data kept per await while waiting for its pattern; older bytes are dropped,
+// so a match (and the data await returns) cannot span more than this
+#define MAX_AWAIT_WINDOW 8192
+#define AWAIT_WINDOW_STR "8192"
+// Resolution of await timeouts and sleep()
+#define SCRIPT_TIMER_TICK_MS 10
+
+typedef struct {
+    lua_State *owner;           // Main state the task belongs to
+    lua_State *thread;          // Suspended coroutine
+    int thread_ref;             // Registry reference keeping it alive
+    char *pattern;              // Plain byte pattern, NULL for sleep()
+    size_t pattern_length;
+    GString *window;            // Data received since await() was called
+    gboolean window_trimmed;    // Window hit MAX_AWAIT_WINDOW and lost its head
+    gint64 deadline_us;         // Monotonic deadline, 0 for none
+} ScriptWaiter;
+
+static SerialTerminal* get_terminal(lua_State *L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, "terminal");
+    SerialTerminal *terminal = (SerialTerminal*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return terminal;
+}
+
+static void free_waiter(ScriptWaiter *waiter) {
+    g_free(waiter->pattern);
+    if (waiter->window) {
+        g_string_free(waiter->window, TRUE);
+    }
+    g_free(waiter);
+}
+
+static gboolean script_timer_tick(gpointer data);
+
+// Register the calling coroutine as waiting; it must yield right after
+static void add_waiter(SerialTerminal *terminal, lua_State *L, const char *pattern,
+                       size_t pattern_length, lua_Integer timeout_ms) {
+    ScriptWaiter *waiter = g_malloc0(sizeof(ScriptWaiter));
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+    waiter->owner = lua_tothread(L, -1);
+    lua_pop(L, 1);
+
+    waiter->thread = L;
+    lua_pushthread(L);
+    waiter->thread_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    if (pattern) {
+        waiter->pattern = g_malloc(pattern_length);
+        memcpy(waiter->pattern, pattern, pattern_length);
+        waiter->pattern_length = pattern_length;
+        waiter->window = g_string_sized_new(256);
+    }
+
+    if (timeout_ms > 0) {
+        waiter->deadline_us = g_get_monotonic_time() + timeout_ms * 1000;
+        if (!terminal->script_timer_id) {
+            terminal->script_timer_id = g_timeout_add(SCRIPT_TIMER_TICK_MS, script_timer_tick, terminal);
+        }
+    }
+
+    if (!terminal->script_waiters) {
+        terminal->script_waiters = g_ptr_array_new();
+    }
+    g_ptr_array_add(terminal->script_waiters, waiter);
+}
+
+// Whether a suspended task is registered as waiting
+static gboolean is_waiting(SerialTerminal *terminal, lua_State *thread) {
+    for (guint i = 0; terminal->script_waiters && i < terminal->script_waiters->len; i++) {
+        if (((ScriptWaiter*)g_ptr_array_index(terminal->script_waiters, i))->thread == thread) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Resume a task with nargs values already pushed on its stack; caller holds script_mutex
+static void resume_task(SerialTerminal *terminal, lua_State *from, lua_State *thread, int nargs) {
+    int nresults = 0;
+
+    int status = lua_resume(thread, from, nargs, &nresults);
+    if (status == LUA_YIELD) {
+        // Only await() and sleep() may suspend a task; they register a waiter first
+        if (!is_waiting(terminal, thread)) {
+            g_print("Script task error: coroutine.yield() outside await()/sleep(), task stopped\n");
+        }
+        lua_pop(thread, nresults);
+    } else if (status == LUA_OK) {
+        lua_pop(thread, nresults);
+    } else {
+        g_print("Script task error: %s\n", lua_tostring(thread, -1));
+        lua_pop(thread, 1);
+    }
+}
+
+// Wake a waiter that has been removed from the list
+static void wake_waiter(SerialTerminal *terminal, ScriptWaiter *waiter, const char *data,
+                        size_t length, gboolean timed_out) {
+    lua_State *thread = waiter->thread;
+    int nargs;
+
+    if (!waiter->pattern) {
+        lua_pushboolean(thread, 1);
+        nargs = 1;
+    } else if (timed_out) {
+        lua_pushnil(thread);
+        if (waiter->window_trimmed) {
+            lua_pushliteral(thread, "timeout (only the last " AWAIT_WINDOW_STR " bytes received are searched)");
+        } else {
+            lua_pushliteral(thread, "timeout");
+        }
+        nargs = 2;
+    } else {
+        lua_pushlstring(thread, data, length);
+        nargs = 1;
+    }
+
+    // Drop our reference only after the task has run
+    resume_task(terminal, waiter->owner, thread, nargs);
+    luaL_unref(waiter->owner, LUA_REGISTRYINDEX, waiter->thread_ref);
+    free_waiter(waiter);
+}
+
+// Feed received data to pending awaits, resuming those whose pattern completed
+void scripting_async_feed(SerialTerminal *terminal, const char *data, size_t length) {
+    if (!terminal || !data || length == 0) return;
+
+    pthread_mutex_lock(&terminal->script_mutex);
+
+    GPtrArray *waiters = terminal->script_waiters;
+    if (!waiters || waiters->len == 0) {
+        pthread_mutex_unlock(&terminal->script_mutex);
+        return;
+    }
+
+    // Match first, resume afterwards: resumed tasks may add new waiters
+    GPtrArray *matched = NULL;
+    for (guint i = 0; i < waiters->len; ) {
+        ScriptWaiter *waiter = g_ptr_array_index(waiters, i);
+        if (!waiter->pattern) {
+            i++;
+            continue;
+        }
+
+        // Only rescan the tail that could straddle the previous chunk
+        size_t overlap = waiter->pattern_length - 1;
+        size_t search_from = waiter->window->len > overlap ? waiter->window->len - overlap : 0;
+        g_string_append_len(waiter->window, data, length);
+
+        const char *hit = memmem(waiter->window->str + search_from, waiter->window->len - search_from,
+                                 waiter->pattern, waiter->pattern_length);
+        if (hit) {
+            g_string_truncate(waiter->window, (hit - waiter->window->str) + waiter->pattern_length);
+            g_ptr_array_remove_index(waiters, i);
+            if (!matched) matched = g_ptr_array_new();
+            g_ptr_array_add(matched, waiter);
+            continue;
+        }
+
+        // Bound memory for awaits that see lots of non-matching traffic
+        if (waiter->window->len > MAX_AWAIT_WINDOW) {
+            g_string_erase(waiter->window, 0, waiter->window->len - MAX_AWAIT_WINDOW);
+            waiter->window_trimmed = TRUE;
+        }
+        i++;
+    }
+
+    if (matched) {
+        for (guint i = 0; i < matched->len; i++) {
+            ScriptWaiter *waiter = g_ptr_array_index(matched, i);
+            wake_waiter(terminal, waiter, waiter->window->str, waiter->window->len, FALSE);
+        }
+        g_ptr_array_free(matched, TRUE);
+    }
+
+    pthread_mutex_unlock(&terminal->script_mutex);
+}
+
+// Main-loop tick: expire timeouts and finished sleeps
+static gboolean script_timer_tick(gpointer data) {
+    SerialTerminal *terminal = (SerialTerminal*)data;
+
+    pthread_mutex_lock(&terminal->script_mutex);
+
+    GPtrArray *waiters = terminal->script_waiters;
+    GPtrArray *expired = NULL;
+    gboolean pending_deadlines = FALSE;
+    gint64 now = g_get_monotonic_time();
+
+    for (guint i = 0; waiters && i < waiters->len; ) {
+        ScriptWaiter *waiter = g_ptr_array_index(waiters, i);
+        if (waiter->deadline_us && waiter->deadline_us <= now) {
+            g_ptr_array_remove_index(waiters, i);
+            if (!expired) expired = g_ptr_array_new();
+            g_ptr_array_add(expired, waiter);
+            continue;
+        }
+        i++;
+    }
+
+    if (expired) {
+        for (guint i = 0; i < expired->len; i++) {
+            wake_waiter(terminal, g_ptr_array_index(expired, i), NULL, 0, TRUE);
+        }
+        g_ptr_array_free(expired, TRUE);
+    }
+
+    // Resumed tasks may have registered new deadlines
+    for (guint i = 0; waiters && i < waiters->len; i++) {
+        if (((ScriptWaiter*)g_ptr_array_index(waiters, i))->deadline_us) {
+            pending_deadlines = TRUE;
+            break;
+        }
+    }
+
+    if (!pending_deadlines) {
+        terminal->script_timer_id = 0;
+    }
+
+    pthread_mutex_unlock(&terminal->script_mutex);
+    return pending_deadlines ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+// Forget the tasks of a state that is about to be closed.
+// Caller holds script_mutex; the coroutines themselves die with their state.
+void scripting_async_drop_state(SerialTerminal *terminal, lua_State *L) {
+    for (guint i = 0; terminal->script_waiters && i < terminal->script_waiters->len; ) {
+        ScriptWaiter *waiter = g_ptr_array_index(terminal->script_waiters, i);
+        if (waiter->owner == L) {
+            g_ptr_array_remove_index(terminal->script_waiters, i);
+            free_waiter(waiter);
+            continue;
+        }
+        i++;
+    }
+}
+
+// Number of suspended tasks
+guint scripting_async_pending(SerialTerminal *terminal) {
+    pthread_mutex_lock(&terminal->script_mutex);
+    guint pending = terminal->script_waiters ? terminal->script_waiters->len : 0;
+    pthread_mutex_unlock(&terminal->script_mutex);
+    return pending;
+}
+
+// spawn(fn, ...) - run fn as a task; returns true, or false and the error
+int lua_last_spawn(lua_State *L) {
+    SerialTerminal *terminal = get_terminal(L);
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    int nargs = lua_gettop(L) - 1;
+
+    lua_State *thread = lua_newthread(L);
+    int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    // Move the function and its arguments onto the new task's stack
+    lua_xmove(L, thread, nargs + 1);
+
+    pthread_mutex_lock(&terminal->script_mutex);
+    int nresults = 0;
+    int status = lua_resume(thread, L, nargs, &nresults);
+    if (status == LUA_YIELD && !is_waiting(terminal, thread)) {
+        g_print("Script task error: coroutine.yield() outside await()/sleep(), task stopped\n");
+    }
+    pthread_mutex_unlock(&terminal->script_mutex);
+
+    if (status == LUA_OK || status == LUA_YIELD) {
+        lua_pop(thread, nresults);
+        luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+
+    lua_pushboolean(L, 0);
+    lua_xmove(thread, L, 1);
+    luaL_unref(L, LUA_REGISTRYINDEX, ref);
+    return 2;
+}
+
+// await(pattern [, timeout_ms]) - wait for pattern in received data.
+// Returns the data received up to and including the match (at most the last
+// MAX_AWAIT_WINDOW bytes), or nil and a timeout message.
+int lua_last_await(lua_State *L) {
+    SerialTerminal *terminal = get_terminal(L);
+    size_t pattern_length;
+    const char *pattern = luaL_checklstring(L, 1, &pattern_length);
+    lua_Integer timeout_ms = luaL_optinteger(L, 2, 0);
+
+    luaL_argcheck(L, pattern_length > 0, 1, "pattern must not be empty");
+    luaL_argcheck(L, pattern_length <= MAX_AWAIT_WINDOW, 1,
+                  "pattern longer than the " AWAIT_WINDOW_STR "-byte await window");
+    if (!lua_isyieldable(L)) {
+        return luaL_error(L, "await() must be called from a task started with spawn()");
+    }
+
+    pthread_mutex_lock(&terminal->script_mutex);
+    add_waiter(terminal, L, pattern, pattern_length, timeout_ms);
+    pthread_mutex_unlock(&terminal->script_mutex);
+    return lua_yield(L, 0);
+}
+
+// sleep(ms) - suspend the task for ms milliseconds
+int lua_last_sleep(lua_State *L) {
+    SerialTerminal *terminal = get_terminal(L);
+    lua_Integer ms = luaL_checkinteger(L, 1);
+
+    if (!lua_isyieldable(L)) {
+        return luaL_error(L, "sleep() must be called from a task started with spawn()");
+    }
+
+    pthread_mutex_lock(&terminal->script_mutex);
+    add_waiter(terminal, L, NULL, 0, ms > 0 ? ms : 1);
+    pthread_mutex_unlock(&terminal->script_mutex);
+    return lua_yield(L, 0);
+}
+
+// Register spawn(), await() and sleep()
+void scripting_async_register(lua_State *L) {
+    lua_register(L, "spawn", lua_last_spawn);
+    lua_register(L, "await", lua_last_await);
+    lua_register(L, "sleep", lua_last_sleep);
+}
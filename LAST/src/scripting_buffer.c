@@ -0,0 +1,336 @@
+/*
+ * Binary Buffer userdata for LAST Lua scripts
+ *
+ * A Buffer is either a view onto bytes owned by LAST (the chunk handed to an
+ * event handler) or a block of memory owned by the script (buffer.new).
+ * Views are never copied into Lua strings; they are invalidated when the
+ * handler returns, so a script cannot keep a pointer to a recycled read buffer.
+ * All accessors take zero-based byte offsets and are bounds-checked.
+ */
+
+#include "scripting.h"
+#include <string.h>
+
+#define SCRIPT_BUFFER_METATABLE "LAST.Buffer"
+#define SCRIPT_BUFFER_EPOCH_KEY "LAST.BufferEpoch"
+#define SCRIPT_BUFFER_MODE_KEY "LAST.BufferMode"
+
+// Typed field accessors, registered as both get (name) and set (set_name)
+typedef struct {
+    const char *name;
+    unsigned char size;
+    char kind;              // 'u' unsigned, 'i' signed, 'f' IEEE float
+    gboolean big_endian;
+} BufferField;
+
+static const BufferField buffer_fields[] = {
+    {"u8", 1, 'u', FALSE},    {"i8", 1, 'i', FALSE},
+    {"u16le", 2, 'u', FALSE}, {"u16be", 2, 'u', TRUE},
+    {"i16le", 2, 'i', FALSE}, {"i16be", 2, 'i', TRUE},
+    {"u32le", 4, 'u', FALSE}, {"u32be", 4, 'u', TRUE},
+    {"i32le", 4, 'i', FALSE}, {"i32be", 4, 'i', TRUE},
+    {"i64le", 8, 'i', FALSE}, {"i64be", 8, 'i', TRUE},
+    {"f32le", 4, 'f', FALSE}, {"f32be", 4, 'f', TRUE},
+    {"f64le", 8, 'f', FALSE}, {"f64be", 8, 'f', TRUE},
+};
+
+static unsigned long* get_epoch(lua_State *L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, SCRIPT_BUFFER_EPOCH_KEY);
+    unsigned long *epoch = (unsigned long*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return epoch;
+}
+
+static ScriptBuffer* new_buffer(lua_State *L) {
+    ScriptBuffer *buf = (ScriptBuffer*)lua_newuserdatauv(L, sizeof(ScriptBuffer), 1);
+    memset(buf, 0, sizeof(ScriptBuffer));
+    luaL_setmetatable(L, SCRIPT_BUFFER_METATABLE);
+    return buf;
+}
+
+// Check argument is a live buffer; raises a Lua error for stale views
+static ScriptBuffer* check_buffer(lua_State *L, int index) {
+    ScriptBuffer *buf = (ScriptBuffer*)luaL_checkudata(L, index, SCRIPT_BUFFER_METATABLE);
+    if (!scripting_buffer_is_valid(buf)) {
+        luaL_error(L, "buffer is no longer valid (received data is only accessible during the handler)");
+    }
+    return buf;
+}
+
+// Check that [offset, offset + size) lies inside the buffer
+static size_t check_range(lua_State *L, ScriptBuffer *buf, int arg, size_t size) {
+    lua_Integer offset = luaL_checkinteger(L, arg);
+    luaL_argcheck(L, offset >= 0 && (size_t)offset <= buf->length &&
+                  size <= buf->length - (size_t)offset, arg, "offset out of range");
+    return (size_t)offset;
+}
+
+static guint64 load_bytes(const unsigned char *p, size_t size, gboolean big_endian) {
+    guint64 value = 0;
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = big_endian ? (size - 1 - i) : i;
+        value |= (guint64)p[i] << (8 * shift);
+    }
+    return value;
+}
+
+static void store_bytes(unsigned char *p, size_t size, gboolean big_endian, guint64 value) {
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = big_endian ? (size - 1 - i) : i;
+        p[i] = (unsigned char)(value >> (8 * shift));
+    }
+}
+
+// buf:<field>(offset)
+static int buffer_get(lua_State *L) {
+    const BufferField *field = &buffer_fields[lua_tointeger(L, lua_upvalueindex(1))];
+    ScriptBuffer *buf = check_buffer(L, 1);
+    size_t offset = check_range(L, buf, 2, field->size);
+    guint64 raw = load_bytes(buf->data + offset, field->size, field->big_endian);
+
+    if (field->kind == 'f') {
+        if (field->size == 4) {
+            guint32 bits = (guint32)raw;
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            lua_pushnumber(L, value);
+        } else {
+            double value;
+            memcpy(&value, &raw, sizeof(value));
+            lua_pushnumber(L, value);
+        }
+    } else {
+        if (field->kind == 'i' && field->size < 8 && (raw >> (field->size * 8 - 1)) & 1) {
+            raw |= ~(guint64)0 << (field->size * 8);
+        }
+        lua_pushinteger(L, (lua_Integer)raw);
+    }
+    return 1;
+}
+
+// buf:set_<field>(offset, value)
+static int buffer_set(lua_State *L) {
+    const BufferField *field = &buffer_fields[lua_tointeger(L, lua_upvalueindex(1))];
+    ScriptBuffer *buf = check_buffer(L, 1);
+    luaL_argcheck(L, buf->writable, 1, "buffer is read-only");
+    size_t offset = check_range(L, buf, 2, field->size);
+    guint64 raw;
+
+    if (field->kind == 'f') {
+        if (field->size == 4) {
+            float value = (float)luaL_checknumber(L, 3);
+            guint32 bits;
+            memcpy(&bits, &value, sizeof(bits));
+            raw = bits;
+        } else {
+            double value = luaL_checknumber(L, 3);
+            memcpy(&raw, &value, sizeof(raw));
+        }
+    } else {
+        raw = (guint64)luaL_checkinteger(L, 3);
+    }
+
+    store_bytes(buf->data + offset, field->size, field->big_endian, raw);
+    return 0;
+}
+
+// buf:slice(offset [, length]) - view sharing the same memory
+static int buffer_slice(lua_State *L) {
+    ScriptBuffer *buf = check_buffer(L, 1);
+    size_t offset = check_range(L, buf, 2, 0);
+    size_t length = buf->length - offset;
+    if (!lua_isnoneornil(L, 3)) {
+        lua_Integer requested = luaL_checkinteger(L, 3);
+        luaL_argcheck(L, requested >= 0 && (size_t)requested <= length, 3, "length out of range");
+        length = (size_t)requested;
+    }
+
+    ScriptBuffer *slice = new_buffer(L);
+    slice->data = buf->data + offset;
+    slice->length = length;
+    slice->writable = buf->writable;
+    slice->epoch = buf->epoch;
+    slice->view_epoch = buf->view_epoch;
+
+    // Keep the parent alive for as long as the slice
+    lua_pushvalue(L, 1);
+    lua_setiuservalue(L, -2, 1);
+    return 1;
+}
+
+// buf:find(needle [, init]) - zero-based offset of needle (string or Buffer), or nil
+static int buffer_find(lua_State *L) {
+    ScriptBuffer *buf = check_buffer(L, 1);
+    const char *needle;
+    size_t needle_length;
+
+    ScriptBuffer *needle_buf = scripting_buffer_test(L, 2);
+    if (needle_buf) {
+        needle_buf = check_buffer(L, 2);
+        needle = (const char*)needle_buf->data;
+        needle_length = needle_buf->length;
+    } else {
+        needle = luaL_checklstring(L, 2, &needle_length);
+    }
+
+    size_t init = lua_isnoneornil(L, 3) ? 0 : check_range(L, buf, 3, 0);
+    const unsigned char *found = NULL;
+    if (needle_length == 0) {
+        found = buf->data + init;
+    } else if (buf->length - init >= needle_length) {
+        found = memmem(buf->data + init, buf->length - init, needle, needle_length);
+    }
+
+    if (found) {
+        lua_pushinteger(L, (lua_Integer)(found - buf->data));
+    } else {
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+// buf:tostring([offset [, length]]) - explicit copy into a Lua string
+static int buffer_tostring(lua_State *L) {
+    ScriptBuffer *buf = check_buffer(L, 1);
+    size_t offset = lua_isnoneornil(L, 2) ? 0 : check_range(L, buf, 2, 0);
+    size_t length = buf->length - offset;
+    if (!lua_isnoneornil(L, 3)) {
+        lua_Integer requested = luaL_checkinteger(L, 3);
+        luaL_argcheck(L, requested >= 0 && (size_t)requested <= length, 3, "length out of range");
+        length = (size_t)requested;
+    }
+    lua_pushlstring(L, (const char*)buf->data + offset, length);
+    return 1;
+}
+
+static int buffer_len(lua_State *L) {
+    ScriptBuffer *buf = check_buffer(L, 1);
+    lua_pushinteger(L, (lua_Integer)buf->length);
+    return 1;
+}
+
+static int buffer_gc(lua_State *L) {
+    ScriptBuffer *buf = (ScriptBuffer*)luaL_checkudata(L, 1, SCRIPT_BUFFER_METATABLE);
+    if (buf->owned) {
+        g_free(buf->data);
+    }
+    buf->data = NULL;
+    buf->length = 0;
+    return 0;
+}
+
+// buffer.new(size | string) - writable buffer owned by the script
+static int buffer_new(lua_State *L) {
+    size_t length;
+    const char *init = NULL;
+
+    if (lua_type(L, 1) == LUA_TSTRING) {
+        init = lua_tolstring(L, 1, &length);
+    } else {
+        lua_Integer size = luaL_checkinteger(L, 1);
+        luaL_argcheck(L, size >= 0, 1, "size must not be negative");
+        length = (size_t)size;
+    }
+
+    ScriptBuffer *buf = new_buffer(L);
+    // One spare zero byte so the memory can be handed over as a C string
+    buf->data = g_malloc0(length + 1);
+    buf->length = length;
+    buf->owned = TRUE;
+    buf->writable = TRUE;
+    if (init) {
+        memcpy(buf->data, init, length);
+    }
+    return 1;
+}
+
+// set_buffer_mode(enabled) - pass Buffer views instead of strings to data handlers
+int lua_last_set_buffer_mode(lua_State *L) {
+    lua_pushboolean(L, lua_toboolean(L, 1));
+    lua_setfield(L, LUA_REGISTRYINDEX, SCRIPT_BUFFER_MODE_KEY);
+    return 0;
+}
+
+// Register the Buffer type, the buffer library and set_buffer_mode()
+void scripting_buffer_register(lua_State *L) {
+    unsigned long *epoch = (unsigned long*)lua_newuserdatauv(L, sizeof(unsigned long), 0);
+    *epoch = 0;
+    lua_setfield(L, LUA_REGISTRYINDEX, SCRIPT_BUFFER_EPOCH_KEY);
+
+    luaL_newmetatable(L, SCRIPT_BUFFER_METATABLE);
+
+    lua_newtable(L);
+    for (size_t i = 0; i < G_N_ELEMENTS(buffer_fields); i++) {
+        char setter[32];
+
+        lua_pushinteger(L, (lua_Integer)i);
+        lua_pushcclosure(L, buffer_get, 1);
+        lua_setfield(L, -2, buffer_fields[i].name);
+
+        snprintf(setter, sizeof(setter), "set_%s", buffer_fields[i].name);
+        lua_pushinteger(L, (lua_Integer)i);
+        lua_pushcclosure(L, buffer_set, 1);
+        lua_setfield(L, -2, setter);
+    }
+    lua_pushcfunction(L, buffer_slice);
+    lua_setfield(L, -2, "slice");
+    lua_pushcfunction(L, buffer_find);
+    lua_setfield(L, -2, "find");
+    lua_pushcfunction(L, buffer_tostring);
+    lua_setfield(L, -2, "tostring");
+    lua_pushcfunction(L, buffer_len);
+    lua_setfield(L, -2, "len");
+    lua_setfield(L, -2, "__index");
+
+    lua_pushcfunction(L, buffer_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, buffer_tostring);
+    lua_setfield(L, -2, "__tostring");
+    lua_pushcfunction(L, buffer_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushcfunction(L, buffer_new);
+    lua_setfield(L, -2, "new");
+    lua_setglobal(L, "buffer");
+
+    lua_register(L, "set_buffer_mode", lua_last_set_buffer_mode);
+}
+
+// Whether the loaded script asked for Buffer arguments
+gboolean scripting_buffer_mode(lua_State *L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, SCRIPT_BUFFER_MODE_KEY);
+    gboolean enabled = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    return enabled;
+}
+
+// Push a read-only view onto caller-owned bytes, valid until the next invalidation
+ScriptBuffer* scripting_buffer_push_view(lua_State *L, const char *data, size_t length) {
+    ScriptBuffer *buf = new_buffer(L);
+    buf->data = (unsigned char*)data;
+    buf->length = length;
+    buf->epoch = get_epoch(L);
+    buf->view_epoch = buf->epoch ? *buf->epoch : 0;
+    return buf;
+}
+
+// Invalidate every view handed out so far (called when a handler returns)
+void scripting_buffer_invalidate_views(lua_State *L) {
+    unsigned long *epoch = get_epoch(L);
+    if (epoch) {
+        (*epoch)++;
+    }
+}
+
+// Buffer at index, or NULL if the value is not a Buffer
+ScriptBuffer* scripting_buffer_test(lua_State *L, int index) {
+    return (ScriptBuffer*)luaL_testudata(L, index, SCRIPT_BUFFER_METATABLE);
+}
+
+gboolean scripting_buffer_is_valid(const ScriptBuffer *buf) {
+    if (!buf) return FALSE;
+    if (buf->epoch && *buf->epoch != buf->view_epoch) return FALSE;
+    return buf->data != NULL || buf->length == 0;
+}
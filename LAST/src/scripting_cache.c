@@ -0,0 +1,142 @@
+/*
+ * Lua bytecode cache for LAST - Linux Advanced Serial Transceiver
+ * Compiled scripts are dumped with lua_dump and stored under
+ * ~/.config/last/script_cache, keyed by a SHA-256 of the source text and the
+ * Lua release, so reloading an unchanged script skips the parser entirely.
+ */
+
+#include "scripting.h"
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+// Least recently used entries beyond this count are pruned after each store
+#define MAX_CACHED_SCRIPTS 32
+
+// Cache directory; caller frees with g_free
+char* scripting_cache_dir(void) {
+    return g_build_filename(g_get_user_config_dir(), "last", "script_cache", NULL);
+}
+
+// Cache file path for the given source; caller frees with g_free
+static char* cache_path_for(const char *script_content, size_t length) {
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    char abi[64];
+
+    // Bytecode is only valid for the Lua release and word sizes that produced it
+    snprintf(abi, sizeof(abi), "%s/%zu/%zu\n", LUA_RELEASE, sizeof(lua_Integer), sizeof(lua_Number));
+    g_checksum_update(checksum, (const guchar*)abi, strlen(abi));
+    g_checksum_update(checksum, (const guchar*)script_content, length);
+
+    char *cache_dir = scripting_cache_dir();
+    char *filename = g_strdup_printf("%s.luac", g_checksum_get_string(checksum));
+    char *path = g_build_filename(cache_dir, filename, NULL);
+
+    g_free(filename);
+    g_free(cache_dir);
+    g_checksum_free(checksum);
+    return path;
+}
+
+static int dump_writer(lua_State *L, const void *p, size_t size, void *ud) {
+    (void)L;
+    g_string_append_len((GString*)ud, (const gchar*)p, size);
+    return 0;
+}
+
+// Remove the least recently used entries once the cache grows past its limit.
+// A hit touches its entry, so the mtime is the last use.
+static void prune_cache(const char *cache_dir) {
+    DIR *dir = opendir(cache_dir);
+    if (!dir) return;
+
+    for (;;) {
+        struct dirent *entry;
+        char *oldest = NULL;
+        time_t oldest_mtime = 0;
+        int count = 0;
+
+        rewinddir(dir);
+        while ((entry = readdir(dir)) != NULL) {
+            if (!g_str_has_suffix(entry->d_name, ".luac")) continue;
+
+            char *path = g_build_filename(cache_dir, entry->d_name, NULL);
+            struct stat st;
+            if (stat(path, &st) == 0) {
+                count++;
+                if (!oldest || st.st_mtime < oldest_mtime) {
+                    g_free(oldest);
+                    oldest = path;
+                    oldest_mtime = st.st_mtime;
+                    continue;
+                }
+            }
+            g_free(path);
+        }
+
+        if (count <= MAX_CACHED_SCRIPTS || !oldest) {
+            g_free(oldest);
+            break;
+        }
+        int removed = unlink(oldest);
+        g_free(oldest);
+        if (removed != 0) break;
+    }
+
+    closedir(dir);
+}
+
+// Store the compiled function on top of the stack in the cache
+static void store_chunk(lua_State *L, const char *path) {
+    GString *bytecode = g_string_sized_new(4096);
+
+    // Keep debug info so runtime errors still report line numbers
+    if (lua_dump(L, dump_writer, bytecode, 0) == 0 && bytecode->len > 0) {
+        char *cache_dir = scripting_cache_dir();
+        if (g_mkdir_with_parents(cache_dir, 0700) == 0) {
+            GError *error = NULL;
+            // Written to a temporary file and renamed, so readers never see a partial chunk
+            if (g_file_set_contents(path, bytecode->str, bytecode->len, &error)) {
+                prune_cache(cache_dir);
+            } else {
+                g_print("Script cache: could not write %s: %s\n", path, error->message);
+                g_error_free(error);
+            }
+        }
+        g_free(cache_dir);
+    }
+
+    g_string_free(bytecode, TRUE);
+}
+
+// Push the compiled chunk for script_content onto L, from the bytecode cache when
+// possible. Compiles the source and stores the result on a cache miss.
+// Returns a Lua status code; on error the message is on the stack instead.
+int scripting_cache_load(lua_State *L, const char *script_content, size_t length) {
+    char *path = cache_path_for(script_content, length);
+    gchar *bytecode = NULL;
+    gsize bytecode_length = 0;
+
+    if (g_file_get_contents(path, &bytecode, &bytecode_length, NULL)) {
+        int status = luaL_loadbufferx(L, bytecode, bytecode_length, "=script", "b");
+        g_free(bytecode);
+        if (status == LUA_OK) {
+            utime(path, NULL);
+            g_free(path);
+            return LUA_OK;
+        }
+
+        // Stale or damaged entry: drop it and fall back to the source
+        lua_pop(L, 1);
+        unlink(path);
+    }
+
+    int status = luaL_loadbufferx(L, script_content, length, "=script", "t");
+    if (status == LUA_OK) {
+        store_chunk(L, path);
+    }
+
+    g_free(path);
+    return status;
+}
@@ -6,7 +6,6 @@
 // Forward declarations for functions from other modules
 char* get_current_timestamp(void);
 char* format_data_for_display(const char *data, size_t data_len, gboolean hex_mode);
-void stop_repeat_file_sending(SerialTerminal *terminal);
 
 /*
  * Serial communication module for LAST
@@ -17,21 +16,42 @@ void stop_repeat_file_sending(SerialTerminal *terminal);
 void scan_all_serial_devices(GtkComboBoxText *combo);
 gboolean is_serial_device(const char *path);
 
-// Connection management functions
-void connect_serial(SerialTerminal *terminal);
-void disconnect_serial(SerialTerminal *terminal);
+// Connection management functions (serial settings come from the saved_* fields,
+// network ones from network_host/network_port)
+gboolean connection_open(SerialTerminal *terminal);
+void connection_close(SerialTerminal *terminal);
 
 // Serial configuration functions
 void apply_serial_settings(SerialTerminal *terminal);
+gboolean is_supported_baudrate(const char *baudrate);
 
 // Data I/O functions
-void send_data(SerialTerminal *terminal);
 void *read_thread_func(void *arg);
 
-// Text display functions
+// Unified data path for all connection types (runs script hooks)
+ssize_t connection_send_raw(SerialTerminal *terminal, const char *data, size_t length);
+ssize_t connection_send(SerialTerminal *terminal, const char *data, size_t length,
+                        const char *line_ending);
+void connection_handle_received(SerialTerminal *terminal, char *buffer, size_t length);
+void connection_notify_open(SerialTerminal *terminal);
+void connection_notify_close(SerialTerminal *terminal);
+ssize_t connection_send_line(SerialTerminal *terminal, const char *text, const char *line_ending);
+
+// Text capture log. name.idx next to it maps time to file offset, in the
+// layout of BRIDGE's sniff log index (BRIDGE/src/sniff_protocol.h), so
+// BRIDGE/examples/log_seek can jump to a time and rebuild a lost index.
+#define LOG_INDEX_SUFFIX ".idx"
+#define LOG_INDEX_MAGIC 0x42534958     // "BSIX"
+#define LOG_INDEX_VERSION 1
+#define LOG_INDEX_HEADER_SIZE 8
+#define LOG_INDEX_ENTRY_SIZE 24
+#define LOG_INDEX_RECORDS 10000        // An entry at least this often, and whenever the second changes
+
+gboolean connection_log_open(SerialTerminal *terminal, const char *filename);
+void connection_log_close(SerialTerminal *terminal);
+
+// Text display function (passes text to the front end's text sink)
 void append_to_receive_text(SerialTerminal *terminal, const char *text, gboolean is_received);
-gboolean append_to_receive_text_idle(gpointer data);
-gboolean append_to_dual_display_idle(gpointer data);
 
 // Status message function (for application messages, not serial data)
 void show_status_message(SerialTerminal *terminal, const char *message);
@@ -40,10 +60,4 @@ void show_status_message(SerialTerminal *terminal, const char *message);
 void set_control_signals(SerialTerminal *terminal);
 void send_break_signal(SerialTerminal *terminal);
 
-// Signal line indicator functions
-void update_indicator_color(GtkWidget *indicator, const char *color);
-gboolean update_signal_indicators(gpointer data);
-void start_signal_monitoring(SerialTerminal *terminal);
-void stop_signal_monitoring(SerialTerminal *terminal);
-
 #endif // SERIAL_H
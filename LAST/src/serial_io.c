@@ -1,42 +1,70 @@
 /*
  * Serial I/O module for LAST - Linux Advanced Serial Transceiver
- * Handles connection, configuration, data I/O, and control signals
+ * Handles connection, configuration, data I/O, logging, and control signals
+ * Part of the core engine: reports through the front-end hooks, never GTK
  */
 
 #include "serial.h"
 #include "scripting.h"
+#include "network.h"
 
-void connect_serial(SerialTerminal *terminal) {
-    const char *port = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->port_combo));
-    const char *baudrate_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->baudrate_combo));
-    const char *databits_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->databits_combo));
-    const char *parity_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->parity_combo));
-    const char *stopbits_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->stopbits_combo));
-    const char *flow_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->flowcontrol_combo));
-    (void)flow_str; // Suppress unused warning - used in apply_serial_settings
-
-    if (!port || !baudrate_str) {
-        gtk_label_set_text(GTK_LABEL(terminal->status_label), "Please select port and baud rate");
-        return;
+// Open the serial port named by saved_port with the saved_* line settings
+static gboolean open_serial(SerialTerminal *terminal) {
+    const char *port = terminal->saved_port;
+
+    if (!port || strlen(port) == 0 || !terminal->saved_baudrate) {
+        show_status_message(terminal, "Please select port and baud rate");
+        return FALSE;
     }
 
     // Check if "Custom Path..." is still selected (shouldn't happen with new callback logic)
     if (strcmp(port, "Custom Path...") == 0) {
-        gtk_label_set_text(GTK_LABEL(terminal->status_label), "Please select a valid port or use Custom Path option");
-        return;
+        show_status_message(terminal, "Please select a valid port or use Custom Path option");
+        return FALSE;
     }
 
-    // Open serial port
     terminal->connection_fd = open(port, O_RDWR | O_NOCTTY);
     if (terminal->connection_fd < 0) {
         char error_msg[256];
         snprintf(error_msg, sizeof(error_msg), "Failed to open %s: %s", port, strerror(errno));
-        gtk_label_set_text(GTK_LABEL(terminal->status_label), error_msg);
-        return;
+        show_status_message(terminal, error_msg);
+        return FALSE;
     }
 
-    // Apply all serial settings
     apply_serial_settings(terminal);
+    return TRUE;
+}
+
+// Connect to network_host/network_port; the callers validate both
+static gboolean open_network(SerialTerminal *terminal) {
+    int port = atoi(terminal->network_port);
+
+    switch (terminal->connection_type) {
+        case CONNECTION_TYPE_TCP_CLIENT:
+            return connect_tcp_client(terminal, terminal->network_host, port);
+        case CONNECTION_TYPE_TCP_SERVER:
+            return connect_tcp_server(terminal, port);
+        case CONNECTION_TYPE_UDP_CLIENT:
+            return connect_udp_client(terminal, terminal->network_host, port);
+        case CONNECTION_TYPE_UDP_SERVER:
+            return connect_udp_server(terminal, port);
+        default:
+            return FALSE;
+    }
+}
+
+// Open the connection selected by connection_type and start its read thread.
+// Failures are reported through the status sink.
+gboolean connection_open(SerialTerminal *terminal) {
+    if (terminal->connected) return TRUE;
+
+    // server_fd may already be listening (headless --tcp-listen); it is -1 otherwise
+    terminal->connection_fd = -1;
+
+    gboolean serial = terminal->connection_type == CONNECTION_TYPE_SERIAL;
+    if (!(serial ? open_serial(terminal) : open_network(terminal))) {
+        return FALSE;
+    }
 
     // Initialize statistics
     terminal->bytes_sent = 0;
@@ -46,44 +74,49 @@ void connect_serial(SerialTerminal *terminal) {
     // Start read thread
     terminal->connected = TRUE;
     terminal->thread_running = TRUE;
-    pthread_create(&terminal->read_thread, NULL, read_thread_func, terminal);
-
-    // Update UI
-    gtk_widget_set_sensitive(terminal->connect_button, FALSE);
-    gtk_widget_set_sensitive(terminal->disconnect_button, TRUE);
-    gtk_widget_set_sensitive(terminal->send_entry, TRUE);
-    gtk_widget_set_sensitive(terminal->send_button, TRUE);
-    gtk_widget_set_sensitive(terminal->send_file_button, TRUE);
-    gtk_widget_set_sensitive(terminal->send_file_repeat_check, TRUE);
-    gtk_widget_set_sensitive(terminal->send_file_interval_combo, TRUE);
-    gtk_widget_set_sensitive(terminal->break_button, TRUE);
-
-    // Apply control signals
-    set_control_signals(terminal);
-
-    char status_msg[256];
-    snprintf(status_msg, sizeof(status_msg), "Connected to %s at %s baud (%s%s%s)",
-             port, baudrate_str, databits_str, parity_str, stopbits_str);
-    gtk_label_set_text(GTK_LABEL(terminal->status_label), status_msg);
-
-    // Connection message already shown in status label above
-    // Don't clutter the serial data area with connection messages
-
-    // Start signal line monitoring
-    start_signal_monitoring(terminal);
+    pthread_create(&terminal->read_thread, NULL,
+                   serial ? read_thread_func : network_read_thread_func, terminal);
+
+    if (serial) {
+        set_control_signals(terminal);
+
+        char status_msg[256];
+        snprintf(status_msg, sizeof(status_msg), "Connected to %s at %s baud (%s%s%s)",
+                 terminal->saved_port, terminal->saved_baudrate,
+                 terminal->saved_databits ? terminal->saved_databits : "8",
+                 terminal->saved_parity ? terminal->saved_parity : "None",
+                 terminal->saved_stopbits ? terminal->saved_stopbits : "1");
+        show_status_message(terminal, status_msg);
+    } else {
+        char *info = get_network_connection_info(terminal);
+        if (info) {
+            show_status_message(terminal, info);
+            free(info);
+        }
+    }
+
+    connection_notify_open(terminal);
+    return TRUE;
 }
 
-void disconnect_serial(SerialTerminal *terminal) {
+// Run on_connection_close, stop the read thread and release the descriptors
+void connection_close(SerialTerminal *terminal) {
     if (!terminal->connected) return;
 
+    connection_notify_close(terminal);
+
     terminal->connected = FALSE;
     terminal->thread_running = FALSE;
 
-    // Stop repeat file sending if active
-    stop_repeat_file_sending(terminal);
+    // Wait for read thread to finish
+    pthread_join(terminal->read_thread, NULL);
 
-    // Stop signal line monitoring
-    stop_signal_monitoring(terminal);
+    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
+        close(terminal->connection_fd);
+        terminal->connection_fd = -1;
+    } else {
+        disconnect_network(terminal);
+    }
 
     // Reset all activity indicators
     terminal->tx_active = FALSE;
@@ -91,36 +124,6 @@ void disconnect_serial(SerialTerminal *terminal) {
     terminal->tx_last_activity = 0;
     terminal->rx_last_activity = 0;
 
-    // Force immediate update of indicators to show inactive state
-    update_signal_indicators(terminal);
-
-    // Wait for read thread to finish
-    pthread_join(terminal->read_thread, NULL);
-
-    // Close log file if open
-    if (terminal->log_file) {
-        fclose(terminal->log_file);
-        terminal->log_file = NULL;
-    }
-
-    // Close serial port
-    close(terminal->connection_fd);
-    terminal->connection_fd = -1;
-
-    // Update UI
-    gtk_widget_set_sensitive(terminal->connect_button, TRUE);
-    gtk_widget_set_sensitive(terminal->disconnect_button, FALSE);
-    gtk_widget_set_sensitive(terminal->send_entry, FALSE);
-    gtk_widget_set_sensitive(terminal->send_button, FALSE);
-    gtk_widget_set_sensitive(terminal->send_file_button, FALSE);
-    gtk_widget_set_sensitive(terminal->send_file_repeat_check, FALSE);
-    gtk_widget_set_sensitive(terminal->send_file_interval_combo, FALSE);
-    gtk_widget_set_sensitive(terminal->send_file_stop_button, FALSE);
-    gtk_widget_set_sensitive(terminal->break_button, FALSE);
-
-    gtk_label_set_text(GTK_LABEL(terminal->status_label), "Disconnected");
-
-    // Show disconnection in status label
     show_status_message(terminal, "Disconnected");
 }
 
@@ -141,201 +144,385 @@ void *read_thread_func(void *arg) {
         if (result > 0 && FD_ISSET(terminal->connection_fd, &readfds)) {
             ssize_t bytes_read = read(terminal->connection_fd, buffer, sizeof(buffer) - 1);
             if (bytes_read > 0) {
-                // Update statistics
-                terminal->bytes_received += bytes_read;
-
-                // Mark RX activity
-                terminal->rx_active = TRUE;
-                terminal->rx_last_activity = time(NULL);
-
-                // Execute script on received data if enabled
-                char *display_data = buffer;
-                size_t display_length = bytes_read;
-                gboolean suppress_display = FALSE;
-                ScriptResult *script_result = NULL;
-
-                if (terminal->scripting_enabled) {
-                    script_result = scripting_execute_on_data_received(terminal, buffer, bytes_read);
-                    if (script_result) {
-                        if (script_result->success) {
-                            if (script_result->result_data) {
-                                display_data = script_result->result_data;
-                                display_length = script_result->result_length;
-                            }
-                            suppress_display = script_result->suppress_original;
-                        } else if (script_result->error_message) {
-                            g_print("Script error on data received: %s\n", script_result->error_message);
-                        }
-                    }
-                }
+                connection_handle_received(terminal, buffer, bytes_read);
+            }
+        }
+    }
 
-                // Log to file if enabled
-                if (terminal->log_file) {
-                    char *timestamp = get_current_timestamp();
-                    // For file logging, null-terminate for text output
-                    buffer[bytes_read] = '\0';
-                    fprintf(terminal->log_file, "[%s] RX: %s", timestamp, buffer);
-                    fflush(terminal->log_file);
-                    free(timestamp);
-                }
+    return NULL;
+}
 
-                // Create dual display data structure (only if not suppressed by script)
-                if (!suppress_display) {
-                    DualDisplayData *dual_data = malloc(sizeof(DualDisplayData));
-                    dual_data->text_data = format_data_for_display(display_data, display_length, FALSE); // Always format as text
-                    dual_data->hex_data = format_data_for_display(display_data, display_length, TRUE);   // Always format as hex
-                    dual_data->show_hex = terminal->hex_display;
+// Unified data path shared by serial and network connections.
+// Every RX chunk, TX write and open/close notification passes through here so
+// scripts see the same events whatever the connection type.
 
-                    // Schedule UI update in main thread
-                    g_idle_add(append_to_dual_display_idle, dual_data);
-                }
+// Write bytes to the active connection, bypassing script hooks
+ssize_t connection_send_raw(SerialTerminal *terminal, const char *data, size_t length) {
+    if (!terminal || terminal->connection_fd < 0 || !data || length == 0) return -1;
+
+    ssize_t bytes_written;
+    if (terminal->connection_type == CONNECTION_TYPE_SERIAL) {
+        bytes_written = write(terminal->connection_fd, data, length);
+    } else {
+        bytes_written = network_send_data(terminal, data, length);
+    }
+
+    if (bytes_written > 0) {
+        terminal->bytes_sent += bytes_written;
+        // Mark TX activity
+        terminal->tx_active = TRUE;
+        terminal->tx_last_activity = time(NULL);
+    }
+    return bytes_written;
+}
 
-                // Clean up script result if allocated
-                if (script_result) {
-                    if (script_result->result_data) free(script_result->result_data);
-                    if (script_result->error_message) free(script_result->error_message);
-                    free(script_result);
+// Transmit data through the script's on_data_send hook, then append the line
+// ending (if any). Returns bytes written, or 0 if the script suppressed the data.
+ssize_t connection_send(SerialTerminal *terminal, const char *data, size_t length,
+                        const char *line_ending) {
+    const char *out_data = data;
+    size_t out_length = length;
+    ScriptResult *script_result = NULL;
+
+    if (terminal->scripting_enabled) {
+        script_result = scripting_execute_on_data_send(terminal, data, length);
+        if (script_result) {
+            if (script_result->success) {
+                if (script_result->suppress_original) {
+                    scripting_free_result(script_result);
+                    return 0;
                 }
+                if (script_result->result_data) {
+                    out_data = script_result->result_data;
+                    out_length = script_result->result_length;
+                }
+            } else if (script_result->error_message) {
+                g_print("Script error on data send: %s\n", script_result->error_message);
             }
         }
     }
 
-    return NULL;
-}
-
-gboolean append_to_receive_text_idle(gpointer data) {
-    char *text = (char *)data;
-    if (g_terminal) {
-        GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(g_terminal->receive_text));
-        GtkTextIter end_iter;
-        gtk_text_buffer_get_end_iter(buffer, &end_iter);
-
-        // Add timestamp if enabled
-        if (g_terminal->show_timestamps) {
-            char *timestamp = get_current_timestamp();
-            gtk_text_buffer_insert(buffer, &end_iter, timestamp, -1);
-            gtk_text_buffer_insert(buffer, &end_iter, " ", -1);
-            free(timestamp);
+    ssize_t total = 0;
+    if (out_length > 0) {
+        total = connection_send_raw(terminal, out_data, out_length);
+    }
+    if (total >= 0 && line_ending && strlen(line_ending) > 0) {
+        ssize_t ending_bytes = connection_send_raw(terminal, line_ending, strlen(line_ending));
+        if (ending_bytes > 0) {
+            total += ending_bytes;
         }
+    }
 
-        // Insert the text
-        gtk_text_buffer_insert(buffer, &end_iter, text, -1);
+    scripting_free_result(script_result);
+    return total;
+}
 
-        // Auto-scroll if enabled
-        if (g_terminal->autoscroll) {
-            GtkTextMark *mark = gtk_text_buffer_get_insert(buffer);
-            gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(g_terminal->receive_text), mark, 0.0, TRUE, 0.0, 1.0);
-        }
+// Big-endian, as BRIDGE writes its index
+static void put_u32(unsigned char *p, uint32_t value) {
+    for (int i = 3; i >= 0; i--) {
+        p[i] = (unsigned char)value;
+        value >>= 8;
     }
+}
 
-    // Clean up
-    free(text);
+static uint32_t get_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
 
-    return G_SOURCE_REMOVE;
+static void put_u64(unsigned char *p, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (unsigned char)value;
+        value >>= 8;
+    }
 }
 
-gboolean append_to_dual_display_idle(gpointer data) {
-    DualDisplayData *dual_data = (DualDisplayData *)data;
-    if (g_terminal) {
-        // Always update text display
-        GtkTextBuffer *text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(g_terminal->receive_text));
-        GtkTextIter text_end;
-        gtk_text_buffer_get_end_iter(text_buffer, &text_end);
-
-        // Add timestamp to text display if enabled
-        if (g_terminal->show_timestamps) {
-            char *timestamp = get_current_timestamp();
-            gtk_text_buffer_insert(text_buffer, &text_end, timestamp, -1);
-            gtk_text_buffer_insert(text_buffer, &text_end, " ", -1);
-            free(timestamp);
-        }
+static uint64_t get_u64(const unsigned char *p) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
 
-        // Insert text data
-        gtk_text_buffer_insert(text_buffer, &text_end, dual_data->text_data, -1);
+// Open or start the index for a log that is appended to. One that does not
+// match the log (a bad header, or entries past its end) is started over; a torn
+// last entry is cut off.
+static void log_index_open(SerialTerminal *terminal, const char *filename) {
+    char path[4096];
+    unsigned char header[LOG_INDEX_HEADER_SIZE];
+    unsigned char entry[LOG_INDEX_ENTRY_SIZE];
+    struct stat log_stat;
+
+    snprintf(path, sizeof(path), "%s%s", filename, LOG_INDEX_SUFFIX);
+    terminal->log_index = fopen(path, "r+b");
+    if (!terminal->log_index) terminal->log_index = fopen(path, "w+b");
+    if (!terminal->log_index) return;
+
+    off_t log_size = fstat(fileno(terminal->log_file), &log_stat) == 0 ? log_stat.st_size : 0;
+    fseeko(terminal->log_index, 0, SEEK_END);
+    off_t size = ftello(terminal->log_index);
+    off_t entries = size >= LOG_INDEX_HEADER_SIZE ? (size - LOG_INDEX_HEADER_SIZE) / LOG_INDEX_ENTRY_SIZE : 0;
+    gboolean valid = log_size > 0 && size >= LOG_INDEX_HEADER_SIZE;
+
+    rewind(terminal->log_index);
+    if (valid) {
+        valid = fread(header, 1, sizeof(header), terminal->log_index) == sizeof(header) &&
+                get_u32(header) == LOG_INDEX_MAGIC &&
+                header[4] == LOG_INDEX_VERSION;
+    }
+    if (valid && entries > 0) {
+        fseeko(terminal->log_index, size - (size - LOG_INDEX_HEADER_SIZE) % LOG_INDEX_ENTRY_SIZE -
+               LOG_INDEX_ENTRY_SIZE, SEEK_SET);
+        valid = fread(entry, 1, sizeof(entry), terminal->log_index) == sizeof(entry) &&
+                get_u64(entry + 8) <= (uint64_t)log_size;
+        if (valid) terminal->log_index_time = (time_t)(get_u64(entry) / 1000000000ULL);
+    }
 
-        // Add newline for text display if needed
-        size_t text_len = strlen(dual_data->text_data);
-        if (text_len == 0 || dual_data->text_data[text_len - 1] != '\n') {
-            gtk_text_buffer_insert(text_buffer, &text_end, "\n", -1);
-        }
+    if (!valid) {
+        entries = 0;
+        terminal->log_index_time = 0;
+        memset(header, 0, sizeof(header));
+        put_u32(header, LOG_INDEX_MAGIC);
+        header[4] = LOG_INDEX_VERSION;
+        rewind(terminal->log_index);
+        fwrite(header, 1, sizeof(header), terminal->log_index);
+    }
+    fflush(terminal->log_index);
+    if (ftruncate(fileno(terminal->log_index), LOG_INDEX_HEADER_SIZE + entries * LOG_INDEX_ENTRY_SIZE) != 0) {
+        fclose(terminal->log_index);
+        terminal->log_index = NULL;
+        return;
+    }
+    fseeko(terminal->log_index, 0, SEEK_END);
+    terminal->log_index_records = LOG_INDEX_RECORDS;    // The first record gets an entry
+}
 
-        // Auto-scroll text view if enabled
-        if (g_terminal->autoscroll) {
-            GtkTextMark *mark = gtk_text_buffer_get_insert(text_buffer);
-            gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(g_terminal->receive_text), mark, 0.0, TRUE, 0.0, 1.0);
-        }
+// Called before each record goes into the log: an entry when the second has
+// moved on or LOG_INDEX_RECORDS records went by. Never back in time, so a
+// reader can binary search. Caller holds log_mutex, so the offset is the one
+// the record is written at.
+static void log_index_point(SerialTerminal *terminal) {
+    if (!terminal->log_index) return;
+
+    time_t now = time(NULL);
+    terminal->log_index_records++;
+    if (now < terminal->log_index_time ||
+        (now == terminal->log_index_time && terminal->log_index_records < LOG_INDEX_RECORDS)) {
+        return;
+    }
 
-        // Update hex display if visible
-        if (g_terminal->hex_frame && gtk_widget_get_visible(g_terminal->hex_frame)) {
-            GtkTextBuffer *hex_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(g_terminal->hex_text));
-            GtkTextIter hex_end;
-            gtk_text_buffer_get_end_iter(hex_buffer, &hex_end);
-
-            // Add timestamp to hex display if enabled
-            if (g_terminal->show_timestamps) {
-                char *timestamp = get_current_timestamp();
-                gtk_text_buffer_insert(hex_buffer, &hex_end, timestamp, -1);
-                gtk_text_buffer_insert(hex_buffer, &hex_end, "\n", -1);
-                free(timestamp);
-            }
+    unsigned char entry[LOG_INDEX_ENTRY_SIZE];
+    uint64_t offset = (uint64_t)ftello(terminal->log_file);
+    put_u64(entry, (uint64_t)now * 1000000000ULL);
+    put_u64(entry + 8, offset);
+    put_u64(entry + 16, offset);
+    fwrite(entry, 1, sizeof(entry), terminal->log_index);
+    fflush(terminal->log_index);
+    terminal->log_index_time = now;
+    terminal->log_index_records = 0;
+}
 
-            // Insert hex data
-            gtk_text_buffer_insert(hex_buffer, &hex_end, dual_data->hex_data, -1);
+// Append one record to the capture log, if it is open, with its index entry
+static void log_record(SerialTerminal *terminal, const char *direction, const char *text,
+                       const char *end) {
+    pthread_mutex_lock(&terminal->log_mutex);
+    if (terminal->log_file) {
+        log_index_point(terminal);
+        char *timestamp = get_current_timestamp();
+        fprintf(terminal->log_file, "[%s] %s: %s%s", timestamp, direction, text, end);
+        fflush(terminal->log_file);
+        free(timestamp);
+    }
+    pthread_mutex_unlock(&terminal->log_mutex);
+}
 
-            // Auto-scroll hex view if enabled
-            if (g_terminal->autoscroll) {
-                GtkTextMark *mark = gtk_text_buffer_get_insert(hex_buffer);
-                gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(g_terminal->hex_text), mark, 0.0, TRUE, 0.0, 1.0);
+// Process a received chunk: statistics, on_data_received, logging and display.
+// buffer must have room for one extra byte (used to terminate the text log line).
+void connection_handle_received(SerialTerminal *terminal, char *buffer, size_t length) {
+    // Update statistics
+    terminal->bytes_received += length;
+
+    // Mark RX activity
+    terminal->rx_active = TRUE;
+    terminal->rx_last_activity = time(NULL);
+
+    // Execute script on received data if enabled
+    char *display_data = buffer;
+    size_t display_length = length;
+    gboolean suppress_display = FALSE;
+    ScriptResult *script_result = NULL;
+
+    if (terminal->scripting_enabled) {
+        script_result = scripting_execute_on_data_received(terminal, buffer, length);
+        if (script_result) {
+            if (script_result->success) {
+                if (script_result->result_data) {
+                    display_data = script_result->result_data;
+                    display_length = script_result->result_length;
+                }
+                suppress_display = script_result->suppress_original;
+            } else if (script_result->error_message) {
+                g_print("Script error on data received: %s\n", script_result->error_message);
             }
         }
     }
 
-    // Clean up
-    free(dual_data->text_data);
-    free(dual_data->hex_data);
-    free(dual_data);
+    // Log to file if enabled
+    if (terminal->log_file) {
+        // For file logging, null-terminate for text output
+        buffer[length] = '\0';
+        log_record(terminal, "RX", buffer, "");
+    }
+
+    // Hand the data to the front end (only if not suppressed by script)
+    if (!suppress_display && terminal->receive_sink) {
+        terminal->receive_sink(terminal, display_data, display_length);
+    }
 
-    return G_SOURCE_REMOVE;
+    // Clean up script result if allocated
+    scripting_free_result(script_result);
+}
+
+// Run on_connection_open once the connection is usable
+void connection_notify_open(SerialTerminal *terminal) {
+    terminal->connection_count++;
+    g_atomic_int_set(&terminal->close_notified, 0);
+
+    ScriptResult *script_result = scripting_execute_on_connection_open(terminal);
+    if (script_result && !script_result->success && script_result->error_message) {
+        g_print("Script error on connection open: %s\n", script_result->error_message);
+    }
+    scripting_free_result(script_result);
+}
+
+// Run on_connection_close while the connection can still send. Once per
+// connection: the read thread calls it when the peer goes away, and the
+// disconnect that follows must not run it again.
+void connection_notify_close(SerialTerminal *terminal) {
+    if (!g_atomic_int_compare_and_exchange(&terminal->close_notified, 0, 1)) return;
+
+    ScriptResult *script_result = scripting_execute_on_connection_close(terminal);
+    if (script_result && !script_result->success && script_result->error_message) {
+        g_print("Script error on connection close: %s\n", script_result->error_message);
+    }
+    scripting_free_result(script_result);
+}
+
+// Transmitted-data bookkeeping shared by every way of sending a line
+
+// Start the text capture log, appending to filename
+gboolean connection_log_open(SerialTerminal *terminal, const char *filename) {
+    connection_log_close(terminal);
+
+    pthread_mutex_lock(&terminal->log_mutex);
+    terminal->log_file = fopen(filename, "a");
+    if (!terminal->log_file) {
+        pthread_mutex_unlock(&terminal->log_mutex);
+        return FALSE;
+    }
+    // Offsets for the index come from ftello, which needs to start at the end
+    fseeko(terminal->log_file, 0, SEEK_END);
+    log_index_open(terminal, filename);
+
+    log_index_point(terminal);
+    char *timestamp = get_current_timestamp();
+    fprintf(terminal->log_file, "\n=== Log started at %s ===\n", timestamp);
+    fflush(terminal->log_file);
+    free(timestamp);
+    pthread_mutex_unlock(&terminal->log_mutex);
+
+    if (terminal->log_filename) free(terminal->log_filename);
+    terminal->log_filename = strdup(filename);
+    return TRUE;
+}
+
+void connection_log_close(SerialTerminal *terminal) {
+    pthread_mutex_lock(&terminal->log_mutex);
+    if (!terminal->log_file) {
+        pthread_mutex_unlock(&terminal->log_mutex);
+        return;
+    }
+
+    log_index_point(terminal);
+    char *timestamp = get_current_timestamp();
+    fprintf(terminal->log_file, "=== Log ended at %s ===\n\n", timestamp);
+    fclose(terminal->log_file);
+    terminal->log_file = NULL;
+    free(timestamp);
+
+    if (terminal->log_index) {
+        fclose(terminal->log_index);
+        terminal->log_index = NULL;
+    }
+    pthread_mutex_unlock(&terminal->log_mutex);
+}
+
+// Send one line through the script hooks, then log it and echo it locally
+ssize_t connection_send_line(SerialTerminal *terminal, const char *text, const char *line_ending) {
+    ssize_t bytes_written = connection_send(terminal, text, strlen(text), line_ending);
+
+    // Log to file if enabled
+    log_record(terminal, "TX", text, "\n");
+
+    // Local echo if enabled
+    if (terminal->local_echo) {
+        char echo_text[1024];
+        snprintf(echo_text, sizeof(echo_text), "TX: %s", text);
+        append_to_receive_text(terminal, echo_text, FALSE);
+    }
+
+    return bytes_written;
 }
 
 void append_to_receive_text(SerialTerminal *terminal, const char *text, gboolean is_received) {
-    (void)terminal; // Suppress unused warning
     (void)is_received; // For future use (different colors, etc.)
-    g_idle_add(append_to_receive_text_idle, g_strdup(text));
+    if (terminal && terminal->text_sink) {
+        terminal->text_sink(terminal, text);
+    }
 }
 
 void show_status_message(SerialTerminal *terminal, const char *message) {
-    // Show status messages in the status label, not in the serial data area
-    if (terminal && terminal->status_label) {
-        gtk_label_set_text(GTK_LABEL(terminal->status_label), message);
+    // Status messages go to the front end's status area, not the serial data area
+    if (terminal && terminal->status_sink) {
+        terminal->status_sink(terminal, message);
+    }
+}
+
+static const struct {
+    const char *name;
+    speed_t speed;
+} baud_rates[] = {
+    {"300", B300}, {"1200", B1200}, {"2400", B2400}, {"4800", B4800},
+    {"9600", B9600}, {"19200", B19200}, {"38400", B38400}, {"57600", B57600},
+    {"115200", B115200}, {"230400", B230400}, {"460800", B460800}, {"921600", B921600},
+};
+
+gboolean is_supported_baudrate(const char *baudrate) {
+    for (size_t i = 0; baudrate && i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++) {
+        if (strcmp(baudrate, baud_rates[i].name) == 0) return TRUE;
     }
+    return FALSE;
 }
 
 void apply_serial_settings(SerialTerminal *terminal) {
     struct termios tio;
     tcgetattr(terminal->connection_fd, &tio);
 
-    // Get settings from UI
-    const char *baudrate_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->baudrate_combo));
-    const char *databits_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->databits_combo));
-    const char *parity_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->parity_combo));
-    const char *stopbits_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->stopbits_combo));
-    const char *flow_str = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(terminal->flowcontrol_combo));
+    // Settings come from the saved_* fields, kept in step with the UI by update_settings_from_ui
+    const char *baudrate_str = terminal->saved_baudrate ? terminal->saved_baudrate : "9600";
+    const char *databits_str = terminal->saved_databits ? terminal->saved_databits : "8";
+    const char *parity_str = terminal->saved_parity ? terminal->saved_parity : "None";
+    const char *stopbits_str = terminal->saved_stopbits ? terminal->saved_stopbits : "1";
+    const char *flow_str = terminal->saved_flowcontrol ? terminal->saved_flowcontrol : "None";
 
     // Set baud rate
     speed_t baud = B9600;  // Default
-    if (strcmp(baudrate_str, "300") == 0) baud = B300;
-    else if (strcmp(baudrate_str, "1200") == 0) baud = B1200;
-    else if (strcmp(baudrate_str, "2400") == 0) baud = B2400;
-    else if (strcmp(baudrate_str, "4800") == 0) baud = B4800;
-    else if (strcmp(baudrate_str, "9600") == 0) baud = B9600;
-    else if (strcmp(baudrate_str, "19200") == 0) baud = B19200;
-    else if (strcmp(baudrate_str, "38400") == 0) baud = B38400;
-    else if (strcmp(baudrate_str, "57600") == 0) baud = B57600;
-    else if (strcmp(baudrate_str, "115200") == 0) baud = B115200;
-    else if (strcmp(baudrate_str, "230400") == 0) baud = B230400;
-    else if (strcmp(baudrate_str, "460800") == 0) baud = B460800;
-    else if (strcmp(baudrate_str, "921600") == 0) baud = B921600;
+    for (size_t i = 0; i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++) {
+        if (strcmp(baudrate_str, baud_rates[i].name) == 0) {
+            baud = baud_rates[i].speed;
+            break;
+        }
+    }
 
     cfsetispeed(&tio, baud);
     cfsetospeed(&tio, baud);
@@ -391,51 +578,6 @@ void apply_serial_settings(SerialTerminal *terminal) {
     tcsetattr(terminal->connection_fd, TCSANOW, &tio);
 }
 
-void send_data(SerialTerminal *terminal) {
-    if (!terminal->connected) return;
-
-    const char *text = gtk_entry_get_text(GTK_ENTRY(terminal->send_entry));
-    if (strlen(text) == 0) return;
-
-    // Send data with line ending
-    ssize_t bytes_written = write(terminal->connection_fd, text, strlen(text));
-    if (bytes_written > 0) {
-        terminal->bytes_sent += bytes_written;
-        // Mark TX activity
-        terminal->tx_active = TRUE;
-        terminal->tx_last_activity = time(NULL);
-    }
-
-    // Add line ending if configured
-    if (terminal->line_ending && strlen(terminal->line_ending) > 0) {
-        bytes_written = write(terminal->connection_fd, terminal->line_ending, strlen(terminal->line_ending));
-        if (bytes_written > 0) {
-            terminal->bytes_sent += bytes_written;
-            // Mark TX activity for line ending too
-            terminal->tx_active = TRUE;
-            terminal->tx_last_activity = time(NULL);
-        }
-    }
-
-    // Log to file if enabled
-    if (terminal->log_file) {
-        char *timestamp = get_current_timestamp();
-        fprintf(terminal->log_file, "[%s] TX: %s\n", timestamp, text);
-        fflush(terminal->log_file);
-        free(timestamp);
-    }
-
-    // Local echo if enabled
-    if (terminal->local_echo) {
-        char echo_text[1024];
-        snprintf(echo_text, sizeof(echo_text), "TX: %s", text);
-        append_to_receive_text(terminal, echo_text, FALSE);
-    }
-
-    // Clear entry
-    gtk_entry_set_text(GTK_ENTRY(terminal->send_entry), "");
-}
-
 void set_control_signals(SerialTerminal *terminal) {
     if (!terminal->connected) return;
 
@@ -445,14 +587,14 @@ void set_control_signals(SerialTerminal *terminal) {
     }
 
     // Set DTR
-    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(terminal->dtr_check))) {
+    if (terminal->dtr_enabled) {
         status |= TIOCM_DTR;
     } else {
         status &= ~TIOCM_DTR;
     }
 
     // Set RTS
-    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(terminal->rts_check))) {
+    if (terminal->rts_enabled) {
         status |= TIOCM_RTS;
     } else {
         status &= ~TIOCM_RTS;
@@ -467,78 +609,3 @@ void send_break_signal(SerialTerminal *terminal) {
     tcsendbreak(terminal->connection_fd, 0);
     show_status_message(terminal, "Break signal sent");
 }
-
-void update_indicator_color(GtkWidget *indicator, const char *color) {
-    if (!indicator) return;
-
-    char css[256];
-    snprintf(css, sizeof(css),
-        "label { background-color: %s; color: white; font-weight: bold; "
-        "border: 1px solid #333; border-radius: 3px; font-size: 9px; }", color);
-
-    GtkCssProvider *provider = gtk_css_provider_new();
-    gtk_css_provider_load_from_data(provider, css, -1, NULL);
-    GtkStyleContext *context = gtk_widget_get_style_context(indicator);
-    gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(provider),
-                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    g_object_unref(provider);
-}
-
-gboolean update_signal_indicators(gpointer data) {
-    SerialTerminal *terminal = (SerialTerminal *)data;
-
-    if (!terminal->connected) {
-        // Set all indicators to inactive when disconnected
-        update_indicator_color(terminal->tx_indicator, "#666666");  // Gray
-        update_indicator_color(terminal->rx_indicator, "#666666");  // Gray
-        update_indicator_color(terminal->cts_indicator, "#CC0000"); // Red
-        update_indicator_color(terminal->rts_indicator, "#CC0000"); // Red
-        update_indicator_color(terminal->dtr_indicator, "#CC0000"); // Red
-        update_indicator_color(terminal->dsr_indicator, "#CC0000"); // Red
-        return TRUE; // Continue timer
-    }
-
-    // Read current signal line status
-    int status;
-    if (ioctl(terminal->connection_fd, TIOCMGET, &status) == 0) {
-        // Update control signal indicators
-        update_indicator_color(terminal->cts_indicator, (status & TIOCM_CTS) ? "#00CC00" : "#CC0000");
-        update_indicator_color(terminal->rts_indicator, (status & TIOCM_RTS) ? "#00CC00" : "#CC0000");
-        update_indicator_color(terminal->dtr_indicator, (status & TIOCM_DTR) ? "#00CC00" : "#CC0000");
-        update_indicator_color(terminal->dsr_indicator, (status & TIOCM_DSR) ? "#00CC00" : "#CC0000");
-    }
-
-    // Update TX/RX activity indicators (show yellow for 500ms after activity)
-    time_t current_time = time(NULL);
-
-    if (terminal->tx_active && (current_time - terminal->tx_last_activity) < 1) {
-        update_indicator_color(terminal->tx_indicator, "#FFCC00");  // Yellow
-    } else {
-        update_indicator_color(terminal->tx_indicator, "#666666");  // Gray
-        terminal->tx_active = FALSE;
-    }
-
-    if (terminal->rx_active && (current_time - terminal->rx_last_activity) < 1) {
-        update_indicator_color(terminal->rx_indicator, "#FFCC00");  // Yellow
-    } else {
-        update_indicator_color(terminal->rx_indicator, "#666666");  // Gray
-        terminal->rx_active = FALSE;
-    }
-
-    return TRUE; // Continue timer
-}
-
-void start_signal_monitoring(SerialTerminal *terminal) {
-    if (terminal->signal_update_timer_id == 0) {
-        // Update indicators every 100ms
-        terminal->signal_update_timer_id = g_timeout_add(100, update_signal_indicators, terminal);
-    }
-}
-
-void stop_signal_monitoring(SerialTerminal *terminal) {
-    if (terminal->signal_update_timer_id != 0) {
-        g_source_remove(terminal->signal_update_timer_id);
-        terminal->signal_update_timer_id = 0;
-    }
-}
-
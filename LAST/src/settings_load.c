@@ -117,6 +117,11 @@ void load_settings(SerialTerminal *terminal) {
             } else if (strcmp(key, "line_by_line_delay_ms") == 0) {
                 terminal->line_by_line_delay_ms = atoi(value);
             }
+            // Monitoring settings
+            else if (strcmp(key, "metrics_port") == 0) {
+                terminal->metrics_port = atoi(value);
+                if (terminal->metrics_port < 0 || terminal->metrics_port > 65535) terminal->metrics_port = 0;
+            }
             // Macro settings
             else if (strcmp(key, "macro_panel_visible") == 0) {
                 terminal->macro_panel_visible = (strcmp(value, "true") == 0);
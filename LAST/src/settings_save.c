@@ -89,6 +89,11 @@ void save_settings(SerialTerminal *terminal) {
     fprintf(file, "line_by_line_delay_ms=%d\n", terminal->line_by_line_delay_ms);
     fprintf(file, "\n");
 
+    // Monitoring settings
+    fprintf(file, "[Monitoring]\n");
+    fprintf(file, "metrics_port=%d\n", terminal->metrics_port);
+    fprintf(file, "\n");
+
     // Macro settings
     fprintf(file, "[Macros]\n");
     fprintf(file, "macro_panel_visible=%s\n", terminal->macro_panel_visible ? "true" : "false");
@@ -26,6 +26,24 @@ void create_data_area(SerialTerminal *terminal, GtkWidget *parent);
 void apply_appearance_settings(SerialTerminal *terminal);
 void apply_theme_setting(SerialTerminal *terminal);
 
+// Output sinks installed on the terminal, and the idle handlers behind them
+void ui_receive_sink(SerialTerminal *terminal, const char *data, size_t length);
+void ui_text_sink(SerialTerminal *terminal, const char *text);
+void ui_status_sink(SerialTerminal *terminal, const char *message);
+gboolean append_to_receive_text_idle(gpointer data);
+gboolean append_to_dual_display_idle(gpointer data);
+gboolean set_status_label_idle(gpointer data);
+
+// Signal line indicator functions
+void update_indicator_color(GtkWidget *indicator, const char *color);
+gboolean update_signal_indicators(gpointer data);
+void start_signal_monitoring(SerialTerminal *terminal);
+void stop_signal_monitoring(SerialTerminal *terminal);
+
+// Statistics label and its one-second timer (also refreshes the metrics snapshot)
+void update_statistics(SerialTerminal *terminal);
+gboolean update_statistics_timer(gpointer data);
+
 // Interval dropdown functions
 void populate_interval_dropdown_for_repeat(SerialTerminal *terminal);
 void populate_interval_dropdown_for_lines(SerialTerminal *terminal);
@@ -1,10 +1,12 @@
 /*
  * Display area creation for LAST - Linux Advanced Serial Terminal
- * Handles data area, appearance settings, and theme application
+ * Handles data area, appearance settings, theme application, and the GTK
+ * output sinks, signal indicators and statistics the engine reports through
  */
 
 #include "ui.h"
 #include "callbacks.h"
+#include "utils.h"
 
 void create_data_area(SerialTerminal *terminal, GtkWidget *parent) {
     // Receive area - make it less tall
@@ -206,3 +208,237 @@ void apply_theme_setting(SerialTerminal *terminal) {
     }
 }
 
+gboolean append_to_receive_text_idle(gpointer data) {
+    char *text = (char *)data;
+    if (g_terminal) {
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(g_terminal->receive_text));
+        GtkTextIter end_iter;
+        gtk_text_buffer_get_end_iter(buffer, &end_iter);
+
+        // Add timestamp if enabled
+        if (g_terminal->show_timestamps) {
+            char *timestamp = get_current_timestamp();
+            gtk_text_buffer_insert(buffer, &end_iter, timestamp, -1);
+            gtk_text_buffer_insert(buffer, &end_iter, " ", -1);
+            free(timestamp);
+        }
+
+        // Insert the text
+        gtk_text_buffer_insert(buffer, &end_iter, text, -1);
+
+        // Auto-scroll if enabled
+        if (g_terminal->autoscroll) {
+            GtkTextMark *mark = gtk_text_buffer_get_insert(buffer);
+            gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(g_terminal->receive_text), mark, 0.0, TRUE, 0.0, 1.0);
+        }
+    }
+
+    // Clean up
+    free(text);
+
+    return G_SOURCE_REMOVE;
+}
+
+gboolean append_to_dual_display_idle(gpointer data) {
+    DualDisplayData *dual_data = (DualDisplayData *)data;
+    if (g_terminal) {
+        // Always update text display
+        GtkTextBuffer *text_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(g_terminal->receive_text));
+        GtkTextIter text_end;
+        gtk_text_buffer_get_end_iter(text_buffer, &text_end);
+
+        // Add timestamp to text display if enabled
+        if (g_terminal->show_timestamps) {
+            char *timestamp = get_current_timestamp();
+            gtk_text_buffer_insert(text_buffer, &text_end, timestamp, -1);
+            gtk_text_buffer_insert(text_buffer, &text_end, " ", -1);
+            free(timestamp);
+        }
+
+        // Insert text data
+        gtk_text_buffer_insert(text_buffer, &text_end, dual_data->text_data, -1);
+
+        // Add newline for text display if needed
+        size_t text_len = strlen(dual_data->text_data);
+        if (text_len == 0 || dual_data->text_data[text_len - 1] != '\n') {
+            gtk_text_buffer_insert(text_buffer, &text_end, "\n", -1);
+        }
+
+        // Auto-scroll text view if enabled
+        if (g_terminal->autoscroll) {
+            GtkTextMark *mark = gtk_text_buffer_get_insert(text_buffer);
+            gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(g_terminal->receive_text), mark, 0.0, TRUE, 0.0, 1.0);
+        }
+
+        // Update hex display if visible
+        if (g_terminal->hex_frame && gtk_widget_get_visible(g_terminal->hex_frame)) {
+            GtkTextBuffer *hex_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(g_terminal->hex_text));
+            GtkTextIter hex_end;
+            gtk_text_buffer_get_end_iter(hex_buffer, &hex_end);
+
+            // Add timestamp to hex display if enabled
+            if (g_terminal->show_timestamps) {
+                char *timestamp = get_current_timestamp();
+                gtk_text_buffer_insert(hex_buffer, &hex_end, timestamp, -1);
+                gtk_text_buffer_insert(hex_buffer, &hex_end, "\n", -1);
+                free(timestamp);
+            }
+
+            // Insert hex data
+            gtk_text_buffer_insert(hex_buffer, &hex_end, dual_data->hex_data, -1);
+
+            // Auto-scroll hex view if enabled
+            if (g_terminal->autoscroll) {
+                GtkTextMark *mark = gtk_text_buffer_get_insert(hex_buffer);
+                gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(g_terminal->hex_text), mark, 0.0, TRUE, 0.0, 1.0);
+            }
+        }
+    }
+
+    // Clean up
+    free(dual_data->text_data);
+    free(dual_data->hex_data);
+    free(dual_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+gboolean set_status_label_idle(gpointer data) {
+    char *message = (char *)data;
+    if (g_terminal && g_terminal->status_label) {
+        gtk_label_set_text(GTK_LABEL(g_terminal->status_label), message);
+    }
+    g_free(message);
+    return G_SOURCE_REMOVE;
+}
+
+// Output sinks for the GTK front end. The engine may call these from the read
+// thread, so each one defers the widget update to the main loop.
+
+void ui_receive_sink(SerialTerminal *terminal, const char *data, size_t length) {
+    DualDisplayData *dual_data = malloc(sizeof(DualDisplayData));
+    dual_data->text_data = format_data_for_display(data, length, FALSE); // Always format as text
+    dual_data->hex_data = format_data_for_display(data, length, TRUE);   // Always format as hex
+    dual_data->show_hex = terminal->hex_display;
+
+    // Schedule UI update in main thread
+    g_idle_add(append_to_dual_display_idle, dual_data);
+}
+
+void ui_text_sink(SerialTerminal *terminal, const char *text) {
+    (void)terminal;
+    g_idle_add(append_to_receive_text_idle, g_strdup(text));
+}
+
+void ui_status_sink(SerialTerminal *terminal, const char *message) {
+    (void)terminal;
+    g_idle_add(set_status_label_idle, g_strdup(message));
+}
+
+void update_indicator_color(GtkWidget *indicator, const char *color) {
+    if (!indicator) return;
+
+    char css[256];
+    snprintf(css, sizeof(css),
+        "label { background-color: %s; color: white; font-weight: bold; "
+        "border: 1px solid #333; border-radius: 3px; font-size: 9px; }", color);
+
+    GtkCssProvider *provider = gtk_css_provider_new();
+    gtk_css_provider_load_from_data(provider, css, -1, NULL);
+    GtkStyleContext *context = gtk_widget_get_style_context(indicator);
+    gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(provider),
+                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    g_object_unref(provider);
+}
+
+gboolean update_signal_indicators(gpointer data) {
+    SerialTerminal *terminal = (SerialTerminal *)data;
+
+    if (!terminal->connected) {
+        // Set all indicators to inactive when disconnected
+        update_indicator_color(terminal->tx_indicator, "#666666");  // Gray
+        update_indicator_color(terminal->rx_indicator, "#666666");  // Gray
+        update_indicator_color(terminal->cts_indicator, "#CC0000"); // Red
+        update_indicator_color(terminal->rts_indicator, "#CC0000"); // Red
+        update_indicator_color(terminal->dtr_indicator, "#CC0000"); // Red
+        update_indicator_color(terminal->dsr_indicator, "#CC0000"); // Red
+        return TRUE; // Continue timer
+    }
+
+    // Read current signal line status
+    int status;
+    if (ioctl(terminal->connection_fd, TIOCMGET, &status) == 0) {
+        // Update control signal indicators
+        update_indicator_color(terminal->cts_indicator, (status & TIOCM_CTS) ? "#00CC00" : "#CC0000");
+        update_indicator_color(terminal->rts_indicator, (status & TIOCM_RTS) ? "#00CC00" : "#CC0000");
+        update_indicator_color(terminal->dtr_indicator, (status & TIOCM_DTR) ? "#00CC00" : "#CC0000");
+        update_indicator_color(terminal->dsr_indicator, (status & TIOCM_DSR) ? "#00CC00" : "#CC0000");
+    }
+
+    // Update TX/RX activity indicators (show yellow for 500ms after activity)
+    time_t current_time = time(NULL);
+
+    if (terminal->tx_active && (current_time - terminal->tx_last_activity) < 1) {
+        update_indicator_color(terminal->tx_indicator, "#FFCC00");  // Yellow
+    } else {
+        update_indicator_color(terminal->tx_indicator, "#666666");  // Gray
+        terminal->tx_active = FALSE;
+    }
+
+    if (terminal->rx_active && (current_time - terminal->rx_last_activity) < 1) {
+        update_indicator_color(terminal->rx_indicator, "#FFCC00");  // Yellow
+    } else {
+        update_indicator_color(terminal->rx_indicator, "#666666");  // Gray
+        terminal->rx_active = FALSE;
+    }
+
+    return TRUE; // Continue timer
+}
+
+void start_signal_monitoring(SerialTerminal *terminal) {
+    if (terminal->signal_update_timer_id == 0) {
+        // Update indicators every 100ms
+        terminal->signal_update_timer_id = g_timeout_add(100, update_signal_indicators, terminal);
+    }
+}
+
+void stop_signal_monitoring(SerialTerminal *terminal) {
+    if (terminal->signal_update_timer_id != 0) {
+        g_source_remove(terminal->signal_update_timer_id);
+        terminal->signal_update_timer_id = 0;
+    }
+}
+
+void update_statistics(SerialTerminal *terminal) {
+    if (!terminal->stats_label) return;
+
+    char stats_text[256];
+
+    if (terminal->connected) {
+        time_t current_time = time(NULL);
+        int connection_duration = (int)(current_time - terminal->connection_start_time);
+        int hours = connection_duration / 3600;
+        int minutes = (connection_duration % 3600) / 60;
+        int seconds = connection_duration % 60;
+
+        snprintf(stats_text, sizeof(stats_text),
+                "Sent: %lu bytes | Received: %lu bytes | Time: %02d:%02d:%02d",
+                terminal->bytes_sent, terminal->bytes_received, hours, minutes, seconds);
+    } else {
+        snprintf(stats_text, sizeof(stats_text),
+                "Sent: %lu bytes | Received: %lu bytes | Time: 00:00:00",
+                terminal->bytes_sent, terminal->bytes_received);
+    }
+
+    gtk_label_set_text(GTK_LABEL(terminal->stats_label), stats_text);
+}
+
+gboolean update_statistics_timer(gpointer data) {
+    SerialTerminal *terminal = (SerialTerminal *)data;
+
+    update_statistics(terminal);
+    if (terminal->metrics_http) {
+        publish_metrics(terminal);
+    }
+    return TRUE; // Continue timer
+}
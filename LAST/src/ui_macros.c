@@ -6,6 +6,7 @@
 #include "ui.h"
 #include "callbacks.h"
 #include "settings.h"
+#include "scripting.h"
 
 void create_menu_bar(SerialTerminal *terminal, GtkWidget *parent) {
     // Create menu bar
@@ -296,6 +297,21 @@ void toggle_macro_panel_visibility(SerialTerminal *terminal) {
     save_settings(terminal);
 }
 
+// Refresh the per-event script cost line while the script window is open
+static gboolean update_script_stats_label(gpointer data) {
+    SerialTerminal *terminal = (SerialTerminal *)data;
+
+    if (!terminal->script_window || !terminal->script_stats_label) {
+        terminal->script_stats_timer_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    char *stats = scripting_format_event_stats(terminal);
+    gtk_label_set_text(GTK_LABEL(terminal->script_stats_label), stats);
+    g_free(stats);
+    return G_SOURCE_CONTINUE;
+}
+
 void create_scripting_window(SerialTerminal *terminal) {
     // Don't create multiple windows
     if (terminal->script_window) {
@@ -384,12 +400,28 @@ void create_scripting_window(SerialTerminal *terminal) {
         "• get_statistics() - Get connection statistics\n"
         "• parse_nmea(sentence) - Parse NMEA sentence\n"
         "• create_nmea(talker, sentence, data) - Create NMEA sentence\n"
-        "• calculate_checksum(data) - Calculate NMEA checksum"
+        "• calculate_checksum(data) - Calculate NMEA checksum\n"
+        "• set_buffer_mode(true) - Receive binary Buffer views instead of strings\n"
+        "• spawn(fn) - Run fn as a task that can use await() and sleep()\n"
+        "• await(pattern, timeout_ms) - Wait for pattern in received data\n"
+        "• sleep(ms) - Pause a task without blocking the terminal"
     );
     gtk_label_set_justify(GTK_LABEL(info_label), GTK_JUSTIFY_LEFT);
     gtk_widget_set_halign(info_label, GTK_ALIGN_START);
     gtk_box_pack_start(GTK_BOX(info_vbox), info_label, FALSE, FALSE, 0);
 
+    // Per-event script cost
+    GtkWidget *stats_frame = gtk_frame_new("Event Cost");
+    gtk_box_pack_start(GTK_BOX(main_vbox), stats_frame, FALSE, FALSE, 0);
+
+    terminal->script_stats_label = gtk_label_new("");
+    gtk_label_set_justify(GTK_LABEL(terminal->script_stats_label), GTK_JUSTIFY_LEFT);
+    gtk_widget_set_halign(terminal->script_stats_label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(terminal->script_stats_label, 10);
+    gtk_container_add(GTK_CONTAINER(stats_frame), terminal->script_stats_label);
+    update_script_stats_label(terminal);
+    terminal->script_stats_timer_id = g_timeout_add(1000, update_script_stats_label, terminal);
+
     // Connect window destroy signal
     g_signal_connect(terminal->script_window, "destroy", G_CALLBACK(on_script_window_destroy), terminal);
 
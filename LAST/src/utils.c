@@ -1,9 +1,13 @@
 /*
  * Utility functions module for LAST - Linux Advanced Serial Transceiver
- * Handles data formatting, timestamps, and statistics
+ * Handles data formatting, timestamps, metrics snapshots, and macro sending
  */
 
 #include "utils.h"
+#include "serial.h"
+#include "metrics_http.h"
+#include "network.h"
+#include "scripting.h"
 
 char* format_data_for_display(const char *data, size_t data_len, gboolean hex_mode) {
     if (!hex_mode) {
@@ -68,33 +72,39 @@ char* get_current_timestamp(void) {
     return timestamp;
 }
 
-void update_statistics(SerialTerminal *terminal) {
-    if (!terminal->stats_label) return;
-
-    char stats_text[256];
-
-    if (terminal->connected) {
-        time_t current_time = time(NULL);
-        int connection_duration = (int)(current_time - terminal->connection_start_time);
-        int hours = connection_duration / 3600;
-        int minutes = (connection_duration % 3600) / 60;
-        int seconds = connection_duration % 60;
-
-        snprintf(stats_text, sizeof(stats_text),
-                "Sent: %lu bytes | Received: %lu bytes | Time: %02d:%02d:%02d",
-                terminal->bytes_sent, terminal->bytes_received, hours, minutes, seconds);
-    } else {
-        snprintf(stats_text, sizeof(stats_text),
-                "Sent: %lu bytes | Received: %lu bytes | Time: 00:00:00",
-                terminal->bytes_sent, terminal->bytes_received);
-    }
-
-    gtk_label_set_text(GTK_LABEL(terminal->stats_label), stats_text);
+// Connection counters and script cost in the Prometheus text format.
+// Byte counters restart with every connection, which Prometheus reads as a
+// counter reset.
+static void metrics_format_prometheus(SerialTerminal *terminal, GString *out) {
+    g_string_append_printf(out,
+        "# HELP last_connected 1 while a serial or network connection is open\n"
+        "# TYPE last_connected gauge\n"
+        "last_connected{type=\"%s\"} %d\n"
+        "# HELP last_connections_total Connections opened since startup, reconnects included\n"
+        "# TYPE last_connections_total counter\n"
+        "last_connections_total %lu\n"
+        "# HELP last_connection_seconds Time the current connection has been open\n"
+        "# TYPE last_connection_seconds gauge\n"
+        "last_connection_seconds %ld\n"
+        "# HELP last_bytes_sent_total Bytes sent on the current connection\n"
+        "# TYPE last_bytes_sent_total counter\n"
+        "last_bytes_sent_total %lu\n"
+        "# HELP last_bytes_received_total Bytes received on the current connection\n"
+        "# TYPE last_bytes_received_total counter\n"
+        "last_bytes_received_total %lu\n",
+        connection_type_to_string(terminal->connection_type), terminal->connected ? 1 : 0,
+        terminal->connection_count,
+        terminal->connected ? (long)(time(NULL) - terminal->connection_start_time) : 0L,
+        terminal->bytes_sent, terminal->bytes_received);
+
+    scripting_format_prometheus(terminal, out);
 }
 
-gboolean update_statistics_timer(gpointer data) {
-    update_statistics((SerialTerminal *)data);
-    return TRUE; // Continue timer
+// Hand the metrics endpoint a fresh snapshot, formatted on the main thread
+void publish_metrics(SerialTerminal *terminal) {
+    GString *text = g_string_sized_new(4096);
+    metrics_format_prometheus(terminal, text);
+    metrics_http_publish(terminal->metrics_http, text);
 }
 
 // Macro chaining implementation
@@ -306,6 +316,31 @@ void free_macro_parts(MacroParts *parts) {
     free(parts);
 }
 
+// Send a macro command, giving each chained macro reference its own line ending
+void send_macro_command(SerialTerminal *terminal, const char *command, int macro_index) {
+    if (!terminal || !command || !terminal->connected || strlen(command) == 0) return;
+
+    // Parse command into parts to handle macro chaining properly
+    MacroParts *parts = parse_macro_command(terminal, command, macro_index);
+    if (!parts) {
+        // Fallback to sending as single command
+        connection_send_line(terminal, command, terminal->line_ending);
+        return;
+    }
+
+    // Send each part
+    for (int i = 0; i < parts->count; i++) {
+        if (parts->parts[i] && strlen(parts->parts[i]) > 0) {
+            // Each macro reference gets its own line ending
+            // Regular text parts are combined until the next macro reference
+            gboolean add_ending = parts->is_macro_ref[i] || (i == parts->count - 1);
+            connection_send_line(terminal, parts->parts[i], add_ending ? terminal->line_ending : NULL);
+        }
+    }
+
+    free_macro_parts(parts);
+}
+
 char* expand_macro_references(SerialTerminal *terminal, const char *command, int current_macro_index) {
     if (!terminal || !command) return NULL;
 
@@ -5,18 +5,15 @@
 
 /*
  * Utility functions module for LAST
- * Handles data formatting, timestamps, and statistics
+ * Handles data formatting, timestamps, metrics snapshots, and macro sending
  */
 
 // Data formatting functions
 char* format_data_for_display(const char *data, size_t data_len, gboolean hex_mode);
 char* get_current_timestamp(void);
 
-// Statistics functions
-void update_statistics(SerialTerminal *terminal);
-
-// Timer callback for statistics updates
-gboolean update_statistics_timer(gpointer data);
+// Metrics endpoint snapshot (main thread)
+void publish_metrics(SerialTerminal *terminal);
 
 // Macro chaining structures and functions
 typedef struct {
@@ -28,6 +25,7 @@ typedef struct {
 char* expand_macro_references(SerialTerminal *terminal, const char *command, int current_macro_index);
 MacroParts* parse_macro_command(SerialTerminal *terminal, const char *command, int current_macro_index);
 void free_macro_parts(MacroParts *parts);
+void send_macro_command(SerialTerminal *terminal, const char *command, int macro_index);
 int resolve_macro_by_name(SerialTerminal *terminal, const char *name);
 int resolve_macro_by_number(const char *number_str);
 gboolean has_macro_reference(const char *command);
@@ -102,7 +102,6 @@ System Requirements:
   • Linux with GTK3
   • GCC compiler
   • Make build system
-  • socat utility
 
 License: MIT License
 Author: Fragillidae Software - Chuck Finch
@@ -87,15 +87,16 @@ if ! command_exists pkg-config; then
     MISSING_DEPS+=("pkg-config")
 fi
 
-if ! command_exists socat; then
-    MISSING_DEPS+=("socat")
-fi
-
 # Check for GTK3 development libraries
 if ! pkg-config --exists gtk+-3.0; then
     MISSING_DEPS+=("libgtk-3-dev")
 fi
 
+# BRIDGE compresses sniff logs with zlib
+if ! pkg-config --exists zlib; then
+    MISSING_DEPS+=("zlib1g-dev")
+fi
+
 if [ ${#MISSING_DEPS[@]} -ne 0 ]; then
     echo -e "${RED}Missing dependencies: ${MISSING_DEPS[*]}${NC}"
     echo ""
@@ -103,13 +104,13 @@ if [ ${#MISSING_DEPS[@]} -ne 0 ]; then
     echo ""
     echo -e "${YELLOW}Ubuntu/Debian:${NC}"
     echo "sudo apt-get update"
-    echo "sudo apt-get install build-essential libgtk-3-dev socat pkg-config"
+    echo "sudo apt-get install build-essential libgtk-3-dev zlib1g-dev pkg-config"
     echo ""
     echo -e "${YELLOW}Fedora:${NC}"
-    echo "sudo dnf install gcc make gtk3-devel socat pkgconf-pkg-config"
+    echo "sudo dnf install gcc make gtk3-devel zlib-devel pkgconf-pkg-config"
     echo ""
     echo -e "${YELLOW}Arch Linux:${NC}"
-    echo "sudo pacman -S base-devel gtk3 socat pkgconf"
+    echo "sudo pacman -S base-devel gtk3 zlib pkgconf"
     echo ""
     exit 1
 fi
@@ -145,12 +145,6 @@ else
     echo -e "${YELLOW}⚠${NC} GTK3 development libraries missing (needed for build)"
 fi
 
-if command -v socat >/dev/null 2>&1; then
-    echo -e "${GREEN}✓${NC} socat utility found"
-else
-    echo -e "${YELLOW}⚠${NC} socat utility missing (needed for BRIDGE)"
-fi
-
 # Test clean build
 echo ""
 echo "Testing clean build..."